@@ -0,0 +1,171 @@
+/*
+Microbenchmarks for the parsing and lookup hot paths.
+
+Usage: `Bench.exe [files...]`; see also `make bench`. Each benchmark is run over
+each file which parses as an ELF `Binary`; file-independent ones are run once.
+Results go to stdout as JSON lines, one per benchmark and file, e.g.:
+
+  {"bench":"symtab_each","file":"a.out","iters":4096,"ns_per_op":812.5}
+
+Each result is the best of several timed repetitions, with the iteration count
+scaled so that each repetition takes roughly `kTargetNanos`.
+*/
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <proginfo/binary/Binary.h>
+#include <proginfo/binary/Section.h>
+#include <proginfo/binary/SymbolTable.h>
+#include <proginfo/symbolize/SymbolIndex.h>
+#include <proginfo/util/Alloc.h>
+#include <proginfo/util/MMap.h>
+#include <string_view>
+#include <vector>
+
+using namespace proginfo;
+
+namespace {
+
+constexpr uint64_t kTargetNanos = 20'000'000;
+constexpr unsigned kReps = 5;
+
+using Clock = std::chrono::steady_clock;
+
+// Keeps results alive so the optimizer can't discard the work being timed
+uint64_t volatile gSink;
+
+/** Time `fn` (which does one operation per call); print the result. */
+template <class F>
+void bench(char const* name, std::string_view file, F&& fn) {
+  uint64_t iters = 1;
+  double best = 0;
+  for (unsigned rep = 0; rep < kReps;) {
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < iters; i++) { fn(); }
+    auto elapsed = Clock::now() - start;
+    auto nanos = uint64_t(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    if (nanos < kTargetNanos / 10 && iters < (uint64_t(1) << 40)) {
+      iters *= 8;  // Too quick to measure well; not counted as a repetition
+      continue;
+    }
+    auto perOp = double(nanos) / double(iters);
+    if (!rep++ || perOp < best) { best = perOp; }
+  }
+  printf("{\"bench\":\"%s\",\"file\":\"%.*s\",\"iters\":%llu,"
+         "\"ns_per_op\":%.1f}\n",
+         name,
+         int(file.size()),
+         file.data(),
+         (unsigned long long) iters,
+         best);
+  fflush(stdout);
+}
+
+void benchFile(std::string_view path) {
+  util::MMap mm(path);
+  if (!mm) {
+    fprintf(stderr, "Bench: can't map %.*s\n", int(path.size()), path.data());
+    return;
+  }
+  auto bin = binary::Binary::at(mm.addr_, mm.size_, false, false);
+  if (!bin || !bin->isELF()) {
+    // (Mach-O parsing isn't implemented yet)
+    fprintf(stderr, "Bench: can't parse %.*s\n", int(path.size()), path.data());
+    return;
+  }
+
+  bench("binary_at", path, [&] {
+    auto b = binary::Binary::at(mm.addr_, mm.size_, false, false);
+    gSink = b->secHeaderCount();
+  });
+
+  // Look up the last section by name, i.e. the worst case for a linear search
+  std::string_view lastName;
+  bin->eachSection([&](auto& sec) {
+    lastName = sec.name();
+    return true;
+  });
+  if (!lastName.empty()) {
+    bench("section_by_name", path, [&] {
+      gSink = bin->section(lastName)->size();
+    });
+  }
+
+  auto symTable = bin->symTable();
+  if (!symTable) { return; }
+
+  bench("symtab_each", path, [&] {
+    uint64_t sum = 0;
+    symTable->each([&](auto& sym) {
+      sum += sym.value() + sym.name().size();
+      return true;
+    });
+    gSink = sum;
+  });
+
+  symbolize::SymbolIndex index;
+  bench("symindex_build", path, [&] { gSink = index.build(*bin); });
+  if (!index.size()) { return; }
+
+  // Addresses spread over the indexed range, from the first symbol to the last
+  std::vector<uintptr_t> addrs(4096);
+  auto lo = index.minAddr();
+  auto hi = index.maxAddr();
+  uint64_t x = 0x9e3779b97f4a7c15;
+  for (auto& addr : addrs) {
+    x ^= x << 13, x ^= x >> 7, x ^= x << 17;
+    addr = lo + uintptr_t(x % (hi - lo + 1));
+  }
+  size_t next = 0;
+  bench("symindex_lookup", path, [&] {
+    auto* e = index.lookup(addrs[next++ % addrs.size()]);
+    gSink = e ? e->addr : 0;
+  });
+}
+
+void benchAlloc() {
+  alignas(std::max_align_t) static std::byte space[65536];
+  util::Alloc alloc(space, sizeof(space));
+  constexpr unsigned kSizes[] = {16, 24, 40, 64, 96, 128, 200, 48};
+  std::byte* live[8] {};
+  for (unsigned i = 0; i < 8; i++) { live[i] = alloc.alloc(kSizes[i]); }
+  size_t next = 0;
+  // Steady state churn: free one block, and allocate another of a new size
+  bench("alloc_churn", "", [&] {
+    auto i = next++ % 8;
+    alloc.dealloc(live[i]);
+    live[i] = alloc.alloc(kSizes[(i + next / 8) % 8]);
+    gSink = uintptr_t(live[i]);
+  });
+  for (auto* ptr : live) { alloc.dealloc(ptr); }
+}
+
+void benchDecode(std::string_view path) {
+  util::MMap mm(path);
+  if (!mm || mm.size_ < 4) { return; }
+  util::Addr addr {mm.addr_, mm.size_};
+  auto end = mm.size_ - 3;
+  size_t offset = 0;
+  bench("u32LE", path, [&] {
+    gSink = addr.u32LE(offset);
+    offset = (offset + 4) % end;
+  });
+  bench("u32BE", path, [&] {
+    gSink = addr.u32BE(offset);
+    offset = (offset + 4) % end;
+  });
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  benchAlloc();
+  util::Alloc alloc;
+  for (int i = 1; i < argc; i++) {
+    benchFile(argv[i]);
+    benchDecode(argv[i]);
+  }
+}
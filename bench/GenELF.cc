@@ -0,0 +1,69 @@
+/*
+Writes a synthetic ELF file; see `test/GenELF.h`.
+
+Usage: `GenELF.exe OUTPUT [--32|--64] [--le|--be] [--symbols N]
+        [--sections N] [--cus N] [--fdes N] [--func-size N]`
+*/
+
+#include "../test/GenELF.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+int main(int argc, char** argv) {
+  GenELF::Options opts;
+  char const* path = nullptr;
+  auto usage = [&] {
+    fprintf(stderr,
+            "usage: %s OUTPUT [--32|--64] [--le|--be] [--symbols N] "
+            "[--sections N] [--cus N] [--fdes N] [--func-size N]\n",
+            argv[0]);
+    return 1;
+  };
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    auto num = [&](uint32_t* out) {
+      if (i + 1 >= argc) { return false; }
+      char* end;
+      auto val = strtoul(argv[++i], &end, 0);
+      *out = uint32_t(val);
+      return !*end && val == *out;
+    };
+    bool ok = true;
+    if (arg == "--32") {
+      opts.is64 = false;
+    } else if (arg == "--64") {
+      opts.is64 = true;
+    } else if (arg == "--le") {
+      opts.isLE = true;
+    } else if (arg == "--be") {
+      opts.isLE = false;
+    } else if (arg == "--symbols") {
+      ok = num(&opts.symbols);
+    } else if (arg == "--sections") {
+      ok = num(&opts.sections) && opts.sections <= GenELF::kMaxSections;
+    } else if (arg == "--cus") {
+      ok = num(&opts.cus) && opts.cus;
+    } else if (arg == "--fdes") {
+      ok = num(&opts.fdes);
+    } else if (arg == "--func-size") {
+      ok = num(&opts.funcSize) && opts.funcSize >= 4;
+    } else if (!path && arg[0] != '-') {
+      path = argv[i];
+    } else {
+      ok = false;
+    }
+    if (!ok) { return usage(); }
+  }
+  if (!path) { return usage(); }
+  if (!opts.is64 && GenELF::symbolAddr(opts, opts.symbols) > UINT32_MAX) {
+    fprintf(stderr, "%s: too many symbols for ELF32\n", argv[0]);
+    return 1;
+  }
+  if (!GenELF::write(opts, path)) {
+    fprintf(stderr, "%s: can't write %s: %s\n", argv[0], path, strerror(errno));
+    return 1;
+  }
+}
@@ -1,6 +1,7 @@
 #pragma once
 static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
 
+#include "Demangle.h"
 #include "detail/Binary.h"
 #include "elf/ELF.h"
 #include "elf/ELF32.h"
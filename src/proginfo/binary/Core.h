@@ -0,0 +1,268 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "Binary.h"
+#include "elf/Notes.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+namespace proginfo::binary {
+
+/*
+Reader for ELF core dumps (`ET_CORE`), e.g. for producing backtraces offline.
+
+A core file's `PT_NOTE` segments describe the dumped process: one `NT_PRSTATUS`
+note per thread, with its registers; and an `NT_FILE` note, listing which files
+were mapped where (i.e. where to find the binaries, and their load addresses).
+Its `PT_LOAD` segments hold the process's memory, which `memory` presents as an
+address space, pointing straight into the (typically `mmap`ped) core file;
+nothing is copied.
+
+Like `Binary`, this doesn't allocate, and the core must outlive it.  Register
+layouts are known for x86-64, AArch64, and i386; for other machines, threads'
+`pc`, `sp` and `fp` are zero, but `regs` still holds the raw `pr_reg` contents.
+*/
+class Core {
+public:
+  using Note = binary::Note;  // Names are e.g. "CORE", "LINUX"
+
+  struct Thread {
+    uint32_t pid;
+    uint16_t signal;  // Signal which caused the dump (if any); `pr_cursig`
+    uintptr_t pc;
+    uintptr_t sp;
+    uintptr_t fp;
+    util::Addr regs;  // Raw register set (`pr_reg`), in the core's byte order
+  };
+
+  struct MappedFile {
+    uintptr_t start;
+    uintptr_t end;
+    uint64_t fileOffset;  // Offset within `path` which is mapped at `start`
+    std::string_view path;
+  };
+
+  constexpr static uint32_t kPTLoad = 1;
+  constexpr static uint32_t kPTNote = 4;
+  constexpr static uint32_t kNTPRStatus = 1;
+  constexpr static uint32_t kNTFile = 0x46494c45;  // "FILE"
+
+  constexpr static uint16_t kEM386 = 3;
+  constexpr static uint16_t kEMX86_64 = 62;
+  constexpr static uint16_t kEMAArch64 = 183;
+
+private:
+  ELF const* elf_ {};
+  bool is64_ {};
+  size_t phOffset_ {};
+  size_t phSize_ {};
+  unsigned phCount_ {};
+  unsigned loadBegin_ {};  // Range of program headers which are all `PT_LOAD`
+  unsigned loadEnd_ {};
+
+  struct Phdr {
+    uint32_t type;
+    uint64_t offset;
+    uint64_t vaddr;
+    uint64_t fileSize;
+  };
+
+  Phdr phdr(unsigned i) const {
+    auto off = phOffset_ + i * phSize_;
+    if (is64_) {
+      return {elf_->u32(off),
+              elf_->u64(off + 0x08),
+              elf_->u64(off + 0x10),
+              elf_->u64(off + 0x20)};
+    }
+    return {elf_->u32(off),
+            elf_->u32(off + 0x04),
+            elf_->u32(off + 0x08),
+            elf_->u32(off + 0x10)};
+  }
+
+  size_t fileSize() const { return elf_->baseAddr().size_; }
+
+  uint64_t word(util::Addr const& addr, size_t off) const {
+    auto le = elf_->isLE();
+    if (is64_) { return le ? addr.u64LE(off) : addr.u64BE(off); }
+    return le ? addr.u32LE(off) : addr.u32BE(off);
+  }
+
+  uint32_t u32(util::Addr const& addr, size_t off) const {
+    return elf_->isLE() ? addr.u32LE(off) : addr.u32BE(off);
+  }
+
+  uint16_t u16(util::Addr const& addr, size_t off) const {
+    return elf_->isLE() ? addr.u16LE(off) : addr.u16BE(off);
+  }
+
+  /** Where `pr_reg` starts in `elf_prstatus`, and indexes of pc, sp, fp. */
+  struct RegLayout {
+    size_t regsOffset;
+    size_t regsSize;
+    int pc;
+    int sp;
+    int fp;
+  };
+
+  RegLayout regLayout() const {
+    switch (elf_->machine()) {
+    case kEMX86_64:  return {112, 27 * 8, 16, 19, 4};
+    case kEMAArch64: return {112, 34 * 8, 32, 31, 29};
+    case kEM386:     return {72, 17 * 4, 12, 15, 5};
+    default:         return {is64_ ? 112u : 72u, 0, -1, -1, -1};
+    }
+  }
+
+public:
+  /** `bin` should be an ELF core (see `Binary::isCore`); else this is empty. */
+  explicit Core(Binary const& bin) {
+    if (!bin.isELF() || !bin.isCore()) { return; }
+    elf_ = dynamic_cast<ELF const*>(&bin);
+    is64_ = bin.is64();
+    phOffset_ = elf_->segHeaderOffset();
+    phSize_ = elf_->segHeaderSize();
+    phCount_ = unsigned(bin.segHeaderCount());
+    if (phCount_ == 0xffff) {
+      // `PN_XNUM`: too many for the header; the count is in section 0's
+      // `sh_info` instead
+      auto sh = elf_->secHeaderOffset();
+      auto infoOff = sh + (is64_ ? 0x2c : 0x1c);
+      phCount_ = (sh && infoOff + 4 <= fileSize()) ? elf_->u32(infoOff) : 0;
+    }
+    if (phOffset_ > fileSize() ||
+        phCount_ * phSize_ > fileSize() - phOffset_ ||
+        phSize_ < (is64_ ? 56u : 32u)) {
+      elf_ = nullptr;
+      return;
+    }
+    // `PT_LOAD`s are sorted by address, and the kernel (and gdb's `gcore`)
+    // write them all together, after the notes.  Find that run, so `memory`
+    // can binary-search it.
+    unsigned i = 0;
+    while (i < phCount_ && phdr(i).type != kPTLoad) { ++i; }
+    loadBegin_ = i;
+    while (i < phCount_ && phdr(i).type == kPTLoad) { ++i; }
+    loadEnd_ = i;
+  }
+
+  operator bool() const { return elf_; }
+
+  /**
+  Call `cb` with each note in the `PT_NOTE` segments, until it returns false.
+  The `desc` of each is checked to be within the file.
+  */
+  void eachNote(std::function<bool(Note const&)> cb) const {
+    if (!elf_) { return; }
+    for (unsigned i = 0; i < phCount_; i++) {
+      auto ph = phdr(i);
+      if (ph.type != kPTNote) { continue; }
+      if (ph.offset > fileSize() || ph.fileSize > fileSize() - ph.offset) {
+        continue;
+      }
+      auto notes = (elf_->baseAddr() + ph.offset).trunc(ph.fileSize);
+      NoteReader reader(notes, elf_->isLE());
+      while (auto note = reader.next()) {
+        if (!cb(*note)) { return; }
+      }
+    }
+  }
+
+  /** Call `cb` with each thread (`NT_PRSTATUS` note) until it returns false. */
+  void eachThread(std::function<bool(Thread const&)> cb) const {
+    if (!elf_) { return; }
+    auto layout = regLayout();
+    eachNote([&](Note const& note) {
+      if (note.type != kNTPRStatus || note.name != "CORE") { return true; }
+      auto& desc = note.desc;
+      if (desc.size_ < layout.regsOffset + layout.regsSize) { return true; }
+      Thread thread {};
+      thread.signal = u16(desc, 12);
+      thread.pid = u32(desc, is64_ ? 32 : 24);
+      thread.regs = (desc + layout.regsOffset).trunc(layout.regsSize);
+      auto reg = [&](int index) -> uintptr_t {
+        if (index < 0) { return 0; }
+        return uintptr_t(word(thread.regs, size_t(index) * (is64_ ? 8 : 4)));
+      };
+      thread.pc = reg(layout.pc);
+      thread.sp = reg(layout.sp);
+      thread.fp = reg(layout.fp);
+      return cb(thread);
+    });
+  }
+
+  /**
+  Call `cb` with each file mapping (from the `NT_FILE` note) until it returns
+  false.  These are in address order; a file usually has several.
+  */
+  void eachFile(std::function<bool(MappedFile const&)> cb) const {
+    size_t const w = is64_ ? 8 : 4;
+    eachNote([&](Note const& note) {
+      if (note.type != kNTFile || note.name != "CORE") { return true; }
+      auto& desc = note.desc;
+      if (desc.size_ < 2 * w) { return false; }
+      auto count = word(desc, 0);
+      auto pageSize = word(desc, w);
+      if (count > (desc.size_ - 2 * w) / (3 * w)) { return false; }
+      auto names = (desc + (2 + 3 * count) * w).str();
+      for (uint64_t i = 0; i < count; i++) {
+        auto entry = (2 + 3 * i) * w;
+        auto end = names.find('\0');
+        MappedFile file {uintptr_t(word(desc, entry)),
+                         uintptr_t(word(desc, entry + w)),
+                         word(desc, entry + 2 * w) * pageSize,
+                         names.substr(0, end)};
+        if (!cb(file)) { return false; }
+        names.remove_prefix((end == names.npos) ? names.size() : end + 1);
+      }
+      return false;  // Only one `NT_FILE` is expected
+    });
+  }
+
+  /**
+  The dumped process's memory at `addr`, up to `size` bytes, or less if the
+  dump doesn't have all of it (e.g. it's at the end of a segment, or the
+  segment's contents weren't dumped).  Empty if `addr` isn't in the dump.
+  The result points into the core file.
+  */
+  util::Addr memory(uintptr_t addr, size_t size) const {
+    if (!elf_) { return {}; }
+    // Last `PT_LOAD` (in the sorted run) starting at or before `addr`
+    unsigned lo = loadBegin_;
+    unsigned hi = loadEnd_;
+    while (lo < hi) {
+      auto mid = lo + (hi - lo) / 2;
+      if (phdr(mid).vaddr <= addr) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    if (lo == loadBegin_) { return {}; }
+    auto ph = phdr(lo - 1);
+    auto delta = addr - ph.vaddr;
+    if (delta >= ph.fileSize || ph.offset > fileSize()) { return {}; }
+    auto avail = std::min<uint64_t>(ph.fileSize, fileSize() - ph.offset);
+    if (delta >= avail) { return {}; }
+    auto len = std::min<uint64_t>(size, avail - delta);
+    return (elf_->baseAddr() + size_t(ph.offset + delta)).trunc(size_t(len));
+  }
+
+  /** Read a pointer-sized word of the process's memory; false if not dumped. */
+  bool readWord(uintptr_t addr, uintptr_t* out) const {
+    size_t const w = is64_ ? 8 : 4;
+    auto mem = memory(addr, w);
+    if (mem.size_ < w) { return false; }
+    *out = uintptr_t(word(mem, 0));
+    return true;
+  }
+};
+
+}  // namespace proginfo::binary
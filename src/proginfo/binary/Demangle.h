@@ -0,0 +1,1387 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory_resource>
+#include <string_view>
+
+namespace proginfo::binary {
+
+// clang-format off
+
+/*
+Receives demangled output, one character at a time.
+
+By default this writes into a caller-provided buffer of `cap` bytes, keeping at
+most `cap - 1` characters and always leaving room for a NUL terminator (see
+`finish`). Output past that is dropped, but still counted, so (like `snprintf`)
+one can tell how big the buffer would have needed to be, by way of `total()`.
+
+Alternatively a `flush` function can be supplied; in that case the buffer is
+just a staging area and `flush` is handed each full buffer (and whatever remains
+at `finish`). Nothing is ever truncated in this mode, so a small buffer can
+stream arbitrarily long names to, e.g., a file descriptor.
+
+Neither mode allocates, and neither calls anything besides `flush`.
+*/
+
+class DemangleSink {
+public:
+  using FlushFn = void (*)(void* ctx, char const* data, size_t size);
+
+private:
+  friend class Demangler;
+
+  char* buf_;
+  size_t cap_;
+  size_t used_ {};
+  size_t total_ {};
+  FlushFn flush_ {};
+  void* ctx_ {};
+  char last_ {};          // Most recent (unmuted) char, to avoid emitting `>>`
+  unsigned mute_ {};      // While nonzero, output is discarded
+  std::string_view sep_;  // To emit before the next list item, if there is one
+
+  void doFlush() {
+    if (used_) { flush_(ctx_, buf_, used_); }
+    used_ = 0;
+  }
+
+  void putChar(char c) {
+    ++total_;
+    last_ = c;
+    if (flush_) {
+      if (used_ == cap_) { doFlush(); }
+      buf_[used_++] = c;
+    } else if (used_ + 1 < cap_) {
+      buf_[used_++] = c;
+    }
+  }
+
+  // List separators are deferred, since a list item (e.g. an empty parameter
+  // pack) might not produce any output.
+  void sep(std::string_view sep) {
+    if (!mute_) { sep_ = sep; }
+  }
+
+  void endList() {
+    if (!mute_) { sep_ = {}; }
+  }
+
+public:
+  /** Write into `buf`, truncating as needed (see `truncated`). */
+  DemangleSink(char* buf, size_t cap) : buf_(buf), cap_(cap) {}
+
+  /** Stage output in `buf`, passing it to `flush` whenever it fills up. */
+  DemangleSink(char* buf, size_t cap, FlushFn flush, void* ctx)
+      : buf_(buf), cap_(cap), flush_(flush), ctx_(ctx) {
+    assert(cap);
+  }
+
+  DemangleSink(DemangleSink const&) = delete;
+  DemangleSink& operator=(DemangleSink const&) = delete;
+
+  void put(char c) {
+    if (mute_) { return; }
+    if (!sep_.empty()) {
+      auto sep = sep_;
+      sep_ = {};
+      for (char s : sep) { putChar(s); }
+    }
+    putChar(c);
+  }
+
+  void put(std::string_view str) {
+    for (char c : str) { put(c); }
+  }
+
+  /** NUL-terminate the buffer, or flush any remaining output, if streaming. */
+  void finish() {
+    if (flush_) {
+      doFlush();
+    } else if (cap_) {
+      buf_[used_] = '\0';
+    }
+  }
+
+  /** Discard output so far, e.g. to write something else after failing. */
+  void reset() {
+    assert(!flush_);  // Can't un-flush things
+    used_ = 0;
+    total_ = 0;
+    last_ = '\0';
+    sep_ = {};
+  }
+
+  /** Total number of characters produced, including any which didn't fit. */
+  size_t total() const { return total_; }
+
+  /** Whether some output was dropped for lack of space (never if streaming). */
+  bool truncated() const { return !flush_ && total_ >= cap_; }
+
+  /** Characters currently in the buffer (not meaningful when streaming). */
+  std::string_view str() const { return {buf_, used_}; }
+};
+
+/*
+Itanium C++ ABI (i.e. GCC / Clang) demangler which never touches the heap, so
+unlike `abi::__cxa_demangle`, it's safe to use from a signal handler.
+
+Output is written to a `DemangleSink` as we go, and aims to look like GNU
+`c++filt`.
+
+Mangled names are compressed with back-references ("substitutions" and template
+parameters) to earlier parts of the name.  Most demanglers build a tree of nodes
+for the whole name, so those references can point into it.  We instead only
+remember where each referenceable component lies within the mangled string, and
+re-parse that range whenever it's referenced.  Each such entry is an `Entry` in
+a table in caller-provided scratch memory; substitutions grow from the start of
+that table, and the current template arguments from the end.  A name needing
+more entries than fit will fail to demangle, rather than growing the table.
+
+Since output is streamed, things which appear in the mangled string *after* they
+are supposed to be printed (e.g. return types of function templates) are dealt
+with by parsing the earlier part once with output muted, then replaying it
+afterwards.
+
+Recursion depth and total work are both capped, so pathological input fails
+quickly instead of blowing the (possibly small, alternate signal) stack.
+
+Typical use is via the `demangle` function below; use this class directly to
+control scratch space or to stream output elsewhere.
+*/
+
+class Demangler {
+public:
+  // Substitution or template argument: a range of the mangled string, to be
+  // re-parsed as the given kind of thing.
+  struct Entry {
+    uint32_t begin;
+    uint32_t end;
+    uint8_t kind;
+  };
+
+  // A reasonable amount of scratch for most names, small enough to fit in
+  // `util::Alloc`.
+  constexpr static unsigned kDefaultEntries = 40;
+  constexpr static size_t kDefaultScratch = kDefaultEntries * sizeof(Entry);
+
+private:
+  enum Kind : uint8_t { kType, kPrefix, kUnscoped, kTemplateArg };
+
+  constexpr static unsigned kMaxDepth = 128;    // Recursion limit
+  constexpr static unsigned kBudget = 1 << 16;  // Limit on parse steps
+  constexpr static unsigned kMaxLevels = 8;     // Pointers, etc. on one type
+
+  // Pointer, reference, or CV-qualifier applied to some type.
+  struct Level {
+    uint32_t begin;
+    char kind;   // 'P', 'R', 'O', or 'K' (for any CV-qualifiers)
+    uint8_t cv;  // if 'K': bitmask of kConst etc.
+  };
+
+  constexpr static uint8_t kConst = 1;
+  constexpr static uint8_t kVolatile = 2;
+  constexpr static uint8_t kRestrict = 4;
+
+  // Details of the most recently parsed name, needed for deciding how to print
+  // things.
+  struct NameState {
+    uint8_t cv;          // CV-qualifiers of a nested name (const member fn)
+    char ref;            // and its ref-qualifier, if any ('R' or 'O')
+    bool ctorDtorConv;   // Constructor, destructor, or conversion operator
+    bool endsWithTArgs;  // Name is a template specialization
+  };
+
+  Entry* table_;
+  unsigned cap_;
+  std::pmr::memory_resource* mr_ {};
+  size_t size_ {};  // Bytes obtained from `mr_`
+
+  std::string_view src_;
+  size_t pos_ {};
+  DemangleSink* out_ {};
+  unsigned subs_ {};       // Number of substitutions, at start of `table_`
+  unsigned targs_ {};      // Number of template args, at end of `table_`
+  unsigned targBase_ {};   // Where innermost encoding's template args start
+  unsigned encodings_ {};  // Nesting level of encodings (in local names)
+  unsigned replay_ {};     // While nonzero, re-parsing; don't record
+  unsigned depth_ {};
+  unsigned budget_ {};
+  bool failed_ {};             // Set if we ran out of scratch space
+  bool tagTArgs_ {};           // Template args are those of the encoding's name
+  int packIndex_ {-2};         // Pack element to print (-1: probing, -2: none)
+  int packSize_ {-1};          // Size of pack found while probing an expansion
+  std::string_view lastName_;  // Last source name seen, for ctors / dtors
+  char lastRef_ {};            // 'R' or 'O' if the last type was a reference
+  bool local_ {};              // Encoding is the scope of a local name
+  NameState name_ {};
+
+public:
+  /** Use `size` bytes at `scratch` for tables. */
+  Demangler(void* scratch, size_t size)
+      : table_((Entry*) scratch)
+      , cap_(unsigned(size / sizeof(Entry))) {
+    assert(!(uintptr_t(scratch) % alignof(Entry)));
+  }
+
+  /** Get scratch space from `mr` (e.g. a `util::Alloc`); returned when done. */
+  explicit Demangler(
+      std::pmr::memory_resource& mr, size_t size = kDefaultScratch)
+      : table_((Entry*) mr.allocate(size, alignof(Entry)))
+      , cap_(unsigned(size / sizeof(Entry)))
+      , mr_(&mr)
+      , size_(size) {}
+
+  ~Demangler() {
+    if (mr_) { mr_->deallocate(table_, size_, alignof(Entry)); }
+  }
+
+  Demangler(Demangler const&) = delete;
+  Demangler(Demangler&&) = delete;
+  Demangler& operator=(Demangler const&) = delete;
+  Demangler& operator=(Demangler&&) = delete;
+
+  /**
+  Demangle `mangled` (which should start with `_Z`, or `__Z` for Mach-O symbols)
+  into `out`. Returns false if this isn't a mangled name, or it's malformed, or
+  uses some feature we don't support, or we ran out of scratch space.  In that
+  case `out` will have some partial output, which the caller will probably want
+  to `reset`.
+  */
+  bool demangle(std::string_view mangled, DemangleSink& out) {
+    src_ = mangled;
+    pos_ = 0;
+    out_ = &out;
+    subs_ = targs_ = targBase_ = encodings_ = replay_ = depth_ = 0;
+    budget_ = kBudget;
+    failed_ = false;
+    tagTArgs_ = false;
+    packIndex_ = -2;
+    packSize_ = -1;
+    lastName_ = {};
+    lastRef_ = '\0';
+    local_ = false;
+    name_ = {};
+    if (mangled.size() > UINT32_MAX) { return false; }
+    if (!consume("_Z") && !consume("__Z")) { return false; }
+    if (!parseEncoding()) { return false; }
+    while (peek() == '.') {
+      if (!parseCloneSuffix()) { return false; }
+    }
+    return !failed_ && pos_ == src_.size();
+  }
+
+private:
+  // Guards recursion depth and total work; every recursive parse function
+  // creates one.
+  struct Enter {
+    Demangler& d_;
+    bool const ok_;
+    explicit Enter(Demangler& d)
+        : d_(d), ok_(++d.depth_ < kMaxDepth && d.budget_ && d.budget_--) {}
+    ~Enter() { --d_.depth_; }
+  };
+
+  char peek(size_t ahead = 0) const {
+    return pos_ + ahead < src_.size() ? src_[pos_ + ahead] : '\0';
+  }
+
+  bool consume(char c) {
+    if (peek() != c) { return false; }
+    ++pos_;
+    return true;
+  }
+
+  bool consume(std::string_view str) {
+    if (src_.substr(pos_, str.size()) != str) { return false; }
+    pos_ += str.size();
+    return true;
+  }
+
+  static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+  static bool isUpper(char c) { return c >= 'A' && c <= 'Z'; }
+  static bool isLower(char c) { return c >= 'a' && c <= 'z'; }
+
+  void put(char c) { out_->put(c); }
+  void put(std::string_view str) { out_->put(str); }
+
+  /**
+  Separate items of a list, but only once some item (the list started at
+  `listStart`) has produced output.
+  */
+  void listSep(size_t listStart) {
+    if (out_->total_ != listStart) { out_->sep(", "); }
+  }
+
+  void putNumber(size_t n) {
+    char digits[24];
+    unsigned i = 0;
+    do {
+      digits[i++] = char('0' + (n % 10));
+      n /= 10;
+    } while (n);
+    while (i) { put(digits[--i]); }
+  }
+
+  /** Parse a decimal number; returns false if there were no digits. */
+  bool parseNumber(size_t* ret) {
+    if (!isDigit(peek())) { return false; }
+    size_t n = 0;
+    while (isDigit(peek())) {
+      if (n > SIZE_MAX / 36) { return false; }
+      n = n * 10 + size_t(src_[pos_++] - '0');
+    }
+    *ret = n;
+    return true;
+  }
+
+  /** Parse an optional base-36 "seq-id" then `_`; none means 0, else id+1. */
+  bool parseSeqId(size_t* ret) {
+    size_t n = 0;
+    bool any = false;
+    for (char c = peek(); c != '_'; c = peek()) {
+      if (n > SIZE_MAX / 36) { return false; }
+      if (isDigit(c)) {
+        n = n * 36 + size_t(c - '0');
+      } else if (isUpper(c)) {
+        n = n * 36 + size_t(c - 'A' + 10);
+      } else {
+        return false;
+      }
+      ++pos_;
+      any = true;
+    }
+    ++pos_;
+    *ret = any ? n + 1 : 0;
+    return true;
+  }
+
+  void record(Kind kind, size_t begin) {
+    if (replay_) { return; }
+    if (subs_ + targs_ >= cap_) {
+      failed_ = true;
+      return;
+    }
+    table_[subs_++] = {uint32_t(begin), uint32_t(pos_), kind};
+  }
+
+  void recordTemplateArg(size_t begin) {
+    if (subs_ + targs_ >= cap_) {
+      failed_ = true;
+      return;
+    }
+    auto& entry = table_[cap_ - 1 - targs_++];
+    entry = {uint32_t(begin), uint32_t(pos_), kTemplateArg};
+  }
+
+  /** Re-parse the thing described by `entry`, printing but not recording. */
+  bool replay(Entry const& entry) {
+    Enter e(*this);
+    if (!e.ok_) { return false; }
+    auto saved = pos_;
+    pos_ = entry.begin;
+    ++replay_;
+    bool ok = false;
+    switch (entry.kind) {
+    case kType:        ok = parseType(); break;
+    case kUnscoped:    ok = parseUnscopedName(); break;
+    case kTemplateArg: ok = parseTemplateArg(); break;
+    case kPrefix:
+      ok = true;
+      for (bool first = true; ok && pos_ < entry.end; first = false) {
+        ok = parseNestedComponent(first, entry.begin);
+      }
+      break;
+    }
+    if (entry.kind == kPrefix || entry.kind == kUnscoped) { lastRef_ = '\0'; }
+    --replay_;
+    pos_ = saved;
+    return ok;
+  }
+
+  // <encoding> ::= <name> <bare-function-type> | <name> | <special-name>
+  bool parseEncoding() {
+    Enter e(*this);
+    if (!e.ok_) { return false; }
+    if (peek() == 'T' || peek() == 'G') {
+      local_ = false;
+      return parseSpecialName();
+    }
+
+    // An encoding nested in another (e.g. in a local name) has its own
+    // template args, which we stack atop the outer encoding's, and pop when
+    // done.
+    auto savedTArgs = targs_;
+    auto savedBase = targBase_;
+    if (encodings_++) { targBase_ = targs_; }
+    bool ok = parseFunctionEncoding();
+    if (--encodings_) {
+      targs_ = savedTArgs;
+      targBase_ = savedBase;
+    }
+    return ok;
+  }
+
+  bool parseFunctionEncoding() {
+    // The return type (if any) comes after the name, but is printed before it,
+    // so parse the name first with output muted.  This also records
+    // substitutions in the right order.
+    auto begin = pos_;
+    bool local = local_;
+    local_ = false;
+    auto savedTag = tagTArgs_;
+    tagTArgs_ = true;
+    ++out_->mute_;
+    bool ok = parseName();
+    --out_->mute_;
+    tagTArgs_ = savedTag;
+    if (!ok) { return false; }
+    auto name = name_;
+
+    auto const replayName = [&] {
+      auto saved = pos_;
+      pos_ = begin;
+      ++replay_;
+      bool ok = parseName();
+      --replay_;
+      pos_ = saved;
+      return ok;
+    };
+
+    if (pos_ == src_.size() || peek() == 'E' || peek() == '.') {
+      return replayName();  // Not a function; just a name (e.g. of a variable)
+    }
+    if (name.endsWithTArgs && !name.ctorDtorConv) {
+      if (local) { ++out_->mute_; }
+      bool ok = parseType();
+      if (local) { --out_->mute_; }
+      if (!ok) { return false; }
+      if (!local) { put(' '); }
+    }
+    if (!replayName()) { return false; }
+    if (!parseBareFunctionType()) { return false; }
+    putQualifiers(name.cv);
+    putRefQualifier(name.ref);
+    return true;
+  }
+
+  bool parseSpecialName() {
+    if (consume("TV")) { put("vtable for "); return parseType(); }
+    if (consume("TT")) { put("VTT for "); return parseType(); }
+    if (consume("TI")) { put("typeinfo for "); return parseType(); }
+    if (consume("TS")) { put("typeinfo name for "); return parseType(); }
+    if (consume("TW")) { put("TLS wrapper function for "); return parseName(); }
+    if (consume("TH")) { put("TLS init function for "); return parseName(); }
+    if (consume("GV")) { put("guard variable for "); return parseName(); }
+    if (consume("GA")) { put("hidden alias for "); return parseEncoding(); }
+    if (consume("GTt")) {
+      put("transaction clone for ");
+      return parseEncoding();
+    }
+    if (consume("GR")) {
+      put("reference temporary for ");
+      if (!parseName()) { return false; }
+      size_t seq;
+      return parseSeqId(&seq);
+    }
+    if (peek() == 'T' && (peek(1) == 'h' || peek(1) == 'v')) {
+      put(peek(1) == 'h' ? "non-virtual thunk to " : "virtual thunk to ");
+      ++pos_;
+      return parseCallOffset() && parseEncoding();
+    }
+    if (consume("Tc")) {
+      put("covariant return thunk to ");
+      return parseCallOffset() && parseCallOffset() && parseEncoding();
+    }
+    return false;
+  }
+
+  // <call-offset> ::= h <number> _ | v <number> _ <number> _
+  bool parseCallOffset() {
+    size_t n;
+    bool isVirtual = consume('v');
+    if (!isVirtual && !consume('h')) { return false; }
+    consume('n');
+    if (!parseNumber(&n) || !consume('_')) { return false; }
+    if (!isVirtual) { return true; }
+    consume('n');
+    return parseNumber(&n) && consume('_');
+  }
+
+  bool parseCloneSuffix() {
+    auto begin = pos_++;
+    if (isLower(peek()) || isUpper(peek()) || peek() == '_') {
+      while (isLower(peek()) || isUpper(peek()) || peek() == '_') { ++pos_; }
+    }
+    while (peek() == '.' && isDigit(peek(1))) {
+      ++pos_;
+      while (isDigit(peek())) { ++pos_; }
+    }
+    if (pos_ == begin + 1) { return false; }
+    put(" [clone ");
+    put(src_.substr(begin, pos_ - begin));
+    put(']');
+    return true;
+  }
+
+  // <name> ::= <nested-name> | <local-name> | <unscoped-name> [<template-args>]
+  //          | <substitution> <template-args>
+  bool parseName() {
+    Enter e(*this);
+    if (!e.ok_) { return false; }
+    name_ = {};
+    auto begin = pos_;
+    switch (peek()) {
+    case 'N': return parseNestedName();
+    case 'Z': return parseLocalName();
+    case 'S':
+      if (peek(1) != 't') {
+        return parseSubstitution() && peek() == 'I' && parseTemplateArgs();
+      }
+      break;
+    }
+    if (!parseUnscopedName()) { return false; }
+    if (peek() == 'I') {
+      record(kUnscoped, begin);
+      return parseTemplateArgs();
+    }
+    return true;
+  }
+
+  // <unscoped-name> ::= <unqualified-name> | St <unqualified-name>
+  bool parseUnscopedName() {
+    if (consume("St")) { put("std::"); }
+    return parseUnqualifiedName();
+  }
+
+  // <nested-name> ::= N [<CV-qualifiers>] [<ref-qualifier>] <prefix>
+  // <unqualified-name> E
+  bool parseNestedName() {
+    if (!consume('N')) { return false; }
+    auto cv = parseCVQualifiers();
+    char ref = '\0';
+    if (peek() == 'R' || peek() == 'O') { ref = src_[pos_++]; }
+    auto begin = pos_;
+    for (bool first = true; !consume('E'); first = false) {
+      if (pos_ >= src_.size()) { return false; }
+      if (!parseNestedComponent(first, begin)) { return false; }
+    }
+    name_.cv = cv;
+    name_.ref = ref;
+    return true;
+  }
+
+  /**
+  One piece of a nested name; every prefix of the name (except the whole
+  thing) is a substitution.
+  */
+  bool parseNestedComponent(bool first, size_t begin) {
+    Enter e(*this);
+    if (!e.ok_) { return false; }
+    char c = peek();
+    if (c == 'S' && first) {
+      if (consume("St")) {
+        put("std");
+        return true;
+      }
+      return parseSubstitution();  // Already a substitution; don't re-record
+    }
+    if (!first && c != 'I') { put("::"); }
+    if (c != 'I') { name_.ctorDtorConv = false; }
+    name_.endsWithTArgs = false;
+    if (c == 'I') {
+      if (first || !parseTemplateArgs()) { return false; }
+    } else if (c == 'T') {
+      if (!parseTemplateParam()) { return false; }
+    } else if (c == 'M') {
+      return false;  // Member initializer lambdas: not supported
+    } else if (!parseUnqualifiedName()) {
+      return false;
+    }
+    if (peek() != 'E') { record(kPrefix, begin); }
+    return true;
+  }
+
+  // <local-name> ::= Z <encoding> E <entity name> [<discriminator>]
+  //              ::= Z <encoding> E s [<discriminator>]
+  bool parseLocalName() {
+    if (!consume('Z')) { return false; }
+    local_ = true;
+    if (!parseEncoding() || !consume('E')) { return false; }
+    if (consume('s')) {
+      put("::string literal");
+      return parseDiscriminator();
+    }
+    if (peek() == 'd') { return false; }  // Default arguments: not supported
+    put("::");
+    return parseName() && parseDiscriminator();
+  }
+
+  // <discriminator> ::= _ <digit> | __ <number> _
+  bool parseDiscriminator() {
+    size_t n;
+    if (consume("__")) { return parseNumber(&n) && consume('_'); }
+    if (consume('_')) { return parseNumber(&n); }
+    return true;
+  }
+
+  // <unqualified-name> ::= <operator-name> | <ctor-dtor-name> | <source-name>
+  //                      | <unnamed-type-name>, followed by any <abi-tags>
+  bool parseUnqualifiedName() {
+    consume('L');  // Internal linkage
+    char c = peek();
+    bool ok = false;
+    if (isDigit(c)) {
+      ok = parseSourceName(true);
+    } else if (c == 'C' || (c == 'D' && isDigit(peek(1)))) {
+      ok = parseCtorDtorName();
+    } else if (c == 'U') {
+      ok = parseUnnamedTypeName();
+    } else if (isLower(c)) {
+      ok = parseOperatorName();
+    }
+    while (ok && consume('B')) {
+      put("[abi:");
+      ok = parseSourceName(false);
+      put(']');
+    }
+    return ok;
+  }
+
+  // <source-name> ::= <positive length number> <identifier>
+  bool parseSourceName(bool isName) {
+    size_t len;
+    if (!parseNumber(&len) || len > src_.size() - pos_) { return false; }
+    auto name = src_.substr(pos_, len);
+    pos_ += len;
+    if (name.substr(0, 10) == "_GLOBAL__N") {
+      put("(anonymous namespace)");
+    } else {
+      put(name);
+    }
+    if (isName) { lastName_ = name; }
+    return true;
+  }
+
+  bool parseCtorDtorName() {
+    name_.ctorDtorConv = true;
+    if (consume('C')) {
+      bool inheriting = consume('I');
+      if (!isDigit(peek()) || peek() == '0') { return false; }
+      ++pos_;
+      put(lastName_);
+      if (inheriting) {
+        ++out_->mute_;
+        bool ok = parseType();
+        --out_->mute_;
+        return ok;
+      }
+      return true;
+    }
+    if (consume('D')) {
+      if (!isDigit(peek()) || peek() == '3') { return false; }
+      ++pos_;
+      put('~');
+      put(lastName_);
+      return true;
+    }
+    return false;
+  }
+
+  // <unnamed-type-name> ::= Ut [<number>] _ | Ul <lambda-sig> E [<number>] _
+  bool parseUnnamedTypeName() {
+    size_t n = 0;
+    if (consume("Ut")) {
+      put("{unnamed type#");
+    } else if (consume("Ul")) {
+      put("{lambda");
+      if (!parseBareFunctionType() || !consume('E')) { return false; }
+      put('#');
+    } else {
+      return false;
+    }
+    bool hasNumber = parseNumber(&n);
+    if (!consume('_')) { return false; }
+    putNumber(hasNumber ? n + 2 : 1);
+    put('}');
+    return true;
+  }
+
+  bool parseOperatorName() {
+    struct Op {
+      char code[3];
+      char const* name;
+    };
+    static constexpr Op kOps[] = {
+        {"nw", " new"}, {"na", " new[]"}, {"dl", " delete"},
+        {"da", " delete[]"},
+        {"ps", "+"},    {"ng", "-"},      {"ad", "&"},       {"de", "*"},
+        {"co", "~"},    {"pl", "+"},      {"mi", "-"},       {"ml", "*"},
+        {"dv", "/"},    {"rm", "%"},      {"an", "&"},       {"or", "|"},
+        {"eo", "^"},    {"aS", "="},      {"pL", "+="},      {"mI", "-="},
+        {"mL", "*="},   {"dV", "/="},     {"rM", "%="},      {"aN", "&="},
+        {"oR", "|="},   {"eO", "^="},     {"ls", "<<"},      {"rs", ">>"},
+        {"lS", "<<="},  {"rS", ">>="},    {"eq", "=="},      {"ne", "!="},
+        {"lt", "<"},    {"gt", ">"},      {"le", "<="},      {"ge", ">="},
+        {"ss", "<=>"},  {"nt", "!"},      {"aa", "&&"},      {"oo", "||"},
+        {"pp", "++"},   {"mm", "--"},     {"cm", ","},       {"pm", "->*"},
+        {"pt", "->"},   {"cl", "()"},     {"ix", "[]"},      {"qu", "?"},
+        {"aw", " co_await"},
+    };
+    if (consume("cv")) {
+      name_.ctorDtorConv = true;
+      put("operator ");
+      return parseType();
+    }
+    if (consume("li")) {
+      put("operator\"\" ");
+      return parseSourceName(false);
+    }
+    if (consume('v') && isDigit(peek())) {
+      ++pos_;
+      put("operator ");
+      return parseSourceName(false);
+    }
+    for (auto const& op : kOps) {
+      if (consume(op.code)) {
+        put("operator");
+        put(op.name);
+        if (peek() == 'I' && out_->last_ == '<') { put(' '); }
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // <substitution> ::= S_ | S <seq-id> _ | St | Sa | Sb | Ss | Si | So | Sd
+  bool parseSubstitution() {
+    Enter e(*this);
+    if (!e.ok_ || !consume('S')) { return false; }
+    struct Abbrev {
+      char code;
+      char const* full;
+      char const* name;  // For constructors / destructors
+    };
+    static constexpr Abbrev kAbbrevs[] = {
+        {'a', "std::allocator", "allocator"},
+        {'b', "std::basic_string", "basic_string"},
+        {'s',
+         "std::basic_string<char, std::char_traits<char>, std::allocator<char> >",
+         "basic_string"},
+        {'i',
+         "std::basic_istream<char, std::char_traits<char> >",
+         "basic_istream"},
+        {'o',
+         "std::basic_ostream<char, std::char_traits<char> >",
+         "basic_ostream"},
+        {'d',
+         "std::basic_iostream<char, std::char_traits<char> >",
+         "basic_iostream"},
+    };
+    for (auto const& abbrev : kAbbrevs) {
+      if (consume(abbrev.code)) {
+        put(abbrev.full);
+        lastName_ = abbrev.name;
+        return true;
+      }
+    }
+    size_t index;
+    if (!parseSeqId(&index) || index >= subs_) { return false; }
+    return replay(table_[index]);
+  }
+
+  // <template-param> ::= T_ | T <number> _
+  bool parseTemplateParam() {
+    if (!consume('T')) { return false; }
+    size_t index = 0;
+    if (parseNumber(&index)) { ++index; }
+    index += targBase_;
+    if (!consume('_') || index >= targs_) { return false; }
+    auto const& entry = table_[cap_ - 1 - index];
+    if (src_[entry.begin] != 'J') { return replay(entry); }
+
+    // This is a parameter pack.  If we're expanding a pack, print just the
+    // current element; otherwise print all of them.
+    if (packIndex_ == -1 && packSize_ < 0) { packSize_ = 0; }
+    auto saved = pos_;
+    pos_ = entry.begin + 1;
+    ++replay_;
+    bool ok = true;
+    int i = 0;
+    char ref = '\0';
+    auto listStart = out_->total_;
+    for (; ok && !consume('E'); i++) {
+      bool show = packIndex_ < 0 || packIndex_ == i;
+      if (!show) { ++out_->mute_; }
+      if (packIndex_ < 0) { listSep(listStart); }
+      ok = parseTemplateArg();
+      if (!show) { --out_->mute_; }
+      if (packIndex_ == i) { ref = lastRef_; }
+    }
+    lastRef_ = ref;
+    out_->endList();
+    --replay_;
+    pos_ = saved;
+    if (packIndex_ == -1) { packSize_ = i; }
+    return ok;
+  }
+
+  // <template-args> ::= I <template-arg>+ E
+  bool parseTemplateArgs() {
+    if (!consume('I')) { return false; }
+    auto savedName = name_;
+    auto savedLast = lastName_;
+    auto savedTag = tagTArgs_;
+    bool tag = tagTArgs_;
+    tagTArgs_ = false;
+    if (tag) { targs_ = targBase_; }
+    put('<');
+    auto listStart = out_->total_;
+    while (!consume('E')) {
+      if (pos_ >= src_.size()) { return false; }
+      listSep(listStart);
+      auto begin = pos_;
+      if (!parseTemplateArg()) { return false; }
+      if (tag) { recordTemplateArg(begin); }
+    }
+    out_->endList();
+    if (out_->last_ == '>') { put(' '); }
+    put('>');
+    tagTArgs_ = savedTag;
+    lastName_ = savedLast;
+    name_ = savedName;
+    name_.endsWithTArgs = true;
+    return true;
+  }
+
+  // <template-arg> ::= <type> | X <expression> E | <expr-primary> | J
+  // <template-arg>* E
+  bool parseTemplateArg() {
+    Enter e(*this);
+    if (!e.ok_) { return false; }
+    switch (peek()) {
+    case 'L': return parseExprPrimary();
+    case 'X': return consume('X') && parseExpression() && consume('E');
+    case 'J':
+      {
+        ++pos_;
+        auto listStart = out_->total_;
+        while (!consume('E')) {
+          if (pos_ >= src_.size()) { return false; }
+          listSep(listStart);
+          if (!parseTemplateArg()) { return false; }
+        }
+        out_->endList();
+        return true;
+      }
+    default: return parseType();
+    }
+  }
+
+  // Only the simplest expressions (template params, literals, function params,
+  // and names of dependent members, e.g. `enable_if<is_foo<T>::value>`) are
+  // supported.
+  bool parseExpression() {
+    Enter e(*this);
+    if (!e.ok_) { return false; }
+    switch (peek()) {
+    case 'T': return parseTemplateParam();
+    case 'L': return parseExprPrimary();
+    case 'f':
+      if (consume("fp")) {
+        parseCVQualifiers();
+        size_t n = 0;
+        if (parseNumber(&n)) { ++n; }
+        put("{parm#");
+        putNumber(n + 1);
+        put('}');
+        return consume('_');
+      }
+      return false;
+    case 's':
+      if (consume("sr")) { return parseUnresolvedName(); }
+      if (consume("sZ")) {
+        put("sizeof...(");
+        if (!parseTemplateParam()) { return false; }
+        put(')');
+        return true;
+      }
+      return false;
+    default: return false;
+    }
+  }
+
+  // <unresolved-name> (after `sr`) ::= N <unresolved-type> <simple-id>* E
+  // <base-unresolved-name> | <simple-id>+ E <base-unresolved-name> |
+  // <unresolved-type> <base-unresolved-name>
+  bool parseUnresolvedName() {
+    auto begin = pos_;
+    bool nested = consume('N');
+    if (isDigit(peek())) {
+      for (bool first = true; !consume('E'); first = false) {
+        if (!first) { put("::"); }
+        if (!parseSimpleId()) { return false; }
+      }
+    } else {
+      if (peek() == 'T') {
+        if (!parseTemplateParam()) { return false; }
+        record(kType, begin + nested);
+      } else if (consume("St")) {
+        put("std::");
+        if (!parseSourceName(false)) { return false; }
+      } else if (!parseSubstitution()) {
+        return false;
+      }
+      if (peek() == 'I' && !parseTemplateArgs()) { return false; }
+      while (nested && !consume('E')) {
+        put("::");
+        if (!parseSimpleId()) { return false; }
+      }
+    }
+    put("::");
+    if (consume("on")) {
+      return parseOperatorName() && (peek() != 'I' || parseTemplateArgs());
+    }
+    if (consume("dn")) {
+      put('~');
+      return peek() == 'S' ? parseSubstitution() : parseSimpleId();
+    }
+    return parseSimpleId();
+  }
+
+  // <simple-id> ::= <source-name> [<template-args>]
+  bool parseSimpleId() {
+    if (!parseSourceName(false)) { return false; }
+    return peek() != 'I' || parseTemplateArgs();
+  }
+
+  // <expr-primary> ::= L <type> <value> E | L <mangled-name> E
+  bool parseExprPrimary() {
+    if (!consume('L')) { return false; }
+    if (consume("_Z") || consume('Z')) {
+      return parseEncoding() && consume('E');
+    }
+    if (consume("DnE") || consume("Dn0E")) {
+      put("nullptr");
+      return true;
+    }
+    if (consume("b0E")) {
+      put("false");
+      return true;
+    }
+    if (consume("b1E")) {
+      put("true");
+      return true;
+    }
+    char const* suffix = nullptr;
+    switch (peek()) {
+    case 'i': suffix = ""; break;
+    case 'j': suffix = "u"; break;
+    case 'l': suffix = "l"; break;
+    case 'm': suffix = "ul"; break;
+    case 'x': suffix = "ll"; break;
+    case 'y': suffix = "ull"; break;
+    }
+    if (suffix) {
+      ++pos_;
+    } else {
+      put('(');
+      if (!parseType()) { return false; }
+      put(')');
+    }
+    if (consume('n')) { put('-'); }
+    auto begin = pos_;
+    while (peek() && peek() != 'E') { ++pos_; }
+    put(src_.substr(begin, pos_ - begin));
+    if (suffix) { put(suffix); }
+    return consume('E');
+  }
+
+  uint8_t parseCVQualifiers() {
+    uint8_t cv = 0;
+    if (consume('r')) { cv |= kRestrict; }
+    if (consume('V')) { cv |= kVolatile; }
+    if (consume('K')) { cv |= kConst; }
+    return cv;
+  }
+
+  void putQualifiers(uint8_t cv) {
+    if (cv & kConst) { put(" const"); }
+    if (cv & kVolatile) { put(" volatile"); }
+    if (cv & kRestrict) { put(" restrict"); }
+  }
+
+  void putRefQualifier(char ref) {
+    if (ref == 'R') { put(" &"); }
+    if (ref == 'O') { put(" &&"); }
+  }
+
+  /**
+  Print pointers / references / qualifiers, innermost first, e.g. `PKc` ->
+  `char const*`. If the type these apply to was itself a reference (`baseRef`),
+  references collapse.
+  */
+  void putLevels(Level const* levels, unsigned n, char baseRef = '\0') {
+    for (unsigned i = n; i-- > 0;) {
+      bool isRef = levels[i].kind == 'R' || levels[i].kind == 'O';
+      if (baseRef && isRef && i == n - 1) { continue; }
+      switch (levels[i].kind) {
+      case 'P': put('*'); break;
+      case 'R': put('&'); break;
+      case 'O': put("&&"); break;
+      case 'K': putQualifiers(levels[i].cv); break;
+      }
+    }
+  }
+
+  /** Type names which are just one letter (and never substitutions). */
+  static char const* builtinType(char c) {
+    switch (c) {
+    case 'v': return "void";
+    case 'w': return "wchar_t";
+    case 'b': return "bool";
+    case 'c': return "char";
+    case 'a': return "signed char";
+    case 'h': return "unsigned char";
+    case 's': return "short";
+    case 't': return "unsigned short";
+    case 'i': return "int";
+    case 'j': return "unsigned int";
+    case 'l': return "long";
+    case 'm': return "unsigned long";
+    case 'x': return "long long";
+    case 'y': return "unsigned long long";
+    case 'n': return "__int128";
+    case 'o': return "unsigned __int128";
+    case 'f': return "float";
+    case 'd': return "double";
+    case 'e': return "long double";
+    case 'g': return "__float128";
+    case 'z': return "...";
+    default:  return nullptr;
+    }
+  }
+
+  bool isFunctionType() const {
+    if (peek() == 'F') { return true; }
+    return peek() == 'D' && (peek(1) == 'o' || peek(1) == 'x') &&
+           peek(2) == 'F';
+  }
+
+  // <type>; the state of any name we're in the middle of is preserved.
+  bool parseType() {
+    Enter e(*this);
+    if (!e.ok_) { return false; }
+    auto savedName = name_;
+    auto savedTag = tagTArgs_;
+    tagTArgs_ = false;
+    bool ok = parseTypeInner();
+    tagTArgs_ = savedTag;
+    name_ = savedName;
+    return ok;
+  }
+
+  bool parseTypeInner() {
+    auto begin = pos_;
+    char c = peek();
+    lastRef_ = '\0';
+    if (auto* builtin = builtinType(c)) {
+      ++pos_;
+      put(builtin);
+      return true;
+    }
+    switch (c) {
+    case 'P':
+    case 'R':
+    case 'O':
+    case 'r':
+    case 'V':
+    case 'K': return parseQualifiedType();
+    case 'F':
+    case 'A':
+    case 'M': return parseDeclarator(nullptr, 0);
+    case 'u':
+      ++pos_;
+      if (!parseSourceName(false)) { return false; }
+      record(kType, begin);
+      return true;
+    case 'T':
+      if (!parseTemplateParam()) { return false; }
+      record(kType, begin);
+      if (peek() == 'I') {
+        if (!parseTemplateArgs()) { return false; }
+        record(kType, begin);
+        lastRef_ = '\0';
+      }
+      return true;
+    case 'S':
+      if (peek(1) == 't') { break; }
+      if (!parseSubstitution()) { return false; }
+      if (peek() == 'I') {
+        if (!parseTemplateArgs()) { return false; }
+        record(kType, begin);
+        lastRef_ = '\0';
+      }
+      return true;
+    case 'D': return parseDType();
+    }
+    // Class or enum type
+    if (!parseName()) { return false; }
+    record(kType, begin);
+    lastRef_ = '\0';
+    return true;
+  }
+
+  bool parseDType() {
+    auto begin = pos_;
+    if (isFunctionType()) { return parseDeclarator(nullptr, 0); }
+    if (consume("Dn")) { put("decltype(nullptr)"); return true; }
+    if (consume("Da")) { put("auto"); return true; }
+    if (consume("Dc")) { put("decltype(auto)"); return true; }
+    if (consume("Di")) { put("char32_t"); return true; }
+    if (consume("Ds")) { put("char16_t"); return true; }
+    if (consume("Du")) { put("char8_t"); return true; }
+    if (consume("Df")) { put("decimal32"); return true; }
+    if (consume("Dd")) { put("decimal64"); return true; }
+    if (consume("De")) { put("decimal128"); return true; }
+    if (consume("Dh")) { put("half"); return true; }
+    if (consume("DF")) {
+      size_t bits;
+      if (!parseNumber(&bits) || !consume('_')) { return false; }
+      put("_Float");
+      putNumber(bits);
+      return true;
+    }
+    if (consume("Dp")) {
+      // Pack expansion.  Parse the pattern once (muted) to see if it refers to
+      // a pack, and how big; then print it once per pack element.
+      auto patBegin = pos_;
+      auto savedIndex = packIndex_;
+      auto savedSize = packSize_;
+      packIndex_ = -1;
+      packSize_ = -1;
+      ++out_->mute_;
+      bool ok = parseType();
+      --out_->mute_;
+      auto size = packSize_;
+      auto end = pos_;
+      ++replay_;
+      if (ok && size < 0) {
+        packIndex_ = -2;
+        pos_ = patBegin;
+        ok = parseType();
+        put("...");
+      }
+      auto listStart = out_->total_;
+      for (int i = 0; ok && i < size; i++) {
+        listSep(listStart);
+        packIndex_ = i;
+        pos_ = patBegin;
+        ok = parseType();
+      }
+      out_->endList();
+      --replay_;
+      pos_ = end;
+      packIndex_ = savedIndex;
+      packSize_ = savedSize;
+      if (!ok) { return false; }
+      record(kType, begin);
+      return true;
+    }
+    if (consume("Dt") || consume("DT")) {
+      put("decltype (");
+      if (!parseExpression() || !consume('E')) { return false; }
+      put(')');
+      record(kType, begin);
+      return true;
+    }
+    return false;  // Vector types (`Dv`) etc.: not supported
+  }
+
+  /** Pointers / references / qualifiers, then the type they apply to. */
+  bool parseQualifiedType() {
+    Level levels[kMaxLevels];
+    unsigned n = 0;
+    for (char c = peek();; c = peek()) {
+      auto begin = uint32_t(pos_);
+      if (c == 'P' || c == 'R' || c == 'O') {
+        if (n == kMaxLevels) { return false; }
+        levels[n++] = {begin, c, 0};
+        ++pos_;
+      } else if (c == 'r' || c == 'V' || c == 'K') {
+        if (n == kMaxLevels) { return false; }
+        auto cv = parseCVQualifiers();
+        levels[n++] = {begin, 'K', cv};
+      } else {
+        break;
+      }
+    }
+    return parseDeclarator(levels, n);
+  }
+
+  /**
+  Parse the type to which `levels` apply, and print it along with `levels`.
+  Usually this is just `<type><levels>`, but functions, arrays, and member
+  pointers are printed inside-out, e.g. `PFviE` -> `void (*)(int)`.
+  */
+  bool parseDeclarator(Level const* levels, unsigned n) {
+    bool ok;
+    if (isFunctionType()) {
+      // Qualifiers directly on a function type (`KFvvE`) print after its
+      // parameters
+      bool cv = n && levels[n - 1].kind == 'K';
+      ok = parseFunctionType(
+          levels, cv ? n - 1 : n, nullptr, cv ? levels[n - 1].cv : 0);
+    } else if (peek() == 'A') {
+      ok = parseArrayType(levels, n);
+    } else if (peek() == 'M') {
+      ok = parseMemberPointerType(levels, n);
+    } else {
+      ok = parseType();
+      putLevels(levels, n, lastRef_);
+    }
+    if (!ok) { return false; }
+    for (unsigned i = n; i-- > 0;) { record(kType, levels[i].begin); }
+    bool ref = n && levels[0].kind != 'K' && levels[0].kind != 'P';
+    lastRef_ = ref ? levels[0].kind : '\0';
+    return true;
+  }
+
+  // <function-type> ::= [Do] F [Y] <return type> <bare-function-type>
+  // [<ref-qualifier>] E If this is a member function, `memberOf` is the class
+  // type's entry, and `cv` its qualifiers.
+  bool parseFunctionType(
+      Level const* levels, unsigned n, Entry const* memberOf, uint8_t cv) {
+    auto begin = pos_;
+    bool isNoexcept = consume("Do");
+    consume("Dx");
+    if (!consume('F')) { return false; }
+    consume('Y');
+    if (!parseType()) { return false; }
+    if (n || memberOf) {
+      put(" (");
+      if (memberOf) {
+        if (!replay(*memberOf)) { return false; }
+        put("::*");
+      }
+      putLevels(levels, n);
+      put(')');
+    } else {
+      put(' ');
+    }
+    if (!parseBareFunctionType()) { return false; }
+    char ref = '\0';
+    if (peek() == 'R' || peek() == 'O') { ref = src_[pos_++]; }
+    if (!consume('E')) { return false; }
+    putQualifiers(cv);
+    putRefQualifier(ref);
+    if (isNoexcept) { put(" noexcept"); }
+    record(kType, begin);
+    return true;
+  }
+
+  // <array-type> ::= A <number> _ <type> | A _ <type>
+  bool parseArrayType(Level const* levels, unsigned n) {
+    uint32_t begins[kMaxLevels];
+    std::string_view dims[kMaxLevels];
+    unsigned k = 0;
+    while (peek() == 'A') {
+      if (k == kMaxLevels) { return false; }
+      begins[k] = uint32_t(pos_++);
+      auto dimBegin = pos_;
+      while (isDigit(peek())) { ++pos_; }
+      dims[k++] = src_.substr(dimBegin, pos_ - dimBegin);
+      if (!consume('_')) { return false; }
+    }
+    if (!parseType()) { return false; }
+    if (n) {
+      put(" (");
+      putLevels(levels, n);
+      put(')');
+    }
+    put(' ');
+    for (unsigned i = 0; i < k; i++) {
+      put('[');
+      put(dims[i]);
+      put(']');
+    }
+    for (unsigned i = k; i-- > 0;) { record(kType, begins[i]); }
+    return true;
+  }
+
+  // <pointer-to-member-type> ::= M <class type> <member type>
+  bool parseMemberPointerType(Level const* levels, unsigned n) {
+    auto begin = pos_;
+    if (!consume('M')) { return false; }
+    Entry memberOf {uint32_t(pos_), 0, kType};
+    ++out_->mute_;
+    bool ok = parseType();
+    --out_->mute_;
+    if (!ok) { return false; }
+    memberOf.end = uint32_t(pos_);
+
+    // Member functions' qualifiers come before the function type
+    auto cvBegin = pos_;
+    auto cv = parseCVQualifiers();
+    if (isFunctionType()) {
+      if (!parseFunctionType(levels, n, &memberOf, cv)) { return false; }
+      if (cv) { record(kType, cvBegin); }
+    } else {
+      pos_ = cvBegin;
+      if (!parseType()) { return false; }
+      put(' ');
+      if (!replay(memberOf)) { return false; }
+      put("::*");
+      putLevels(levels, n);
+    }
+    record(kType, begin);
+    return true;
+  }
+
+  // <bare-function-type> ::= <signature type>+ ; a lone `v` means no parameters
+  bool parseBareFunctionType() {
+    auto const atEnd = [&] {
+      char c = peek();
+      if (!c || c == 'E' || c == '.') { return true; }
+      return (c == 'R' || c == 'O') && peek(1) == 'E';
+    };
+    put('(');
+    if (peek() == 'v') {
+      ++pos_;
+      if (!atEnd()) { return false; }
+    }
+    auto listStart = out_->total_;
+    while (!atEnd()) {
+      listSep(listStart);
+      if (!parseType()) { return false; }
+    }
+    out_->endList();
+    put(')');
+    return true;
+  }
+};
+
+/**
+Demangle `mangled` into `buf`, or if it can't be demangled, just copy it there
+as-is.  The result is always NUL-terminated (if `size` is nonzero). Like
+`snprintf`, returns the length of the full output, so a return value of `size`
+or more means it was truncated.
+*/
+inline size_t demangle(std::string_view mangled, char* buf, size_t size) {
+  Demangler::Entry scratch[64];
+  Demangler demangler(scratch, sizeof(scratch));
+  DemangleSink out(buf, size);
+  if (!demangler.demangle(mangled, out)) {
+    out.reset();
+    out.put(mangled);
+  }
+  out.finish();
+  return out.total();
+}
+
+}  // namespace proginfo::binary
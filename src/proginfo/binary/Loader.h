@@ -0,0 +1,664 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "../util/Bytes.h"
+#include "../util/MMap.h"
+#include "../util/Stats.h"
+#include "../util/ThreadPool.h"
+#include "Binary.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#define PROGINFO_IO_URING 1
+#else
+#define PROGINFO_IO_URING 0
+#endif
+
+namespace proginfo::binary {
+
+/** A binary from `Loader`, mapped, with its headers and hot sections read. */
+struct LoadedBinary {
+  std::string path;
+  std::unique_ptr<util::MMap> mm;  // Null if it failed
+  util::Virtual<Binary> bin;       // On `mm`
+  int error {};  // `errno` value if it failed; `ENOEXEC` if not a binary
+};
+
+struct LoaderOptions {
+  unsigned queueDepth {64};  // Files in flight at once, with io_uring
+  unsigned threads {};       // For the fallback; 0 for one per CPU
+  bool ioUring {true};       // If the kernel allows it; else threads are used
+  std::vector<std::string> willNeed {".symtab", ".strtab", ".eh_frame_hdr"};
+  std::pmr::memory_resource* mr {std::pmr::new_delete_resource()};  // Binaries
+};
+
+struct LoadStats {
+  size_t loaded {};
+  size_t failed {};
+  bool ioUring {};  // Or threads were used
+  uint64_t totalNanos {};
+};
+
+namespace detail {
+
+/*
+One file's progress through loading: opened, then its file header, section
+headers and section names read (into buffers of its own), to find which
+sections to prefault; then mapped, and those sections `madvise`d.  The same
+steps are done with io_uring or on threads.
+*/
+struct LoadJob {
+  enum class Step : uint8_t {
+    kOpen,
+    kHeader,      // Reading the file header
+    kSecHeaders,  // Reading the section header table
+    kSecNames,    // Reading the section names
+    kMap,
+    kAdvise,
+    kDone,
+  };
+
+  constexpr static size_t kHeaderBytes = 4096;
+  constexpr static size_t kMaxTable = 16 << 20;  // Bigger ones aren't read
+
+  size_t index {};
+  std::string const* path {};
+  int fd {-1};
+  int error {};
+  Step step {Step::kOpen};
+  std::vector<char> buf;  // Being read
+  uint64_t readAt {};     // File offset of `buf`
+  bool is64 {};
+  bool isLE {};
+  size_t secHeaderSize {};
+  uint16_t secNamesIndex {};
+  std::vector<char> secHeaders;
+  std::vector<std::pair<size_t, size_t>> willNeed;  // File ranges
+  std::unique_ptr<util::MMap> mm;
+  unsigned advising {};  // `madvise`s in flight
+
+  void read(uint64_t offset, size_t size, Step next) {
+    readAt = offset;
+    buf.assign(size, 0);
+    step = next;
+  }
+
+  bool reading() const {
+    return step == Step::kHeader || step == Step::kSecHeaders ||
+           step == Step::kSecNames;
+  }
+
+  void fail(int err) {
+    error = err;
+    step = Step::kDone;
+    if (fd >= 0) { close(fd); }
+    fd = -1;
+    mm.reset();
+  }
+
+  uint64_t word(util::Addr addr, size_t off, bool isWord64) const {
+    if (isWord64) { return isLE ? addr.u64LE(off) : addr.u64BE(off); }
+    return isLE ? addr.u32LE(off) : addr.u32BE(off);
+  }
+
+  uint16_t half(util::Addr addr, size_t off) const {
+    return isLE ? addr.u16LE(off) : addr.u16BE(off);
+  }
+
+  /** Having read `got` bytes into `buf`, go on to the next step. */
+  void onRead(size_t got, std::vector<std::string> const& names) {
+    buf.resize(std::min(got, buf.size()));
+    util::Addr addr {buf.data(), buf.size()};
+    switch (step) {
+    case Step::kHeader:
+      if (got >= 64 && !memcmp(buf.data(), "\x7f\x45\x4c\x46", 4)) {
+        is64 = buf[4] == 2;
+        isLE = buf[5] == 1;
+        auto shOff = word(addr, is64 ? 0x28 : 0x20, is64);
+        secHeaderSize = half(addr, is64 ? 0x3a : 0x2e);
+        auto shCount = half(addr, is64 ? 0x3c : 0x30);  // 0 if extended
+        secNamesIndex = half(addr, is64 ? 0x3e : 0x32);
+        auto bytes = size_t(shCount) * secHeaderSize;
+        if (shOff && bytes && bytes <= kMaxTable &&
+            secHeaderSize >= (is64 ? 64u : 40u)) {
+          read(shOff, bytes, Step::kSecHeaders);
+        } else {
+          step = Step::kMap;
+        }
+      } else if (got >= 32 && !memcmp(buf.data(), "\xcf\xfa\xed\xfe", 4)) {
+        willNeed.push_back({0, 32 + size_t(addr.u32LE(0x14))});  // Commands
+        step = Step::kMap;
+      } else {
+        fail(ENOEXEC);
+      }
+      break;
+
+    case Step::kSecHeaders:
+      secHeaders = std::move(buf);
+      if (secNamesIndex < secHeaders.size() / secHeaderSize) {
+        auto sh = secNamesIndex * secHeaderSize;
+        util::Addr table {secHeaders.data(), secHeaders.size()};
+        auto off = word(table, sh + (is64 ? 0x18 : 0x10), is64);
+        auto size = word(table, sh + (is64 ? 0x20 : 0x14), is64);
+        if (size && size <= kMaxTable) {
+          read(off, size_t(size), Step::kSecNames);
+          break;
+        }
+      }
+      step = Step::kMap;
+      break;
+
+    case Step::kSecNames: {
+      // Section headers: name, type, flags, addr, offset, size, ...
+      util::Addr table {secHeaders.data(), secHeaders.size()};
+      std::string_view strings {buf.data(), buf.size()};
+      for (size_t sh = 0; sh + secHeaderSize <= secHeaders.size();
+           sh += secHeaderSize) {
+        auto nameAt = word(table, sh, false);
+        if (nameAt >= strings.size() || word(table, sh + 4, false) == 8) {
+          continue;  // SHT_NOBITS: nothing in the file
+        }
+        auto name = strings.substr(nameAt);
+        name = name.substr(0, name.find('\0'));
+        for (auto& want : names) {
+          if (name != want) { continue; }
+          willNeed.push_back(
+              {size_t(word(table, sh + (is64 ? 0x18 : 0x10), is64)),
+               size_t(word(table, sh + (is64 ? 0x20 : 0x14), is64))});
+        }
+      }
+      step = Step::kMap;
+      break;
+    }
+
+    default: break;
+    }
+  }
+
+  /** Map the file (from `fd`, which the mapping then owns). */
+  void map() {
+    mm = std::make_unique<util::MMap>(
+        *path, fd, util::MMap::Options {.advice = util::MMap::Advice::kRandom});
+    fd = -1;
+    if (!*mm) {
+      fail(mm->errno_ ? mm->errno_ : ENOEXEC);
+      return;
+    }
+    // Only what's in the file
+    auto size = mm->size_;
+    for (auto& [off, len] : willNeed) {
+      off = std::min(off, size);
+      len = std::min(len, size - off);
+    }
+    step = Step::kAdvise;
+  }
+};
+
+#if PROGINFO_IO_URING
+
+/*
+A minimal io_uring: a submission and a completion queue, with the kernel's
+shared rings used directly (without liburing).  Not thread-safe.
+*/
+class Ring {
+  int fd_ {-1};
+  bool ok_ {};
+  unsigned entries_ {};
+  void* sq_ {};
+  size_t sqSize_ {};
+  void* cq_ {};
+  size_t cqSize_ {};
+  io_uring_sqe* sqes_ {};
+  size_t sqesSize_ {};
+  unsigned* sqHead_ {};
+  unsigned* sqTail_ {};
+  unsigned* sqMask_ {};
+  unsigned* sqArray_ {};
+  unsigned* cqHead_ {};
+  unsigned* cqTail_ {};
+  unsigned* cqMask_ {};
+  io_uring_cqe* cqes_ {};
+  unsigned tail_ {};      // Where the next submission goes
+  unsigned toSubmit_ {};  // Filled in, but not yet submitted
+
+  static void* mapRing(int fd, size_t size, uint64_t offset) {
+    auto* ret = mmap(nullptr,
+                     size,
+                     PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE,
+                     fd,
+                     off_t(offset));
+    return ret == MAP_FAILED ? nullptr : ret;
+  }
+
+  /** Whether the kernel supports all of `ops`. */
+  bool supports(std::initializer_list<unsigned> ops) const {
+    constexpr unsigned kOps = 256;
+    auto* probe = (io_uring_probe*) calloc(
+        1, sizeof(io_uring_probe) + kOps * sizeof(io_uring_probe_op));
+    if (!probe) { return false; }
+    bool ret = syscall(__NR_io_uring_register,
+                       fd_,
+                       IORING_REGISTER_PROBE,
+                       probe,
+                       kOps) >= 0;
+    for (auto op : ops) {
+      ret = ret && op <= probe->last_op &&
+            (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    return ret;
+  }
+
+public:
+  explicit Ring(unsigned entries) {
+    io_uring_params p {};
+    fd_ = int(syscall(__NR_io_uring_setup, entries, &p));
+    if (fd_ < 0) { return; }  // E.g. not allowed, in some containers
+    sqSize_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqSize_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) { sqSize_ = cqSize_ = std::max(sqSize_, cqSize_); }
+    sq_ = mapRing(fd_, sqSize_, IORING_OFF_SQ_RING);
+    cq_ = single ? sq_ : mapRing(fd_, cqSize_, IORING_OFF_CQ_RING);
+    sqesSize_ = p.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = (io_uring_sqe*) mapRing(fd_, sqesSize_, IORING_OFF_SQES);
+    if (!sq_ || !cq_ || !sqes_) { return; }
+
+    auto* sq = (char*) sq_;
+    auto* cq = (char*) cq_;
+    sqHead_ = (unsigned*) (sq + p.sq_off.head);
+    sqTail_ = (unsigned*) (sq + p.sq_off.tail);
+    sqMask_ = (unsigned*) (sq + p.sq_off.ring_mask);
+    sqArray_ = (unsigned*) (sq + p.sq_off.array);
+    cqHead_ = (unsigned*) (cq + p.cq_off.head);
+    cqTail_ = (unsigned*) (cq + p.cq_off.tail);
+    cqMask_ = (unsigned*) (cq + p.cq_off.ring_mask);
+    cqes_ = (io_uring_cqe*) (cq + p.cq_off.cqes);
+    entries_ = p.sq_entries;
+    tail_ = *sqTail_;
+    ok_ = supports({IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_MADVISE});
+  }
+
+  ~Ring() {
+    if (sqes_) { munmap(sqes_, sqesSize_); }
+    if (cq_ && cq_ != sq_) { munmap(cq_, cqSize_); }
+    if (sq_) { munmap(sq_, sqSize_); }
+    if (fd_ >= 0) { close(fd_); }
+  }
+
+  Ring(Ring const&) = delete;
+  Ring& operator=(Ring const&) = delete;
+
+  explicit operator bool() const { return ok_; }
+
+  /** A zeroed submission to fill in; or null if the queue is full. */
+  io_uring_sqe* sqe(uint64_t userData) {
+    auto head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (tail_ - head >= entries_) { return nullptr; }
+    auto index = tail_ & *sqMask_;
+    auto* ret = &sqes_[index];
+    memset(ret, 0, sizeof(*ret));
+    ret->user_data = userData;
+    sqArray_[index] = index;
+    ++tail_;
+    ++toSubmit_;
+    return ret;
+  }
+
+  /**
+  Submit what's been filled in, and wait for at least `waitFor` completions.
+  Returns 0, or an `errno` value.
+  */
+  int submit(unsigned waitFor) {
+    __atomic_store_n(sqTail_, tail_, __ATOMIC_RELEASE);
+    while (true) {
+      auto ret = syscall(__NR_io_uring_enter,
+                         fd_,
+                         toSubmit_,
+                         waitFor,
+                         waitFor ? IORING_ENTER_GETEVENTS : 0,
+                         nullptr,
+                         0);
+      if (ret >= 0) {
+        toSubmit_ -= unsigned(ret);
+        return 0;
+      }
+      if (errno == EINTR) { continue; }
+      // Out of resources, or completions to reap first: try again after that
+      return (errno == EAGAIN || errno == EBUSY) ? 0 : errno;
+    }
+  }
+
+  /** Wait for a completion, submitting nothing more.  Returns 0 or `errno`. */
+  int wait() {
+    while (syscall(__NR_io_uring_enter,
+                   fd_,
+                   0,
+                   1,
+                   IORING_ENTER_GETEVENTS,
+                   nullptr,
+                   0) < 0) {
+      if (errno != EINTR) { return errno; }
+    }
+    return 0;
+  }
+
+  /** Submissions filled in, but not taken by the kernel yet. */
+  unsigned unsubmitted() const { return toSubmit_; }
+
+  /** Call `fn(userData, result)` for each completion. */
+  template <class Fn>
+  void reap(Fn&& fn) {
+    auto head = *cqHead_;
+    auto tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+      auto& cqe = cqes_[head & *cqMask_];
+      fn(cqe.user_data, cqe.res);
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+  }
+};
+
+#endif
+
+}  // namespace detail
+
+/*
+Loads many binaries at once, e.g. the hundreds of binaries and debug files a
+symbolization service needs at startup, handing each over as it's ready.
+
+For each file, this opens it, reads its header, section header table and
+section names (which is enough to find its sections, and leaves those in the
+page cache), maps it, and starts reading its hot sections (`willNeed`; by
+default those symbolization needs first) in with `madvise(MADV_WILLNEED)`.
+Done one file at a time, each of those waits on I/O, which on a cold cache or
+network filesystem adds up to minutes.
+
+On Linux, all of these are submitted together through io_uring, `queueDepth`
+files at a time, and each file moves on to its next step as the last one
+completes.  Where io_uring isn't available (other platforms, older kernels, or
+where it's disallowed, as in some containers), files are loaded on a
+`util::ThreadPool` instead.
+
+Either way, `ready` is called on the calling thread, as each file is ready.
+Binaries are allocated from `mr` (by default, the heap, so they can be used on
+any thread).  Uses the heap and threads; not signal-safe.
+*/
+class Loader {
+  LoaderOptions opts_;
+
+  using Job = detail::LoadJob;
+  using Step = Job::Step;
+  using Clock = std::chrono::steady_clock;
+
+  LoadedBinary finish(Job& job) const {
+    LoadedBinary ret {*job.path, std::move(job.mm), {}, job.error};
+    job = Job {};  // Free its buffers
+    if (!ret.error && ret.mm->size_ < 64) { ret.error = ENOEXEC; }
+    if (!ret.error) {
+      ret.bin = Binary::at(
+          ret.mm->addr_, ret.mm->size_, false, false, opts_.mr);
+      if (!ret.bin) { ret.error = ENOEXEC; }
+    }
+    if (ret.error) { ret.mm.reset(); }
+    return ret;
+  }
+
+  /** Do `job`'s steps, one after another. */
+  void runSync(Job& job) const {
+    job.fd = open(job.path->c_str(), O_RDONLY | O_CLOEXEC);
+    if (job.fd < 0) { return job.fail(errno); }
+    job.read(0, Job::kHeaderBytes, Step::kHeader);
+    while (job.reading()) {
+      size_t got = 0;
+      while (got < job.buf.size()) {
+        auto ret = pread(job.fd,
+                         job.buf.data() + got,
+                         job.buf.size() - got,
+                         off_t(job.readAt + got));
+        if (ret < 0 && errno == EINTR) { continue; }
+        if (ret < 0) { return job.fail(errno); }
+        if (!ret) { break; }
+        got += size_t(ret);
+      }
+      job.onRead(got, opts_.willNeed);
+    }
+    if (job.step != Step::kMap) { return; }
+    job.map();
+    if (job.step != Step::kAdvise) { return; }
+    for (auto& [off, len] : job.willNeed) {
+      job.mm->advise(off, len, util::MMap::Advice::kWillNeed);
+    }
+    job.step = Step::kDone;
+  }
+
+  void loadThreads(std::vector<Job>& jobs,
+                   std::function<void(Job&)> const& done) const {
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<Job*> ready;
+    util::ThreadPool pool(opts_.threads ? opts_.threads
+                                        : std::thread::hardware_concurrency());
+    for (auto& job : jobs) {
+      pool.submit([&, job = &job] {
+        runSync(*job);
+        std::lock_guard lock(mutex);
+        ready.push_back(job);
+        cond.notify_one();
+      });
+    }
+    for (size_t n = 0; n < jobs.size(); n++) {
+      std::unique_lock lock(mutex);
+      cond.wait(lock, [&] { return !ready.empty(); });
+      auto* job = ready.front();
+      ready.pop_front();
+      lock.unlock();
+      done(*job);
+    }
+  }
+
+#if PROGINFO_IO_URING
+  /** Returns false, having done nothing, if io_uring can't be used. */
+  bool loadIoUring(std::vector<Job>& jobs,
+                   std::function<void(Job&)> const& done) const {
+    auto depth = std::max(opts_.queueDepth, 1u);
+    detail::Ring ring(depth);
+    if (!ring) { return false; }
+
+    // Submissions wanted, for (job index, `willNeed` range or ~0), in order
+    std::deque<std::pair<size_t, size_t>> wanted;
+    size_t started = 0, finished = 0, active = 0, inFlight = 0;
+    auto page = uintptr_t(sysconf(_SC_PAGESIZE));
+
+    // Queue what `job` needs next, or if nothing, it's done
+    auto next = [&](Job& job) {
+      if (job.step == Step::kMap) { job.map(); }
+      if (job.step == Step::kAdvise) {
+        job.advising = unsigned(job.willNeed.size());
+        for (size_t i = 0; i < job.willNeed.size(); i++) {
+          wanted.push_back({job.index, i});
+        }
+        if (!job.advising) { job.step = Step::kDone; }
+      } else if (job.step != Step::kDone) {
+        wanted.push_back({job.index, ~size_t(0)});
+      }
+      if (job.step == Step::kDone) {
+        --active;
+        ++finished;
+        done(job);
+      }
+    };
+
+    auto fill = [&](io_uring_sqe* sqe, Job& job, size_t range) {
+      switch (job.step) {
+      case Step::kOpen:
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = uint64_t(uintptr_t(job.path->c_str()));
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        break;
+      case Step::kAdvise: {
+        auto [off, len] = job.willNeed[range];
+        auto start = uintptr_t(job.mm->addr_) + off;
+        auto aligned = start & ~(page - 1);
+        sqe->opcode = IORING_OP_MADVISE;
+        sqe->addr = uint64_t(aligned);
+        sqe->len = uint32_t(std::min<size_t>(start + len - aligned, ~0u));
+        sqe->fadvise_advice = MADV_WILLNEED;
+        break;
+      }
+      default:  // Reads
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = job.fd;
+        sqe->addr = uint64_t(uintptr_t(job.buf.data()));
+        sqe->len = uint32_t(job.buf.size());
+        sqe->off = job.readAt;
+        break;
+      }
+    };
+
+    auto complete = [&](uint64_t index, int res) {
+      --inFlight;
+      auto& job = jobs[index];
+      switch (job.step) {
+      case Step::kOpen:
+        if (res < 0) {
+          job.fail(-res);
+        } else {
+          job.fd = res;
+          job.read(0, Job::kHeaderBytes, Step::kHeader);
+        }
+        break;
+      case Step::kAdvise:
+        if (--job.advising) { return; }  // Only a hint: errors don't matter
+        job.step = Step::kDone;
+        break;
+      default:
+        if (res < 0) {
+          job.fail(-res);
+        } else {
+          job.onRead(size_t(res), opts_.willNeed);
+        }
+        break;
+      }
+      next(job);
+    };
+
+    while (finished < jobs.size()) {
+      while (active < depth && started < jobs.size()) {
+        ++active;
+        wanted.push_back({started++, ~size_t(0)});
+      }
+      while (!wanted.empty()) {
+        auto [index, range] = wanted.front();
+        auto* sqe = ring.sqe(index);
+        if (!sqe) { break; }
+        fill(sqe, jobs[index], range);
+        wanted.pop_front();
+        ++inFlight;
+      }
+      if (auto err = ring.submit(inFlight ? 1 : 0)) {
+        // Give up on what's left; but first let what the kernel has taken,
+        // which may be reading into jobs' buffers, complete
+        auto submitted = inFlight - ring.unsubmitted();
+        while (submitted) {
+          ring.reap([&](uint64_t index, int res) {
+            --submitted;
+            auto& job = jobs[index];
+            if (job.step == Step::kOpen && res >= 0) { job.fd = res; }
+          });
+          if (submitted && ring.wait()) {
+            // Can't tell when they're done: leave those buffers be
+            for (auto& job : jobs) {
+              if (job.reading()) { (void) new auto(std::move(job.buf)); }
+            }
+            break;
+          }
+        }
+        for (auto& job : jobs) {
+          if (job.path && job.step != Step::kDone) {
+            job.fail(err);
+            done(job);
+          }
+        }
+        break;
+      }
+      ring.reap(complete);
+    }
+    return true;
+  }
+#endif
+
+public:
+  explicit Loader(LoaderOptions opts = {}) : opts_(std::move(opts)) {}
+
+  /**
+  Load the files at `paths`, calling `ready(i, binary)` with each (`i` being
+  its index in `paths`) as it's ready, in no particular order.  `paths` must
+  stay valid until this returns.
+  */
+  LoadStats load(std::vector<std::string> const& paths,
+                 std::function<void(size_t, LoadedBinary)> const& ready) {
+    util::Stats::Scope timer(util::Timer::kIO);
+    LoadStats stats;
+    auto start = Clock::now();
+    std::vector<Job> jobs(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+      jobs[i].index = i;
+      jobs[i].path = &paths[i];
+    }
+    auto done = [&](Job& job) {
+      auto index = job.index;
+      auto loaded = finish(job);
+      ++(loaded.error ? stats.failed : stats.loaded);
+      ready(index, std::move(loaded));
+    };
+#if PROGINFO_IO_URING
+    stats.ioUring = opts_.ioUring && loadIoUring(jobs, done);
+#endif
+    if (!stats.ioUring) { loadThreads(jobs, done); }
+    stats.totalNanos = uint64_t(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                             start)
+            .count());
+    return stats;
+  }
+
+  /** Load all of `paths`; the results are in the same order. */
+  std::vector<LoadedBinary> loadAll(std::vector<std::string> const& paths,
+                                    LoadStats* stats = nullptr) {
+    std::vector<LoadedBinary> ret(paths.size());
+    auto s = load(paths, [&](size_t i, LoadedBinary loaded) {
+      ret[i] = std::move(loaded);
+    });
+    if (stats) { *stats = s; }
+    return ret;
+  }
+};
+
+}  // namespace proginfo::binary
@@ -5,18 +5,82 @@ static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
 
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <string_view>
 
 namespace proginfo::binary {
 
+/** What a symbol names.  Values are ELF's `STT_*`, except for `kOther`. */
+enum class SymbolType : uint8_t {
+  kNone = 0,
+  kObject = 1,    // Data
+  kFunction = 2,  // Code
+  kSection = 3,
+  kFile = 4,
+  kCommon = 5,  // Uninitialized data, not yet allocated
+  kTLS = 6,
+  kIndirectFunction = 10,  // GNU ifunc: its value is a resolver function's
+  kOther = 15,
+};
+
+/** Values are ELF's `STB_*`, except for `kOther`. */
+enum class SymbolBinding : uint8_t {
+  kLocal = 0,
+  kGlobal = 1,
+  kWeak = 2,
+  kUnique = 10,  // GNU extension: one definition process-wide
+  kOther = 15,
+};
+
+/** Values are ELF's `STV_*`. */
+enum class SymbolVisibility : uint8_t {
+  kDefault = 0,
+  kInternal = 1,
+  kHidden = 2,
+  kProtected = 3,
+};
+
 struct Symbol : util::Bytes {
+  // Special section indexes
+  constexpr static uint16_t kUndefined = 0;      // Defined in some other module
+  constexpr static uint16_t kAbsolute = 0xfff1;  // Not relative to a section
+  constexpr static uint16_t kCommon = 0xfff2;
+  constexpr static uint16_t kExtended = 0xffff;  // Index is in `.symtab_shndx`
+
   virtual ~Symbol() = default;
   explicit Symbol(util::Addr addr) : util::Bytes {addr} {}
 
   virtual uintptr_t value() const = 0;
   virtual std::string_view name() const = 0;
+
+  /** Of the function or object, in bytes; 0 if unknown (or empty). */
+  virtual uintptr_t size() const = 0;
+  virtual SymbolType type() const = 0;
+  virtual SymbolBinding binding() const = 0;
+  virtual SymbolVisibility visibility() const = 0;
+  virtual uint16_t secIndex() const = 0;
+
+  bool isDefined() const { return secIndex() != kUndefined; }
+
+  /** Whether `addr` is within the symbol; false if its size isn't known. */
+  bool contains(uintptr_t addr) const {
+    return addr >= value() && addr - value() < size();
+  }
+
+  /** `SymbolType` from an ELF symbol's `st_info` */
+  static SymbolType typeOf(uint8_t info) {
+    auto type = info & 0x0f;
+    return (type <= 6 || type == 10) ? SymbolType(type) : SymbolType::kOther;
+  }
+
+  /** `SymbolBinding` from an ELF symbol's `st_info` */
+  static SymbolBinding bindingOf(uint8_t info) {
+    auto bind = info >> 4;
+    return (bind <= 2 || bind == 10) ? SymbolBinding(bind)
+                                     : SymbolBinding::kOther;
+  }
 };
 
 }  // namespace proginfo::binary
@@ -5,16 +5,58 @@ static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
 
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <functional>
+#include <utility>
 
 namespace proginfo::binary {
 
+/**
+Which symbols a scan of a `SymbolTable` wants.  These are checked against the
+raw table entries, before any `Symbol` is made for the callback, so skipping
+(say) everything but functions is cheap.  By default, all are wanted.
+*/
+struct SymbolFilter {
+  uint32_t types {~0u};     // Bits, `1 << SymbolType`
+  uint32_t bindings {~0u};  // Bits, `1 << SymbolBinding`
+  bool definedOnly {};      // Skip undefined symbols (i.e. imports)
+  bool sizedOnly {};        // Skip symbols with no size
+
+  constexpr static uint32_t bit(SymbolType type) {
+    return 1u << unsigned(type);
+  }
+  constexpr static uint32_t bit(SymbolBinding binding) {
+    return 1u << unsigned(binding);
+  }
+
+  /** Defined functions and data: what address lookups want. */
+  static SymbolFilter addressable() {
+    return {bit(SymbolType::kFunction) | bit(SymbolType::kObject), ~0u, true};
+  }
+
+  bool wants(SymbolType type,
+             SymbolBinding binding,
+             uint16_t secIndex,
+             uintptr_t size) const {
+    return (types & bit(type)) && (bindings & bit(binding)) &&
+           (!definedOnly || secIndex != Symbol::kUndefined) &&
+           (!sizedOnly || size);
+  }
+};
+
 class SymbolTable {
 public:
   virtual ~SymbolTable() = default;
-  virtual void each(std::function<bool(Symbol const&)> cb) const = 0;
+
+  /** Call `cb` with each symbol `filter` wants, until it returns false. */
+  virtual void each(SymbolFilter const& filter,
+                    std::function<bool(Symbol const&)> cb) const = 0;
+
+  void each(std::function<bool(Symbol const&)> cb) const {
+    each(SymbolFilter {}, std::move(cb));
+  }
 };
 
 }  // namespace proginfo::binary
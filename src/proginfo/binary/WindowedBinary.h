@@ -0,0 +1,96 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "../util/WindowedFile.h"
+#include "Binary.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+namespace proginfo::binary {
+
+/*
+A `Binary` on a `util::WindowedFile`: the headers it needs to find its
+segments and sections are fetched (and stay pinned) up front, and nothing else
+until asked for.  So for a multi-GB debug file, where only a few sections (say,
+`.symtab` and `.debug_line`) are needed, only those are ever read.
+
+For ELF, that's the file header, the program and section header tables, and
+section names; for Mach-O, the header and load commands.  Other formats aren't
+supported (this is empty).  Before reading any section's contents, including
+via `symTable()`, `fetch` it, and keep the `Pin` while using it.  The file must
+outlive this.
+*/
+class WindowedBinary {
+  using Pin = util::WindowedFile::Pin;
+
+  util::WindowedFile& file_;
+  std::vector<Pin> headers_;
+  util::Virtual<Binary> bin_;
+  Binary const* ptr_ {};  // `bin_`'s, if its headers were read
+
+  bool pin(size_t offset, size_t size) {
+    auto pin = file_.fetch(offset, size);
+    if (!pin) { return false; }
+    headers_.push_back(std::move(pin));
+    return true;
+  }
+
+  bool fetchELF() {
+    auto& elf = static_cast<ELF const&>(*bin_);
+    auto size = file_.size();
+    auto phOff = elf.segHeaderOffset();
+    auto shOff = elf.secHeaderOffset();
+    auto phBytes = bin_->segHeaderCount() * elf.segHeaderSize();
+    auto shBytes = bin_->secHeaderCount() * elf.secHeaderSize();
+    if (phOff > size || phBytes > size - phOff || shOff > size ||
+        shBytes > size - shOff) {
+      return false;
+    }
+    if (!pin(phOff, phBytes) || !pin(shOff, shBytes)) { return false; }
+    auto names = bin_->section(elf.sectionNameIndex());
+    return !names || pin(names->fileOffset(), names->size());
+  }
+
+public:
+  /**
+  Open the binary in `file` (as a file, not loaded), allocated from `mr` (by
+  default, the thread's `util::Alloc`).  Empty if it's not a binary, or the
+  headers couldn't be read.
+  */
+  explicit WindowedBinary(util::WindowedFile& file,
+                          std::pmr::memory_resource* mr = nullptr)
+      : file_(file) {
+    if (!file || !pin(0, 64)) { return; }  // Enough for any file header
+    auto addr = file.addr();
+    if (addr.size_ < 64) { return; }
+    bin_ = Binary::at(addr.ptr_, addr.size_, false, false, mr);
+    if (!bin_) { return; }
+    bool ok = false;
+    if (bin_->isELF()) {
+      ok = fetchELF();
+    } else if (bin_->isMachO()) {
+      ok = pin(32, addr.u32LE(0x14));  // `sizeofcmds`
+    }
+    if (ok) { ptr_ = &*bin_; }
+  }
+
+  explicit operator bool() const { return ptr_; }
+  Binary const& operator*() const { return *ptr_; }
+  Binary const* operator->() const { return ptr_; }
+
+  /** Read section `name`'s contents; the `Pin` is false if that failed. */
+  Pin fetch(std::string_view name) {
+    if (!ptr_) { return {}; }
+    auto sec = ptr_->section(name);
+    if (!sec) { return {}; }
+    return file_.fetch(sec->fileOffset(), sec->size());
+  }
+
+  util::WindowedFile& file() const { return file_; }
+};
+
+}  // namespace proginfo::binary
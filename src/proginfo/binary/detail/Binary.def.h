@@ -1,6 +1,7 @@
 #pragma once
 static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
 
+#include "../../util/Stats.h"
 #include "../elf/ELF32.h"
 #include "../elf/ELF64.h"
 #include "../macho/MachO64.h"
@@ -24,13 +25,15 @@ inline util::Virtual<Segment> Binary::segment(std::string_view name) const {
 inline util::Virtual<Section> Binary::section(std::string_view name) const {
   util::Virtual<Section> ret;
   auto n = unsigned(secHeaderCount());
-  for (unsigned i = 0; i < n; i++) {
+  unsigned i = 0;
+  for (; i < n; i++) {
     auto sec = section(i);
     if (sec->name() == name) {
       ret = std::move(sec);
       break;
     }
   }
+  util::Stats::add(util::Counter::kSectionsScanned, std::min(i + 1, n));
   return ret;
 };
 
@@ -44,15 +47,21 @@ inline void Binary::eachSegment(std::function<bool(Segment const&)> cb) const {
 
 inline void Binary::eachSection(std::function<bool(Section const&)> cb) const {
   auto n = unsigned(secHeaderCount());
-  for (unsigned i = 0; i < n; i++) {
+  unsigned i = 0;
+  for (; i < n; i++) {
     auto sec = section(i);
     if (!cb(*sec)) { break; }
   }
+  util::Stats::add(util::Counter::kSectionsScanned, std::min(i + 1, n));
 }
 
-inline util::Virtual<binary::Binary>
-Binary::at(void const* ptr, size_t size, bool isLoaded, bool isAuxBinary) {
-  util::Virtual<binary::Binary> ret;
+inline util::Virtual<binary::Binary> Binary::at(
+    void const* ptr,
+    size_t size,
+    bool isLoaded,
+    bool isAuxBinary,
+    std::pmr::memory_resource* mr) {
+  util::Virtual<binary::Binary> ret {mr};
   auto buf = (uint8_t*) ptr;
   if (!memcmp(buf, "\x7f\x45\x4c\x46", 4)) {
     util::Addr addr {ptr, size};
@@ -25,8 +25,17 @@ class Binary : public util::Bytes {
 public:
   virtual ~Binary() = default;
 
+  /**
+  Get a `Binary` for the file at `ptr`, allocated from `mr` (by default, the
+  current thread's `util::Alloc`).  To share it with other threads, use e.g. a
+  `util::SharedPool`.
+  */
   inline static util::Virtual<Binary>
-  at(void const* ptr, size_t size, bool isLoaded, bool isAuxBinary);
+  at(void const* ptr,
+     size_t size,
+     bool isLoaded,
+     bool isAuxBinary,
+     std::pmr::memory_resource* mr = nullptr);
 
   explicit Binary(util::Addr addr, bool isLoaded, bool isAuxBinary)
       : util::Bytes {addr}
@@ -41,6 +50,7 @@ public:
 
   virtual bool isExecutable() const = 0;
   virtual bool isSharedObject() const = 0;
+  virtual bool isCore() const = 0;
   virtual bool isLoaded() const final { return isLoaded_; }
   virtual bool isAuxBinary() const final { return isAuxBinary_; }
 
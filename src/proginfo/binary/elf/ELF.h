@@ -38,6 +38,13 @@ public:
     return false;
   }
 
+  bool isCore() const override { return u16(0x10) == 0x0004; }
+
+  /** An object file (`ET_REL`), as yet unlinked; see `Relocatable`. */
+  bool isRelocatable() const { return u16(0x10) == 0x0001; }
+
+  uint16_t machine() const { return u16(0x12); }
+
   virtual uintptr_t segHeaderOffset() const = 0;
   virtual uintptr_t segHeaderSize() const = 0;
   virtual uintptr_t secHeaderOffset() const = 0;
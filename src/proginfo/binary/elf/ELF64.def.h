@@ -38,7 +38,7 @@ inline util::Virtual<SymbolTable> ELF64::symTable() const {
   auto symData = baseAddr() + symtab->fileOffset();
   auto symSize = symbolSize();
   assert(symtab->size() % symSize == 0);
-  auto symCount = uint16_t(symtab->size() / symSize);
+  auto symCount = uint32_t(symtab->size() / symSize);
   auto strtabChars = baseAddr() + strtab->fileOffset();
   ret.emplace<SymbolTable64>(
       symData, symCount, symSize, isLE(), strtabChars.str());
@@ -0,0 +1,182 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "../Binary.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string_view>
+
+namespace proginfo::binary {
+
+/** An ELF note: a small, typed record, in `PT_NOTE` / `SHT_NOTE` data. */
+struct Note {
+  std::string_view name;  // Its owner, e.g. "GNU", "CORE"; no trailing NUL
+  uint32_t type;
+  util::Addr desc;
+};
+
+/*
+Reads the notes in one block of note data (a `PT_NOTE` segment or `SHT_NOTE`
+section), in place: names and descriptors point into the data, nothing is
+copied.  Each is a header of three 32-bit words in the binary's byte order
+(name size, descriptor size, type), then the name and descriptor, each padded
+to `align` bytes: 4 as a rule, 8 for blocks aligned to 8 (as GNU property
+notes are).  Stops at the first note which doesn't fit in the block.
+*/
+class NoteReader {
+  util::Addr notes_;
+  bool isLE_;
+  size_t align_;
+  size_t off_ {};
+
+  uint32_t u32(size_t off) const {
+    return isLE_ ? notes_.u32LE(off) : notes_.u32BE(off);
+  }
+
+  size_t pad(size_t size) const { return (size + align_ - 1) & ~(align_ - 1); }
+
+public:
+  constexpr static uint32_t kNTGnuBuildId = 3;
+
+  NoteReader(util::Addr notes, bool isLE, size_t align = 4)
+      : notes_(notes)
+      , isLE_(isLE)
+      , align_(align == 8 ? 8 : 4) {}
+
+  /** The next note, if there are any more. */
+  std::optional<Note> next() {
+    auto size = notes_.size_;
+    if (off_ > size || size - off_ < 12) { return {}; }
+    auto nameSize = u32(off_);
+    auto descSize = u32(off_ + 4);
+    auto nameOff = off_ + 12;
+    auto descOff = nameOff + pad(nameSize);
+    if (nameSize > size - nameOff || descOff > size ||
+        descSize > size - descOff) {
+      off_ = size;
+      return {};
+    }
+    auto name = (notes_ + nameOff).trunc(nameSize).str();
+    if (!name.empty() && name.back() == '\0') { name.remove_suffix(1); }
+    Note ret {name, u32(off_ + 8), (notes_ + descOff).trunc(descSize)};
+    off_ = descOff + pad(descSize);
+    return ret;
+  }
+
+  /** The raw GNU build ID in the rest of the notes, or empty if none. */
+  std::string_view buildId() {
+    while (auto note = next()) {
+      if (note->type == kNTGnuBuildId && note->name == "GNU") {
+        return note->desc.str();
+      }
+    }
+    return {};
+  }
+};
+
+namespace detail {
+
+/**
+Call `fn` with a `NoteReader` for each `PT_NOTE` segment in `bin`, or if it has
+none (as relocatable objects don't), each `SHT_NOTE` section, until it returns
+false.  Headers are read directly, so this doesn't allocate.  For loaded
+images, segments are found by address, and sections (which aren't loaded) are
+skipped.  Returns false if `fn` did.
+*/
+template <class Fn>
+bool eachNoteBlock(Binary const& bin, Fn&& fn) {
+  if (!bin.isELF()) { return true; }
+  auto& elf = static_cast<ELF const&>(bin);
+  auto is64 = bin.is64();
+  auto isLE = bin.isLE();
+  auto base = bin.baseAddr();
+  auto word = [&](size_t off) { return is64 ? elf.u64(off) : elf.u32(off); };
+  auto block = [&](uint64_t off, uint64_t size, uint64_t align) {
+    if (off > base.size_ || size > base.size_ - off) { return true; }
+    NoteReader reader((base + size_t(off)).trunc(size_t(size)), isLE, align);
+    return fn(reader);
+  };
+
+  // Program headers: type, then (64-bit) flags, offset, vaddr, paddr, filesz,
+  // memsz, align; or (32-bit) offset, vaddr, paddr, filesz, memsz, flags, align
+  auto phOff = elf.segHeaderOffset();
+  auto phSize = elf.segHeaderSize();
+  auto phCount = bin.segHeaderCount();
+  if (phOff > base.size_ || phSize < (is64 ? 56u : 32u) ||
+      phCount > (base.size_ - phOff) / phSize) {
+    phCount = 0;
+  }
+  uint64_t bias = 0;  // Loaded images: vaddr of data at `base`
+  if (bin.isLoaded()) {
+    for (size_t i = 0; i < phCount; i++) {
+      auto ph = phOff + i * phSize;
+      if (elf.u32(ph) == 1) {  // PT_LOAD
+        bias = word(ph + (is64 ? 0x10 : 0x08)) - word(ph + (is64 ? 8 : 4));
+        break;
+      }
+    }
+  }
+  bool found = false;
+  for (size_t i = 0; i < phCount; i++) {
+    auto ph = phOff + i * phSize;
+    if (elf.u32(ph) != 4) { continue; }  // PT_NOTE
+    found = true;
+    auto off = bin.isLoaded() ? word(ph + (is64 ? 0x10 : 0x08)) - bias
+                              : word(ph + (is64 ? 0x08 : 0x04));
+    auto size = word(ph + (is64 ? 0x20 : 0x10));
+    if (!block(off, size, word(ph + (is64 ? 0x30 : 0x1c)))) { return false; }
+  }
+  if (found || bin.isLoaded()) { return true; }
+
+  // Section headers: name, type, flags, addr, offset, size, link, info, align
+  auto shOff = elf.secHeaderOffset();
+  auto shSize = elf.secHeaderSize();
+  auto shCount = bin.secHeaderCount();
+  if (shOff > base.size_ || shSize < (is64 ? 64u : 40u) ||
+      shCount > (base.size_ - shOff) / shSize) {
+    return true;
+  }
+  for (size_t i = 0; i < shCount; i++) {
+    auto sh = shOff + i * shSize;
+    if (elf.u32(sh + 4) != 7) { continue; }  // SHT_NOTE
+    auto off = word(sh + (is64 ? 0x18 : 0x10));
+    auto size = word(sh + (is64 ? 0x20 : 0x14));
+    if (!block(off, size, word(sh + (is64 ? 0x30 : 0x20)))) { return false; }
+  }
+  return true;
+}
+
+}  // namespace detail
+
+/**
+Call `cb` with each note in `bin` (an ELF file, or loaded image), until it
+returns false.  Notes come from the `PT_NOTE` segments; or if there are none,
+the `SHT_NOTE` sections.
+*/
+inline void eachNote(Binary const& bin, std::function<bool(Note const&)> cb) {
+  detail::eachNoteBlock(bin, [&](NoteReader& reader) {
+    while (auto note = reader.next()) {
+      if (!cb(*note)) { return false; }
+    }
+    return true;
+  });
+}
+
+/**
+The raw GNU build ID (`NT_GNU_BUILD_ID` note's descriptor) of `bin`, pointing
+into it; or empty if it has none.  The build ID note is usually first, so this
+is typically a few reads of the headers and the note itself.
+*/
+inline std::string_view buildId(Binary const& bin) {
+  std::string_view ret;
+  detail::eachNoteBlock(bin, [&](NoteReader& reader) {
+    ret = reader.buildId();
+    return ret.empty();
+  });
+  return ret;
+}
+
+}  // namespace proginfo::binary
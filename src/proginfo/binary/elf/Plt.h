@@ -0,0 +1,259 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "../Binary.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+namespace proginfo::binary {
+
+/*
+A stub in an ELF binary's procedure linkage table (`.plt`, `.plt.sec` or
+`.plt.got`), and the function it jumps to.
+
+Calls to functions in other modules go through these stubs, so profiles often
+land in them; but they have no symbols of their own.  As with `objdump`, each
+one's function is found from the relocation for the GOT slot it jumps through,
+whose symbol (in `.dynsym`) names it.  On x86 and x86-64 the slot is decoded
+from the stub's `jmp` instruction; elsewhere (AArch64, RISC-V) the stubs are
+assumed to be in the same order as the relocations in `.rela.plt`.
+*/
+struct PltEntry {
+  uintptr_t addr;         // Link-time address of the stub
+  uint32_t size;          // In bytes
+  std::string_view name;  // Function called (without "@plt"), or empty
+  uintptr_t target;       // If no `name`: the `IRELATIVE` reloc's resolver
+};
+
+namespace detail {
+
+/** The header fields (of `Section64` or `Section32`) needed here. */
+struct ElfSectionInfo {
+  uint32_t type;
+  uint32_t link;
+  size_t entSize;
+
+  static ElfSectionInfo of(Section const& sec) {
+    if (auto* sec64 = dynamic_cast<Section64 const*>(&sec)) {
+      return {sec64->type(), sec64->link(), sec64->entSize()};
+    }
+    auto& sec32 = static_cast<Section32 const&>(sec);
+    return {sec32.type(), sec32.link(), sec32.entSize()};
+  }
+};
+
+/*
+The relocations for GOT slots, from `.rela.plt` and `.rela.dyn` (or `.rel.*`),
+with their symbols' names.  Those from `.rela.plt` are kept in file order, for
+finding stubs by position; all are kept sorted by slot, for finding them by
+the slot a stub jumps through.
+*/
+class GotSlots {
+public:
+  struct Slot {
+    uintptr_t addr;
+    std::string_view name;  // Empty for `IRELATIVE` relocs
+    uintptr_t target;       // Their resolver function
+  };
+
+private:
+  Binary const& bin_;
+  std::pmr::vector<Slot> plt_;
+  std::pmr::vector<Slot> all_;
+  size_t pltEntSize_ {};  // Of `.rela.plt`'s (or `.rel.plt`'s) entries
+
+  bool inFile(Section const& sec) const {
+    auto fileSize = bin_.baseAddr().size_;
+    return sec.fileOffset() <= fileSize &&
+           sec.size() <= fileSize - sec.fileOffset();
+  }
+
+  /** Name of symbol `index` in the symbol table section `symtab`. */
+  std::string_view symbolName(unsigned symtab, uint64_t index) const {
+    auto syms = bin_.section(symtab);
+    if (!syms || !inFile(*syms)) { return {}; }
+    auto symSize = bin_.is64() ? 24u : 16u;
+    if (index >= syms->size() / symSize) { return {}; }
+    auto strs = bin_.section(ElfSectionInfo::of(*syms).link);
+    if (!strs || !inFile(*strs)) { return {}; }
+    auto nameIndex = bin_.u32(syms->fileOffset() + index * symSize);
+    std::string_view strings {
+        (char const*) bin_.baseAddr().ptr_ + strs->fileOffset(), strs->size()};
+    if (nameIndex >= strings.size()) { return {}; }
+    auto ret = strings.substr(nameIndex);
+    return ret.substr(0, ret.find('\0'));
+  }
+
+  /**
+  Add the relocations in the section called `name`, if there is one; returns
+  the size of each.
+  */
+  size_t read(std::string_view name, std::pmr::vector<Slot>& out) {
+    auto sec = bin_.section(name);
+    if (!sec || !inFile(*sec)) { return 0; }
+    auto info = ElfSectionInfo::of(*sec);
+    bool isRela = info.type == 4;  // SHT_RELA, else SHT_REL
+    auto is64 = bin_.is64();
+    size_t size = is64 ? (isRela ? 24 : 16) : (isRela ? 12 : 8);
+    for (size_t off = 0; off + size <= sec->size(); off += size) {
+      auto pos = sec->fileOffset() + off;
+      uint64_t addr, sym, addend = 0;
+      if (is64) {
+        addr = bin_.u64(pos);
+        sym = bin_.u64(pos + 8) >> 32;
+        if (isRela) { addend = bin_.u64(pos + 16); }
+      } else {
+        addr = bin_.u32(pos);
+        sym = bin_.u32(pos + 4) >> 8;
+        if (isRela) { addend = bin_.u32(pos + 8); }
+      }
+      auto name = sym ? symbolName(info.link, sym) : std::string_view();
+      out.push_back({uintptr_t(addr), name, name.empty() ? addend : 0});
+    }
+    return size;
+  }
+
+public:
+  explicit GotSlots(
+      Binary const& bin,
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : bin_(bin)
+      , plt_(mr)
+      , all_(mr) {
+    pltEntSize_ = read(".rela.plt", plt_);
+    if (!pltEntSize_) { pltEntSize_ = read(".rel.plt", plt_); }
+    read(".rela.dyn", all_);
+    read(".rel.dyn", all_);
+    all_.insert(all_.end(), plt_.begin(), plt_.end());
+    std::sort(all_.begin(), all_.end(), [](auto& a, auto& b) {
+      return a.addr < b.addr;
+    });
+  }
+
+  /** The `i`th relocation in `.rela.plt`, or nullptr. */
+  Slot const* plt(size_t i) const {
+    return i < plt_.size() ? &plt_[i] : nullptr;
+  }
+  size_t pltCount() const { return plt_.size(); }
+
+  /** The relocation at byte `offset` into `.rela.plt`, or nullptr. */
+  Slot const* pltAt(size_t offset) const {
+    if (!pltEntSize_ || offset % pltEntSize_) { return nullptr; }
+    return plt(offset / pltEntSize_);
+  }
+
+  /** The relocation for the slot at `addr`, or nullptr. */
+  Slot const* find(uintptr_t addr) const {
+    auto it = std::lower_bound(
+        all_.begin(), all_.end(), addr, [](auto& slot, uintptr_t a) {
+          return slot.addr < a;
+        });
+    return it != all_.end() && it->addr == addr ? &*it : nullptr;
+  }
+};
+
+/**
+The slot that the x86 or x86-64 PLT stub at `pos` (in the file; `addr` when
+loaded) jumps through, or nullptr.  Looks for `jmp *slot`, possibly after an
+`endbr` and/or `bnd` prefix; or, failing that, the lazy-binding `push` of
+the relocation's index (on x86-64) or offset (on x86).
+*/
+inline GotSlots::Slot const* x86Slot(Binary const& bin,
+                                     GotSlots const& slots,
+                                     size_t pos,
+                                     uintptr_t addr,
+                                     size_t size,
+                                     uintptr_t gotPlt) {
+  auto is64 = bin.is64();
+  for (size_t off : {0u, 1u, 4u, 5u}) {
+    if (off + 6 > size || bin.u8(pos + off) != 0xff) { continue; }
+    auto modrm = bin.u8(pos + off + 1);
+    auto disp = bin.u32(pos + off + 2);
+    uintptr_t slot;
+    if (modrm == 0x25 && is64) {  // jmp *disp(%rip)
+      slot = addr + off + 6 + uintptr_t(int64_t(int32_t(disp)));
+    } else if (modrm == 0x25) {  // jmp *abs
+      slot = disp;
+    } else if (modrm == 0xa3) {  // jmp *disp(%ebx), %ebx being the GOT
+      slot = gotPlt + disp;
+    } else {
+      continue;
+    }
+    if (auto* ret = slots.find(slot)) { return ret; }
+  }
+  for (size_t off : {0u, 4u}) {
+    if (off + 5 <= size && bin.u8(pos + off) == 0x68) {  // push $reloc
+      auto reloc = bin.u32(pos + off + 1);
+      return is64 ? slots.plt(reloc) : slots.pltAt(reloc);
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace detail
+
+/**
+Call `cb` for each PLT stub in `bin` (see `PltEntry`) whose function can be
+worked out, until it returns false.  Needs a `util::Alloc` on this thread.
+*/
+inline void eachPltEntry(Binary const& bin,
+                         std::function<bool(PltEntry const&)> cb) {
+  if (!bin.isELF()) { return; }
+  detail::GotSlots slots(bin);
+  auto machine = static_cast<ELF const&>(bin).machine();
+  auto fileSize = bin.baseAddr().size_;
+
+  auto each = [&](char const* name, auto&& slotFor) {
+    auto sec = bin.section(name);
+    if (!sec || sec->fileOffset() > fileSize ||
+        sec->size() > fileSize - sec->fileOffset()) {
+      return true;
+    }
+    // GNU ld gives i386's `.plt` an entry size of 4, not its stubs' size
+    auto size = detail::ElfSectionInfo::of(*sec).entSize;
+    if (size < 8) { size = 16; }
+    for (size_t off = 0; off + size <= sec->size(); off += size) {
+      auto addr = sec->virtAddr() + off;
+      auto* slot = slotFor(sec->fileOffset() + off, addr, size, off);
+      if (!slot || (slot->name.empty() && !slot->target)) { continue; }
+      if (!cb({addr, uint32_t(size), slot->name, slot->target})) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  if (machine == 62 || machine == 3) {  // EM_X86_64, EM_386
+    auto gotPlt = bin.section(".got.plt");
+    if (!gotPlt) { gotPlt = bin.section(".got"); }
+    auto gotPltAddr = gotPlt ? gotPlt->virtAddr() : 0;
+    auto x86 = [&](size_t pos, uintptr_t addr, size_t size, size_t) {
+      return detail::x86Slot(bin, slots, pos, addr, size, gotPltAddr);
+    };
+    // With `.plt.sec` (for IBT), `.plt` has only the lazy-binding stubs, which
+    // aren't called directly; `objdump` names only those in `.plt.sec`
+    if (bin.section(".plt.sec")) {
+      each(".plt.sec", x86) && each(".plt.got", x86);
+    } else {
+      each(".plt", x86) && each(".plt.got", x86);
+    }
+  } else if (machine == 183 || machine == 243) {  // EM_AARCH64, EM_RISCV
+    // A header, then one 16-byte stub per `.rela.plt` entry
+    auto plt = bin.section(".plt");
+    if (!plt || plt->size() < slots.pltCount() * 16) { return; }
+    auto header = plt->size() - slots.pltCount() * 16;
+    if (header > 64) { return; }
+    each(".plt", [&](size_t, uintptr_t, size_t, size_t off) {
+      return off < header ? nullptr : slots.plt((off - header) / 16);
+    });
+  }
+}
+
+}  // namespace proginfo::binary
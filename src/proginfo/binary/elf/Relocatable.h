@@ -0,0 +1,387 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "../Binary.h"
+#include "../Symbol.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+namespace proginfo::binary {
+
+/*
+A relocatable object (`ET_REL`, e.g. a `.o` file), as if it had been linked.
+
+Sections in these all start at address 0, and references between them (such as
+DWARF's, from `.debug_info` to code and to `.debug_str`) are left for the
+linker to fill in, from `.rel[a].*` sections.  So read as they are, every
+function seems to be at 0, and every string the first one.
+
+This gives each allocated section (`SHF_ALLOC`: code and data) a synthetic
+address, laid out one after another from `kBaseAddr` as a linker would (with
+thread-local ones together, last, as the TLS block), and symbols' addresses in
+them; other sections are at 0, as in a linked file.  Sections' contents are
+copied, on first use, into a buffer owned by this, and their relocations
+applied there: only those used are copied, and those without relocations are
+returned in place.  Views returned stay valid for this object's lifetime.
+
+Relocations of the common data kinds (absolute and PC-relative, of 8 to 64
+bits, RISC-V's add / subtract pairs, and x86's offsets in the TLS block, as
+DWARF uses for thread-local variables) are handled, for x86, ARM, AArch64,
+PowerPC, RISC-V and s390; others (as in code, which this doesn't relocate) are
+left as they are, and counted in `skipped`.  Not thread-safe.
+*/
+class Relocatable {
+public:
+  constexpr static uintptr_t kBaseAddr = 0x1000;
+
+private:
+  enum class Kind : uint8_t {
+    kNone,
+    kAbs,    // S + A
+    kPCRel,  // S + A - P
+    kAdd,    // In place + S + A
+    kSub,    // In place - (S + A)
+    kTLS,    // S + A - (start of the TLS block)
+  };
+
+  struct How {
+    Kind kind {};
+    uint8_t bytes {};
+  };
+
+  struct Header {
+    uint32_t type {};
+    uint64_t flags {};
+    uint64_t offset {};
+    uint64_t size {};
+    uint32_t link {};
+    uint32_t info {};
+    uint64_t align {};
+    uint64_t entSize {};
+  };
+
+  struct Applied {
+    unsigned index;
+    std::pmr::vector<char> data;
+  };
+
+  Binary const& bin_;
+  bool ok_ {};
+  uint16_t machine_ {};
+  std::pmr::vector<Header> headers_;
+  std::pmr::vector<uintptr_t> addrs_;     // Per section; 0 if not allocated
+  uintptr_t tlsAddr_ {};                  // Of the first `SHF_TLS` section
+  std::pmr::vector<unsigned> relocsFor_;  // Per section; 0 if none
+  mutable std::pmr::vector<Applied> applied_;
+  mutable size_t skipped_ {};
+
+  uint64_t word(size_t off) const {
+    auto& elf = static_cast<ELF const&>(bin_);
+    return bin_.is64() ? elf.u64(off) : elf.u32(off);
+  }
+
+  How how(uint32_t type) const;
+  uint64_t symbolValue(Header const& symtab, uint64_t sym) const;
+  void apply(Header const& relocs, std::pmr::vector<char>& data) const;
+
+public:
+  /** Lays out `bin`; if it's not an ELF relocatable object, this is empty. */
+  explicit Relocatable(
+      Binary const& bin,
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource());
+
+  Relocatable(Relocatable const&) = delete;
+  Relocatable& operator=(Relocatable const&) = delete;
+
+  explicit operator bool() const { return ok_; }
+
+  /** The synthetic address of section `index`; 0 if it's not allocated. */
+  uintptr_t sectionAddr(size_t index) const {
+    return index < addrs_.size() ? addrs_[index] : 0;
+  }
+
+  /**
+  `sym`'s address: its value, relative to its section's synthetic address.
+  Undefined and common symbols (which have none yet) are 0.
+  */
+  uintptr_t symbolAddr(Symbol const& sym) const {
+    auto index = sym.secIndex();
+    if (index == Symbol::kAbsolute) { return sym.value(); }
+    if (index >= addrs_.size() || !addrs_[index]) { return 0; }
+    return addrs_[index] + sym.value();
+  }
+
+  /**
+  The contents of section `index`, with its relocations applied; empty if it
+  has no contents in the file.
+  */
+  std::string_view contents(size_t index) const;
+
+  /** The contents of the section named `name`, relocated; or empty. */
+  std::string_view contents(std::string_view name) const {
+    std::string_view ret;
+    size_t index = 0;
+    bin_.eachSection([&](Section const& sec) {
+      if (sec.name() == name) {
+        ret = contents(index);
+        return false;
+      }
+      ++index;
+      return true;
+    });
+    return ret;
+  }
+
+  /** Relocations not applied, being of unsupported types. */
+  size_t skipped() const { return skipped_; }
+};
+
+inline Relocatable::Relocatable(Binary const& bin,
+                                std::pmr::memory_resource* mr)
+    : bin_(bin)
+    , headers_(mr)
+    , addrs_(mr)
+    , relocsFor_(mr)
+    , applied_(mr) {
+  if (!bin.isELF() || bin.isLoaded()) { return; }
+  auto& elf = static_cast<ELF const&>(bin);
+  if (!elf.isRelocatable()) { return; }
+  machine_ = elf.machine();
+
+  // Section headers: name, type, flags, addr, offset, size, link, info, align,
+  // entsize; the 64-bit ones with 64-bit flags, addresses and sizes
+  auto is64 = bin.is64();
+  auto fileSize = bin.baseAddr().size_;
+  auto shOff = elf.secHeaderOffset();
+  auto shSize = elf.secHeaderSize();
+  auto shCount = bin.secHeaderCount();
+  if (shOff > fileSize || shSize < (is64 ? 64u : 40u) ||
+      shCount > (fileSize - shOff) / shSize) {
+    return;
+  }
+  headers_.resize(shCount);
+  addrs_.assign(shCount, 0);
+  relocsFor_.assign(shCount, 0);
+  for (size_t i = 0; i < shCount; i++) {
+    auto sh = shOff + i * shSize;
+    auto& h = headers_[i];
+    h.type = elf.u32(sh + 4);
+    h.flags = word(sh + 8);
+    h.offset = word(sh + (is64 ? 0x18 : 0x10));
+    h.size = word(sh + (is64 ? 0x20 : 0x14));
+    h.link = elf.u32(sh + (is64 ? 0x28 : 0x18));
+    h.info = elf.u32(sh + (is64 ? 0x2c : 0x1c));
+    h.align = word(sh + (is64 ? 0x30 : 0x20));
+    h.entSize = word(sh + (is64 ? 0x38 : 0x24));
+  }
+  // `SHF_ALLOC` sections; those also `SHF_TLS` after the rest, together
+  auto next = kBaseAddr;
+  for (bool tls : {false, true}) {
+    for (size_t i = 1; i < shCount; i++) {
+      auto& h = headers_[i];
+      if (!(h.flags & 0x2) || bool(h.flags & 0x400) != tls) { continue; }
+      auto align = uintptr_t(h.align > 1 ? h.align : 1);
+      if (align & (align - 1)) { align = 1; }
+      next = (next + align - 1) & ~(align - 1);
+      if (tls && !tlsAddr_) { tlsAddr_ = next; }
+      addrs_[i] = next;
+      next += uintptr_t(h.size ? h.size : 1);  // Keep each distinct
+    }
+  }
+  for (size_t i = 0; i < shCount; i++) {
+    auto& h = headers_[i];
+    if ((h.type == 4 || h.type == 9) && h.info && h.info < shCount &&
+        h.link < shCount) {  // SHT_RELA, SHT_REL
+      relocsFor_[h.info] = unsigned(i);
+    }
+  }
+  ok_ = true;
+}
+
+inline std::string_view Relocatable::contents(size_t index) const {
+  if (index >= headers_.size()) { return {}; }
+  auto& h = headers_[index];
+  auto fileSize = bin_.baseAddr().size_;
+  if (h.type == 8 || h.offset > fileSize || h.size > fileSize - h.offset ||
+      (h.flags & 0x800)) {  // SHT_NOBITS, SHF_COMPRESSED
+    return {};
+  }
+  std::string_view raw {(char const*) bin_.baseAddr().ptr_ + h.offset,
+                        size_t(h.size)};
+  if (!relocsFor_[index]) { return raw; }
+  for (auto& a : applied_) {
+    if (a.index == index) { return {a.data.data(), a.data.size()}; }
+  }
+  // The buffer moves with its vector, so views of it stay valid
+  std::pmr::vector<char> data(raw.begin(), raw.end(), applied_.get_allocator());
+  apply(headers_[relocsFor_[index]], data);
+  applied_.push_back({unsigned(index), std::move(data)});
+  auto& added = applied_.back();
+  return {added.data.data(), added.data.size()};
+}
+
+inline Relocatable::How Relocatable::how(uint32_t type) const {
+  switch (machine_) {
+  case 62:  // EM_X86_64
+    switch (type) {
+    case 1: return {Kind::kAbs, 8};     // R_X86_64_64
+    case 2: return {Kind::kPCRel, 4};   // R_X86_64_PC32
+    case 10: return {Kind::kAbs, 4};    // R_X86_64_32
+    case 11: return {Kind::kAbs, 4};    // R_X86_64_32S
+    case 17: return {Kind::kTLS, 8};    // R_X86_64_DTPOFF64
+    case 21: return {Kind::kTLS, 4};    // R_X86_64_DTPOFF32
+    case 24: return {Kind::kPCRel, 8};  // R_X86_64_PC64
+    }
+    break;
+  case 3:  // EM_386
+    switch (type) {
+    case 1: return {Kind::kAbs, 4};    // R_386_32
+    case 2: return {Kind::kPCRel, 4};  // R_386_PC32
+    case 32: return {Kind::kTLS, 4};   // R_386_TLS_LDO_32
+    }
+    break;
+  case 40:  // EM_ARM
+    switch (type) {
+    case 2: return {Kind::kAbs, 4};    // R_ARM_ABS32
+    case 3: return {Kind::kPCRel, 4};  // R_ARM_REL32
+    case 38: return {Kind::kAbs, 4};   // R_ARM_TARGET1
+    }
+    break;
+  case 183:  // EM_AARCH64
+    switch (type) {
+    case 257: return {Kind::kAbs, 8};    // R_AARCH64_ABS64
+    case 258: return {Kind::kAbs, 4};    // R_AARCH64_ABS32
+    case 259: return {Kind::kAbs, 2};    // R_AARCH64_ABS16
+    case 260: return {Kind::kPCRel, 8};  // R_AARCH64_PREL64
+    case 261: return {Kind::kPCRel, 4};  // R_AARCH64_PREL32
+    case 262: return {Kind::kPCRel, 2};  // R_AARCH64_PREL16
+    }
+    break;
+  case 20:  // EM_PPC
+  case 21:  // EM_PPC64
+    switch (type) {
+    case 1: return {Kind::kAbs, 4};     // R_PPC_ADDR32
+    case 26: return {Kind::kPCRel, 4};  // R_PPC_REL32
+    case 38: return {Kind::kAbs, 8};    // R_PPC64_ADDR64
+    case 44: return {Kind::kPCRel, 8};  // R_PPC64_REL64
+    }
+    break;
+  case 22:  // EM_S390
+    switch (type) {
+    case 4: return {Kind::kAbs, 4};     // R_390_32
+    case 5: return {Kind::kPCRel, 4};   // R_390_PC32
+    case 22: return {Kind::kAbs, 8};    // R_390_64
+    case 23: return {Kind::kPCRel, 8};  // R_390_PC64
+    }
+    break;
+  case 243:  // EM_RISCV
+    switch (type) {
+    case 1: return {Kind::kAbs, 4};     // R_RISCV_32
+    case 2: return {Kind::kAbs, 8};     // R_RISCV_64
+    case 33: return {Kind::kAdd, 1};    // R_RISCV_ADD8
+    case 34: return {Kind::kAdd, 2};    // R_RISCV_ADD16
+    case 35: return {Kind::kAdd, 4};    // R_RISCV_ADD32
+    case 36: return {Kind::kAdd, 8};    // R_RISCV_ADD64
+    case 37: return {Kind::kSub, 1};    // R_RISCV_SUB8
+    case 38: return {Kind::kSub, 2};    // R_RISCV_SUB16
+    case 39: return {Kind::kSub, 4};    // R_RISCV_SUB32
+    case 40: return {Kind::kSub, 8};    // R_RISCV_SUB64
+    case 54: return {Kind::kAbs, 1};    // R_RISCV_SET8
+    case 55: return {Kind::kAbs, 2};    // R_RISCV_SET16
+    case 56: return {Kind::kAbs, 4};    // R_RISCV_SET32
+    case 57: return {Kind::kPCRel, 4};  // R_RISCV_32_PCREL
+    }
+    break;
+  }
+  return {};
+}
+
+/**
+Symbol number `sym`'s address in `symtab`.  Entries are (32-bit) name, value,
+size, info, other, section index; or (64-bit) name, info, other, section index,
+value, size.
+*/
+inline uint64_t Relocatable::symbolValue(Header const& symtab,
+                                         uint64_t sym) const {
+  auto& elf = static_cast<ELF const&>(bin_);
+  auto is64 = bin_.is64();
+  auto entSize = symtab.entSize ? symtab.entSize : (is64 ? 24u : 16u);
+  if (sym >= symtab.size / entSize) { return 0; }
+  auto at = size_t(symtab.offset + sym * entSize);
+  auto secIndex = elf.u16(at + (is64 ? 6 : 14));
+  auto value = word(at + (is64 ? 8 : 4));
+  if (secIndex == Symbol::kAbsolute) { return value; }
+  if (!secIndex || secIndex >= addrs_.size()) { return 0; }  // Undefined etc.
+  return addrs_[secIndex] + value;
+}
+
+/**
+Apply the relocations in `relocs` (`SHT_REL` or `SHT_RELA`) to `data`: the
+contents of the section they're for.  Entries are offset, info (symbol and
+type: for 32-bit, 24 and 8 bits; for 64-bit, 32 and 32), then for `RELA`, an
+explicit addend; for `REL` the addend is what's in place.
+*/
+inline void Relocatable::apply(Header const& relocs,
+                               std::pmr::vector<char>& data) const {
+  auto is64 = bin_.is64();
+  auto isLE = bin_.isLE();
+  auto isRela = relocs.type == 4;
+  auto w = is64 ? 8u : 4u;
+  auto entSize = relocs.entSize ? relocs.entSize : (isRela ? 3 * w : 2 * w);
+  auto fileSize = bin_.baseAddr().size_;
+  auto& symtab = headers_[relocs.link];
+  if (relocs.offset > fileSize || relocs.size > fileSize - relocs.offset ||
+      entSize < (isRela ? 3 * w : 2 * w) || symtab.offset > fileSize ||
+      symtab.size > fileSize - symtab.offset) {
+    return;
+  }
+  auto secAddr = addrs_[relocs.info];  // Of the section being relocated
+
+  auto get = [&](size_t at, unsigned bytes) {
+    uint64_t ret = 0;
+    for (unsigned i = 0; i < bytes; i++) {
+      auto shift = 8 * (isLE ? i : bytes - 1 - i);
+      ret |= uint64_t(uint8_t(data[at + i])) << shift;
+    }
+    return ret;
+  };
+  auto put = [&](size_t at, unsigned bytes, uint64_t val) {
+    for (unsigned i = 0; i < bytes; i++) {
+      auto shift = 8 * (isLE ? i : bytes - 1 - i);
+      data[at + i] = char(uint8_t(val >> shift));
+    }
+  };
+
+  for (uint64_t off = 0; off + entSize <= relocs.size; off += entSize) {
+    auto at = size_t(relocs.offset + off);
+    auto where = word(at);
+    auto info = word(at + w);
+    auto sym = is64 ? info >> 32 : info >> 8;
+    auto type = uint32_t(is64 ? info & 0xffffffff : info & 0xff);
+    auto rel = how(type);
+    if (rel.kind == Kind::kNone) {
+      if (type) { ++skipped_; }  // `R_*_NONE` is 0 on all of these
+      continue;
+    }
+    if (where > data.size() || rel.bytes > data.size() - where) { continue; }
+    // Values wrap, and are truncated to `rel.bytes`, so signs don't matter
+    auto inPlace = get(size_t(where), rel.bytes);
+    auto addend = isRela ? word(at + 2 * w) : inPlace;
+    auto value = symbolValue(symtab, sym) + addend;
+    switch (rel.kind) {
+    case Kind::kAbs: break;
+    case Kind::kPCRel: value -= secAddr + where; break;
+    case Kind::kAdd: value = inPlace + value; break;
+    case Kind::kSub: value = inPlace - value; break;
+    case Kind::kTLS: value -= tlsAddr_; break;
+    case Kind::kNone: break;
+    }
+    put(size_t(where), rel.bytes, value);
+  }
+}
+
+}  // namespace proginfo::binary
@@ -20,6 +20,8 @@ struct Section32 final : Section {
   uint32_t nameIndex() const { return u32(0); }
   uint32_t type() const { return u32(4); }
   uint32_t flags() const { return u32(8); }
+  uint32_t link() const { return u32(0x18); }
+  size_t entSize() const { return size_t(u32(0x24)); }
 
   size_t size() const override { return u32(0x14); }
   uintptr_t virtAddr() const override { return u32(0x0c); }
@@ -20,6 +20,8 @@ struct Section64 final : Section {
   uint32_t nameIndex() const { return u32(0); }
   uint32_t type() const { return u32(4); }
   uint64_t flags() const { return u64(8); }
+  uint32_t link() const { return u32(0x28); }
+  size_t entSize() const { return size_t(u64(0x38)); }
 
   size_t size() const override { return u64(0x20); }
   uintptr_t virtAddr() const override { return u64(0x10); }
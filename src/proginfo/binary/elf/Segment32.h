@@ -21,7 +21,7 @@ struct Segment32 : Segment {
 
   bool canWrite() const override { return flags() & 0x00000002; }
   bool canExecute() const override { return flags() & 0x00000001; }
-  bool loadable() const override { return type() & 0x00000001; }
+  bool loadable() const override { return type() == 0x00000001; }  // PT_LOAD
 
   uintptr_t virtAddr() const override { return u32(0x08); }
   uintptr_t virtSize() const override { return u32(0x14); }
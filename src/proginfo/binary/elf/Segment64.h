@@ -21,7 +21,7 @@ struct Segment64 final : Segment {
 
   bool canWrite() const override { return flags() & 0x00000002; }
   bool canExecute() const override { return flags() & 0x00000001; }
-  bool loadable() const override { return type() & 0x00000001; }
+  bool loadable() const override { return type() == 0x00000001; }  // PT_LOAD
 
   uintptr_t virtAddr() const override { return u64(0x10); }
   uintptr_t virtSize() const override { return u64(0x28); }
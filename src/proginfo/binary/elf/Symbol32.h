@@ -31,8 +31,15 @@ struct Symbol32 final : Symbol {
   uint32_t nameIndex() const { return u32(0); }
   uint8_t info() const { return u8(12); }
   uint8_t other() const { return u8(13); }
-  uint16_t secIndex() const { return u16(14); }
+  uint16_t secIndex() const override { return u16(14); }
   uintptr_t value() const override { return u32(4); }
+  uintptr_t size() const override { return u32(8); }
+
+  SymbolType type() const override { return typeOf(info()); }
+  SymbolBinding binding() const override { return bindingOf(info()); }
+  SymbolVisibility visibility() const override {
+    return SymbolVisibility(other() & 3);
+  }
 };
 
 }  // namespace proginfo::binary
@@ -31,8 +31,15 @@ struct Symbol64 final : Symbol {
   uint32_t nameIndex() const { return u32(0); }
   uint8_t info() const { return u8(4); }
   uint8_t other() const { return u8(5); }
-  uint16_t secIndex() const { return u16(6); }
+  uint16_t secIndex() const override { return u16(6); }
   uintptr_t value() const override { return u64(8); }
+  uintptr_t size() const override { return u64(16); }
+
+  SymbolType type() const override { return typeOf(info()); }
+  SymbolBinding binding() const override { return bindingOf(info()); }
+  SymbolVisibility visibility() const override {
+    return SymbolVisibility(other() & 3);
+  }
 };
 
 }  // namespace proginfo::binary
@@ -12,7 +12,7 @@ namespace proginfo::binary {
 
 struct SymbolTable32 : SymbolTable {
   util::Addr base_;
-  uint16_t count_;
+  uint32_t count_;
   uint16_t symSize_;
   bool isLE_;
   std::string_view strings_;
@@ -21,12 +21,14 @@ struct SymbolTable32 : SymbolTable {
 
   SymbolTable32(
       util::Addr base,
-      uint16_t count,
+      uint32_t count,
       uint16_t symSize,
       bool isLE,
       std::string_view strings);
 
-  void each(std::function<bool(Symbol const&)> cb) const override;
+  using SymbolTable::each;
+  void each(SymbolFilter const& filter,
+            std::function<bool(Symbol const&)> cb) const override;
 };
 
 }  // namespace proginfo::binary
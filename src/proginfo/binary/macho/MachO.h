@@ -119,6 +119,8 @@ public:
     }
   }
 
+  bool isCore() const override final { return type() == Type::_MH_CORE; }
+
   virtual uintptr_t segHeaderOffset() const = 0;
   virtual uintptr_t segHeaderSize() const = 0;
   virtual uint16_t sectionNameIndex() const = 0;
@@ -1 +1,331 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
 
+#include "../binary/Binary.h"
+#include "../binary/elf/Relocatable.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace proginfo::debug {
+
+/*
+Basics for reading DWARF (version 5, and the parts of 4 still commonly found):
+a binary's `.debug_*` sections, a bounds-checked reader for them, and the
+attribute forms.  Everything reads the sections in place; nothing is copied
+(except from object files, which are relocated: see `binary::Relocatable`).
+*/
+
+/** `DW_FORM_*` attribute encodings. */
+enum class Form : uint16_t {
+  kAddr = 0x01,
+  kBlock2 = 0x03,
+  kBlock4 = 0x04,
+  kData2 = 0x05,
+  kData4 = 0x06,
+  kData8 = 0x07,
+  kString = 0x08,
+  kBlock = 0x09,
+  kBlock1 = 0x0a,
+  kData1 = 0x0b,
+  kFlag = 0x0c,
+  kSdata = 0x0d,
+  kStrp = 0x0e,
+  kUdata = 0x0f,
+  kRefAddr = 0x10,
+  kRef1 = 0x11,
+  kRef2 = 0x12,
+  kRef4 = 0x13,
+  kRef8 = 0x14,
+  kRefUdata = 0x15,
+  kIndirect = 0x16,
+  kSecOffset = 0x17,
+  kExprloc = 0x18,
+  kFlagPresent = 0x19,
+  kStrx = 0x1a,
+  kAddrx = 0x1b,
+  kRefSup4 = 0x1c,
+  kStrpSup = 0x1d,
+  kData16 = 0x1e,
+  kLineStrp = 0x1f,
+  kRefSig8 = 0x20,
+  kImplicitConst = 0x21,
+  kLoclistx = 0x22,
+  kRnglistx = 0x23,
+  kRefSup8 = 0x24,
+  kStrx1 = 0x25,
+  kStrx2 = 0x26,
+  kStrx3 = 0x27,
+  kStrx4 = 0x28,
+  kAddrx1 = 0x29,
+  kAddrx2 = 0x2a,
+  kAddrx3 = 0x2b,
+  kAddrx4 = 0x2c,
+  kGnuAddrIndex = 0x1f01,  // Pre-standard split DWARF
+  kGnuStrIndex = 0x1f02,
+  kGnuRefAlt = 0x1f20,  // In a `.gnu_debugaltlink` file
+  kGnuStrpAlt = 0x1f21,
+};
+
+/**
+The `.debug_*` sections of a binary (those present; the rest are empty).  In a
+split DWARF object (`.dwo`) these are the `.debug_*.dwo` sections.
+*/
+struct Sections {
+  std::string_view info;
+  std::string_view abbrev;
+  std::string_view str;
+  std::string_view line;        // `.debug_line`
+  std::string_view lineStr;     // `.debug_line_str`
+  std::string_view strOffsets;  // `.debug_str_offsets`
+  std::string_view addr;        // `.debug_addr`
+  std::string_view rnglists;    // `.debug_rnglists`
+  std::string_view loclists;    // `.debug_loclists`
+  std::string_view names;       // `.debug_names`
+  std::string_view gdbIndex;    // `.gdb_index`
+  bool isLE {true};
+
+  /**
+  Find `bin`'s sections.  Compressed ones (`SHF_COMPRESSED`) aren't supported,
+  and are left empty.  Needs a `util::Alloc` on this thread.
+
+  For a relocatable object (`.o`), pass `relocs`, made from `bin`: sections are
+  then read from it, with their relocations applied (so `relocs` must outlive
+  these), and addresses are its synthetic ones.
+  */
+  static Sections of(binary::Binary const& bin,
+                     binary::Relocatable const* relocs = nullptr) {
+    Sections ret;
+    ret.isLE = bin.isLE();
+    auto fileSize = bin.baseAddr().size_;
+    size_t index = 0;
+    bin.eachSection([&](auto& sec) {
+      auto secIndex = index++;
+      auto name = sec.name();
+      if (name.size() > 4 && name.substr(name.size() - 4) == ".dwo") {
+        name.remove_suffix(4);
+      }
+      std::string_view* out = nullptr;
+      if (name == ".debug_info") {
+        out = &ret.info;
+      } else if (name == ".debug_abbrev") {
+        out = &ret.abbrev;
+      } else if (name == ".debug_str") {
+        out = &ret.str;
+      } else if (name == ".debug_line") {
+        out = &ret.line;
+      } else if (name == ".debug_line_str") {
+        out = &ret.lineStr;
+      } else if (name == ".debug_str_offsets") {
+        out = &ret.strOffsets;
+      } else if (name == ".debug_addr") {
+        out = &ret.addr;
+      } else if (name == ".debug_rnglists") {
+        out = &ret.rnglists;
+      } else if (name == ".debug_loclists") {
+        out = &ret.loclists;
+      } else if (name == ".debug_names") {
+        out = &ret.names;
+      } else if (name == ".gdb_index") {
+        out = &ret.gdbIndex;
+      }
+      if (out && relocs && *relocs) {
+        *out = relocs->contents(secIndex);
+      } else if (out && !isCompressed(sec) && sec.fileOffset() <= fileSize &&
+                 sec.size() <= fileSize - sec.fileOffset()) {
+        auto* data = (char const*) bin.baseAddr().ptr_ + sec.fileOffset();
+        *out = {data, sec.size()};
+      }
+      return true;
+    });
+    return ret;
+  }
+
+  static bool isCompressed(binary::Section const& sec) {
+    if (auto* sec64 = dynamic_cast<binary::Section64 const*>(&sec)) {
+      return sec64->flags() & 0x800;  // SHF_COMPRESSED
+    }
+    if (auto* sec32 = dynamic_cast<binary::Section32 const*>(&sec)) {
+      return sec32->flags() & 0x800;
+    }
+    return false;
+  }
+};
+
+/**
+Bounds-checked reads from a section.  Reading past the end clears `ok` (for
+good) and returns zeroes, so a run of reads can be checked once at the end.
+*/
+class Reader {
+  std::string_view data_;
+  size_t pos_;
+  bool isLE_;
+  bool ok_ {true};
+
+public:
+  explicit Reader(std::string_view data, bool isLE = true, size_t pos = 0)
+      : data_(data)
+      , pos_(pos)
+      , isLE_(isLE)
+      , ok_(pos <= data.size()) {}
+
+  bool ok() const { return ok_; }
+  bool isLE() const { return isLE_; }
+  size_t pos() const { return pos_; }
+  size_t size() const { return data_.size(); }
+  std::string_view data() const { return data_; }
+  bool atEnd() const { return !ok_ || pos_ >= data_.size(); }
+
+  /** Move to `pos`; not ok if it's past the end. */
+  void seek(size_t pos) {
+    ok_ = ok_ && pos <= data_.size();
+    pos_ = ok_ ? pos : data_.size();
+  }
+
+  bool has(size_t n) {
+    ok_ = ok_ && n <= data_.size() - pos_;
+    if (!ok_) { pos_ = data_.size(); }
+    return ok_;
+  }
+
+  void skip(size_t n) {
+    if (has(n)) { pos_ += n; }
+  }
+
+  /** An `n`-byte unsigned integer (`n` up to 8). */
+  uint64_t read(unsigned n) {
+    if (!has(n)) { return 0; }
+    uint64_t ret = 0;
+    for (unsigned i = 0; i < n; i++) {
+      auto byte = uint64_t(uint8_t(data_[pos_ + i]));
+      ret |= byte << (8 * (isLE_ ? i : n - 1 - i));
+    }
+    pos_ += n;
+    return ret;
+  }
+
+  uint8_t u8() { return uint8_t(read(1)); }
+  uint16_t u16() { return uint16_t(read(2)); }
+  uint32_t u32() { return uint32_t(read(4)); }
+  uint64_t u64() { return read(8); }
+
+  uint64_t uleb() {
+    uint64_t ret = 0;
+    for (unsigned shift = 0; has(1); shift += 7) {
+      auto byte = uint8_t(data_[pos_++]);
+      if (shift < 64) { ret |= uint64_t(byte & 0x7f) << shift; }
+      if (!(byte & 0x80)) { break; }
+    }
+    return ret;
+  }
+
+  int64_t sleb() {
+    uint64_t ret = 0;
+    unsigned shift = 0;
+    uint8_t byte = 0;
+    while (has(1)) {
+      byte = uint8_t(data_[pos_++]);
+      if (shift < 64) { ret |= uint64_t(byte & 0x7f) << shift; }
+      shift += 7;
+      if (!(byte & 0x80)) { break; }
+    }
+    if (shift < 64 && (byte & 0x40)) { ret |= ~uint64_t(0) << shift; }
+    return int64_t(ret);
+  }
+
+  /** A section offset: 8 bytes in 64-bit DWARF, else 4. */
+  uint64_t offset(bool is64) { return read(is64 ? 8 : 4); }
+
+  /**
+  A unit's initial length field: returns the length of the rest of the unit,
+  and sets `is64` if it's in the 64-bit DWARF format.
+  */
+  uint64_t initialLength(bool& is64) {
+    uint64_t ret = u32();
+    is64 = ret == 0xffffffff;
+    if (is64) { ret = u64(); }
+    if (ret >= 0xfffffff0 && !is64) { ok_ = false; }  // Reserved values
+    return ret;
+  }
+
+  std::string_view bytes(size_t n) {
+    if (!has(n)) { return {}; }
+    auto ret = data_.substr(pos_, n);
+    pos_ += n;
+    return ret;
+  }
+
+  /** A null-terminated string (without its terminator). */
+  std::string_view cstr() {
+    auto end = data_.find('\0', pos_);
+    if (end == data_.npos) {
+      ok_ = false;
+      pos_ = data_.size();
+      return {};
+    }
+    auto ret = data_.substr(pos_, end - pos_);
+    pos_ = end + 1;
+    return ret;
+  }
+
+  /**
+  Skip an attribute's value, in form `form`, in a unit with the given offset
+  and address sizes.  False (and not ok) for forms this doesn't know.
+  */
+  bool skipForm(Form form, bool is64, unsigned addrSize) {
+    switch (form) {
+    case Form::kFlagPresent:
+    case Form::kImplicitConst: return ok_;
+    case Form::kData1:
+    case Form::kRef1:
+    case Form::kFlag:
+    case Form::kStrx1:
+    case Form::kAddrx1: skip(1); break;
+    case Form::kData2:
+    case Form::kRef2:
+    case Form::kStrx2:
+    case Form::kAddrx2: skip(2); break;
+    case Form::kStrx3:
+    case Form::kAddrx3: skip(3); break;
+    case Form::kData4:
+    case Form::kRef4:
+    case Form::kRefSup4:
+    case Form::kStrx4:
+    case Form::kAddrx4: skip(4); break;
+    case Form::kData8:
+    case Form::kRef8:
+    case Form::kRefSig8:
+    case Form::kRefSup8: skip(8); break;
+    case Form::kData16: skip(16); break;
+    case Form::kAddr: skip(addrSize); break;
+    case Form::kStrp:
+    case Form::kLineStrp:
+    case Form::kRefAddr:
+    case Form::kSecOffset:
+    case Form::kStrpSup:
+    case Form::kGnuRefAlt:
+    case Form::kGnuStrpAlt: skip(is64 ? 8 : 4); break;
+    case Form::kSdata: sleb(); break;
+    case Form::kUdata:
+    case Form::kRefUdata:
+    case Form::kStrx:
+    case Form::kAddrx:
+    case Form::kLoclistx:
+    case Form::kRnglistx:
+    case Form::kGnuAddrIndex:
+    case Form::kGnuStrIndex: uleb(); break;
+    case Form::kString: cstr(); break;
+    case Form::kBlock1: skip(u8()); break;
+    case Form::kBlock2: skip(u16()); break;
+    case Form::kBlock4: skip(u32()); break;
+    case Form::kBlock:
+    case Form::kExprloc: skip(size_t(uleb())); break;
+    case Form::kIndirect: return skipForm(Form(uleb()), is64, addrSize);
+    default: ok_ = false; break;
+    }
+    return ok_;
+  }
+};
+
+}  // namespace proginfo::debug
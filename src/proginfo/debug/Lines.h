@@ -0,0 +1,490 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "../util/Stats.h"
+#include "DWARF.h"
+#include "Units.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+namespace proginfo::debug {
+
+/** A source file named in a line table. */
+struct LineFile {
+  std::string_view dir;  // Empty if relative to the compilation directory
+  std::string_view name;
+};
+
+/**
+A row of a line table: where the code from `addr` (up to the next row's) came
+from.
+*/
+struct LineRow {
+  uint64_t addr;
+  uint32_t file;  // Index in its table's files
+  uint32_t line;  // From 1; 0 if not attributable to a line
+  uint32_t column;
+  bool endSequence;  // Just past a sequence's code, rather than in it
+};
+
+/*
+A unit's line number program, in `.debug_line` (versions 2 to 5): its header,
+with the file table, and running the program to produce its rows.  Strings
+are views into the sections; nothing else is kept.
+*/
+class LineProgram {
+  std::string_view data_;
+  bool isLE_ {true};
+  size_t program_ {};  // Start of the opcodes
+  size_t end_ {};
+  uint16_t version_ {};
+  uint8_t minInstLength_ {};
+  int8_t lineBase_ {};
+  uint8_t lineRange_ {};
+  uint8_t opcodeBase_ {};
+  size_t opcodeLengths_ {};  // Of the standard opcodes' operand counts
+  std::pmr::vector<std::string_view> dirs_;
+  std::pmr::vector<LineFile> files_;
+
+  // DW_LNCT_*
+  constexpr static uint64_t kPath = 1;
+  constexpr static uint64_t kDirectoryIndex = 2;
+
+  /** A version 5 directory or file entry, in the given formats. */
+  bool entry(Units const& units,
+             Unit const& unit,
+             Reader& r,
+             std::string_view formats,
+             LineFile& out) {
+    Reader f(formats, isLE_);
+    while (!f.atEnd()) {
+      auto type = f.uleb();
+      auto form = Form(f.uleb());
+      if (type == kPath) {
+        out.name = units.string(unit, form, r);
+      } else if (type == kDirectoryIndex && form == Form::kUdata) {
+        out.dir = dir(r.uleb());
+      } else if (type == kDirectoryIndex && form == Form::kData1) {
+        out.dir = dir(r.u8());
+      } else if (type == kDirectoryIndex && form == Form::kData2) {
+        out.dir = dir(r.u16());
+      } else {
+        r.skipForm(form, unit.is64, unit.addrSize);
+      }
+    }
+    return r.ok() && f.ok();
+  }
+
+  std::string_view dir(uint64_t i) const {
+    return i < dirs_.size() ? dirs_[size_t(i)] : std::string_view();
+  }
+
+  /** The v5 entry formats: a count, then pairs of content type and form. */
+  static std::string_view formats(Reader& r) {
+    auto start = r.pos();
+    for (auto n = r.u8(); n && r.ok(); n--) {
+      r.uleb();
+      r.uleb();
+    }
+    return r.data().substr(start + 1, r.pos() - start - 1);
+  }
+
+public:
+  explicit LineProgram(
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : dirs_(mr)
+      , files_(mr) {}
+
+  /**
+  Read the header of `unit`'s line program (from its `DW_AT_stmt_list`).
+  False if it has none, or it's malformed.
+  */
+  bool open(Units const& units, Unit const& unit) {
+    auto& sections = units.sections();
+    data_ = sections.line;
+    isLE_ = sections.isLE;
+    dirs_.clear();
+    files_.clear();
+    if (unit.lineOffset >= data_.size()) { return false; }
+    Reader r(data_, isLE_, size_t(unit.lineOffset));
+    auto u = unit;  // Its strings are read as if from the unit's DIEs
+    auto length = r.initialLength(u.is64);
+    if (!r.has(length)) { return false; }
+    end_ = r.pos() + size_t(length);
+    version_ = r.u16();
+    if (version_ < 2 || version_ > 5) { return false; }
+    if (version_ >= 5) {
+      u.addrSize = r.u8();
+      r.u8();  // Segment selector size
+    }
+    auto headerLength = r.offset(u.is64);
+    program_ = r.pos() + size_t(headerLength);
+    minInstLength_ = r.u8();
+    if (version_ >= 4) { r.u8(); }  // Maximum ops per instruction (for VLIW)
+    r.u8();                         // Default `is_stmt`
+    lineBase_ = int8_t(r.u8());
+    lineRange_ = r.u8();
+    opcodeBase_ = r.u8();
+    opcodeLengths_ = r.pos();
+    if (opcodeBase_) { r.skip(opcodeBase_ - 1u); }
+    if (!r.ok() || !lineRange_ || program_ > end_) { return false; }
+
+    if (version_ >= 5) {
+      auto dirFormats = formats(r);
+      for (auto n = r.uleb(); n && r.ok(); n--) {
+        LineFile d {};
+        if (!entry(units, u, r, dirFormats, d)) { return false; }
+        dirs_.push_back(d.name);
+      }
+      auto fileFormats = formats(r);
+      for (auto n = r.uleb(); n && r.ok(); n--) {
+        LineFile f {};
+        if (!entry(units, u, r, fileFormats, f)) { return false; }
+        files_.push_back(f);
+      }
+    } else {
+      // Directories and files are numbered from 1; 0 means the unit's own
+      dirs_.push_back({});
+      for (auto d = r.cstr(); !d.empty(); d = r.cstr()) { dirs_.push_back(d); }
+      files_.push_back({});
+      for (auto name = r.cstr(); !name.empty(); name = r.cstr()) {
+        auto d = dir(r.uleb());
+        r.uleb();  // Modification time
+        r.uleb();  // Size
+        files_.push_back({d, name});
+      }
+    }
+    return r.ok() && r.pos() <= program_;
+  }
+
+  size_t fileCount() const { return files_.size(); }
+  LineFile const& file(size_t i) const { return files_[i]; }
+
+  /**
+  Run the program, calling `fn(LineRow const&)` for each row it emits, until
+  it returns false.  Returns false if the program is malformed.  Doesn't
+  allocate.
+  */
+  template <class Fn>
+  bool run(Fn&& fn) const {
+    util::Stats::add(util::Counter::kBytesDecoded, end_ - program_);
+    Reader r(data_.substr(0, end_), isLE_, program_);
+    Reader lengths(data_, isLE_, opcodeLengths_);
+    auto reset = [](LineRow& row) { row = {0, 1, 1, 0, false}; };
+    LineRow row;
+    reset(row);
+    auto advance = [&](uint64_t opAdvance) {
+      row.addr += opAdvance * minInstLength_;
+    };
+    while (!r.atEnd()) {
+      auto op = r.u8();
+      if (op >= opcodeBase_) {  // Special opcodes: advance, then a row
+        auto adjusted = uint8_t(op - opcodeBase_);
+        advance(adjusted / lineRange_);
+        row.line =
+            uint32_t(int64_t(row.line) + lineBase_ + adjusted % lineRange_);
+        if (!fn(static_cast<LineRow const&>(row))) { return true; }
+        continue;
+      }
+      switch (op) {
+      case 0: {  // Extended
+        auto length = r.uleb();
+        auto next = r.pos() + size_t(length);
+        if (!length || !r.has(size_t(length))) { return false; }
+        switch (r.u8()) {
+        case 1:  // End sequence
+          row.endSequence = true;
+          if (!fn(static_cast<LineRow const&>(row))) { return true; }
+          reset(row);
+          break;
+        case 2:  // Set address
+          row.addr = r.read(unsigned(std::min<uint64_t>(length - 1, 8)));
+          break;
+        }
+        r.seek(next);
+        break;
+      }
+      case 1:  // Copy
+        if (!fn(static_cast<LineRow const&>(row))) { return true; }
+        break;
+      case 2: advance(r.uleb()); break;  // Advance PC
+      case 3: row.line = uint32_t(int64_t(row.line) + r.sleb()); break;
+      case 4: row.file = uint32_t(r.uleb()); break;
+      case 5: row.column = uint32_t(r.uleb()); break;
+      case 8: advance((255u - opcodeBase_) / lineRange_); break;
+      case 9: row.addr += r.u16(); break;  // Fixed advance PC
+      default:
+        // Flags (6, 7, 10, 11), the ISA (12), or unknown: skip the operands
+        lengths.seek(opcodeLengths_ + op - 1u);
+        for (auto n = lengths.u8(); n; n--) { r.uleb(); }
+        break;
+      }
+    }
+    return r.ok();
+  }
+};
+
+/*
+The line tables of a whole binary, compacted for keeping in memory: finding
+the file and line of an address without keeping (or re-decoding) the tables.
+
+Rows are sorted by address and delta-encoded in blocks of `kBlockRows`, each
+row taking a few bytes (typically 2 to 4): varints of the address advance,
+and of the line advance (zigzagged) with flags for whether the file or column
+changed, then those if they did.  A sparse index of each block's first
+address and offset finds the block for an address by binary search; a lookup
+then decodes at most one block.
+
+Sequences (each a function, or a unit's contiguous code) which overlap one
+already added (such as those of discarded functions, left at address 0) are
+dropped.  The file table's strings are views into the sections.
+*/
+class LineTable {
+public:
+  constexpr static size_t kBlockRows = 32;
+
+private:
+  struct Block {
+    uint64_t addr;    // Of its first row
+    uint64_t offset;  // In `bytes_`
+  };
+
+  struct Sequence {
+    size_t begin;  // In `pending_`
+    size_t end;
+  };
+
+  std::pmr::vector<LineFile> files_;
+  std::pmr::vector<Block> blocks_;
+  std::pmr::vector<char> bytes_;
+  size_t rows_ {};
+
+  // Rows added since the last `finish`
+  std::pmr::vector<LineRow> pending_;
+  std::pmr::vector<Sequence> sequences_;
+
+  /** End the last sequence, if it's unfinished. */
+  void endSequence() {
+    if (!pending_.empty() && !pending_.back().endSequence) {
+      auto last = pending_.back();
+      last.endSequence = true;
+      add(last);
+    }
+  }
+
+  void varint(uint64_t val) {
+    for (; val >= 0x80; val >>= 7) { bytes_.push_back(char(val | 0x80)); }
+    bytes_.push_back(char(val));
+  }
+
+  static uint64_t zigzag(int64_t val) {
+    return (uint64_t(val) << 1) ^ uint64_t(val >> 63);
+  }
+
+  static int64_t unzigzag(uint64_t val) {
+    return int64_t(val >> 1) ^ -int64_t(val & 1);
+  }
+
+  static uint64_t varint(char const*& pos, char const* end) {
+    uint64_t ret = 0;
+    for (unsigned shift = 0; pos < end && shift < 64; shift += 7) {
+      auto byte = uint8_t(*pos++);
+      ret |= uint64_t(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) { break; }
+    }
+    return ret;
+  }
+
+  /** Decode a row at `pos`, given the previous one (in the same block). */
+  static void decode(char const*& pos, char const* end, LineRow& row) {
+    row.addr += varint(pos, end);
+    auto bits = varint(pos, end);
+    row.endSequence = bits & 1;
+    row.line = uint32_t(int64_t(row.line) + unzigzag(bits >> 3));
+    if (bits & 2) { row.file = uint32_t(varint(pos, end)); }
+    if (bits & 4) { row.column = uint32_t(varint(pos, end)); }
+  }
+
+  /** Rows at the start of a block are relative to this. */
+  static LineRow blockStart(Block const& block) {
+    return {block.addr, ~0u, 0, 0, false};
+  }
+
+  void encode(LineRow const& row, LineRow const& prev) {
+    bool newFile = row.file != prev.file;
+    bool newColumn = row.column != prev.column;
+    varint(row.addr - prev.addr);
+    varint(zigzag(int64_t(row.line) - int64_t(prev.line)) << 3 |
+           uint64_t(newColumn) << 2 | uint64_t(newFile) << 1 |
+           uint64_t(row.endSequence));
+    if (newFile) { varint(row.file); }
+    if (newColumn) { varint(row.column); }
+  }
+
+public:
+  explicit LineTable(
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : files_(mr)
+      , blocks_(mr)
+      , bytes_(mr)
+      , pending_(mr)
+      , sequences_(mr) {}
+
+  /** Add a file, returning its index for rows' `file`. */
+  uint32_t addFile(LineFile file) {
+    files_.push_back(file);
+    return uint32_t(files_.size() - 1);
+  }
+
+  /**
+  Add a row; sequences end with an `endSequence` row, and their rows are in
+  address order.  Added rows are only found after `finish`.
+  */
+  void add(LineRow const& row) {
+    if (sequences_.empty() || pending_[sequences_.back().end - 1].endSequence) {
+      sequences_.push_back({pending_.size(), pending_.size()});
+    }
+    pending_.push_back(row);
+    sequences_.back().end = pending_.size();
+  }
+
+  /**
+  Add the rows of every unit's line program (once for each distinct one).
+  Returns false if any is malformed; the rows from the others are kept.
+  */
+  bool add(Units const& units) {
+    std::pmr::vector<Unit const*> todo(files_.get_allocator());
+    for (auto& unit : units) {
+      if (unit.lineOffset != ~uint64_t(0)) { todo.push_back(&unit); }
+    }
+    std::stable_sort(todo.begin(), todo.end(), [](auto* x, auto* y) {
+      return x->lineOffset < y->lineOffset;
+    });
+    LineProgram program(files_.get_allocator().resource());
+    bool ret = true;
+    for (size_t u = 0; u < todo.size(); u++) {
+      if (u && todo[u]->lineOffset == todo[u - 1]->lineOffset) { continue; }
+      if (!program.open(units, *todo[u])) {
+        ret = false;
+        continue;
+      }
+      auto base = uint32_t(files_.size());
+      for (size_t i = 0; i < program.fileCount(); i++) {
+        addFile(program.file(i));
+      }
+      endSequence();
+      auto before = pending_.size();
+      bool ok = program.run([&](LineRow const& row) {
+        auto r = row;
+        r.file = row.file < program.fileCount() ? base + row.file : ~0u;
+        add(r);
+        return true;
+      });
+      if (!ok) {  // Drop the partial program's rows
+        pending_.resize(before);
+        while (!sequences_.empty() && sequences_.back().begin >= before) {
+          sequences_.pop_back();
+        }
+        ret = false;
+      }
+      endSequence();
+    }
+    return ret;
+  }
+
+  /**
+  Sort and encode the rows added so far, with those already encoded.  (The
+  encoded rows are decoded again to merge them.)
+  */
+  void finish() {
+    if (pending_.empty()) { return; }
+    endSequence();
+    // Decode the rows encoded by an earlier `finish`, to merge them in
+    auto old = std::move(bytes_);
+    auto oldBlocks = std::move(blocks_);
+    bytes_ = decltype(bytes_)(old.get_allocator());
+    blocks_ = decltype(blocks_)(oldBlocks.get_allocator());
+    for (size_t b = 0; b < oldBlocks.size(); b++) {
+      char const* pos = old.data() + oldBlocks[b].offset;
+      char const* end = old.data() + (b + 1 < oldBlocks.size()
+                                          ? oldBlocks[b + 1].offset
+                                          : old.size());
+      auto row = blockStart(oldBlocks[b]);
+      while (pos < end) {
+        decode(pos, end, row);
+        add(row);
+      }
+    }
+
+    std::stable_sort(
+        sequences_.begin(), sequences_.end(), [&](auto& x, auto& y) {
+          return pending_[x.begin].addr < pending_[y.begin].addr;
+        });
+    rows_ = 0;
+    uint64_t covered = 0;  // End of the last sequence kept
+    LineRow prev {};
+    for (auto& seq : sequences_) {
+      auto start = pending_[seq.begin].addr;
+      if (rows_ && start < covered) { continue; }  // Overlaps: drop it
+      for (auto i = seq.begin; i < seq.end; i++) {
+        auto& row = pending_[i];
+        if (rows_ % kBlockRows == 0) {
+          blocks_.push_back({row.addr, bytes_.size()});
+          prev = blockStart(blocks_.back());
+        }
+        encode(row, prev);
+        prev = row;
+        ++rows_;
+      }
+      covered = std::max(covered, pending_[seq.end - 1].addr);
+    }
+    pending_ = decltype(pending_)(pending_.get_allocator());
+    sequences_ = decltype(sequences_)(sequences_.get_allocator());
+    bytes_.shrink_to_fit();
+    blocks_.shrink_to_fit();
+  }
+
+  /**
+  The row for `addr` (the last one at or before it), if it's in a sequence.
+  Doesn't allocate.
+  */
+  bool lookup(uint64_t addr, LineRow& out) const {
+    auto it = std::upper_bound(
+        blocks_.begin(), blocks_.end(), addr, [](uint64_t a, auto& block) {
+          return a < block.addr;
+        });
+    if (it == blocks_.begin()) { return false; }
+    --it;
+    auto* pos = bytes_.data() + it->offset;
+    auto* end = bytes_.data() +
+                (it + 1 != blocks_.end() ? (it + 1)->offset : bytes_.size());
+    auto row = blockStart(*it);
+    decode(pos, end, row);
+    out = row;
+    while (pos < end) {
+      decode(pos, end, row);
+      if (row.addr > addr) { break; }
+      out = row;
+    }
+    return !out.endSequence;
+  }
+
+  LineFile const* file(uint32_t i) const {
+    return i < files_.size() ? &files_[i] : nullptr;
+  }
+
+  size_t fileCount() const { return files_.size(); }
+  size_t rowCount() const { return rows_; }
+
+  /** Memory taken by the encoded rows and their index. */
+  size_t bytes() const {
+    return bytes_.capacity() + blocks_.capacity() * sizeof(Block);
+  }
+};
+
+}  // namespace proginfo::debug
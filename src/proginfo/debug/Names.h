@@ -0,0 +1,361 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "DWARF.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+namespace proginfo::debug {
+
+/** Something named in a `NameIndex`. */
+struct NameEntry {
+  constexpr static uint64_t kUnknown = ~uint64_t(0);
+
+  uint64_t unitOffset;  // Its unit's offset in `.debug_info`
+  uint64_t dieOffset;   // Its DIE's offset in `.debug_info`, or `kUnknown`
+  uint32_t tag;         // `DW_TAG_*`, or 0 if not known
+};
+
+/*
+Finds debug info entries by name, without walking `.debug_info`: by hashing the
+name, and probing the hash table of the binary's `.debug_names` (DWARF 5) or,
+failing that, its `.gdb_index` (as made by `gdb-add-index`, or linkers' option
+`--gdb-index`).
+
+The tables are read in place; all that's set up front is the location of each
+name index in `.debug_names` (a linker which doesn't merge them leaves one per
+object file, each needing a probe) and each index's abbreviations.
+
+`.debug_names` hashes names with case folding (as LLVM does); only ASCII is
+folded here, so names with other letters which have lower case forms won't be
+found.  `.gdb_index` only knows the unit, not the DIE (so `dieOffset` is
+`kUnknown`), nor the exact tag: `DW_TAG_subprogram` for functions,
+`DW_TAG_variable` for variables, else 0.  Its entries in type units (in DWARF
+4's `.debug_types`) are skipped.
+*/
+class NameIndex {
+  // One name index in `.debug_names`; positions are within the section
+  struct Unit {
+    size_t end;
+    bool is64;
+    uint32_t cuCount;
+    uint32_t localTuCount;
+    uint32_t bucketCount;
+    uint32_t nameCount;
+    size_t cus;  // CU offsets, then local TU offsets
+    size_t buckets;
+    size_t hashes;
+    size_t strOffsets;
+    size_t entryOffsets;
+    size_t pool;
+  };
+
+  struct Abbrev {
+    uint32_t unit;  // Index in `units_`
+    uint32_t pos;   // Of its attribute specs, in `.debug_names`
+    uint64_t code;
+    uint32_t tag;
+  };
+
+  // DW_IDX_*
+  constexpr static uint64_t kIdxCompileUnit = 1;
+  constexpr static uint64_t kIdxTypeUnit = 2;
+  constexpr static uint64_t kIdxDieOffset = 3;
+
+  Sections sections_;
+  std::pmr::vector<Unit> units_;
+  std::pmr::vector<Abbrev> abbrevs_;  // Sorted by unit, then code
+
+  // `.gdb_index`, if there's no `.debug_names`
+  size_t gdbCus_ {};
+  uint32_t gdbCuCount_ {};
+  size_t gdbSymbols_ {};
+  uint32_t gdbSlots_ {};
+  size_t gdbPool_ {};
+
+  bool openNames() {
+    Reader r(sections_.names, sections_.isLE);
+    while (!r.atEnd()) {
+      Unit u {};
+      auto length = r.initialLength(u.is64);
+      u.end = r.pos() + length;
+      if (!r.has(length) || r.u16() != 5) { return false; }
+      r.u16();  // Padding
+      u.cuCount = r.u32();
+      u.localTuCount = r.u32();
+      auto foreignTuCount = r.u32();
+      u.bucketCount = r.u32();
+      u.nameCount = r.u32();
+      auto abbrevSize = r.u32();
+      auto augSize = r.u32();
+      r.skip((augSize + 3) & ~3u);
+      size_t offSize = u.is64 ? 8 : 4;
+      u.cus = r.pos();
+      r.skip((size_t(u.cuCount) + u.localTuCount) * offSize);
+      r.skip(size_t(foreignTuCount) * 8);
+      u.buckets = r.pos();
+      r.skip(size_t(u.bucketCount) * 4);
+      u.hashes = r.pos();
+      if (u.bucketCount) { r.skip(size_t(u.nameCount) * 4); }
+      u.strOffsets = r.pos();
+      r.skip(size_t(u.nameCount) * offSize);
+      u.entryOffsets = r.pos();
+      r.skip(size_t(u.nameCount) * offSize);
+      auto abbrevs = r.pos();
+      r.skip(abbrevSize);
+      u.pool = r.pos();
+      if (!r.ok() || u.pool > u.end) { return false; }
+
+      // Note where each abbreviation's attributes start
+      Reader a(sections_.names.substr(0, u.pool), sections_.isLE, abbrevs);
+      auto first = abbrevs_.size();
+      while (!a.atEnd()) {
+        auto code = a.uleb();
+        if (!code) { break; }
+        auto tag = uint32_t(a.uleb());
+        abbrevs_.push_back(
+            {uint32_t(units_.size()), uint32_t(a.pos()), code, tag});
+        while (a.ok()) {
+          auto idx = a.uleb();
+          auto form = a.uleb();
+          if (!idx && !form) { break; }
+        }
+      }
+      if (!a.ok()) { return false; }
+      std::sort(abbrevs_.begin() + long(first),
+                abbrevs_.end(),
+                [](auto& x, auto& y) { return x.code < y.code; });
+      units_.push_back(u);
+      r.seek(u.end);
+    }
+    return r.ok() && !units_.empty();
+  }
+
+  bool openGdbIndex() {
+    Reader r(sections_.gdbIndex);  // Always little-endian
+    auto version = r.u32();
+    if (version < 7 || version > 8) { return false; }
+    auto cuList = r.u32();
+    auto typesList = r.u32();
+    r.u32();  // Address area
+    auto symbols = r.u32();
+    auto pool = r.u32();
+    if (!r.ok() || cuList > typesList || symbols > pool ||
+        pool > sections_.gdbIndex.size()) {
+      return false;
+    }
+    gdbCus_ = cuList;
+    gdbCuCount_ = (typesList - cuList) / 16;
+    gdbSymbols_ = symbols;
+    gdbSlots_ = (pool - symbols) / 8;
+    gdbPool_ = pool;
+    return gdbSlots_ && !(gdbSlots_ & (gdbSlots_ - 1));  // A power of 2
+  }
+
+  /** Read an index attribute's (constant) value. */
+  static bool value(Reader& r, Form form, bool is64, uint64_t& out) {
+    switch (form) {
+    case Form::kData1:
+    case Form::kRef1: out = r.u8(); break;
+    case Form::kData2:
+    case Form::kRef2: out = r.u16(); break;
+    case Form::kData4:
+    case Form::kRef4: out = r.u32(); break;
+    case Form::kData8:
+    case Form::kRef8: out = r.u64(); break;
+    case Form::kUdata:
+    case Form::kRefUdata: out = r.uleb(); break;
+    case Form::kFlagPresent: out = 1; break;
+    default: r.skipForm(form, is64, 8); return false;
+    }
+    return r.ok();
+  }
+
+  /** Call `fn` for the entries in the list at `pos` in `unit`'s pool. */
+  template <class Fn>
+  size_t entries(uint32_t unit, size_t pos, Fn& fn, bool& more) const {
+    auto& u = units_[unit];
+    size_t offSize = u.is64 ? 8 : 4;
+    Reader r(sections_.names.substr(0, u.end), sections_.isLE, pos);
+    size_t ret = 0;
+    while (more) {
+      auto code = r.uleb();
+      if (!code || !r.ok()) { break; }
+      auto before = [](Abbrev const& a, std::pair<uint32_t, uint64_t> key) {
+        return a.unit < key.first ||
+               (a.unit == key.first && a.code < key.second);
+      };
+      auto it = std::lower_bound(
+          abbrevs_.begin(), abbrevs_.end(), std::pair(unit, code), before);
+      if (it == abbrevs_.end() || it->unit != unit || it->code != code) {
+        break;
+      }
+      uint64_t cu = 0, tu = NameEntry::kUnknown, die = NameEntry::kUnknown;
+      Reader a(sections_.names.substr(0, u.pool), sections_.isLE, it->pos);
+      while (a.ok()) {
+        auto idx = a.uleb();
+        auto form = Form(a.uleb());
+        if (!idx && form == Form(0)) { break; }
+        uint64_t val = 0;
+        bool known = value(r, form, u.is64, val);
+        if (!r.ok()) { return ret; }
+        if (known && idx == kIdxCompileUnit) { cu = val; }
+        if (known && idx == kIdxTypeUnit) { tu = val; }
+        if (known && idx == kIdxDieOffset) { die = val; }
+      }
+      // Units are listed CUs first, then local TUs; foreign TUs aren't here
+      auto unitIndex = tu == NameEntry::kUnknown ? cu : u.cuCount + tu;
+      if (unitIndex >= uint64_t(u.cuCount) + u.localTuCount) { continue; }
+      Reader c(sections_.names, sections_.isLE, u.cus + unitIndex * offSize);
+      auto unitOffset = c.offset(u.is64);
+      if (!c.ok()) { continue; }
+      NameEntry entry {unitOffset,
+                       die == NameEntry::kUnknown ? die : unitOffset + die,
+                       it->tag};
+      ++ret;
+      more = fn(entry);
+    }
+    return ret;
+  }
+
+  template <class Fn>
+  size_t lookupNames(std::string_view name, Fn& fn) const {
+    auto hash = foldedHash(name);
+    size_t ret = 0;
+    bool more = true;
+    for (uint32_t unit = 0; unit < units_.size() && more; unit++) {
+      auto& u = units_[unit];
+      Reader r(sections_.names, sections_.isLE);
+      size_t offSize = u.is64 ? 8 : 4;
+      uint32_t first = 1, last = u.nameCount;  // Names are numbered from 1
+      if (u.bucketCount) {
+        auto bucket = hash % u.bucketCount;
+        r.seek(u.buckets + size_t(bucket) * 4);
+        first = r.u32();
+        if (!first || !r.ok()) { continue; }
+      }
+      for (auto i = first; i <= last && more; i++) {
+        if (u.bucketCount) {
+          r.seek(u.hashes + size_t(i - 1) * 4);
+          auto h = r.u32();
+          if (!r.ok() || h % u.bucketCount != hash % u.bucketCount) { break; }
+          if (h != hash) { continue; }
+        }
+        r.seek(u.strOffsets + size_t(i - 1) * offSize);
+        auto strOff = r.offset(u.is64);
+        if (!r.ok() || strOff >= sections_.str.size()) { break; }
+        auto str = sections_.str.substr(strOff);
+        if (str.substr(0, str.find('\0')) != name) { continue; }
+        r.seek(u.entryOffsets + size_t(i - 1) * offSize);
+        auto entryOff = r.offset(u.is64);
+        if (!r.ok()) { break; }
+        ret += entries(unit, u.pool + entryOff, fn, more);
+      }
+    }
+    return ret;
+  }
+
+  template <class Fn>
+  size_t lookupGdbIndex(std::string_view name, Fn& fn) const {
+    auto hash = gdbHash(name);
+    auto mask = gdbSlots_ - 1;
+    auto step = ((hash * 17) & mask) | 1;
+    Reader r(sections_.gdbIndex);
+    for (uint32_t i = hash & mask, probes = 0; probes < gdbSlots_;
+         i = (i + step) & mask, probes++) {
+      r.seek(gdbSymbols_ + size_t(i) * 8);
+      auto nameOff = r.u32();
+      auto vecOff = r.u32();
+      if (!r.ok() || (!nameOff && !vecOff)) { break; }  // An empty slot
+      auto str = sections_.gdbIndex.substr(
+          std::min(gdbPool_ + nameOff, sections_.gdbIndex.size()));
+      if (str.substr(0, str.find('\0')) != name) { continue; }
+
+      r.seek(gdbPool_ + vecOff);
+      auto count = r.u32();
+      size_t ret = 0;
+      for (uint32_t j = 0; j < count && r.ok(); j++) {
+        auto val = r.u32();
+        auto cu = val & 0xffffff;
+        if (cu >= gdbCuCount_) { continue; }  // A type unit
+        Reader c(sections_.gdbIndex, true, gdbCus_ + size_t(cu) * 16);
+        auto unitOffset = c.u64();
+        if (!c.ok()) { continue; }
+        uint32_t tag = 0;
+        switch ((val >> 28) & 7) {
+        case 2: tag = 0x34; break;  // Variable: DW_TAG_variable
+        case 3: tag = 0x2e; break;  // Function: DW_TAG_subprogram
+        }
+        NameEntry entry {unitOffset, NameEntry::kUnknown, tag};
+        ++ret;
+        if (!fn(entry)) { break; }
+      }
+      return ret;
+    }
+    return 0;
+  }
+
+public:
+  explicit NameIndex(
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : units_(mr)
+      , abbrevs_(mr) {}
+
+  /**
+  Use the index in `sections` (`names` and `str`, or else `gdbIndex`), which
+  must stay mapped.  Returns false if there's neither, or it's malformed.
+  */
+  bool open(Sections const& sections) {
+    sections_ = sections;
+    units_.clear();
+    abbrevs_.clear();
+    gdbSlots_ = 0;
+    if (!sections_.names.empty() && openNames()) { return true; }
+    units_.clear();
+    abbrevs_.clear();
+    return !sections_.gdbIndex.empty() && openGdbIndex();
+  }
+
+  bool hasDebugNames() const { return !units_.empty(); }
+  bool hasGdbIndex() const { return units_.empty() && gdbSlots_; }
+
+  /**
+  Call `fn(NameEntry const&)` for each entry named `name`, until it returns
+  false.  Returns how many entries were found.  Doesn't allocate.
+  */
+  template <class Fn>
+  size_t lookup(std::string_view name, Fn&& fn) const {
+    if (!units_.empty()) { return lookupNames(name, fn); }
+    if (gdbSlots_) { return lookupGdbIndex(name, fn); }
+    return 0;
+  }
+
+  /** The hash used by `.debug_names`: DJB, of the case-folded name. */
+  static uint32_t foldedHash(std::string_view name) {
+    uint32_t ret = 5381;
+    for (auto c : name) {
+      auto byte = uint8_t(c);
+      if (byte >= 'A' && byte <= 'Z') { byte = uint8_t(byte + 32); }
+      ret = ret * 33 + byte;
+    }
+    return ret;
+  }
+
+  /** The hash used by `.gdb_index` (version 5 and later). */
+  static uint32_t gdbHash(std::string_view name) {
+    uint32_t ret = 0;
+    for (auto c : name) {
+      auto byte = uint8_t(c);
+      if (byte >= 'A' && byte <= 'Z') { byte = uint8_t(byte + 32); }
+      ret = ret * 67 + byte - 113;
+    }
+    return ret;
+  }
+};
+
+}  // namespace proginfo::debug
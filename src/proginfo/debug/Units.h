@@ -0,0 +1,481 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "DWARF.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+namespace proginfo::debug {
+
+/** One of a DIE's attributes, as its abbreviation declares it. */
+struct Attribute {
+  uint64_t name;  // `DW_AT_*`
+  Form form;
+  int64_t implicitConst;  // The value, if `form` is `Form::kImplicitConst`
+};
+
+/**
+A unit in `.debug_info`: its header, and what its unit DIE says about the
+rest of its DIEs.  Offsets are within the sections they're into.
+
+The bases are where the unit's part of each table starts (just past that
+part's header), for attributes in the indexed forms.  Split units (in `.dwo`
+files) don't give them: theirs default to just past the section's first
+header, as a `.dwo` has only the one.  Before DWARF 5 they're all 0.
+*/
+struct Unit {
+  uint64_t offset;        // Of its header
+  uint64_t end;           // Just past its last DIE
+  uint64_t dieOffset;     // Of its unit DIE
+  uint64_t abbrevOffset;  // Of its abbreviations, in `.debug_abbrev`
+  uint64_t id;            // DWO ID, or type signature; else 0
+  uint16_t version;
+  uint8_t type;  // `DW_UT_*`; 0 before DWARF 5
+  uint8_t addrSize;
+  bool is64;
+  uint32_t tag;             // Of its unit DIE
+  uint64_t lineOffset;      // Of its line program in `.debug_line`, or ~0
+  uint64_t lowPc;           // The default base address for its lists
+  uint64_t strOffsetsBase;  // In `.debug_str_offsets`, for `DW_FORM_strx*`
+  uint64_t addrBase;        // In `.debug_addr`, for `DW_FORM_addrx*`
+  uint64_t rnglistsBase;    // In `.debug_rnglists`, for `DW_FORM_rnglistx`
+  uint64_t loclistsBase;    // In `.debug_loclists`, for `DW_FORM_loclistx`
+};
+
+/*
+The units in a binary's `.debug_info`, for reading their DIEs' attributes,
+including those in the forms DWARF 5 added to shrink debug info (and which
+compilers now use by default): strings and addresses by index into a unit's
+part of `.debug_str_offsets` and `.debug_addr`, and range and location lists
+in `.debug_rnglists` and `.debug_loclists`.
+
+Opening reads each unit's header and its unit DIE, once, keeping the bases
+for those indexes; and indexes the abbreviation tables.  After that, reading
+an attribute is a lookup in the section; nothing is copied (strings are views
+of `.debug_str`) and nothing is allocated.
+*/
+class Units {
+  struct Abbrev {
+    uint64_t table;  // Offset of its table, in `.debug_abbrev`
+    uint64_t code;
+    size_t pos;  // Of its attribute specs
+    uint32_t tag;
+    bool children;
+  };
+
+  // DW_AT_*
+  constexpr static uint64_t kAtStmtList = 0x10;
+  constexpr static uint64_t kAtLowPc = 0x11;
+  constexpr static uint64_t kAtStrOffsetsBase = 0x72;
+  constexpr static uint64_t kAtAddrBase = 0x73;
+  constexpr static uint64_t kAtRnglistsBase = 0x74;
+  constexpr static uint64_t kAtLoclistsBase = 0x8c;
+  constexpr static uint64_t kAtGnuAddrBase = 0x2133;
+
+  Sections sections_;
+  std::pmr::vector<Unit> units_;      // In section order
+  std::pmr::vector<Abbrev> abbrevs_;  // Sorted by table, then code
+
+  bool readUnits() {
+    Reader r(sections_.info, sections_.isLE);
+    while (!r.atEnd()) {
+      Unit u {};
+      u.offset = r.pos();
+      auto length = r.initialLength(u.is64);
+      if (!r.has(length)) { return false; }
+      u.end = r.pos() + length;
+      u.version = r.u16();
+      if (u.version >= 5) {
+        u.type = r.u8();
+        u.addrSize = r.u8();
+        u.abbrevOffset = r.offset(u.is64);
+        if (u.type == 2 || u.type == 6) {  // DW_UT_type, DW_UT_split_type
+          u.id = r.u64();
+          r.offset(u.is64);                       // Type offset
+        } else if (u.type == 4 || u.type == 5) {  // Skeleton, split compile
+          u.id = r.u64();
+        }
+      } else if (u.version >= 2) {
+        u.abbrevOffset = r.offset(u.is64);
+        u.addrSize = r.u8();
+      } else {
+        return false;
+      }
+      u.dieOffset = r.pos();
+      if (!r.ok() || u.dieOffset > u.end || !u.addrSize || u.addrSize > 8) {
+        return false;
+      }
+      units_.push_back(u);
+      r.seek(u.end);
+    }
+    return r.ok();
+  }
+
+  bool readAbbrevs(uint64_t table) {
+    Reader r(sections_.abbrev, sections_.isLE, table);
+    auto first = abbrevs_.size();
+    while (!r.atEnd()) {
+      auto code = r.uleb();
+      if (!code) { break; }
+      auto tag = uint32_t(r.uleb());
+      bool children = r.u8();
+      abbrevs_.push_back({table, code, r.pos(), tag, children});
+      while (r.ok()) {
+        auto name = r.uleb();
+        auto form = Form(r.uleb());
+        if (form == Form::kImplicitConst) { r.sleb(); }
+        if (!name && form == Form(0)) { break; }
+      }
+    }
+    std::sort(abbrevs_.begin() + long(first),
+              abbrevs_.end(),
+              [](auto& x, auto& y) { return x.code < y.code; });
+    return r.ok();
+  }
+
+  Abbrev const* abbrev(uint64_t table, uint64_t code) const {
+    auto before = [](Abbrev const& a, std::pair<uint64_t, uint64_t> key) {
+      return a.table < key.first ||
+             (a.table == key.first && a.code < key.second);
+    };
+    auto it = std::lower_bound(
+        abbrevs_.begin(), abbrevs_.end(), std::pair(table, code), before);
+    if (it == abbrevs_.end() || it->table != table || it->code != code) {
+      return nullptr;
+    }
+    return &*it;
+  }
+
+  /** Fill in `u`'s bases from its unit DIE. */
+  void readBases(Unit& u) {
+    if (u.version >= 5) {
+      uint64_t header = u.is64 ? 16 : 8;  // Length, version, padding or sizes
+      u.strOffsetsBase = header;
+      u.addrBase = header;
+      u.rnglistsBase = header + 4;  // And the offset entry count
+      u.loclistsBase = header + 4;
+    }
+    u.lineOffset = ~uint64_t(0);
+    uint64_t lowPcIndex = 0;
+    bool lowPcIndexed = false;
+    u.tag = attributes(u, u.dieOffset, [&](Attribute const& a, Reader& v) {
+      switch (a.name) {
+      case kAtLowPc:
+        if (a.form == Form::kAddr) {
+          u.lowPc = v.read(u.addrSize);
+        } else {
+          lowPcIndex = index(v, a.form);
+          lowPcIndexed = true;
+        }
+        break;
+      case kAtStmtList: u.lineOffset = v.offset(u.is64); break;
+      case kAtStrOffsetsBase: u.strOffsetsBase = v.offset(u.is64); break;
+      case kAtAddrBase:
+      case kAtGnuAddrBase: u.addrBase = v.offset(u.is64); break;
+      case kAtRnglistsBase: u.rnglistsBase = v.offset(u.is64); break;
+      case kAtLoclistsBase: u.loclistsBase = v.offset(u.is64); break;
+      }
+      return true;
+    });
+    // The base for `DW_AT_low_pc` could come after it
+    if (lowPcIndexed && !addrx(u, lowPcIndex, u.lowPc)) { u.lowPc = 0; }
+  }
+
+  /** A null-terminated string at `offset` in `sec`. */
+  static std::string_view cstrAt(std::string_view sec, uint64_t offset) {
+    if (offset >= sec.size()) { return {}; }
+    auto ret = sec.substr(size_t(offset));
+    return ret.substr(0, ret.find('\0'));
+  }
+
+  /** The offset in a list table `sec` given by a list attribute's value. */
+  bool listOffset(std::string_view sec,
+                  uint64_t base,
+                  Unit const& u,
+                  Form form,
+                  Reader& r,
+                  uint64_t& out) const {
+    if (form == Form::kSecOffset) {
+      out = r.offset(u.is64);
+      return r.ok();
+    }
+    if (form != Form::kRnglistx && form != Form::kLoclistx) { return false; }
+    auto i = r.uleb();
+    uint64_t offSize = u.is64 ? 8 : 4;
+    if (!r.ok() || base > sec.size() || i >= (sec.size() - base) / offSize) {
+      return false;
+    }
+    Reader t(sec, sections_.isLE, size_t(base + i * offSize));
+    out = base + t.offset(u.is64);  // Relative to the base
+    return t.ok();
+  }
+
+  /**
+  Walk the range list (or location list, for `kIsLoc`) at `offset` in `sec`.
+  The two have the same entry kinds, but for location lists' default entry
+  (and its expression after each one).
+  */
+  template <bool kIsLoc, class Fn>
+  bool list(std::string_view sec, Unit const& u, uint64_t offset, Fn& fn)
+      const {
+    Reader r(sec, sections_.isLE, size_t(offset));
+    auto base = u.lowPc;
+    while (r.ok()) {
+      auto kind = r.u8();
+      uint64_t lo = 0, hi = ~uint64_t(0);
+      bool ok = true;
+      if (kIsLoc && kind == 9) {  // DW_LLE_GNU_view_pair: not a location
+        r.uleb();
+        r.uleb();
+        continue;
+      }
+      if (kIsLoc && kind == 5) {
+        kind = 0xff;  // DW_LLE_default_location
+      } else if (kIsLoc && kind > 5) {
+        --kind;  // As the `DW_RLE_*` kind
+      }
+      switch (kind) {
+      case 0: return r.ok();  // End of list
+      case 1:                 // Base address (x)
+        if (!addrx(u, r.uleb(), base)) { return false; }
+        continue;
+      case 2:  // Start (x), end (x)
+        ok = addrx(u, r.uleb(), lo);
+        ok = addrx(u, r.uleb(), hi) && ok;
+        break;
+      case 3:  // Start (x), length
+        ok = addrx(u, r.uleb(), lo);
+        hi = lo + r.uleb();
+        break;
+      case 4:  // Offsets from the base
+        lo = base + r.uleb();
+        hi = base + r.uleb();
+        break;
+      case 5: base = r.read(u.addrSize); continue;  // Base address
+      case 6:                                       // Start, end
+        lo = r.read(u.addrSize);
+        hi = r.read(u.addrSize);
+        break;
+      case 7:  // Start, length
+        lo = r.read(u.addrSize);
+        hi = lo + r.uleb();
+        break;
+      default:
+        if (!kIsLoc || kind != 0xff) { return false; }
+        lo = 0;  // The default location
+        break;
+      }
+      if (!ok || !r.ok()) { return false; }
+      if constexpr (kIsLoc) {
+        auto expr = r.bytes(size_t(r.uleb()));
+        if (!r.ok()) { return false; }
+        if (!fn(lo, hi, expr)) { return true; }
+      } else {
+        if (!fn(lo, hi)) { return true; }
+      }
+    }
+    return false;
+  }
+
+public:
+  explicit Units(
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : units_(mr)
+      , abbrevs_(mr) {}
+
+  /**
+  Read the units in `sections` (which must stay mapped).  Returns false if
+  there are none, or if a unit header or abbreviation table is malformed.
+  */
+  bool open(Sections const& sections) {
+    sections_ = sections;
+    units_.clear();
+    abbrevs_.clear();
+    if (!readUnits()) {
+      units_.clear();
+      return false;
+    }
+    // Index each abbreviation table, in order, once
+    std::pmr::vector<uint64_t> tables(units_.get_allocator());
+    for (auto& u : units_) { tables.push_back(u.abbrevOffset); }
+    std::sort(tables.begin(), tables.end());
+    tables.erase(std::unique(tables.begin(), tables.end()), tables.end());
+    for (auto table : tables) {
+      if (!readAbbrevs(table)) {
+        units_.clear();
+        abbrevs_.clear();
+        return false;
+      }
+    }
+    for (auto& u : units_) { readBases(u); }
+    return !units_.empty();
+  }
+
+  Sections const& sections() const { return sections_; }
+  size_t size() const { return units_.size(); }
+  Unit const& operator[](size_t i) const { return units_[i]; }
+  auto begin() const { return units_.begin(); }
+  auto end() const { return units_.end(); }
+
+  /** The unit containing `offset` in `.debug_info`, or nullptr. */
+  Unit const* find(uint64_t offset) const {
+    auto it = std::upper_bound(
+        units_.begin(), units_.end(), offset, [](uint64_t off, auto& u) {
+          return off < u.offset;
+        });
+    if (it == units_.begin() || offset >= (--it)->end) { return nullptr; }
+    return &*it;
+  }
+
+  /**
+  Call `fn(Attribute const&, Reader&)` for each attribute of the DIE at
+  `die` (in `.debug_info`), with the reader at its value, until it returns
+  false.  Returns the DIE's tag, or 0 for a null entry (or a malformed one).
+  */
+  template <class Fn>
+  uint32_t attributes(Unit const& unit, uint64_t die, Fn&& fn) const {
+    Reader r(sections_.info.substr(0, size_t(unit.end)),
+             sections_.isLE,
+             size_t(die));
+    auto* ab = abbrev(unit.abbrevOffset, r.uleb());
+    if (!ab || !r.ok()) { return 0; }
+    Reader specs(sections_.abbrev, sections_.isLE, ab->pos);
+    while (true) {
+      Attribute a {};
+      a.name = specs.uleb();
+      a.form = Form(specs.uleb());
+      if (a.form == Form::kImplicitConst) { a.implicitConst = specs.sleb(); }
+      if (!specs.ok()) { return 0; }
+      if (!a.name && a.form == Form(0)) { break; }
+      if (a.form == Form::kIndirect) { a.form = Form(r.uleb()); }
+      auto value = r;
+      if (!r.skipForm(a.form, unit.is64, unit.addrSize)) { return 0; }
+      if (!fn(a, value)) { break; }
+    }
+    return ab->tag;
+  }
+
+  /**
+  Read an index, in one of the indexed forms (`DW_FORM_strx*`, `addrx*`,
+  `rnglistx`, `loclistx`, or their GNU forerunners).
+  */
+  static uint64_t index(Reader& r, Form form) {
+    switch (form) {
+    case Form::kStrx1:
+    case Form::kAddrx1: return r.u8();
+    case Form::kStrx2:
+    case Form::kAddrx2: return r.u16();
+    case Form::kStrx3:
+    case Form::kAddrx3: return r.read(3);
+    case Form::kStrx4:
+    case Form::kAddrx4: return r.u32();
+    default: return r.uleb();
+    }
+  }
+
+  std::string_view strp(uint64_t offset) const {
+    return cstrAt(sections_.str, offset);
+  }
+
+  std::string_view lineStrp(uint64_t offset) const {
+    return cstrAt(sections_.lineStr, offset);
+  }
+
+  /** String `index` of `unit`'s in `.debug_str_offsets`; empty if none. */
+  std::string_view strx(Unit const& unit, uint64_t index) const {
+    auto& sec = sections_.strOffsets;
+    uint64_t offSize = unit.is64 ? 8 : 4;
+    auto base = unit.strOffsetsBase;
+    if (base > sec.size() || index >= (sec.size() - base) / offSize) {
+      return {};
+    }
+    Reader r(sec, sections_.isLE, size_t(base + index * offSize));
+    auto offset = r.offset(unit.is64);
+    return r.ok() ? strp(offset) : std::string_view();
+  }
+
+  /** Address `index` of `unit`'s in `.debug_addr`. */
+  bool addrx(Unit const& unit, uint64_t index, uint64_t& out) const {
+    auto& sec = sections_.addr;
+    auto base = unit.addrBase;
+    if (base > sec.size() || index >= (sec.size() - base) / unit.addrSize) {
+      return false;
+    }
+    Reader r(sec, sections_.isLE, size_t(base + index * unit.addrSize));
+    out = r.read(unit.addrSize);
+    return r.ok();
+  }
+
+  /** Read a string attribute's value, in any string form; empty if not. */
+  std::string_view string(Unit const& unit, Form form, Reader& r) const {
+    switch (form) {
+    case Form::kString: return r.cstr();
+    case Form::kStrp: return strp(r.offset(unit.is64));
+    case Form::kLineStrp: return lineStrp(r.offset(unit.is64));
+    case Form::kStrx:
+    case Form::kStrx1:
+    case Form::kStrx2:
+    case Form::kStrx3:
+    case Form::kStrx4:
+    case Form::kGnuStrIndex: return strx(unit, index(r, form));
+    default: return {};
+    }
+  }
+
+  /** Read an address attribute's value, in `DW_FORM_addr` or `addrx*`. */
+  bool address(Unit const& unit, Form form, Reader& r, uint64_t& out) const {
+    switch (form) {
+    case Form::kAddr: out = r.read(unit.addrSize); return r.ok();
+    case Form::kAddrx:
+    case Form::kAddrx1:
+    case Form::kAddrx2:
+    case Form::kAddrx3:
+    case Form::kAddrx4:
+    case Form::kGnuAddrIndex: return addrx(unit, index(r, form), out);
+    default: return false;
+    }
+  }
+
+  /**
+  The offset in `.debug_rnglists` of the list given by a `DW_AT_ranges`
+  value (in `DW_FORM_sec_offset` or `rnglistx`).
+  */
+  bool rnglist(Unit const& unit, Form form, Reader& r, uint64_t& out) const {
+    return listOffset(
+        sections_.rnglists, unit.rnglistsBase, unit, form, r, out);
+  }
+
+  /** As `rnglist`, for a location list attribute, in `.debug_loclists`. */
+  bool loclist(Unit const& unit, Form form, Reader& r, uint64_t& out) const {
+    return listOffset(
+        sections_.loclists, unit.loclistsBase, unit, form, r, out);
+  }
+
+  /**
+  Call `fn(lo, hi)` for each address range `[lo, hi)` in the range list at
+  `offset` in `.debug_rnglists`, until it returns false.  Returns false if
+  the list is malformed, or uses an address that isn't there (as in a split
+  unit, whose addresses are in the skeleton's `.debug_addr`).
+  */
+  template <class Fn>
+  bool ranges(Unit const& unit, uint64_t offset, Fn&& fn) const {
+    return list<false>(sections_.rnglists, unit, offset, fn);
+  }
+
+  /**
+  As `ranges`, for the location list at `offset` in `.debug_loclists`, with
+  `fn(lo, hi, expr)` given each location's DWARF expression.  The default
+  location (for addresses in no other range) has the range `[0, ~0)`.
+  */
+  template <class Fn>
+  bool locations(Unit const& unit, uint64_t offset, Fn&& fn) const {
+    return list<true>(sections_.loclists, unit, offset, fn);
+  }
+};
+
+}  // namespace proginfo::debug
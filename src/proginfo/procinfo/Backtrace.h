@@ -0,0 +1,100 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ucontext.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/uio.h>
+#endif
+
+namespace proginfo::procinfo {
+
+/** The registers a stack walk starts from. */
+struct Registers {
+  uintptr_t pc;
+  uintptr_t sp;
+  uintptr_t fp;
+
+  /**
+  Registers of the interrupted code, from a signal handler's `ucontext_t`
+  argument.  All zero on architectures we don't know.
+  */
+  static Registers fromContext(void const* context) {
+    auto const& mc = ((ucontext_t const*) context)->uc_mcontext;
+#if defined(__linux__) && defined(__x86_64__)
+    return {uintptr_t(mc.gregs[REG_RIP]),
+            uintptr_t(mc.gregs[REG_RSP]),
+            uintptr_t(mc.gregs[REG_RBP])};
+#elif defined(__linux__) && defined(__aarch64__)
+    return {uintptr_t(mc.pc), uintptr_t(mc.sp), uintptr_t(mc.regs[29])};
+#elif defined(__linux__) && defined(__i386__)
+    return {uintptr_t(mc.gregs[REG_EIP]),
+            uintptr_t(mc.gregs[REG_ESP]),
+            uintptr_t(mc.gregs[REG_EBP])};
+#else
+    (void) mc;
+    return {};
+#endif
+  }
+};
+
+/**
+Copy `size` bytes at `addr` in this process, without crashing if it isn't all
+readable (in which case this returns false).  Signal-safe.  On Linux this asks
+the kernel to do the copy; elsewhere, it just reads the memory.
+*/
+inline bool readMemory(uintptr_t addr, void* out, size_t size) {
+#if defined(__linux__)
+  iovec local {out, size};
+  iovec remote {(void*) addr, size};
+  auto n = process_vm_readv(getpid(), &local, 1, &remote, 1, 0);
+  if (n >= 0) { return size_t(n) == size; }
+  if (errno == EFAULT) { return false; }
+  // Otherwise not permitted (e.g. by seccomp); take our chances
+#endif
+  memcpy(out, (void const*) addr, size);
+  return true;
+}
+
+/*
+Walk the frame-pointer chain from `regs`, storing up to `max` program counters
+in `pcs`: `regs.pc` (unless zero), then each caller's return address.  Returns
+the number stored.  Signal-safe, and doesn't allocate.
+
+This relies on the code having been built with frame pointers (e.g.
+`-fno-omit-frame-pointer`, the default at `-O0`); frames without them are
+skipped over or end the walk early.  Each frame record is the saved frame
+pointer followed by the return address, which holds for x86, x86-64 and
+AArch64.  The walk stops at a null or misaligned frame pointer, one which
+doesn't move up the stack, or an unreadable frame.
+
+Note that return addresses point after the call; look up `pc - 1` to find the
+function and line of the call itself.
+*/
+inline size_t backtrace(Registers const& regs, uintptr_t* pcs, size_t max) {
+  size_t n = 0;
+  if (n < max && regs.pc) { pcs[n++] = regs.pc; }
+  auto fp = regs.fp;
+  auto low = regs.sp;
+  while (n < max && fp && !(fp % sizeof(uintptr_t)) && fp >= low) {
+    uintptr_t frame[2];  // Caller's frame pointer, return address
+    if (!readMemory(fp, frame, sizeof(frame)) || !frame[1]) { break; }
+    pcs[n++] = frame[1];
+    low = fp + sizeof(frame);
+    fp = frame[0];
+  }
+  return n;
+}
+
+/** The current stack (not including this call).  See `backtrace` above. */
+[[gnu::noinline]] inline size_t backtraceHere(uintptr_t* pcs, size_t max) {
+  auto fp = uintptr_t(__builtin_frame_address(0));
+  return backtrace({0, fp, fp}, pcs, max);
+}
+
+}  // namespace proginfo::procinfo
@@ -0,0 +1,211 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "../binary/elf/Notes.h"
+#include "../util/Bytes.h"
+#include "Memory.h"
+#include "ProcInfo.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <link.h>
+#include <unistd.h>
+
+namespace proginfo::procinfo {
+
+/*
+Linux (and other ELF platforms with glibc-style `dl_iterate_phdr`): one module
+per loaded object, spanning its `PT_LOAD` segments.  The build ID is read from
+the object's `PT_NOTE` segments, which are mapped along with everything else.
+
+Other processes' modules are found in `/proc/PID/maps`, then their ELF headers
+(and notes) read through a `MemorySource`, the same way.
+*/
+
+namespace detail {
+
+/** GNU build ID in the note data at `notes`, padded to `align`, if any. */
+inline std::string_view findBuildId(util::Addr notes, size_t align) {
+  constexpr bool kIsLE = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+  return binary::NoteReader(notes, kIsLE, align).buildId();
+}
+
+/** GNU build ID in the loaded `PT_NOTE` segments of `info`, if any. */
+inline std::string_view loadedBuildId(dl_phdr_info const& info) {
+  for (unsigned i = 0; i < info.dlpi_phnum; i++) {
+    auto& ph = info.dlpi_phdr[i];
+    if (ph.p_type != PT_NOTE) { continue; }
+    util::Addr notes {(void const*) (info.dlpi_addr + ph.p_vaddr), ph.p_memsz};
+    auto buildId = findBuildId(notes, ph.p_align);
+    if (!buildId.empty()) { return buildId; }
+  }
+  return {};
+}
+
+/**
+Fill in `mod`'s extent, load bias and build ID from the ELF headers loaded at
+`start` (the mapping of the start of its file) in some process's `memory`; its
+program headers say how the rest was loaded.  Returns false if they're not
+there, or not ELF (for this platform's word size).
+*/
+inline bool remoteModule(MemorySource& memory,
+                         uintptr_t start,
+                         Module* mod,
+                         std::pmr::string* buildId) {
+  ElfW(Ehdr) eh;
+  if (!memory.read(start, &eh) || memcmp(eh.e_ident, ELFMAG, SELFMAG) ||
+      eh.e_ident[EI_CLASS] != (sizeof(void*) == 8 ? ELFCLASS64 : ELFCLASS32) ||
+      eh.e_phentsize != sizeof(ElfW(Phdr)) || eh.e_phnum > 256) {
+    return false;
+  }
+  ElfW(Phdr) phdrs[256];
+  if (!memory.read(start + eh.e_phoff, phdrs, eh.e_phnum * sizeof(phdrs[0]))) {
+    return false;
+  }
+  // The first `PT_LOAD` maps the start of the file
+  mod->start = UINTPTR_MAX;
+  mod->end = 0;
+  for (unsigned i = 0; i < eh.e_phnum; i++) {
+    auto& ph = phdrs[i];
+    if (ph.p_type != PT_LOAD) { continue; }
+    if (mod->start == UINTPTR_MAX) {
+      mod->base = start - uintptr_t(ph.p_vaddr - ph.p_offset);
+    }
+    auto segStart = uintptr_t(mod->base + ph.p_vaddr);
+    mod->start = std::min(mod->start, segStart);
+    mod->end = std::max(mod->end, uintptr_t(segStart + ph.p_memsz));
+  }
+  if (mod->start >= mod->end) { return false; }
+  for (unsigned i = 0; i < eh.e_phnum && buildId->empty(); i++) {
+    auto& ph = phdrs[i];
+    if (ph.p_type != PT_NOTE) { continue; }
+    char notes[1024];
+    auto size = std::min(size_t(ph.p_memsz), sizeof(notes));
+    if (!memory.read(mod->base + ph.p_vaddr, notes, size)) { continue; }
+    *buildId = findBuildId({notes, size}, ph.p_align);
+  }
+  return true;
+}
+
+}  // namespace detail
+
+inline bool ModuleMap::refresh() {
+  modules_.clear();
+  strings_.clear();
+  auto len = readlink("/proc/self/exe", exePath_, sizeof(exePath_) - 1);
+  exePath_[len > 0 ? len : 0] = '\0';
+  dl_iterate_phdr(
+      [](dl_phdr_info* info, size_t, void* ctx) {
+        auto& self = *(ModuleMap*) ctx;
+        Module mod {};
+        mod.path = info->dlpi_name ? info->dlpi_name : "";
+        if (mod.path.empty()) {
+          // The main program; the loader doesn't record its name
+          mod.path = *self.exePath_ ? self.exePath_ : "/proc/self/exe";
+        }
+        mod.base = info->dlpi_addr;
+        mod.start = UINTPTR_MAX;
+        for (unsigned i = 0; i < info->dlpi_phnum; i++) {
+          auto& ph = info->dlpi_phdr[i];
+          if (ph.p_type != PT_LOAD) { continue; }
+          mod.start = std::min(mod.start, uintptr_t(mod.base + ph.p_vaddr));
+          auto segEnd = uintptr_t(mod.base + ph.p_vaddr + ph.p_memsz);
+          mod.end = std::max(mod.end, segEnd);
+        }
+        if (mod.start < mod.end) {
+          mod.buildId = detail::loadedBuildId(*info);
+          self.modules_.push_back(mod);
+        }
+        return 0;
+      },
+      this);
+  sort();
+  return !modules_.empty();
+}
+
+inline bool ModuleMap::refresh(int pid, MemorySource& memory) {
+  clear();
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+  auto* maps = fopen(path, "r");
+  if (!maps) { return false; }
+  // Each line is "start-end perms offset dev inode path"; a module starts where
+  // its file is mapped from offset 0, and its headers are there
+  char line[4096 + 128];
+  while (fgets(line, sizeof(line), maps)) {
+    unsigned long long start, end, offset, inode;
+    int pathPos = 0;
+    if (sscanf(line,
+               "%llx-%llx %*s %llx %*s %llu %n",
+               &start,
+               &end,
+               &offset,
+               &inode,
+               &pathPos) < 4 ||
+        !pathPos || offset) {
+      continue;
+    }
+    std::string_view name(line + pathPos);
+    while (!name.empty() && name.back() == '\n') { name.remove_suffix(1); }
+    bool isFile = inode && name.substr(0, 1) == "/";
+    if (!isFile && name != "[vdso]") { continue; }
+    Module mod {};
+    std::pmr::string buildId(strings_.get_allocator());
+    if (!detail::remoteModule(memory, uintptr_t(start), &mod, &buildId)) {
+      continue;
+    }
+    mod.path = strings_.emplace_back(name);
+    if (!buildId.empty()) { mod.buildId = strings_.emplace_back(buildId); }
+    modules_.push_back(mod);
+  }
+  fclose(maps);
+  sort();
+  return !modules_.empty();
+}
+
+/**
+Store up to `max` of process `pid`'s thread IDs in `out`; returns how many it
+has (which may be more than `max`), or 0 if it can't be read.
+*/
+inline size_t threadIds(int pid, int* out, size_t max) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/task", pid);
+  auto* dir = opendir(path);
+  if (!dir) { return 0; }
+  size_t n = 0;
+  while (auto* ent = readdir(dir)) {
+    if (ent->d_name[0] < '0' || ent->d_name[0] > '9') { continue; }
+    if (n < max) { out[n] = atoi(ent->d_name); }
+    ++n;
+  }
+  closedir(dir);
+  return n;
+}
+
+/**
+The PC and stack pointer of thread `tid` of process `pid`, if it's blocked in
+the kernel (as a hung thread usually is), from `/proc/PID/task/TID/syscall`;
+so without having to stop it.  The frame pointer isn't available, so is left
+zero.  Returns false if the thread is running, or can't be inspected.
+*/
+inline bool blockedRegisters(int pid, int tid, Registers* out) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/task/%d/syscall", pid, tid);
+  auto* f = fopen(path, "r");
+  if (!f) { return false; }
+  // "nr arg1 ... arg6 sp pc", or "-1 sp pc" if not in a system call
+  unsigned long long vals[9];
+  unsigned n = 0;
+  char word[32];
+  while (n < 9 && fscanf(f, "%31s", word) == 1) {
+    vals[n++] = strtoull(word, nullptr, 0);
+  }
+  fclose(f);
+  if (n != 3 && n != 9) { return false; }
+  *out = {uintptr_t(vals[n - 1]), uintptr_t(vals[n - 2]), 0};
+  return true;
+}
+
+}  // namespace proginfo::procinfo
@@ -0,0 +1,156 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "../util/Stats.h"
+#include "Backtrace.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace proginfo::procinfo {
+
+/**
+Somewhere to read a process's memory from, by address: this process's (see
+`SelfMemory`) or, on Linux, another's (`RemoteMemory`).
+*/
+class MemorySource {
+public:
+  virtual ~MemorySource() = default;
+
+  /** Copy `size` bytes at `addr` to `out`; false if not all are readable. */
+  virtual bool read(uintptr_t addr, void* out, size_t size) = 0;
+
+  template <class T>
+  bool read(uintptr_t addr, T* out) {
+    return read(addr, (void*) out, sizeof(T));
+  }
+};
+
+/** This process's memory, via `readMemory` (so unmapped addresses are ok). */
+class SelfMemory final : public MemorySource {
+public:
+  using MemorySource::read;
+
+  bool read(uintptr_t addr, void* out, size_t size) override {
+    return readMemory(addr, out, size);
+  }
+};
+
+#if defined(__linux__)
+
+/*
+Another process's memory, read with `process_vm_readv`: no need to stop it
+with `ptrace`, just permission to (as for `ptrace`: same user, and allowed by
+Yama, if in use).
+
+Small reads go through a cache of whole pages, since parsing headers and
+unwinding stacks tends to make many small reads close together; big ones
+(`readDirect`) go straight to the target.  The process keeps running, so cached
+pages get stale; `invalidate` before each new look at it.  Thread-safe.
+*/
+class RemoteMemory final : public MemorySource {
+public:
+  struct Stats {
+    uint64_t hits {};    // Pages found in the cache
+    uint64_t misses {};  // Pages read from the process
+    uint64_t failed {};  // Reads of unmapped (or otherwise unreadable) pages
+  };
+
+private:
+  constexpr static auto kEmpty = ~uintptr_t(0);
+
+  pid_t pid_;
+  size_t pageSize_;
+  std::pmr::vector<uintptr_t> pages_;  // Each slot's page address, or kEmpty
+  std::pmr::vector<char> data_;        // `pageSize_` bytes per slot
+  std::mutex mutex_;
+  Stats stats_;
+
+  /** The cached copy of the page at `page`, reading it in if needed. */
+  char const* cached(uintptr_t page) {
+    auto i = (page / pageSize_) % pages_.size();
+    auto* data = &data_[i * pageSize_];
+    if (pages_[i] == page) {
+      ++stats_.hits;
+      return data;
+    }
+    pages_[i] = kEmpty;
+    if (readDirect(page, data, pageSize_) != pageSize_) {
+      ++stats_.failed;
+      return nullptr;
+    }
+    ++stats_.misses;
+    pages_[i] = page;
+    return data;
+  }
+
+public:
+  /** Cache up to `cachePages` pages of process `pid`'s memory. */
+  explicit RemoteMemory(
+      pid_t pid,
+      size_t cachePages = 256,
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : pid_(pid)
+      , pageSize_(size_t(sysconf(_SC_PAGESIZE)))
+      , pages_(cachePages ? cachePages : 1, kEmpty, mr)
+      , data_(pages_.size() * pageSize_, mr) {}
+
+  pid_t pid() const { return pid_; }
+
+  using MemorySource::read;
+
+  bool read(uintptr_t addr, void* out, size_t size) override {
+    std::lock_guard lock(mutex_);
+    auto* dest = (char*) out;
+    while (size) {
+      auto page = addr - addr % pageSize_;
+      auto* data = cached(page);
+      if (!data) { return false; }
+      auto off = addr - page;
+      auto n = std::min(size, pageSize_ - off);
+      memcpy(dest, data + off, n);
+      dest += n;
+      addr += n;
+      size -= n;
+    }
+    return true;
+  }
+
+  /**
+  Read up to `size` bytes at `addr`, bypassing the cache; returns how many were
+  read, stopping at the first unreadable page (e.g. the top of a stack).
+  */
+  size_t readDirect(uintptr_t addr, void* out, size_t size) const {
+    util::Stats::Scope timer(util::Timer::kIO);
+    iovec local {out, size};
+    iovec remote {(void*) addr, size};
+    auto n = process_vm_readv(pid_, &local, 1, &remote, 1, 0);
+    return n > 0 ? size_t(n) : 0;
+  }
+
+  /** Forget all cached pages. */
+  void invalidate() {
+    std::lock_guard lock(mutex_);
+    std::fill(pages_.begin(), pages_.end(), kEmpty);
+  }
+
+  Stats stats() {
+    std::lock_guard lock(mutex_);
+    return stats_;
+  }
+};
+
+#endif
+
+}  // namespace proginfo::procinfo
@@ -0,0 +1,109 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace proginfo::procinfo {
+
+/** A program image (the executable, or a shared library) loaded in memory. */
+struct Module {
+  std::string_view path;     // File it was loaded from (may not be a real file)
+  std::string_view buildId;  // Raw GNU build ID bytes, or empty if none
+  uintptr_t base;            // Load bias: runtime minus link-time address
+  uintptr_t start;           // Lowest address of its loaded segments
+  uintptr_t end;             // One past the highest
+
+  bool contains(uintptr_t addr) const { return addr >= start && addr < end; }
+
+  /** `addr` as a link-time address, i.e. comparable with symbol values. */
+  uintptr_t offset(uintptr_t addr) const { return addr - base; }
+};
+
+class MemorySource;
+
+/*
+Snapshot of the modules loaded in the current process (or, on Linux, some other
+process), sorted by address.
+
+Taking the snapshot (`refresh`) uses the platform's loader APIs and allocates
+from the given memory resource, so shouldn't be done in a signal handler; but
+lookups (`find`) only read the snapshot, so are signal-safe.  Modules loaded or
+unloaded afterwards aren't seen until the next `refresh`.
+
+Paths and build IDs point into the loader's own data and the loaded images, so
+they stay valid while the module remains loaded; for other processes, they're
+copies.
+*/
+class ModuleMap {
+  std::pmr::vector<Module> modules_;
+  char exePath_[4096] {};  // Main program's path, which the loader may not know
+  std::pmr::deque<std::pmr::string> strings_;  // For other processes' modules
+
+  void sort() {
+    std::sort(modules_.begin(), modules_.end(), [](auto& a, auto& b) {
+      return a.start < b.start;
+    });
+  }
+
+public:
+  explicit ModuleMap(
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : modules_(mr), strings_(mr) {}
+
+  ModuleMap(ModuleMap const&) = delete;
+  ModuleMap& operator=(ModuleMap const&) = delete;
+
+  /** Replace the snapshot with the currently-loaded modules. */
+  bool refresh();
+
+  /**
+  Replace the snapshot with the modules loaded in process `pid`, as listed in
+  its `/proc/PID/maps`, reading their headers from `memory` (e.g. a
+  `RemoteMemory`).  Paths and build IDs are copied, and owned by this map.
+  Linux only.
+  */
+  bool refresh(int pid, MemorySource& memory);
+
+  /** Add a module (e.g. one described by some other source). */
+  void add(Module const& mod) {
+    modules_.push_back(mod);
+    sort();
+  }
+
+  void clear() {
+    modules_.clear();
+    strings_.clear();
+  }
+
+  size_t size() const { return modules_.size(); }
+  Module const& operator[](size_t i) const { return modules_[i]; }
+  auto begin() const { return modules_.begin(); }
+  auto end() const { return modules_.end(); }
+
+  /** The module containing `addr`, or nullptr.  Signal-safe. */
+  Module const* find(uintptr_t addr) const {
+    auto it = std::upper_bound(
+        modules_.begin(), modules_.end(), addr, [](uintptr_t a, auto& m) {
+          return a < m.start;
+        });
+    if (it == modules_.begin()) { return nullptr; }
+    --it;
+    return it->contains(addr) ? &*it : nullptr;
+  }
+
+  /** Index of `mod` (which must be from this map), e.g. to key other tables. */
+  size_t indexOf(Module const* mod) const { return size_t(mod - &modules_[0]); }
+};
+
+}  // namespace proginfo::procinfo
+
+#if defined(__linux__)
+#include "Linux.h"
+#endif
@@ -0,0 +1,189 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "../symbolize/ProcessSymbols.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace proginfo::profile {
+
+/*
+Builds a CPU profile in pprof's format: a `perftools.profiles.Profile` protocol
+buffer (see `profile.proto` in github.com/google/pprof), serialized by hand.
+
+Each distinct PC becomes a `Location`, in the `Mapping` for its module; PCs
+with a known symbol get a `Line` referring to that symbol's `Function`, named
+with its demangled and mangled names.  No line numbers (yet).
+*/
+class Pprof {
+  /** Just enough protobuf encoding for the above. */
+  struct Writer {
+    std::string out;
+
+    void varint(uint64_t val) {
+      while (val >= 0x80) {
+        out += char(val | 0x80);
+        val >>= 7;
+      }
+      out += char(val);
+    }
+
+    void tag(unsigned field, unsigned wireType) {
+      varint(uint64_t(field) << 3 | wireType);
+    }
+
+    /** A varint field, left out if zero (the default). */
+    void u64(unsigned field, uint64_t val) {
+      if (!val) { return; }
+      tag(field, 0);
+      varint(val);
+    }
+
+    /** A length-delimited field: string, bytes, or message. */
+    void bytes(unsigned field, std::string_view val) {
+      tag(field, 2);
+      varint(val.size());
+      out += val;
+    }
+
+    void packed(unsigned field, std::vector<uint64_t> const& vals) {
+      Writer w;
+      for (auto val : vals) { w.varint(val); }
+      bytes(field, w.out);
+    }
+  };
+
+  // Field numbers, from `profile.proto`
+  enum : unsigned {
+    kSampleType = 1,
+    kSample = 2,
+    kMapping = 3,
+    kLocation = 4,
+    kFunction = 5,
+    kStringTable = 6,
+    kTimeNanos = 9,
+    kDurationNanos = 10,
+    kPeriodType = 11,
+    kPeriod = 12,
+  };
+
+  symbolize::ProcessSymbols const& symbols_;
+  uint64_t periodNanos_;
+  Writer body_;  // Samples, locations, functions, mappings
+  std::vector<std::string> strings_ {""};
+  std::unordered_map<std::string, uint64_t> stringIds_ {{"", 0}};
+  std::unordered_map<uintptr_t, uint64_t> locationIds_;
+  std::unordered_map<void const*, uint64_t> functionIds_;
+  std::vector<uint64_t> mappingIds_;  // By module index; 0 if none yet
+  uint64_t nextMapping_ {1};
+
+  uint64_t string(std::string_view str) {
+    auto [it, isNew] =
+        stringIds_.try_emplace(std::string(str), strings_.size());
+    if (isNew) { strings_.emplace_back(str); }
+    return it->second;
+  }
+
+  std::string valueType(std::string_view type, std::string_view unit) {
+    Writer w;
+    w.u64(1, string(type));
+    w.u64(2, string(unit));
+    return w.out;
+  }
+
+  uint64_t mapping(procinfo::Module const& mod) {
+    auto index = symbols_.modules().indexOf(&mod);
+    if (mappingIds_.size() <= index) { mappingIds_.resize(index + 1); }
+    auto& id = mappingIds_[index];
+    if (id) { return id; }
+    id = nextMapping_++;
+    std::string buildId;
+    for (char c : mod.buildId) {
+      buildId += "0123456789abcdef"[uint8_t(c) >> 4];
+      buildId += "0123456789abcdef"[uint8_t(c) & 15];
+    }
+    Writer w;
+    w.u64(1, id);
+    w.u64(2, mod.start);
+    w.u64(3, mod.end);
+    w.u64(5, string(mod.path));
+    w.u64(6, string(buildId));
+    w.u64(7, symbols_.symbols(mod) != nullptr);  // `has_functions`
+    body_.bytes(kMapping, w.out);
+    return id;
+  }
+
+  uint64_t function(symbolize::ProcessSymbols::Resolved const& res,
+                    uintptr_t pc,
+                    bool isReturn) {
+    auto [it, isNew] =
+        functionIds_.try_emplace(res.symbol, functionIds_.size() + 1);
+    if (!isNew) { return it->second; }
+    char buf[1024];
+    binary::DemangleSink name(buf, sizeof(buf));
+    symbols_.writeFrame(pc, isReturn, name);
+    Writer w;
+    w.u64(1, it->second);
+    w.u64(2, string(name.str()));
+    w.u64(3, string(res.symbol->name));
+    body_.bytes(kFunction, w.out);
+    return it->second;
+  }
+
+  uint64_t location(uintptr_t pc, bool isReturn) {
+    auto [it, isNew] = locationIds_.try_emplace(pc, locationIds_.size() + 1);
+    if (!isNew) { return it->second; }
+    auto res = symbols_.resolve(pc, isReturn);
+    Writer w;
+    w.u64(1, it->second);
+    if (res.module) { w.u64(2, mapping(*res.module)); }
+    w.u64(3, pc);
+    if (res.symbol) {
+      Writer line;
+      line.u64(1, function(res, pc, isReturn));
+      w.bytes(4, line.out);
+    }
+    body_.bytes(kLocation, w.out);
+    return it->second;
+  }
+
+public:
+  /** `symbols` must outlive this. */
+  Pprof(symbolize::ProcessSymbols const& symbols, uint64_t periodNanos)
+      : symbols_(symbols), periodNanos_(periodNanos) {}
+
+  /**
+  Add a stack (innermost first, as from `procinfo::backtrace`; the first is the
+  interrupted PC, the rest return addresses) seen `count` times.
+  */
+  void addSample(uintptr_t const* pcs, size_t depth, uint64_t count) {
+    std::vector<uint64_t> ids;
+    for (size_t i = 0; i < depth; i++) { ids.push_back(location(pcs[i], i)); }
+    Writer w;
+    w.packed(1, ids);
+    w.packed(2, {count, count * periodNanos_});
+    body_.bytes(kSample, w.out);
+  }
+
+  /** The serialized profile. */
+  std::string build(uint64_t timeNanos, uint64_t durationNanos) {
+    Writer w;
+    w.bytes(kSampleType, valueType("samples", "count"));
+    w.bytes(kSampleType, valueType("cpu", "nanoseconds"));
+    auto periodType = valueType("cpu", "nanoseconds");
+    w.out += body_.out;
+    for (auto& str : strings_) { w.bytes(kStringTable, str); }
+    w.u64(kTimeNanos, timeNanos);
+    w.u64(kDurationNanos, durationNanos);
+    w.bytes(kPeriodType, periodType);
+    w.u64(kPeriod, periodNanos_);
+    return w.out;
+  }
+};
+
+}  // namespace proginfo::profile
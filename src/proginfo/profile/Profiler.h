@@ -0,0 +1,433 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "../procinfo/Backtrace.h"
+#include "../symbolize/ProcessSymbols.h"
+#include "../symbolize/StackTable.h"
+#include "Pprof.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace proginfo::profile {
+
+/*
+In-process sampling CPU profiler (Linux).
+
+Samples come from `SIGPROF`, sent either by the process-wide CPU timer
+(`setitimer(ITIMER_PROF)`, which lands on whichever thread is running), or by
+per-thread `perf_event_open` task-clock events.  The handler walks the
+interrupted thread's stack (`procinfo::backtrace`, so frame pointers are
+needed) straight into that thread's ring buffer: a fixed-size, single-producer
+single-consumer queue, claimed by thread ID on the thread's first sample.  It
+doesn't allocate or lock; if a ring is full the sample is dropped.
+
+A background thread drains the rings every so often, counting samples by
+distinct stack in a `symbolize::StackTable` (keyed by `StackFingerprinter`), so
+memory use grows with the number of distinct stacks, not samples.  Symbols are
+only looked up when writing a profile, once per distinct stack (for `folded`)
+or PC (for `pprof`).
+
+All memory for samples is reserved by the constructor; `start` prepares symbols
+for the loaded modules (see `symbolize::ProcessSymbols`), so like that, it needs
+a `util::Alloc` on the calling thread.  Only one profiler can run at a time.
+*/
+class Profiler {
+public:
+  enum class Source {
+    kTimer,      // `ITIMER_PROF`: process CPU time
+    kPerfEvent,  // Per-thread task clock; falls back to `kTimer` if unavailable
+  };
+
+  struct Options {
+    Source source {Source::kTimer};
+    unsigned hz {99};              // Samples per second of CPU, per thread
+    size_t maxDepth {64};          // Frames per sample
+    size_t maxThreads {32};        // Threads which can have ring buffers
+    size_t ringSize {128};         // Samples per ring buffer
+    unsigned drainMillis {100};    // How often the background thread drains
+    size_t maxStacks {1 << 16};    // Distinct stacks
+    size_t stackBytes {16 << 20};  // For all the distinct stacks' PCs
+  };
+
+  struct Stats {
+    Source source {};     // What's actually used
+    uint64_t samples {};  // Taken by the signal handler
+    uint64_t lost {};     // Dropped because a ring was full
+    uint64_t noRing {};   // Dropped because too many threads had rings
+    uint64_t dropped {};  // Dropped because the stack table was full
+    uint64_t noStack {};  // Left out of profiles: no room for their PCs
+    size_t unique {};     // Distinct stacks
+    uint64_t drains {};
+    uint64_t drainNanos {};  // Total time spent draining
+  };
+
+private:
+  struct alignas(64) Ring {
+    std::atomic<pid_t> tid {};      // Owner; 0 if free
+    std::atomic<uint64_t> head {};  // Written only by the owner's handler
+    std::atomic<uint64_t> tail {};  // Written only by the drain thread
+  };
+
+  Options opts_;
+  size_t stride_;  // Words per sample: depth, then PCs
+  std::unique_ptr<Ring[]> rings_;
+  std::unique_ptr<uintptr_t[]> slots_;
+  symbolize::ProcessSymbols symbols_;
+  std::unique_ptr<symbolize::StackFingerprinter> fingerprinter_;
+  symbolize::StackTable stacks_;  // Text is the stack's PCs, as raw bytes
+  std::vector<int> perfFds_;
+  Source source_ {};
+  struct sigaction oldAction_ {};
+  bool running_ {};
+  std::chrono::steady_clock::time_point startTime_;
+  uint64_t startNanos_ {};  // Wall clock, for pprof
+  uint64_t durationNanos_ {};
+
+  std::thread drainer_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stopping_ {};
+
+  std::atomic<uint64_t> samples_ {};
+  std::atomic<uint64_t> lost_ {};
+  std::atomic<uint64_t> noRing_ {};
+  std::atomic<uint64_t> drains_ {};
+  std::atomic<uint64_t> drainNanos_ {};
+
+  static inline std::atomic<Profiler*> current_ {};
+
+  static pid_t gettid() { return pid_t(syscall(SYS_gettid)); }
+
+  static void onSignal(int, siginfo_t* info, void* context) {
+    auto savedErrno = errno;
+    if (auto* self = current_.load(std::memory_order_acquire)) {
+      self->sample(context);
+      if (self->source_ == Source::kPerfEvent && info->si_code == POLL_HUP) {
+        // Re-arm for the next period
+        ioctl(info->si_fd, PERF_EVENT_IOC_REFRESH, 1);
+      }
+    }
+    errno = savedErrno;
+  }
+
+  /** This thread's ring, claiming a free one if it has none yet. */
+  Ring* ring(pid_t tid) {
+    for (size_t i = 0; i < opts_.maxThreads; i++) {
+      if (rings_[i].tid.load(std::memory_order_acquire) == tid) {
+        return &rings_[i];
+      }
+    }
+    for (size_t i = 0; i < opts_.maxThreads; i++) {
+      pid_t free = 0;
+      if (rings_[i].tid.compare_exchange_strong(free, tid)) {
+        return &rings_[i];
+      }
+    }
+    return nullptr;
+  }
+
+  void sample(void* context) {
+    samples_.fetch_add(1, std::memory_order_relaxed);
+    auto* r = ring(gettid());
+    if (!r) {
+      noRing_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    auto head = r->head.load(std::memory_order_relaxed);
+    if (head - r->tail.load(std::memory_order_acquire) >= opts_.ringSize) {
+      lost_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    auto* slot = slotOf(*r, head);
+    auto regs = procinfo::Registers::fromContext(context);
+    slot[0] = procinfo::backtrace(regs, slot + 1, opts_.maxDepth);
+    r->head.store(head + 1, std::memory_order_release);
+  }
+
+  uintptr_t* slotOf(Ring const& r, uint64_t n) const {
+    auto ringIndex = size_t(&r - rings_.get());
+    auto slot = ringIndex * opts_.ringSize + size_t(n % opts_.ringSize);
+    return slots_.get() + slot * stride_;
+  }
+
+  /** Move everything in the rings into `stacks_`. */
+  void drain() {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < opts_.maxThreads; i++) {
+      auto& r = rings_[i];
+      auto tid = r.tid.load(std::memory_order_acquire);
+      if (!tid) { continue; }
+      auto head = r.head.load(std::memory_order_acquire);
+      auto tail = r.tail.load(std::memory_order_relaxed);
+      for (; tail != head; ++tail) {
+        auto* slot = slotOf(r, tail);
+        auto depth = size_t(slot[0]);
+        auto added = stacks_.add((*fingerprinter_)(slot + 1, depth));
+        if (added.isNew) {
+          std::string_view pcs((char const*) (slot + 1),
+                               depth * sizeof(uintptr_t));
+          stacks_.publish(*added.entry, pcs);
+        }
+      }
+      r.tail.store(tail, std::memory_order_release);
+      // Free the rings of threads which have exited
+      if (syscall(SYS_tgkill, getpid(), tid, 0) && errno == ESRCH &&
+          r.head.load(std::memory_order_acquire) == tail) {
+        r.tid.compare_exchange_strong(tid, 0);
+      }
+    }
+    drains_.fetch_add(1, std::memory_order_relaxed);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    drainNanos_.fetch_add(nanos(elapsed), std::memory_order_relaxed);
+  }
+
+  void drainLoop() {
+    // Don't sample the profiler itself
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPROF);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+    std::unique_lock lock(mutex_);
+    while (!stopping_) {
+      wake_.wait_for(lock, std::chrono::milliseconds(opts_.drainMillis));
+      drain();
+    }
+  }
+
+  uint64_t periodNanos() const {
+    return 1000000000ull / std::max(opts_.hz, 1u);
+  }
+
+  template <class Duration>
+  static uint64_t nanos(Duration duration) {
+    using std::chrono::duration_cast;
+    using std::chrono::nanoseconds;
+    return uint64_t(duration_cast<nanoseconds>(duration).count());
+  }
+
+  /**
+  Sample thread `tid` with a perf task-clock event; false if we can't, with
+  `errno` saying why (`ESRCH` if the thread has exited).
+  */
+  bool openPerfEvent(pid_t tid) {
+    perf_event_attr attr {};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.config = PERF_COUNT_SW_TASK_CLOCK;
+    attr.sample_period = periodNanos();
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    auto fd = int(syscall(
+        SYS_perf_event_open, &attr, tid, -1, -1, PERF_FLAG_FD_CLOEXEC));
+    if (fd < 0) { return false; }
+    f_owner_ex owner {F_OWNER_TID, tid};
+    if (fcntl(fd, F_SETFL, O_ASYNC | O_NONBLOCK) ||
+        fcntl(fd, F_SETSIG, SIGPROF) ||
+        fcntl(fd, F_SETOWN_EX, &owner) ||
+        ioctl(fd, PERF_EVENT_IOC_REFRESH, 1)) {
+      auto err = errno;
+      close(fd);
+      errno = err;
+      return false;
+    }
+    perfFds_.push_back(fd);
+    return true;
+  }
+
+  /** Open events for all the process's current threads. */
+  bool openPerfEvents() {
+    auto* dir = opendir("/proc/self/task");
+    if (!dir) { return false; }
+    bool ok = true;
+    while (auto* ent = readdir(dir)) {
+      if (ent->d_name[0] == '.') { continue; }
+      // Threads exiting meanwhile don't need sampling
+      if (!openPerfEvent(pid_t(atoi(ent->d_name))) && errno != ESRCH) {
+        ok = false;
+      }
+    }
+    closedir(dir);
+    return ok && !perfFds_.empty();
+  }
+
+  void closePerfEvents() {
+    for (auto fd : perfFds_) {
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      close(fd);
+    }
+    perfFds_.clear();
+  }
+
+  void setTimer(uint64_t nanos) {
+    itimerval timer {};
+    timer.it_interval.tv_sec = time_t(nanos / 1000000000);
+    timer.it_interval.tv_usec = suseconds_t(nanos % 1000000000 / 1000);
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+  }
+
+  /** Distinct stacks (their PCs, innermost first) and counts, most first. */
+  std::vector<std::pair<std::vector<uintptr_t>, uint64_t>> stacks() const {
+    std::vector<std::pair<std::vector<uintptr_t>, uint64_t>> ret;
+    stacks_.each([&](auto& entry) {
+      auto text = stacks_.text(entry);
+      if (text.empty()) { return; }  // Not published yet, or see `noStack`
+      std::vector<uintptr_t> pcs(text.size() / sizeof(uintptr_t));
+      memcpy(pcs.data(), text.data(), pcs.size() * sizeof(uintptr_t));
+      ret.emplace_back(std::move(pcs), entry.count());
+    });
+    std::sort(ret.begin(), ret.end(), [](auto& a, auto& b) {
+      return a.second > b.second;
+    });
+    return ret;
+  }
+
+public:
+  explicit Profiler(Options const& opts)
+      : opts_(opts)
+      , stride_(1 + opts.maxDepth)
+      , rings_(std::make_unique<Ring[]>(opts.maxThreads))
+      , slots_(std::make_unique<uintptr_t[]>(
+            opts.maxThreads * opts.ringSize * stride_))
+      , stacks_(opts.maxStacks, opts.stackBytes) {}
+
+  Profiler() : Profiler(Options {}) {}
+
+  ~Profiler() { stop(); }
+
+  Profiler(Profiler const&) = delete;
+  Profiler& operator=(Profiler const&) = delete;
+
+  /** Start sampling; false if another profiler is running. */
+  bool start() {
+    Profiler* expected = nullptr;
+    if (!current_.compare_exchange_strong(expected, this)) { return false; }
+    symbols_.refresh();
+    fingerprinter_ =
+        std::make_unique<symbolize::StackFingerprinter>(symbols_.modules());
+
+    struct sigaction sa {};
+    sa.sa_sigaction = onSignal;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGPROF, &sa, &oldAction_);
+
+    running_ = true;
+    stopping_ = false;
+    startTime_ = std::chrono::steady_clock::now();
+    startNanos_ = nanos(std::chrono::system_clock::now().time_since_epoch());
+
+    // Before the drainer starts, so it isn't sampled
+    source_ = opts_.source;
+    if (source_ == Source::kPerfEvent && !openPerfEvents()) {
+      closePerfEvents();
+      source_ = Source::kTimer;
+    }
+    drainer_ = std::thread([this] { drainLoop(); });
+    if (source_ == Source::kTimer) { setTimer(periodNanos()); }
+    return true;
+  }
+
+  /**
+  With `Source::kPerfEvent`, threads started after `start` aren't sampled
+  unless they call this.  Returns false if that didn't work (or isn't needed).
+  */
+  bool addThread() {
+    if (!running_ || source_ != Source::kPerfEvent) { return false; }
+    std::lock_guard lock(mutex_);
+    return openPerfEvent(gettid());
+  }
+
+  /** Stop sampling, and drain what's left.  The results remain. */
+  void stop() {
+    if (!running_) { return; }
+    if (source_ == Source::kTimer) { setTimer(0); }
+    {
+      std::lock_guard lock(mutex_);
+      closePerfEvents();
+      stopping_ = true;
+    }
+    wake_.notify_all();
+    drainer_.join();
+    sigaction(SIGPROF, &oldAction_, nullptr);
+    drain();
+    durationNanos_ = nanos(std::chrono::steady_clock::now() - startTime_);
+    running_ = false;
+    current_ = nullptr;
+  }
+
+  Stats stats() const {
+    Stats ret;
+    ret.source = source_;
+    ret.samples = samples_.load(std::memory_order_relaxed);
+    ret.lost = lost_.load(std::memory_order_relaxed);
+    ret.noRing = noRing_.load(std::memory_order_relaxed);
+    auto table = stacks_.stats();
+    ret.dropped = table.dropped;
+    ret.unique = table.unique;
+    stacks_.each([&](auto& entry) {
+      if (stacks_.isPublished(entry) && stacks_.text(entry).empty()) {
+        ret.noStack += entry.count();
+      }
+    });
+    ret.drains = drains_.load(std::memory_order_relaxed);
+    ret.drainNanos = drainNanos_.load(std::memory_order_relaxed);
+    return ret;
+  }
+
+  symbolize::ProcessSymbols const& symbols() const { return symbols_; }
+
+  /**
+  The profile in "folded" form, as taken by `flamegraph.pl` and similar: a line
+  per distinct stack, with its frames (outermost first, separated by `;`), a
+  space, and its sample count.
+  */
+  std::string folded() const {
+    std::string ret;
+    char buf[4096];
+    for (auto& [pcs, count] : stacks()) {
+      binary::DemangleSink out(buf, sizeof(buf));
+      symbols_.writeFolded(pcs.data(), pcs.size(), false, out);
+      ret += out.str();
+      ret += ' ';
+      ret += std::to_string(count);
+      ret += '\n';
+    }
+    return ret;
+  }
+
+  /**
+  The profile as a (serialized, uncompressed) pprof `Profile` protobuf, with
+  sample counts and CPU time.  `pprof` accepts this as-is, or gzipped.
+  */
+  std::string pprof() const {
+    Pprof builder(symbols_, periodNanos());
+    for (auto& [pcs, count] : stacks()) {
+      builder.addSample(pcs.data(), pcs.size(), count);
+    }
+    return builder.build(startNanos_, durationNanos_);
+  }
+};
+
+}  // namespace proginfo::profile
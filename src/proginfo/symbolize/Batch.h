@@ -0,0 +1,246 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "../binary/Binary.h"
+#include "../binary/elf/Notes.h"
+#include "../util/Alloc.h"
+#include "../util/MMap.h"
+#include "../util/ThreadPool.h"
+#include "SymbolIndex.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace proginfo::symbolize {
+
+/** An address to symbolize, relative to the binary (like symbol values). */
+struct Request {
+  std::string_view module;  // Hex build ID, or the key given to `addBinary`
+  uintptr_t addr;
+};
+
+struct Frame {
+  std::string_view symbol;  // Empty if not found
+  uintptr_t offset;         // `addr` minus the symbol's address
+};
+
+struct BatchStats {
+  size_t requests {};
+  size_t resolved {};
+  size_t unknownModule {};  // Requests for modules which weren't added
+  size_t modules {};        // Distinct modules in this batch
+  size_t indexed {};        // Modules whose indexes were built for this batch
+  size_t chunks {};
+  size_t steals {};
+  uint64_t indexNanos {};  // Wall time spent building indexes
+  uint64_t totalNanos {};
+  uint64_t chunkP50Nanos {};
+  uint64_t chunkP99Nanos {};
+  uint64_t chunkMaxNanos {};
+
+  double perSecond() const {
+    return totalNanos ? double(requests) * 1e9 / double(totalNanos) : 0;
+  }
+};
+
+/*
+Symbolizes large batches of addresses, across many binaries, on a pool of
+threads.
+
+Binaries are added up front (`addBinary`), keyed by build ID; each is mapped and
+parsed once, and its `SymbolIndex` built the first time a batch needs it.
+`resolve` groups a batch's requests by binary, and splits each group into chunks
+which are spread across a work-stealing `ThreadPool`.
+
+Symbol names in the results point into the mapped binaries, so they're valid for
+as long as this object.  This is for offline use; it uses the heap and isn't
+signal-safe.
+*/
+class Batch {
+  constexpr static size_t kChunk = 4096;
+
+  struct Module {
+    std::string key;
+    util::MMap mm;
+    util::Virtual<binary::Binary> bin;
+    SymbolIndex index;
+    bool indexed {};
+
+    // Symbol lookups jump around; prefer not to read ahead
+    explicit Module(std::string_view path)
+        : mm(path, {.advice = util::MMap::Advice::kRandom}) {}
+
+    /** Fault in the sections the index is built from, all in one go. */
+    void prefault() {
+      for (auto name : {".symtab", ".strtab"}) {
+        if (auto sec = bin->section(name)) {
+          mm.prefault(sec->fileOffset(), sec->size());
+        }
+      }
+    }
+  };
+
+  util::ThreadPool pool_;
+  std::vector<std::unique_ptr<Module>> modules_;
+  std::unordered_map<std::string_view, size_t> byKey_;
+
+  using Clock = std::chrono::steady_clock;
+
+  static uint64_t nanosSince(Clock::time_point start) {
+    using std::chrono::nanoseconds;
+    auto elapsed = Clock::now() - start;
+    return uint64_t(std::chrono::duration_cast<nanoseconds>(elapsed).count());
+  }
+
+  /** Hex-encoded GNU build ID of the binary, or empty if it has none. */
+  static std::string buildId(binary::Binary const& bin) {
+    std::string ret;
+    for (char c : binary::buildId(bin)) {
+      auto byte = uint8_t(c);
+      ret += "0123456789abcdef"[byte >> 4];
+      ret += "0123456789abcdef"[byte & 15];
+    }
+    return ret;
+  }
+
+  static void lookup(Module const& mod,
+                     Request const* reqs,
+                     size_t const* order,
+                     size_t n,
+                     Frame* out) {
+    for (size_t i = 0; i < n; i++) {
+      auto r = order[i];
+      auto* e = mod.index.lookup(reqs[r].addr);
+      out[r] = e ? Frame {e->name, reqs[r].addr - e->addr} : Frame {{}, 0};
+    }
+  }
+
+public:
+  explicit Batch(unsigned threads = std::thread::hardware_concurrency())
+      : pool_(threads) {}
+
+  Batch(Batch const&) = delete;
+  Batch& operator=(Batch const&) = delete;
+
+  /**
+  Map and parse the binary at `path`, and make it available under `key`; or if
+  `key` is empty, under its build ID. Returns the key used, or empty if the
+  binary couldn't be loaded, or had no build ID and no key was given.  Like
+  other `Binary` operations, this needs a `util::Alloc` on the calling thread.
+  */
+  std::string_view addBinary(std::string_view path, std::string_view key = {}) {
+    auto mod = std::make_unique<Module>(path);
+    if (!mod->mm) { return {}; }
+    // The binary might be used (and eventually destroyed) on any worker thread
+    mod->bin = binary::Binary::at(
+        mod->mm.addr_,
+        mod->mm.size_,
+        false,
+        false,
+        std::pmr::new_delete_resource());
+    if (!mod->bin) { return {}; }
+    mod->key = key.empty() ? buildId(*mod->bin) : std::string(key);
+    if (mod->key.empty() || byKey_.count(mod->key)) { return {}; }
+    byKey_[mod->key] = modules_.size();
+    modules_.push_back(std::move(mod));
+    return modules_.back()->key;
+  }
+
+  size_t moduleCount() const { return modules_.size(); }
+
+  /** Resolve each of the `n` requests into the corresponding `out` element. */
+  BatchStats resolve(Request const* reqs, size_t n, Frame* out) {
+    BatchStats stats;
+    stats.requests = n;
+    auto start = Clock::now();
+    auto steals = pool_.steals();
+
+    // Group requests by module, with a counting sort; `order` holds request
+    // indexes, module by module, and `groupStart[m]` is where module m's begin.
+    constexpr auto kUnknown = ~size_t(0);
+    std::vector<size_t> moduleOf(n);
+    std::vector<size_t> groupStart(modules_.size() + 1);
+    for (size_t i = 0; i < n; i++) {
+      auto it = byKey_.find(reqs[i].module);
+      moduleOf[i] = (it == byKey_.end()) ? kUnknown : it->second;
+      if (moduleOf[i] == kUnknown) {
+        out[i] = {{}, 0};
+        ++stats.unknownModule;
+      } else {
+        ++groupStart[moduleOf[i] + 1];
+      }
+    }
+    for (size_t m = 0; m < modules_.size(); m++) {
+      groupStart[m + 1] += groupStart[m];
+    }
+    std::vector<size_t> order(groupStart.back());
+    {
+      auto next = groupStart;
+      for (size_t i = 0; i < n; i++) {
+        if (moduleOf[i] != kUnknown) { order[next[moduleOf[i]]++] = i; }
+      }
+    }
+
+    // Build any indexes we're missing, in parallel
+    auto indexStart = Clock::now();
+    for (size_t m = 0; m < modules_.size(); m++) {
+      if (groupStart[m] == groupStart[m + 1]) { continue; }
+      ++stats.modules;
+      auto& mod = *modules_[m];
+      if (mod.indexed) { continue; }
+      ++stats.indexed;
+      pool_.submit([&mod] {
+        util::Alloc alloc;
+        mod.prefault();
+        mod.index.build(*mod.bin);
+        mod.indexed = true;
+      });
+    }
+    pool_.wait();
+    stats.indexNanos = nanosSince(indexStart);
+
+    // Look everything up, in chunks
+    std::vector<uint64_t> chunkNanos;
+    for (size_t m = 0; m < modules_.size(); m++) {
+      for (auto i = groupStart[m]; i < groupStart[m + 1]; i += kChunk) {
+        chunkNanos.push_back(0);
+      }
+    }
+    size_t chunk = 0;
+    for (size_t m = 0; m < modules_.size(); m++) {
+      auto& mod = *modules_[m];
+      for (auto i = groupStart[m]; i < groupStart[m + 1]; i += kChunk) {
+        auto count = std::min(kChunk, groupStart[m + 1] - i);
+        auto* nanos = &chunkNanos[chunk++];
+        pool_.submit([&mod, reqs, out, nanos, ord = &order[i], count] {
+          auto chunkStart = Clock::now();
+          lookup(mod, reqs, ord, count, out);
+          *nanos = nanosSince(chunkStart);
+        });
+      }
+    }
+    pool_.wait();
+
+    for (size_t i = 0; i < n; i++) { stats.resolved += !out[i].symbol.empty(); }
+    stats.chunks = chunkNanos.size();
+    if (!chunkNanos.empty()) {
+      std::sort(chunkNanos.begin(), chunkNanos.end());
+      stats.chunkP50Nanos = chunkNanos[chunkNanos.size() / 2];
+      stats.chunkP99Nanos = chunkNanos[chunkNanos.size() * 99 / 100];
+      stats.chunkMaxNanos = chunkNanos.back();
+    }
+    stats.steals = pool_.steals() - steals;
+    stats.totalNanos = nanosSince(start);
+    return stats;
+  }
+};
+
+}  // namespace proginfo::symbolize
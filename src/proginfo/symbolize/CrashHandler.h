@@ -0,0 +1,292 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "../binary/Demangle.h"
+#include "../procinfo/Backtrace.h"
+#include "../util/FdWriter.h"
+#include "ProcessSymbols.h"
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <pthread.h>
+#include <string_view>
+#include <unistd.h>
+
+namespace proginfo::symbolize {
+
+/*
+Writes a symbolized stack trace to a file descriptor when the program crashes
+(`SIGSEGV`, `SIGABRT`, `SIGBUS`, `SIGILL`, `SIGFPE`).
+
+Everything which can't be done safely in a signal handler is done up front, by
+the constructor: it prepares the loaded modules' symbols (`ProcessSymbols`), and
+reserves the alternate signal stack (so stack overflows can be reported too),
+the frame buffer, and the demangler's scratch space.  The handler itself then
+just walks the stack (see `procinfo::backtrace`), looks up and demangles each
+frame's symbol, and formats it with `util::FdWriter`: no heap, no stdio, no
+locks.
+
+Afterwards the previous handler is restored and the signal repeated, so the
+process still dies (or dumps core, or runs any other handler) as it would have.
+If several threads crash at once, only the first reports; the others wait for it
+to finish killing the process.
+
+Output looks like:
+
+  *** SIGSEGV (signal 11), fault address 0x0 ***
+  #0  0x000055d1a2b3c1a9 in (anonymous namespace)::crash()+0x19 (/bin/x+0x11a9)
+  #1  0x000055d1a2b3c1d4 in main+0x14 (/bin/x+0x11d4)
+
+Modules loaded after construction aren't symbolized (their frames show just the
+address); nor are frames in binaries without a `.symtab`. Construct this with a
+`util::Alloc` on the calling thread, like `Batch::addBinary`.
+*/
+class CrashHandler {
+public:
+  struct Options {
+    int fd {2};                  // Where to write; must stay open
+    size_t maxFrames {64};       // Frames to report, at most
+    size_t maxName {1024};       // Longer demangled names are truncated
+    size_t scratch {16 << 10};   // Demangler's scratch space
+    size_t altStack {64 << 10};  // Alternate signal stack; 0 for none
+  };
+
+private:
+  constexpr static int kSignals[] = {SIGSEGV, SIGABRT, SIGBUS, SIGILL, SIGFPE};
+  constexpr static size_t kNumSignals = sizeof(kSignals) / sizeof(int);
+
+  Options opts_;
+  ProcessSymbols symbols_;
+  std::unique_ptr<uintptr_t[]> frames_;
+  std::unique_ptr<char[]> name_;
+  std::unique_ptr<std::byte[]> scratch_;
+  std::unique_ptr<std::byte[]> altStack_;
+  size_t altStackSize_ {};
+  struct sigaction oldActions_[kNumSignals] {};
+  stack_t oldAltStack_ {};
+  bool installed_ {};
+
+  static inline std::atomic<CrashHandler*> current_ {};
+  static inline std::atomic<bool> busy_ {};
+  static inline pthread_t owner_ {};  // Thread which set `busy_`
+
+  static std::string_view signalName(int sig) {
+    switch (sig) {
+    case SIGSEGV: return "SIGSEGV";
+    case SIGABRT: return "SIGABRT";
+    case SIGBUS:  return "SIGBUS";
+    case SIGILL:  return "SIGILL";
+    case SIGFPE:  return "SIGFPE";
+    default:      return "signal";
+    }
+  }
+
+  void restoreActions() {
+    for (size_t i = 0; i < kNumSignals; i++) {
+      sigaction(kSignals[i], &oldActions_[i], nullptr);
+    }
+  }
+
+  static void onSignal(int sig, siginfo_t* info, void* context) {
+    auto* self = current_.load();
+    if (busy_.exchange(true)) {
+      if (!pthread_equal(owner_, pthread_self())) {
+        // Some other thread is already reporting, and will end the process
+        while (true) { pause(); }
+      }
+      // We crashed while reporting; give up, and let the signal through
+    } else {
+      owner_ = pthread_self();
+      if (self) {
+        self->report(sig, info, procinfo::Registers::fromContext(context));
+      }
+    }
+    if (self) {
+      self->restoreActions();
+    } else {
+      signal(sig, SIG_DFL);
+    }
+    // A fault will just happen again when we return, now going to the previous
+    // handler, with the right details.  Otherwise (e.g. `abort`) send it again;
+    // handlers run with `SA_NODEFER`, so it's delivered right away.
+    if (info->si_code <= 0) { raise(sig); }
+  }
+
+  void report(int sig, siginfo_t const* info, procinfo::Registers const& regs) {
+    util::FdWriter out(opts_.fd);
+    out.put("*** ").put(signalName(sig)).put(" (signal ").putDec(unsigned(sig));
+    out.put(')');
+    if (sig != SIGABRT) {
+      out.put(", fault address ").putHex(uintptr_t(info->si_addr));
+    }
+    out.put(" ***\n");
+    writeTrace(out, regs);
+  }
+
+  /**
+  Look for a frame record on the stack above `sp`: a word pointing further up
+  the stack, to a saved frame pointer and a return address into some module.
+  Code without frame pointers still saves the caller's (as it's callee-saved)
+  if it uses that register, so this usually finds the innermost frame which
+  has one.  Returns its address, or 0.
+  */
+  uintptr_t findFrame(uintptr_t sp) const {
+    constexpr size_t kScan = 64 << 10;
+    constexpr size_t kWord = sizeof(uintptr_t);
+    uintptr_t words[64];
+    auto addr = sp - sp % kWord;
+    for (auto end = addr + kScan; addr < end; addr += sizeof(words)) {
+      if (!procinfo::readMemory(addr, words, sizeof(words))) { return 0; }
+      for (size_t i = 0; i < 64; i++) {
+        auto at = addr + i * kWord;
+        auto fp = words[i];
+        if (fp <= at || fp - at > kScan || fp % kWord) { continue; }
+        uintptr_t frame[2];
+        if (!procinfo::readMemory(fp, frame, sizeof(frame))) { continue; }
+        if (frame[0] && frame[0] <= fp) { continue; }
+        if (symbols_.modules().find(frame[1] - 1)) { return fp; }
+      }
+    }
+    return 0;
+  }
+
+  /**
+  The return address into the function whose frame record is at `fp`, from
+  whatever (frame-pointer-less) function it called: the nearest word below
+  its frame which points into a module.  0 if there's none after `sp`.
+  */
+  uintptr_t findReturn(uintptr_t sp, uintptr_t fp) const {
+    constexpr size_t kMaxWords = 512;
+    auto addr = fp;
+    for (size_t i = 0; i < kMaxWords && addr - sp >= sizeof(uintptr_t); i++) {
+      addr -= sizeof(uintptr_t);
+      uintptr_t word;
+      if (!procinfo::readMemory(addr, &word, sizeof(word))) { break; }
+      if (symbols_.modules().find(word - 1)) { return word; }
+    }
+    return 0;
+  }
+
+  void writeName(util::FdWriter& out, std::string_view name) {
+    binary::DemangleSink sink(name_.get(), opts_.maxName);
+    binary::Demangler demangler(scratch_.get(), opts_.scratch);
+    if (!demangler.demangle(name, sink)) {
+      out.put(name);
+      return;
+    }
+    sink.finish();
+    out.put(sink.str());
+    if (sink.truncated()) { out.put("..."); }
+  }
+
+public:
+  explicit CrashHandler(Options const& opts) : opts_(opts) {
+    frames_ = std::make_unique<uintptr_t[]>(opts_.maxFrames);
+    name_ = std::make_unique<char[]>(std::max<size_t>(opts_.maxName, 1));
+    scratch_ = std::make_unique<std::byte[]>(opts_.scratch);
+    if (opts_.altStack) {
+      altStackSize_ = std::max(opts_.altStack, size_t(SIGSTKSZ));
+      altStack_ = std::make_unique<std::byte[]>(altStackSize_);
+    }
+
+    symbols_.refresh();
+
+    // Resolve (lazily-bound) functions the handler calls, so it doesn't need
+    // the dynamic linker, which takes locks
+    uintptr_t probe;
+    procinfo::readMemory(uintptr_t(&probe), &probe, sizeof(probe));
+    [[maybe_unused]] auto n = ::write(opts_.fd, "", 0);
+    (void) pthread_self();
+  }
+
+  CrashHandler() : CrashHandler(Options {}) {}
+
+  ~CrashHandler() { uninstall(); }
+
+  CrashHandler(CrashHandler const&) = delete;
+  CrashHandler& operator=(CrashHandler const&) = delete;
+
+  /**
+  Install the signal handlers, and the alternate stack for the calling thread
+  (other threads won't have one unless they call `sigaltstack` themselves).
+  Only one `CrashHandler` can be installed at a time; returns false if another
+  one is.
+  */
+  bool install() {
+    CrashHandler* expected = nullptr;
+    if (!current_.compare_exchange_strong(expected, this)) {
+      return expected == this;
+    }
+    if (altStack_) {
+      stack_t ss {};
+      ss.ss_sp = altStack_.get();
+      ss.ss_size = altStackSize_;
+      sigaltstack(&ss, &oldAltStack_);
+    }
+    struct sigaction sa {};
+    sa.sa_sigaction = onSignal;
+    sa.sa_flags = SA_SIGINFO | SA_ONSTACK | SA_NODEFER;
+    sigemptyset(&sa.sa_mask);
+    for (size_t i = 0; i < kNumSignals; i++) {
+      sigaction(kSignals[i], &sa, &oldActions_[i]);
+    }
+    installed_ = true;
+    return true;
+  }
+
+  /** Restore the previous handlers (and the calling thread's alt stack). */
+  void uninstall() {
+    if (!installed_) { return; }
+    restoreActions();
+    if (altStack_) { sigaltstack(&oldAltStack_, nullptr); }
+    installed_ = false;
+    current_ = nullptr;
+  }
+
+  ProcessSymbols const& symbols() const { return symbols_; }
+
+  /**
+  Write the stack trace starting at `regs` to `out`, as the handler does.
+  This is signal-safe but not thread-safe (it uses this object's buffers).
+  */
+  void writeTrace(util::FdWriter& out, procinfo::Registers const& regs) {
+    auto count = procinfo::backtrace(regs, frames_.get(), opts_.maxFrames);
+    if (count < 2 && count < opts_.maxFrames) {
+      // Probably stopped in code without frame pointers (e.g. `abort` in libc)
+      if (auto fp = findFrame(regs.sp)) {
+        if (auto ret = findReturn(regs.sp, fp)) { frames_[count++] = ret; }
+        count += procinfo::backtrace(
+            {0, fp, fp}, frames_.get() + count, opts_.maxFrames - count);
+      }
+    }
+    for (size_t i = 0; i < count; i++) {
+      auto pc = frames_[i];
+      out.put('#').putDec(i).put(i < 10 ? "  " : " ");
+      out.putHex(pc, 2 * sizeof(uintptr_t));
+      if (auto res = symbols_.resolve(pc, i || !regs.pc); res.module) {
+        if (res.symbol) {
+          out.put(" in ");
+          writeName(out, res.symbol->name);
+          out.put('+').putHex(res.symbolOffset);
+        }
+        out.put(" (").put(res.module->path).put('+').putHex(res.moduleOffset);
+        out.put(')');
+      }
+      out.put('\n');
+    }
+    out.flush();
+  }
+
+  /** Write the current thread's stack trace to the configured fd. */
+  [[gnu::noinline]] void writeTrace() {
+    util::FdWriter out(opts_.fd);
+    auto fp = uintptr_t(__builtin_frame_address(0));
+    writeTrace(out, {0, fp, fp});
+  }
+};
+
+}  // namespace proginfo::symbolize
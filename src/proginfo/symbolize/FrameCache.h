@@ -0,0 +1,251 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "../util/Stats.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace proginfo::symbolize {
+
+/** An inlined function that an address's code is in, and where in it. */
+struct InlinedFrame {
+  std::string function;
+  std::string file;
+  uint32_t line {};
+};
+
+/** An address, fully symbolized: what a `FrameCache` holds. */
+struct ResolvedFrame {
+  std::string symbol;   // Empty if not found
+  uintptr_t offset {};  // From the symbol's address
+  std::string file;     // Empty if not known
+  uint32_t line {};
+  std::vector<InlinedFrame> inlined;  // Innermost first
+
+  /** About how much memory this takes. */
+  size_t bytes() const {
+    auto ret = sizeof(*this) + symbol.capacity() + file.capacity() +
+               inlined.capacity() * sizeof(InlinedFrame);
+    for (auto& f : inlined) {
+      ret += f.function.capacity() + f.file.capacity();
+    }
+    return ret;
+  }
+};
+
+struct FrameCacheStats {
+  uint64_t hits {};
+  uint64_t misses {};
+  uint64_t inserts {};
+  uint64_t evictions {};
+  size_t entries {};
+  size_t bytes {};  // Of entries, including the cache's own overhead
+
+  double hitRate() const {
+    return hits + misses ? double(hits) / double(hits + misses) : 0;
+  }
+};
+
+/*
+A bounded cache of symbolized addresses, keyed by module (build ID) and
+offset, so repeatedly symbolizing the same addresses (as when tracing the
+same code paths over and over) costs a hash lookup.
+
+Memory is bounded: each of the shards gets an equal share of `maxBytes`, and
+evicts its least recently used entries to stay within it.  Shards each have
+their own lock, so threads mostly don't contend.  Entries are immutable and
+shared: what `get` returns stays valid even if it's evicted meanwhile.
+
+Build IDs are interned into small module numbers (once each; they're never
+evicted), which callers can keep to skip hashing the ID on each lookup.
+This is for services; it uses the heap and locks, so isn't signal-safe.
+*/
+class FrameCache {
+public:
+  using Frame = std::shared_ptr<ResolvedFrame const>;
+
+private:
+  struct Key {
+    uint32_t module;
+    uint64_t offset;
+
+    bool operator==(Key const& rhs) const {
+      return module == rhs.module && offset == rhs.offset;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(Key const& key) const {
+      auto h = (key.offset ^ (uint64_t(key.module) << 40)) *
+               0x9e3779b97f4a7c15ull;
+      return size_t(h ^ (h >> 29));
+    }
+  };
+
+  struct Node {
+    Key key;
+    Frame frame;
+    size_t bytes;
+  };
+
+  // Per entry, besides the frame: its list node, and hash map node and bucket
+  constexpr static size_t kOverhead = sizeof(Node) + 6 * sizeof(void*);
+
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    std::list<Node> lru;  // Most recently used first
+    std::unordered_map<Key, std::list<Node>::iterator, KeyHash> map;
+    size_t bytes {};
+    uint64_t hits {};
+    uint64_t misses {};
+    uint64_t inserts {};
+    uint64_t evictions {};
+  };
+
+  size_t const shardBytes_;
+  unsigned const shardCount_;
+  std::unique_ptr<Shard[]> shards_;
+
+  std::shared_mutex modulesMutex_;
+  std::deque<std::string> moduleIds_;  // Keys of `modules_`
+  std::unordered_map<std::string_view, uint32_t> modules_;
+
+  Shard& shardOf(Key const& key) const {
+    return shards_[(KeyHash()(key) >> 16) % shardCount_];
+  }
+
+  /** Drop least recently used entries until `shard` is within budget. */
+  void trim(Shard& shard) {
+    while (shard.bytes > shardBytes_ && !shard.lru.empty()) {
+      auto& last = shard.lru.back();
+      shard.bytes -= last.bytes;
+      shard.map.erase(last.key);
+      shard.lru.pop_back();
+      ++shard.evictions;
+    }
+  }
+
+public:
+  explicit FrameCache(size_t maxBytes = size_t(64) << 20, unsigned shards = 16)
+      : shardBytes_(maxBytes / (shards ? shards : 1))
+      , shardCount_(shards ? shards : 1)
+      , shards_(new Shard[shardCount_]) {}
+
+  FrameCache(FrameCache const&) = delete;
+  FrameCache& operator=(FrameCache const&) = delete;
+
+  /** The module number for `buildId` (hex, or any other key). */
+  uint32_t module(std::string_view buildId) {
+    {
+      std::shared_lock lock(modulesMutex_);
+      auto it = modules_.find(buildId);
+      if (it != modules_.end()) { return it->second; }
+    }
+    std::unique_lock lock(modulesMutex_);
+    auto it = modules_.find(buildId);
+    if (it != modules_.end()) { return it->second; }
+    auto ret = uint32_t(moduleIds_.size());
+    modules_.emplace(moduleIds_.emplace_back(buildId), ret);
+    return ret;
+  }
+
+  /** The cached frame for `offset` in `module`, or null if there's none. */
+  Frame get(uint32_t module, uint64_t offset) {
+    Key key {module, offset};
+    auto& shard = shardOf(key);
+    std::lock_guard lock(shard.mutex);
+    auto it = shard.map.find(key);
+    if (it == shard.map.end()) {
+      ++shard.misses;
+      util::Stats::add(util::Counter::kCacheMisses);
+      return nullptr;
+    }
+    ++shard.hits;
+    util::Stats::add(util::Counter::kCacheHits);
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    return it->second->frame;
+  }
+
+  Frame get(std::string_view buildId, uint64_t offset) {
+    return get(module(buildId), offset);
+  }
+
+  /**
+  Cache `frame` for `offset` in `module` (replacing any already there), and
+  return it.  A frame too big for a shard's share of the memory is returned
+  but not kept.
+  */
+  Frame put(uint32_t module, uint64_t offset, ResolvedFrame frame) {
+    auto bytes = frame.bytes() + kOverhead;
+    auto ret = std::make_shared<ResolvedFrame const>(std::move(frame));
+    if (bytes > shardBytes_) { return ret; }
+    Key key {module, offset};
+    auto& shard = shardOf(key);
+    std::lock_guard lock(shard.mutex);
+    auto it = shard.map.find(key);
+    if (it != shard.map.end()) {
+      shard.bytes -= it->second->bytes;
+      shard.lru.erase(it->second);
+      shard.map.erase(it);
+    }
+    shard.lru.push_front({key, ret, bytes});
+    shard.map.emplace(key, shard.lru.begin());
+    shard.bytes += bytes;
+    ++shard.inserts;
+    trim(shard);
+    return ret;
+  }
+
+  /**
+  The cached frame for `offset` in `module`; or on a miss, the result of
+  `resolve()` (a `ResolvedFrame`), which is cached.  `resolve` runs without
+  the shard's lock held, so two threads missing at once might both run it.
+  */
+  template <class Fn>
+  Frame get(uint32_t module, uint64_t offset, Fn&& resolve) {
+    if (auto ret = get(module, offset)) { return ret; }
+    return put(module, offset, resolve());
+  }
+
+  void clear() {
+    for (unsigned i = 0; i < shardCount_; i++) {
+      auto& shard = shards_[i];
+      std::lock_guard lock(shard.mutex);
+      shard.map.clear();
+      shard.lru.clear();
+      shard.bytes = 0;
+    }
+  }
+
+  /** Totals over all shards (each as of when it was read). */
+  FrameCacheStats stats() const {
+    FrameCacheStats ret;
+    for (unsigned i = 0; i < shardCount_; i++) {
+      auto& shard = shards_[i];
+      std::lock_guard lock(shard.mutex);
+      ret.hits += shard.hits;
+      ret.misses += shard.misses;
+      ret.inserts += shard.inserts;
+      ret.evictions += shard.evictions;
+      ret.entries += shard.map.size();
+      ret.bytes += shard.bytes;
+    }
+    return ret;
+  }
+
+  size_t maxBytes() const { return shardBytes_ * shardCount_; }
+  unsigned shards() const { return shardCount_; }
+};
+
+}  // namespace proginfo::symbolize
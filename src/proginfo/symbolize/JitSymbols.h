@@ -0,0 +1,346 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "../binary/Binary.h"
+#include "../procinfo/Memory.h"
+#include "SymbolIndex.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace proginfo::symbolize {
+
+/*
+Symbols for JIT-compiled code, which lives in anonymous memory rather than in
+any module, so `ProcessSymbols` can't otherwise name it (see
+`ProcessSymbols::setJit`).  They come from either or both of:
+
+* `perf` map files (`/tmp/perf-PID.map`), which JITs append a line to per
+  function: `START SIZE name`, with the first two in hex.  `readPerfMap` picks
+  up where the last call left off, so calling it again is cheap.
+* The GDB JIT interface: an in-memory ELF object per batch of compiled code,
+  registered in a linked list at `__jit_debug_descriptor`.  `readGdbJit` walks
+  the list, and indexes the function symbols of each object it hasn't seen.
+
+Either way, everything goes into one address-sorted table, so `lookup` is one
+binary search, like `SymbolIndex::lookup`.  Where entries start at the same
+address (code recompiled into the same place), the most recently read wins.
+
+Lookups only read the table, so are signal-safe and can be made from many
+threads at once; but not at the same time as reading more symbols.
+`readGdbJit` parses ELF, so needs a `util::Alloc` on the calling thread.
+*/
+class JitSymbols {
+  struct Jit {
+    SymbolIndex::Entry entry;
+    uintptr_t end;    // One past the last byte of code
+    uint32_t source;  // 0 if from the perf map, else the object's ID
+  };
+
+  // The GDB JIT interface's structures, with the target's pointers assumed to
+  // be the same size as ours (as with `RemoteMemory` generally)
+  struct Descriptor {
+    uint32_t version;
+    uint32_t action;
+    uintptr_t relevant;
+    uintptr_t first;
+  };
+
+  struct CodeEntry {
+    uintptr_t next;
+    uintptr_t prev;
+    uintptr_t symfile;
+    uint64_t symfileSize;
+  };
+
+  struct Object {
+    uintptr_t addr;
+    uint64_t size;
+    uint32_t id;
+    bool live;
+    std::pmr::vector<uint64_t> data;  // Copy of the ELF image; names point here
+  };
+
+  constexpr static size_t kMaxObjects = 1 << 20;         // In case of cycles
+  constexpr static uint64_t kMaxObjectSize = 256 << 20;  // Sanity check
+
+  std::pmr::vector<Jit> jits_;
+  std::pmr::vector<Jit> added_;              // Scratch, for merging
+  std::pmr::deque<std::pmr::string> names_;  // For perf map entries
+  std::pmr::deque<Object> objects_;          // Those seen in `readGdbJit`
+  std::pmr::string perfPath_;                // File `perfOffset_` is in
+  std::pmr::string partial_;                 // Incomplete last line read
+  uint64_t perfOffset_ {};
+  uint32_t nextId_ {1};
+
+  /** Sort `added_` and merge it into `jits_`, after what was there already. */
+  void merge() {
+    auto byAddr = [](Jit const& a, Jit const& b) {
+      return a.entry.addr < b.entry.addr;
+    };
+    std::stable_sort(added_.begin(), added_.end(), byAddr);
+    auto mid = jits_.size();
+    jits_.insert(jits_.end(), added_.begin(), added_.end());
+    std::inplace_merge(
+        jits_.begin(), jits_.begin() + long(mid), jits_.end(), byAddr);
+    added_.clear();
+  }
+
+  static bool hex(std::string_view& str, uint64_t& out) {
+    if (str.substr(0, 2) == "0x") { str.remove_prefix(2); }
+    size_t n = 0;
+    out = 0;
+    for (; n < str.size() && n < 16; n++) {
+      auto c = str[n];
+      unsigned digit;
+      if (c >= '0' && c <= '9') {
+        digit = unsigned(c - '0');
+      } else if (c >= 'a' && c <= 'f') {
+        digit = unsigned(c - 'a' + 10);
+      } else if (c >= 'A' && c <= 'F') {
+        digit = unsigned(c - 'A' + 10);
+      } else {
+        break;
+      }
+      out = (out << 4) | digit;
+    }
+    str.remove_prefix(n);
+    return n && (str.empty() || str[0] == ' ');
+  }
+
+  /** Parse one perf map line into `added_`; bad lines are skipped. */
+  void perfLine(std::string_view line) {
+    uint64_t start, size;
+    if (!hex(line, start) || line.empty()) { return; }
+    line.remove_prefix(1);
+    if (!hex(line, size) || line.size() < 2 || !size) { return; }
+    line.remove_prefix(1);
+    auto& name = names_.emplace_back(line);
+    SymbolIndex::Entry entry {uintptr_t(start), name, uintptr_t(size)};
+    added_.push_back({entry, uintptr_t(start + size), 0});
+  }
+
+  /** Index the function symbols in `obj`, which was just read in. */
+  bool index(Object const& obj) {
+    auto bin = binary::Binary::at(obj.data.data(),
+                                  obj.size,
+                                  true,
+                                  false,
+                                  std::pmr::new_delete_resource());
+    if (!bin || !bin->isELF()) { return false; }
+    auto symTable = bin->symTable();
+    if (!symTable) { return false; }
+
+    // Each function without a size ends at the next one, or the end of its
+    // section
+    using Range = std::pair<uintptr_t, uintptr_t>;
+    std::pmr::vector<Range> text(jits_.get_allocator());
+    bin->eachSection([&](auto& sec) {
+      if (sec.canExecute() && sec.size()) {
+        text.push_back({sec.virtAddr(), sec.virtAddr() + sec.size()});
+      }
+      return true;
+    });
+    auto first = added_.size();
+    binary::SymbolFilter functions {
+        binary::SymbolFilter::bit(binary::SymbolType::kFunction), ~0u, true};
+    symTable->each(functions, [&](auto& sym) {
+      if (sym.value()) {
+        auto end = sym.size() ? sym.value() + sym.size() : 0;
+        added_.push_back({{sym.value(), sym.name(), sym.size()}, end, obj.id});
+      }
+      return true;
+    });
+    std::sort(added_.begin() + long(first), added_.end(), [](auto& a, auto& b) {
+      return a.entry.addr < b.entry.addr;
+    });
+    auto out = first;
+    for (auto i = first; i < added_.size(); i++) {
+      auto& jit = added_[i];
+      if (!jit.entry.size) {
+        for (auto& [start, end] : text) {
+          auto addr = jit.entry.addr;
+          if (addr >= start && addr < end) { jit.end = end; }
+        }
+        if (i + 1 < added_.size()) {
+          jit.end = std::min(jit.end, added_[i + 1].entry.addr);
+        }
+      }
+      if (jit.end > jit.entry.addr) { added_[out++] = jit; }
+    }
+    added_.resize(out);
+    return true;
+  }
+
+public:
+  explicit JitSymbols(
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : jits_(mr)
+      , added_(mr)
+      , names_(mr)
+      , objects_(mr)
+      , perfPath_(mr)
+      , partial_(mr) {}
+
+  JitSymbols(JitSymbols const&) = delete;
+  JitSymbols& operator=(JitSymbols const&) = delete;
+
+  size_t size() const { return jits_.size(); }
+  size_t objectCount() const { return objects_.size(); }
+
+  /** Forget all symbols, and where the perf map was read up to. */
+  void clear() {
+    jits_.clear();
+    names_.clear();
+    objects_.clear();
+    perfPath_.clear();
+    partial_.clear();
+    perfOffset_ = 0;
+  }
+
+  /** The function containing `addr`, or nullptr if none.  Signal-safe. */
+  SymbolIndex::Entry const* lookup(uintptr_t addr) const {
+    auto it = std::upper_bound(
+        jits_.begin(), jits_.end(), addr, [](uintptr_t a, auto& jit) {
+          return a < jit.entry.addr;
+        });
+    if (it == jits_.begin()) { return nullptr; }
+    --it;
+    return addr < it->end ? &it->entry : nullptr;
+  }
+
+#if defined(__linux__)
+
+  /**
+  Read the lines added to the perf map at `path` since the last call (or all of
+  it, the first time, or if `path` has changed).  Returns false if it can't be
+  read, e.g. because the JIT hasn't written it yet.  Linux only.
+  */
+  bool readPerfMap(std::string_view path) {
+    if (path != perfPath_) {
+      perfPath_ = path;
+      perfOffset_ = 0;
+      partial_.clear();
+    }
+    auto fd = open(perfPath_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) { return false; }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && uint64_t(st.st_size) < perfOffset_) {
+      // Rewritten (e.g. by a new process with the same PID): start over
+      jits_.erase(std::remove_if(jits_.begin(),
+                                 jits_.end(),
+                                 [](auto& jit) { return !jit.source; }),
+                  jits_.end());
+      names_.clear();
+      partial_.clear();
+      perfOffset_ = 0;
+    }
+    char buf[16 << 10];
+    while (true) {
+      auto n = pread(fd, buf, sizeof(buf), off_t(perfOffset_));
+      if (n <= 0) { break; }
+      perfOffset_ += uint64_t(n);
+      std::string_view chunk(buf, size_t(n));
+      while (!chunk.empty()) {
+        auto eol = chunk.find('\n');
+        if (eol == chunk.npos) {
+          partial_ += chunk;  // The rest of it isn't written yet
+          break;
+        }
+        if (partial_.empty()) {
+          perfLine(chunk.substr(0, eol));
+        } else {
+          partial_ += chunk.substr(0, eol);
+          perfLine(partial_);
+          partial_.clear();
+        }
+        chunk.remove_prefix(eol + 1);
+      }
+    }
+    close(fd);
+    merge();
+    return true;
+  }
+
+  /** Likewise, for process `pid`'s map, `/tmp/perf-PID.map`. */
+  bool readPerfMap(int pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/perf-%d.map", pid);
+    return readPerfMap(std::string_view(path));
+  }
+
+#endif
+
+  /**
+  Walk the list of JIT objects registered with the `__jit_debug_descriptor` at
+  `descriptor` (found with e.g. `ProcessSymbols::address`), in `memory`.  Each
+  new object is copied and its function symbols indexed; those no longer in the
+  list (the JIT has freed their code) are dropped.  Returns false if the list
+  can't be read.
+  */
+  bool readGdbJit(procinfo::MemorySource& memory, uintptr_t descriptor) {
+    Descriptor desc;
+    if (!memory.read(descriptor, &desc) || desc.version != 1) { return false; }
+    for (auto& obj : objects_) { obj.live = false; }
+
+    size_t count = 0;
+    for (auto addr = desc.first; addr && count < kMaxObjects; count++) {
+      CodeEntry entry;
+      if (!memory.read(addr, &entry)) { return false; }
+      addr = entry.next;
+      auto it = std::find_if(objects_.begin(), objects_.end(), [&](auto& obj) {
+        return obj.addr == entry.symfile && obj.size == entry.symfileSize;
+      });
+      if (it != objects_.end()) {
+        it->live = true;
+        continue;
+      }
+      if (!entry.symfileSize || entry.symfileSize > kMaxObjectSize) {
+        continue;
+      }
+      auto& obj = objects_.emplace_back(Object {
+          entry.symfile,
+          entry.symfileSize,
+          nextId_++,
+          true,
+          std::pmr::vector<uint64_t>(objects_.get_allocator())});
+      obj.data.resize((entry.symfileSize + 7) / 8);
+      if (!memory.read(obj.addr, obj.data.data(), obj.size) || !index(obj)) {
+        obj.data = {};  // Keep it, without symbols, so as not to try again
+      }
+    }
+
+    // Drop the symbols of objects which have gone, then add the new ones
+    // (objects are in order of ID)
+    auto gone = [&](Jit const& jit) {
+      if (!jit.source) { return false; }
+      auto it = std::lower_bound(
+          objects_.begin(), objects_.end(), jit.source, [](auto& obj, auto id) {
+            return obj.id < id;
+          });
+      return it == objects_.end() || it->id != jit.source || !it->live;
+    };
+    jits_.erase(std::remove_if(jits_.begin(), jits_.end(), gone), jits_.end());
+    objects_.erase(std::remove_if(objects_.begin(),
+                                  objects_.end(),
+                                  [](auto& obj) { return !obj.live; }),
+                   objects_.end());
+    merge();
+    return true;
+  }
+};
+
+}  // namespace proginfo::symbolize
@@ -0,0 +1,217 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "../binary/Binary.h"
+#include "../binary/Demangle.h"
+#include "../procinfo/ProcInfo.h"
+#include "../util/MMap.h"
+#include "../util/Stats.h"
+#include "JitSymbols.h"
+#include "SymbolIndex.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace proginfo::symbolize {
+
+/*
+Symbols for the modules loaded in the current process: a `procinfo::ModuleMap`
+snapshot, plus each module's file, mapped and parsed, and its `SymbolIndex`.
+
+Setting this up (`refresh`) maps files and allocates, so it should be done
+ahead of time; afterwards `resolve` only does binary searches over what was
+prepared, so it's signal-safe and can be called from many threads at once.
+Like `Batch::addBinary`, `refresh` needs a `util::Alloc` on the calling thread.
+*/
+class ProcessSymbols {
+public:
+  /** What's known about an address. */
+  struct Resolved {
+    procinfo::Module const* module;    // Null if not in any module
+    SymbolIndex::Entry const* symbol;  // Null if not known
+    uintptr_t moduleOffset;            // Link-time address (`Module::offset`)
+    uintptr_t symbolOffset;            // From the start of `symbol`
+
+    explicit operator bool() const { return symbol; }
+  };
+
+private:
+  struct Symbols {
+    util::MMap mm;
+    util::Virtual<binary::Binary> bin;
+    SymbolIndex index;
+
+    // Symbol lookups jump around; prefer not to read ahead
+    explicit Symbols(std::string_view path)
+        : mm(path, {.advice = util::MMap::Advice::kRandom}) {}
+  };
+
+  procinfo::ModuleMap modules_;
+  std::vector<std::unique_ptr<Symbols>> symbols_;  // By module; null if none
+  JitSymbols const* jit_ {};                       // For addresses outside them
+
+  /** Set up symbols for the modules in `modules_`. */
+  void index() {
+    symbols_.clear();
+    for (auto& mod : modules_) {
+      auto syms = std::make_unique<Symbols>(mod.path);
+      if (syms->mm) {
+        syms->bin = binary::Binary::at(syms->mm.addr_,
+                                       syms->mm.size_,
+                                       false,
+                                       false,
+                                       std::pmr::new_delete_resource());
+      }
+      if (!syms->bin || !syms->index.build(*syms->bin)) { syms.reset(); }
+      if (syms) {
+        // Lookups will want the names, and shouldn't have to wait for I/O
+        if (auto sec = syms->bin->section(".strtab")) {
+          syms->mm.prefault(sec->fileOffset(), sec->size());
+        }
+      }
+      symbols_.push_back(std::move(syms));
+    }
+  }
+
+public:
+  ProcessSymbols() = default;
+  ProcessSymbols(ProcessSymbols const&) = delete;
+  ProcessSymbols& operator=(ProcessSymbols const&) = delete;
+
+  /**
+  Snapshot the loaded modules, and map and index each one's file.  Modules
+  whose files can't be read, or which have no `.symtab`, are still in
+  `modules()`, just without symbols.
+  */
+  bool refresh() {
+    symbols_.clear();
+    if (!modules_.refresh()) { return false; }
+    index();
+    return true;
+  }
+
+  /**
+  Likewise, for the modules loaded in another process (see
+  `ModuleMap::refresh(pid, memory)`), for symbolizing its stacks.  Their files
+  are opened by the paths that process used.  Linux only.
+  */
+  bool refresh(int pid, procinfo::MemorySource& memory) {
+    symbols_.clear();
+    if (!modules_.refresh(pid, memory)) { return false; }
+    index();
+    return true;
+  }
+
+  procinfo::ModuleMap const& modules() const { return modules_; }
+
+  /**
+  Also look up addresses which aren't in any module in `jit` (or, if null, stop
+  doing so).  It's not copied, so must outlive this, and mustn't be updated
+  while `resolve` might be called.
+  */
+  void setJit(JitSymbols const* jit) { jit_ = jit; }
+
+  /**
+  Runtime address of the symbol `name` in the first module defining it, or 0,
+  e.g. to find a JIT's `__jit_debug_descriptor`.  Scans every symbol table.
+  */
+  uintptr_t address(std::string_view name) const {
+    for (auto& mod : modules_) {
+      auto* index = symbols(mod);
+      auto* sym = index ? index->find(name) : nullptr;
+      if (sym) { return mod.base + sym->addr; }
+    }
+    return 0;
+  }
+
+  /** Symbol index for `mod` (from `modules()`), or nullptr if it has none. */
+  SymbolIndex const* symbols(procinfo::Module const& mod) const {
+    auto& syms = symbols_[modules_.indexOf(&mod)];
+    return syms ? &syms->index : nullptr;
+  }
+
+  /**
+  Look up `addr`.  For return addresses (i.e. all frames of a backtrace except
+  a signal's interrupted PC) pass `isReturn`, so the call instruction is looked
+  up instead; this matters when the call was the last thing in its function.
+  */
+  Resolved resolve(uintptr_t addr, bool isReturn = false) const {
+    util::Stats::Scope timer(util::Timer::kSymbolize);
+    auto where = isReturn ? addr - 1 : addr;
+    Resolved ret {modules_.find(where), nullptr, 0, 0};
+    if (!ret.module) {
+      // Perhaps JIT-compiled code; there's no module, so offsets are addresses
+      ret.symbol = jit_ ? jit_->lookup(where) : nullptr;
+      if (ret.symbol) {
+        ret.moduleOffset = addr;
+        ret.symbolOffset = addr - ret.symbol->addr;
+      }
+      return ret;
+    }
+    ret.moduleOffset = ret.module->offset(addr);
+    if (auto* index = symbols(*ret.module)) {
+      ret.symbol = index->lookup(ret.module->offset(where));
+      if (ret.symbol) {
+        ret.symbolOffset = ret.moduleOffset - ret.symbol->addr;
+      }
+    }
+    return ret;
+  }
+
+  /**
+  Describe `addr` (see `resolve`) in a few words: its function's demangled name
+  if known; else its module and offset, as `path+0x1234`; else the address.
+  Signal-safe, but needs about 10KB of stack for demangling.
+  */
+  void writeFrame(uintptr_t addr,
+                  bool isReturn,
+                  binary::DemangleSink& out) const {
+    auto res = resolve(addr, isReturn);
+    if (res.symbol) {
+      alignas(binary::Demangler::Entry) std::byte scratch[8 << 10];
+      char buf[1024];
+      binary::Demangler demangler(scratch, sizeof(scratch));
+      binary::DemangleSink name(buf, sizeof(buf));
+      auto ok = demangler.demangle(res.symbol->name, name);
+      out.put(ok ? name.str() : res.symbol->name);
+    } else if (res.module) {
+      out.put(res.module->path);
+      out.put('+');
+      putHex(out, res.moduleOffset);
+    } else {
+      putHex(out, addr);
+    }
+  }
+
+  /**
+  Describe a stack (innermost frame first, as from `procinfo::backtrace`) in
+  the "folded" form used for flame graphs: each frame as by `writeFrame`,
+  outermost first, separated by `;`.  All but the first are return addresses;
+  the first is too, if `firstIsReturn`.
+  */
+  void writeFolded(uintptr_t const* pcs,
+                   size_t count,
+                   bool firstIsReturn,
+                   binary::DemangleSink& out) const {
+    for (size_t i = count; i-- > 0;) {
+      writeFrame(pcs[i], i || firstIsReturn, out);
+      if (i) { out.put(';'); }
+    }
+  }
+
+  static void putHex(binary::DemangleSink& out, uint64_t val) {
+    char digits[16];
+    unsigned n = 0;
+    do {
+      digits[n++] = "0123456789abcdef"[val & 15];
+      val >>= 4;
+    } while (val);
+    out.put("0x");
+    while (n) { out.put(digits[--n]); }
+  }
+};
+
+}  // namespace proginfo::symbolize
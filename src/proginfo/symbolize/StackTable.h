@@ -0,0 +1,305 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "../binary/Demangle.h"
+#include "../procinfo/ProcInfo.h"
+#include "ProcessSymbols.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+namespace proginfo::symbolize {
+
+/*
+Hashes stacks (arrays of program counters) into 64-bit fingerprints which are
+stable across runs and processes: each PC is first normalized to its module and
+offset within it, and modules are identified by build ID (or path, if they have
+none), so address-space randomization doesn't matter.  PCs outside any known
+module (e.g. JIT code) are hashed as-is.
+
+Fingerprinting only reads the module map and some precomputed per-module keys,
+so it's cheap, signal-safe and thread-safe.  It's never 0.
+*/
+class StackFingerprinter {
+  procinfo::ModuleMap const& modules_;
+  std::pmr::vector<uint64_t> moduleKeys_;  // By module index
+
+  static uint64_t mix(uint64_t h, uint64_t val) {
+    h = (h ^ val) * 0xff51afd7ed558ccdull;
+    return h ^ (h >> 32);
+  }
+
+public:
+  /** FNV-1a, for module keys; used for nothing secret or adversarial. */
+  static uint64_t hashBytes(std::string_view bytes) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (char c : bytes) { h = (h ^ uint8_t(c)) * 0x100000001b3ull; }
+    return h;
+  }
+
+  /** `modules` must outlive this, and not be refreshed while it's in use. */
+  explicit StackFingerprinter(
+      procinfo::ModuleMap const& modules,
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : modules_(modules), moduleKeys_(mr) {
+    moduleKeys_.reserve(modules.size());
+    for (auto& mod : modules) {
+      auto id = mod.buildId.empty() ? mod.path : mod.buildId;
+      moduleKeys_.push_back(hashBytes(id));
+    }
+  }
+
+  uint64_t operator()(uintptr_t const* pcs, size_t count) const {
+    uint64_t h = mix(0x9e3779b97f4a7c15ull, count);
+    for (size_t i = 0; i < count; i++) {
+      if (auto* mod = modules_.find(pcs[i])) {
+        h = mix(h, moduleKeys_[modules_.indexOf(mod)]);
+        h = mix(h, mod->offset(pcs[i]));
+      } else {
+        h = mix(h, pcs[i]);
+      }
+    }
+    return h ? h : 1;
+  }
+};
+
+/*
+Bounded, lock-free hash table of stacks, keyed by fingerprint, counting how
+many times each was seen (`add`), and holding text for each (e.g. a formatted,
+symbolized trace), which is `publish`ed once by whichever thread added it
+first.
+
+Capacity is fixed at construction, for both entries and text; so is the memory.
+Once the table (or the probe sequence for some fingerprint) is full, new stacks
+are dropped and counted in `stats`; known ones are still counted.  Likewise, a
+stack whose text doesn't fit is kept, with no text.  Nothing is ever removed.
+*/
+class StackTable {
+public:
+  class Entry {
+    friend class StackTable;
+
+    std::atomic<uint64_t> key_ {};  // Fingerprint; 0 while unused
+    std::atomic<uint64_t> count_ {};
+    std::atomic<uint32_t> state_ {};  // kPending etc.
+    uint32_t textSize_ {};
+    size_t textOffset_ {};
+
+  public:
+    uint64_t fingerprint() const {
+      return key_.load(std::memory_order_relaxed);
+    }
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+  };
+
+  struct Added {
+    Entry* entry;  // Null if the table is full
+    bool isNew;    // The caller should `publish` text for it
+  };
+
+  struct Stats {
+    size_t unique {};       // Entries in use
+    uint64_t samples {};    // Total of `add`ed counts, including dropped ones
+    uint64_t dropped {};    // Samples of new stacks which didn't fit
+    size_t textUsed {};     // Bytes
+    size_t textMissing {};  // Entries published without text, for lack of room
+  };
+
+private:
+  constexpr static uint32_t kPending = 0;
+  constexpr static uint32_t kPublished = 1;
+  constexpr static uint32_t kNoText = 2;
+  constexpr static size_t kMaxProbes = 64;
+
+  std::pmr::vector<Entry> entries_;
+  std::pmr::vector<char> text_;
+  size_t mask_;
+  std::atomic<size_t> textUsed_ {};
+  std::atomic<size_t> unique_ {};
+  std::atomic<uint64_t> samples_ {};
+  std::atomic<uint64_t> dropped_ {};
+  std::atomic<size_t> textMissing_ {};
+
+  static size_t roundUp(size_t n) {
+    size_t ret = 1;
+    while (ret < n) { ret <<= 1; }
+    return ret;
+  }
+
+public:
+  /** Room for `capacity` stacks (rounded up to a power of 2), `textBytes`. */
+  StackTable(size_t capacity,
+             size_t textBytes,
+             std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : entries_(roundUp(capacity), mr)
+      , text_(textBytes, mr)
+      , mask_(entries_.size() - 1) {}
+
+  StackTable(StackTable const&) = delete;
+  StackTable& operator=(StackTable const&) = delete;
+
+  size_t capacity() const { return entries_.size(); }
+
+  /** Count `count` samples of the stack with this (nonzero) fingerprint. */
+  Added add(uint64_t fingerprint, uint64_t count = 1) {
+    samples_.fetch_add(count, std::memory_order_relaxed);
+    auto i = size_t(fingerprint) & mask_;
+    for (size_t probe = 0; probe < kMaxProbes && probe <= mask_; probe++) {
+      auto& entry = entries_[(i + probe) & mask_];
+      auto key = entry.key_.load(std::memory_order_acquire);
+      bool isNew = false;
+      if (!key) {
+        isNew = entry.key_.compare_exchange_strong(key, fingerprint);
+        if (isNew) {
+          unique_.fetch_add(1, std::memory_order_relaxed);
+          key = fingerprint;
+        }
+      }
+      if (key == fingerprint) {
+        entry.count_.fetch_add(count, std::memory_order_relaxed);
+        return {&entry, isNew};
+      }
+    }
+    dropped_.fetch_add(count, std::memory_order_relaxed);
+    return {nullptr, false};
+  }
+
+  /** The entry for `fingerprint`, if there is one. */
+  Entry const* find(uint64_t fingerprint) const {
+    auto i = size_t(fingerprint) & mask_;
+    for (size_t probe = 0; probe < kMaxProbes && probe <= mask_; probe++) {
+      auto& entry = entries_[(i + probe) & mask_];
+      auto key = entry.key_.load(std::memory_order_acquire);
+      if (key == fingerprint) { return &entry; }
+      if (!key) { break; }
+    }
+    return nullptr;
+  }
+
+  /**
+  Set `entry`'s text (copying it into the table); only to be done once, by the
+  thread which added it.  Returns false if there wasn't room for it.
+  */
+  bool publish(Entry& entry, std::string_view text) {
+    auto offset = textUsed_.fetch_add(text.size(), std::memory_order_relaxed);
+    if (offset > text_.size() || text.size() > text_.size() - offset) {
+      textMissing_.fetch_add(1, std::memory_order_relaxed);
+      entry.state_.store(kNoText, std::memory_order_release);
+      return false;
+    }
+    memcpy(text_.data() + offset, text.data(), text.size());
+    entry.textOffset_ = offset;
+    entry.textSize_ = uint32_t(text.size());
+    entry.state_.store(kPublished, std::memory_order_release);
+    return true;
+  }
+
+  /** Whether `entry` has been published (though its text might be missing). */
+  bool isPublished(Entry const& entry) const {
+    return entry.state_.load(std::memory_order_acquire) != kPending;
+  }
+
+  /** `entry`'s text; empty if it isn't published yet, or didn't fit. */
+  std::string_view text(Entry const& entry) const {
+    if (entry.state_.load(std::memory_order_acquire) != kPublished) {
+      return {};
+    }
+    return {text_.data() + entry.textOffset_, entry.textSize_};
+  }
+
+  /** Call `cb` with each entry in use (in no particular order). */
+  template <class F>
+  void each(F&& cb) const {
+    for (auto& entry : entries_) {
+      if (entry.key_.load(std::memory_order_acquire)) { cb(entry); }
+    }
+  }
+
+  Stats stats() const {
+    Stats ret;
+    ret.unique = unique_.load(std::memory_order_relaxed);
+    ret.samples = samples_.load(std::memory_order_relaxed);
+    ret.dropped = dropped_.load(std::memory_order_relaxed);
+    auto textUsed = textUsed_.load(std::memory_order_relaxed);
+    ret.textUsed = std::min(textUsed, text_.size());
+    ret.textMissing = textMissing_.load(std::memory_order_relaxed);
+    return ret;
+  }
+};
+
+/*
+Aggregates samples of stacks from the current process: each is fingerprinted
+and counted in a `StackTable`, and only the first sample of each distinct stack
+is symbolized and formatted.
+
+Stacks are formatted "folded", as used for flame graphs (see
+`ProcessSymbols::writeFolded`).  They're as from `procinfo::backtrace`:
+innermost first, and the first may be a signal's interrupted PC rather than a
+return address.
+
+`add` is thread-safe, and doesn't touch the heap, but isn't signal-safe (it can
+demangle names, which is fairly slow); a profiler's signal handler should just
+capture stacks, for some other thread to `add` here.
+*/
+class StackAggregator {
+public:
+  struct Options {
+    size_t capacity {1 << 16};    // Distinct stacks
+    size_t textBytes {16 << 20};  // For all the formatted stacks
+    bool firstIsReturn {false};   // First PC is a return address too
+  };
+
+private:
+  constexpr static size_t kMaxText = 4096;  // Per stack; the rest is dropped
+
+  ProcessSymbols const& symbols_;
+  Options opts_;
+  StackFingerprinter fingerprinter_;
+  StackTable table_;
+
+public:
+  /** `symbols` must be ready (`refresh`ed), and outlive this. */
+  StackAggregator(
+      ProcessSymbols const& symbols,
+      Options const& opts,
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : symbols_(symbols)
+      , opts_(opts)
+      , fingerprinter_(symbols.modules(), mr)
+      , table_(opts.capacity, opts.textBytes, mr) {}
+
+  explicit StackAggregator(ProcessSymbols const& symbols)
+      : StackAggregator(symbols, Options {}) {}
+
+  StackFingerprinter const& fingerprinter() const { return fingerprinter_; }
+  StackTable const& table() const { return table_; }
+
+  /**
+  Count `weight` samples of this stack; returns its entry (null if the table is
+  full), whose text is ready unless another thread is still formatting it.
+  */
+  StackTable::Entry const* add(uintptr_t const* pcs,
+                               size_t count,
+                               uint64_t weight = 1) {
+    auto added = table_.add(fingerprinter_(pcs, count), weight);
+    if (added.isNew) {
+      char buf[kMaxText];
+      binary::DemangleSink out(buf, sizeof(buf));
+      symbols_.writeFolded(pcs, count, opts_.firstIsReturn, out);
+      table_.publish(*added.entry, out.str());
+    }
+    return added.entry;
+  }
+
+  std::string_view text(StackTable::Entry const& entry) const {
+    return table_.text(entry);
+  }
+};
+
+}  // namespace proginfo::symbolize
@@ -0,0 +1,156 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "../binary/Binary.h"
+#include "../binary/elf/Plt.h"
+#include "../binary/elf/Relocatable.h"
+#include "../util/Stats.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+namespace proginfo::symbolize {
+
+/*
+Address-sorted index of a binary's symbol table, for looking up the symbol
+containing some address in `O(log n)` rather than scanning the whole table each
+time.
+
+Names point into the binary's string table, so the binary must outlive the
+index.  Only function and data symbols are indexed (not sections, files, etc.),
+plus a synthetic `foo@plt` for each PLT stub (see `binary::PltEntry`).
+
+Symbols' sizes are kept, so an address past the end of the symbol before it
+(e.g. in padding, or in a `.cold` block split off from some function) isn't
+attributed to that symbol.  Symbols without sizes (as in hand-written assembly)
+are assumed to extend up to the next.
+*/
+class SymbolIndex {
+public:
+  struct Entry {
+    uintptr_t addr;
+    std::string_view name;
+    uintptr_t size {};  // 0 if not known
+  };
+
+  // How many symbols before the nearest one to check for one containing an
+  // address, if the nearest doesn't (e.g. it's a label within a function)
+  constexpr static unsigned kMaxNested = 4;
+
+private:
+  std::pmr::vector<Entry> entries_;
+  std::pmr::vector<char> pltNames_;  // The `@plt` symbols' names
+
+  /**
+  Add an entry for each PLT stub, named for the function it calls.  `IRELATIVE`
+  ones (calling e.g. `memcpy` through an ifunc) are named for their resolver,
+  if it's in the symbol table.  Returns whether any were added.
+  */
+  bool addPlt(binary::Binary const& bin) {
+    std::pmr::vector<binary::PltEntry> stubs(entries_.get_allocator());
+    size_t chars = 0;
+    binary::eachPltEntry(bin, [&](auto& stub) {
+      auto& added = stubs.emplace_back(stub);
+      if (added.name.empty()) {
+        auto* resolver = lookup(added.target);
+        if (resolver && resolver->addr == added.target) {
+          added.name = resolver->name;
+        } else {
+          stubs.pop_back();
+          return true;
+        }
+      }
+      chars += added.name.size() + 4;
+      return true;
+    });
+
+    // Names all go in one buffer, so that views of it stay valid
+    pltNames_.reserve(chars);
+    for (auto& stub : stubs) {
+      auto* name = pltNames_.data() + pltNames_.size();
+      pltNames_.insert(pltNames_.end(), stub.name.begin(), stub.name.end());
+      for (auto c : std::string_view("@plt")) { pltNames_.push_back(c); }
+      entries_.push_back({stub.addr, {name, stub.name.size() + 4}, stub.size});
+    }
+    return !stubs.empty();
+  }
+
+public:
+  explicit SymbolIndex(
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : entries_(mr)
+      , pltNames_(mr) {}
+
+  /**
+  (Re)build from `bin`'s symbol table and PLT.  Returns false if it has no
+  symbols from either.  Symbols in a relocatable object (`.o`), whose values
+  are offsets in their sections, get `binary::Relocatable`'s addresses.
+  */
+  bool build(binary::Binary const& bin) {
+    util::Stats::Scope timer(util::Timer::kParse);
+    entries_.clear();
+    pltNames_.clear();
+    auto symTable = bin.symTable();
+    if (symTable) {
+      binary::Relocatable relocs(bin, entries_.get_allocator().resource());
+      uint64_t visited = 0;
+      symTable->each(binary::SymbolFilter::addressable(), [&](auto& sym) {
+        ++visited;
+        auto addr = relocs ? relocs.symbolAddr(sym) : sym.value();
+        if (addr) { entries_.push_back({addr, sym.name(), sym.size()}); }
+        return true;
+      });
+      util::Stats::add(util::Counter::kSymbolsVisited, visited);
+    }
+    auto byAddr = [](auto& a, auto& b) { return a.addr < b.addr; };
+    std::sort(entries_.begin(), entries_.end(), byAddr);
+    if (addPlt(bin)) { std::sort(entries_.begin(), entries_.end(), byAddr); }
+    return symTable || !entries_.empty();
+  }
+
+  size_t size() const { return entries_.size(); }
+
+  /** Address of the first symbol, or 0 if none. */
+  uintptr_t minAddr() const {
+    return entries_.empty() ? 0 : entries_.front().addr;
+  }
+
+  /** Address of the last symbol (which `lookup` may not find), or 0 if none. */
+  uintptr_t maxAddr() const {
+    return entries_.empty() ? 0 : entries_.back().addr;
+  }
+
+  /**
+  The symbol containing `addr`: the last one at or before it, unless that has
+  a size and `addr` is past its end; then a (nearby) earlier one containing
+  it, if any.  Else nullptr.
+  */
+  Entry const* lookup(uintptr_t addr) const {
+    auto it = std::upper_bound(
+        entries_.begin(), entries_.end(), addr, [](uintptr_t a, auto& e) {
+          return a < e.addr;
+        });
+    if (it == entries_.begin()) { return nullptr; }
+    auto& last = *--it;
+    if (!last.size || addr - last.addr < last.size) { return &last; }
+    for (unsigned i = 0; i < kMaxNested && it != entries_.begin(); i++) {
+      auto& e = *--it;
+      if (addr - e.addr < e.size) { return &e; }
+    }
+    return nullptr;
+  }
+
+  /** The symbol named `name`, or nullptr.  A linear scan; not for hot paths. */
+  Entry const* find(std::string_view name) const {
+    for (auto& e : entries_) {
+      if (e.name == name) { return &e; }
+    }
+    return nullptr;
+  }
+};
+
+}  // namespace proginfo::symbolize
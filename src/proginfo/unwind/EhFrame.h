@@ -0,0 +1,606 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "../binary/Binary.h"
+#include "../util/Bytes.h"
+#include "../util/Stats.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <vector>
+
+namespace proginfo::unwind {
+
+/** How to recover one register (or the CFA) in the caller's frame. */
+struct Rule {
+  enum Kind : uint8_t {
+    kSame,           // Unchanged: the default, for callee-saved registers
+    kUndefined,      // Not recoverable; if the return address, stack ends here
+    kOffset,         // Saved at CFA + `value`
+    kValOffset,      // Is CFA + `value`
+    kRegister,       // Is in register `reg` (plus `value`, for the CFA)
+    kExpression,     // Saved at the address the expression computes
+    kValExpression,  // Is the value the expression computes
+  };
+
+  Kind kind {kSame};
+  uint16_t reg {};
+  uint32_t exprSize {};  // Expression length; it's at `value` in `.eh_frame`
+  int64_t value {};
+};
+
+/**
+The rules in effect at some PC: one row of the call frame information table.
+Only the CFA's `kRegister` and `kValExpression` rules are used.
+*/
+struct Row {
+  constexpr static unsigned kMaxRegs = 33;  // AArch64's x0-x30, sp, pc
+
+  Rule cfa {Rule::kUndefined};
+  Rule regs[kMaxRegs];
+  unsigned raReg {};   // Column holding the return address
+  uintptr_t start {};  // Link-time PCs this row covers
+  uintptr_t end {};    //
+  bool isSignalFrame {};
+  bool raSigned {};  // AArch64: return address is signed (pointer auth.)
+};
+
+/*
+Index of a binary's `.eh_frame` call frame information (the DWARF CFI which the
+C++ runtime unwinds exceptions with), for finding the unwinding rules at any PC.
+
+`build` reads every CIE and FDE once, keeping each CIE's parameters, and a
+sorted table of FDEs with their PC ranges; `find` then only binary-searches
+that, and runs the one FDE's (short) instruction stream up to the PC.  So an
+index can be built once per binary and shared, read-only, by any number of
+threads unwinding any number of stacks.
+
+`.eh_frame_hdr` isn't needed (its table is the same as ours), and neither is
+`.debug_frame`, which only matters for code built without unwind tables.  PCs
+are link-time addresses, as in the binary.  The binary must outlive this.
+*/
+class EhFrame {
+  // DW_EH_PE_* pointer encodings
+  constexpr static uint8_t kOmit = 0xff;
+  constexpr static uint8_t kPCRel = 0x10;
+
+  constexpr static unsigned kMaxStates = 8;  // DW_CFA_remember_state depth
+
+  struct Cie {
+    size_t offset;  // In `.eh_frame`
+    size_t insnStart;
+    size_t insnEnd;
+    uint64_t codeAlign;
+    int64_t dataAlign;
+    unsigned raReg;
+    uint8_t fdeEncoding;
+    bool hasAugData;  // "z" augmentation: FDEs have augmentation data too
+    bool isSignalFrame;
+  };
+
+  struct Fde {
+    uintptr_t begin;
+    uintptr_t end;
+    uint32_t insnStart;  // Offsets in `.eh_frame`
+    uint32_t insnEnd;
+    uint32_t cie;  // Index in `cies_`
+  };
+
+  /** Bounds-checked reads from `.eh_frame`; `ok` is cleared on overrun. */
+  struct Cursor {
+    EhFrame const& eh;
+    size_t pos;
+    size_t end;
+    bool ok {true};
+
+    bool has(size_t n) {
+      ok = ok && n <= end - pos && pos <= end;
+      return ok;
+    }
+
+    uint64_t read(unsigned n) {
+      if (!has(n)) { return 0; }
+      uint64_t ret = 0;
+      for (unsigned i = 0; i < n; i++) {
+        auto byte = uint64_t(eh.data_.u8(pos + i));
+        ret |= byte << (8 * (eh.isLE_ ? i : n - 1 - i));
+      }
+      pos += n;
+      return ret;
+    }
+
+    uint8_t u8() { return uint8_t(read(1)); }
+
+    uint64_t uleb() {
+      uint64_t ret = 0;
+      for (unsigned shift = 0; has(1); shift += 7) {
+        auto byte = eh.data_.u8(pos++);
+        if (shift < 64) { ret |= uint64_t(byte & 0x7f) << shift; }
+        if (!(byte & 0x80)) { break; }
+      }
+      return ret;
+    }
+
+    int64_t sleb() {
+      uint64_t ret = 0;
+      unsigned shift = 0;
+      uint8_t byte = 0;
+      while (has(1)) {
+        byte = eh.data_.u8(pos++);
+        if (shift < 64) { ret |= uint64_t(byte & 0x7f) << shift; }
+        shift += 7;
+        if (!(byte & 0x80)) { break; }
+      }
+      if (shift < 64 && (byte & 0x40)) { ret |= ~uint64_t(0) << shift; }
+      return int64_t(ret);
+    }
+
+    /** A pointer in DW_EH_PE_* encoding `enc`: absolute or PC-relative. */
+    uint64_t pointer(uint8_t enc) {
+      if (enc == kOmit) { return 0; }
+      auto here = eh.vaddr_ + pos;
+      uint64_t ret;
+      switch (enc & 0x0f) {
+      case 0x00: ret = read(eh.is64_ ? 8 : 4); break;
+      case 0x01: ret = uleb(); break;
+      case 0x02: ret = read(2); break;
+      case 0x03: ret = read(4); break;
+      case 0x04: ret = read(8); break;
+      case 0x09: ret = uint64_t(sleb()); break;
+      case 0x0a: ret = uint64_t(int16_t(read(2))); break;
+      case 0x0b: ret = uint64_t(int32_t(read(4))); break;
+      case 0x0c: ret = read(8); break;
+      default: ok = false; return 0;
+      }
+      // The indirect bit (0x80) only matters for personality routines; ignored
+      switch (enc & 0x70) {
+      case 0: break;
+      case kPCRel: ret += here; break;
+      default: ok = false; return 0;  // Text-, data-, function-relative
+      }
+      return eh.is64_ ? ret : uint32_t(ret);
+    }
+  };
+
+  /** One entry's extent, and the CIE ID / CIE pointer field's position. */
+  struct Entry {
+    size_t idPos;
+    size_t end;
+    uint32_t id;
+  };
+
+  util::Addr data_;
+  uintptr_t vaddr_ {};
+  bool isLE_ {true};
+  bool is64_ {true};
+  std::pmr::vector<Cie> cies_;  // By offset
+  std::pmr::vector<Fde> fdes_;  // By `begin`
+  size_t skipped_ {};
+
+  /** The entry at `off`; false at the terminator or end of the section. */
+  bool entry(size_t off, Entry* out) const {
+    Cursor c {*this, off, data_.size_};
+    uint64_t len = c.read(4);
+    if (!c.ok || !len) { return false; }
+    if (len == 0xffffffff) { len = c.read(8); }
+    out->idPos = c.pos;
+    out->id = uint32_t(c.read(4));
+    if (!c.ok || len < 4 || len > data_.size_ - out->idPos) { return false; }
+    out->end = out->idPos + len;
+    return true;
+  }
+
+  bool parseCie(size_t off, Entry const& e, Cie* out) const {
+    Cursor c {*this, e.idPos + 4, e.end};
+    *out = {off, 0, e.end, 1, 1, 0, 0, false, false};
+    auto version = c.u8();
+    if (version != 1 && version != 3 && version != 4) { return false; }
+    auto augStart = c.pos;
+    while (c.has(1) && c.u8()) {}
+    auto aug = data_.str().substr(augStart, c.pos - augStart - 1);
+    if (aug.substr(0, 2) == "eh") { c.read(is64_ ? 8 : 4); }
+    if (version == 4) { c.read(2); }  // Address and segment selector sizes
+    out->codeAlign = c.uleb();
+    out->dataAlign = c.sleb();
+    out->raReg = unsigned(version == 1 ? c.u8() : c.uleb());
+    if (aug.substr(0, 1) == "z") {
+      out->hasAugData = true;
+      auto augEnd = c.uleb();
+      augEnd += c.pos;
+      for (char ch : aug.substr(1)) {
+        if (ch == 'L') {
+          c.u8();
+        } else if (ch == 'P') {
+          c.pointer(c.u8());
+        } else if (ch == 'R') {
+          out->fdeEncoding = c.u8();
+        } else if (ch == 'S') {
+          out->isSignalFrame = true;
+        } else if (ch != 'B' && ch != 'G') {
+          break;  // Unknown, but the length lets us skip the rest
+        }
+      }
+      c.pos = size_t(augEnd);
+    } else if (!aug.empty() && aug != "eh") {
+      return false;  // Can't tell where the instructions start
+    }
+    out->insnStart = c.pos;
+    return c.ok && c.pos <= e.end;
+  }
+
+  Cie const* cieAt(size_t off) const {
+    auto it = std::lower_bound(
+        cies_.begin(), cies_.end(), off, [](auto& cie, size_t o) {
+          return cie.offset < o;
+        });
+    return (it != cies_.end() && it->offset == off) ? &*it : nullptr;
+  }
+
+  static void set(Row& row, uint64_t reg, Rule rule) {
+    if (reg < Row::kMaxRegs) { row.regs[reg] = rule; }
+  }
+
+  /**
+  Run CFA instructions in `[start, end)` on `row`, starting at `*loc`, up to
+  (and not including) the first advance past `pc`.  `initial` is the row the
+  CIE's instructions produced (for DW_CFA_restore), or null while running them.
+  */
+  bool run(Cie const& cie,
+           size_t start,
+           size_t end,
+           uintptr_t pc,
+           uintptr_t* loc,
+           Row& row,
+           Row const* initial) const {
+    Cursor c {*this, start, end};
+    // Saved rows, for DW_CFA_remember_state; left uninitialized until used
+    alignas(Row) std::byte states[kMaxStates * sizeof(Row)];
+    unsigned depth = 0;
+    auto daf = cie.dataAlign;
+
+    // Move to `to`; false if that's past `pc`, and we're done
+    auto advance = [&](uintptr_t to) {
+      if (to > pc) {
+        row.end = to;
+        return false;
+      }
+      *loc = row.start = to;
+      return true;
+    };
+    auto restore = [&](uint64_t reg) {
+      set(row, reg, initial ? initial->regs[reg % Row::kMaxRegs] : Rule {});
+    };
+    auto expr = [&](Rule::Kind kind, uint16_t reg) {
+      auto size = c.uleb();
+      Rule rule {kind, reg, uint32_t(size), int64_t(c.pos)};
+      if (c.has(size_t(size))) { c.pos += size_t(size); }
+      return rule;
+    };
+
+    while (c.ok && c.pos < end) {
+      auto op = c.u8();
+      auto low = uint8_t(op & 0x3f);
+      switch (op & 0xc0) {
+      case 0x40:
+        if (!advance(*loc + low * cie.codeAlign)) { return true; }
+        continue;
+      case 0x80:
+        set(row, low, {Rule::kOffset, 0, 0, int64_t(c.uleb()) * daf});
+        continue;
+      case 0xc0: restore(low); continue;
+      }
+      uint64_t reg;
+      switch (op) {
+      case 0x00: break;  // DW_CFA_nop
+      case 0x01:         // DW_CFA_set_loc
+        if (!advance(uintptr_t(c.pointer(cie.fdeEncoding)))) { return true; }
+        break;
+      case 0x02:  // DW_CFA_advance_loc1, 2, 4
+      case 0x03:
+      case 0x04: {
+        auto delta = c.read(op == 0x02 ? 1 : op == 0x03 ? 2 : 4);
+        if (!advance(*loc + delta * cie.codeAlign)) { return true; }
+        break;
+      }
+      case 0x05:  // DW_CFA_offset_extended
+        reg = c.uleb();
+        set(row, reg, {Rule::kOffset, 0, 0, int64_t(c.uleb()) * daf});
+        break;
+      case 0x06: restore(c.uleb()); break;  // DW_CFA_restore_extended
+      case 0x07:                            // DW_CFA_undefined
+        set(row, c.uleb(), {Rule::kUndefined});
+        break;
+      case 0x08: set(row, c.uleb(), {Rule::kSame}); break;  // DW_CFA_same_value
+      case 0x09:                                            // DW_CFA_register
+        reg = c.uleb();
+        set(row, reg, {Rule::kRegister, uint16_t(c.uleb())});
+        break;
+      case 0x0a:  // DW_CFA_remember_state
+        if (depth == kMaxStates) { return false; }
+        memcpy(states + sizeof(Row) * depth++, &row, sizeof(Row));
+        break;
+      case 0x0b:  // DW_CFA_restore_state
+        if (!depth) { return false; }
+        {
+          auto start = row.start;
+          memcpy(&row, states + sizeof(Row) * --depth, sizeof(Row));
+          row.start = start;
+        }
+        break;
+      case 0x0c:  // DW_CFA_def_cfa
+        reg = c.uleb();
+        row.cfa = {Rule::kRegister, uint16_t(reg), 0, int64_t(c.uleb())};
+        break;
+      case 0x0d:  // DW_CFA_def_cfa_register
+        row.cfa.kind = Rule::kRegister;
+        row.cfa.reg = uint16_t(c.uleb());
+        break;
+      case 0x0e: row.cfa.value = int64_t(c.uleb()); break;  // def_cfa_offset
+      case 0x0f: row.cfa = expr(Rule::kValExpression, 0); break;
+      case 0x10:  // DW_CFA_expression
+        reg = c.uleb();
+        set(row, reg, expr(Rule::kExpression, 0));
+        break;
+      case 0x11:  // DW_CFA_offset_extended_sf
+        reg = c.uleb();
+        set(row, reg, {Rule::kOffset, 0, 0, c.sleb() * daf});
+        break;
+      case 0x12:  // DW_CFA_def_cfa_sf
+        reg = c.uleb();
+        row.cfa = {Rule::kRegister, uint16_t(reg), 0, c.sleb() * daf};
+        break;
+      case 0x13: row.cfa.value = c.sleb() * daf; break;  // def_cfa_offset_sf
+      case 0x14:                                         // DW_CFA_val_offset
+        reg = c.uleb();
+        set(row, reg, {Rule::kValOffset, 0, 0, int64_t(c.uleb()) * daf});
+        break;
+      case 0x15:  // DW_CFA_val_offset_sf
+        reg = c.uleb();
+        set(row, reg, {Rule::kValOffset, 0, 0, c.sleb() * daf});
+        break;
+      case 0x16:  // DW_CFA_val_expression
+        reg = c.uleb();
+        set(row, reg, expr(Rule::kValExpression, 0));
+        break;
+      case 0x2d: row.raSigned = !row.raSigned; break;  // negate_ra_state
+      case 0x2e: c.uleb(); break;                      // DW_CFA_GNU_args_size
+      case 0x2f:  // DW_CFA_GNU_negative_offset_extended
+        reg = c.uleb();
+        set(row, reg, {Rule::kOffset, 0, 0, -int64_t(c.uleb()) * daf});
+        break;
+      default: return false;
+      }
+    }
+    return c.ok;
+  }
+
+public:
+  explicit EhFrame(
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : cies_(mr), fdes_(mr) {}
+
+  /**
+  (Re)build from `bin`'s `.eh_frame`.  Returns false if it has none.  Malformed
+  entries are skipped (and counted in `skipped`), as are FDEs with empty ranges,
+  which linkers leave behind for discarded functions.
+  */
+  bool build(binary::Binary const& bin) {
+    util::Stats::Scope timer(util::Timer::kParse);
+    cies_.clear();
+    fdes_.clear();
+    skipped_ = 0;
+    auto sec = bin.section(".eh_frame");
+    if (!sec || sec->fileOffset() + sec->size() > bin.baseAddr().size_) {
+      return false;
+    }
+    data_ = (bin.baseAddr() + sec->fileOffset()).trunc(sec->size());
+    util::Stats::add(util::Counter::kBytesDecoded, sec->size());
+    vaddr_ = sec->virtAddr();
+    isLE_ = bin.isLE();
+    is64_ = bin.is64();
+
+    // CIEs first, so FDEs can refer to them (in either direction) by index
+    Entry e;
+    for (size_t off = 0; entry(off, &e); off = e.end) {
+      if (e.id) { continue; }
+      Cie cie;
+      if (parseCie(off, e, &cie)) {
+        cies_.push_back(cie);
+      } else {
+        ++skipped_;
+      }
+    }
+    for (size_t off = 0; entry(off, &e); off = e.end) {
+      if (!e.id) { continue; }
+      auto* cie = (e.id <= e.idPos) ? cieAt(e.idPos - e.id) : nullptr;
+      if (!cie || e.end > UINT32_MAX) {
+        ++skipped_;
+        continue;
+      }
+      Cursor c {*this, e.idPos + 4, e.end};
+      auto begin = c.pointer(cie->fdeEncoding);
+      auto range = c.pointer(cie->fdeEncoding & 0x0f);
+      if (cie->hasAugData) { c.pos += size_t(c.uleb()); }
+      if (!c.ok || c.pos > e.end) {
+        ++skipped_;
+        continue;
+      }
+      if (!range) { continue; }
+      fdes_.push_back({uintptr_t(begin),
+                       uintptr_t(begin + range),
+                       uint32_t(c.pos),
+                       uint32_t(e.end),
+                       uint32_t(cie - cies_.data())});
+    }
+    std::sort(fdes_.begin(), fdes_.end(), [](auto& a, auto& b) {
+      return a.begin < b.begin;
+    });
+    return true;
+  }
+
+  size_t cieCount() const { return cies_.size(); }
+  size_t fdeCount() const { return fdes_.size(); }
+  size_t skipped() const { return skipped_; }
+
+  /** `.eh_frame`'s contents, where expressions in `Rule`s point. */
+  util::Addr data() const { return data_; }
+
+  /**
+  Fill in `row` with the rules at (link-time) `pc`.  Returns false if no FDE
+  covers it, or its instructions are malformed.  Doesn't allocate.
+  */
+  bool find(uintptr_t pc, Row& row) const {
+    auto it = std::upper_bound(
+        fdes_.begin(), fdes_.end(), pc, [](uintptr_t p, auto& fde) {
+          return p < fde.begin;
+        });
+    if (it == fdes_.begin() || pc >= (--it)->end) { return false; }
+    auto& cie = cies_[it->cie];
+    row = Row {};
+    row.raReg = cie.raReg;
+    row.isSignalFrame = cie.isSignalFrame;
+    row.start = it->begin;
+    row.end = it->end;
+    auto loc = it->begin;
+    if (!run(cie, cie.insnStart, cie.insnEnd, pc, &loc, row, nullptr)) {
+      return false;
+    }
+    Row initial = row;
+    return run(cie, it->insnStart, it->insnEnd, pc, &loc, row, &initial);
+  }
+
+  /**
+  Evaluate the DWARF expression of a `kExpression` or `kValExpression` rule,
+  with `push` (the CFA, except for the CFA's own rule) initially on the stack.
+  `reg(n, &val)` and `load(addr, &val)` get registers and 8-byte words of
+  memory, returning false if they're unavailable.  Only the arithmetic,
+  constant, register and dereference operations are supported; that's what
+  compilers and linkers use in CFI (e.g. for PLT entries).
+  */
+  template <class RegFn, class LoadFn>
+  bool evaluate(Rule const& rule,
+                uint64_t const* push,
+                RegFn&& reg,
+                LoadFn&& load,
+                uint64_t* out) const {
+    constexpr unsigned kMaxStack = 16;
+    auto start = size_t(rule.value);
+    Cursor c {*this, start, start + rule.exprSize};
+    if (!c.has(rule.exprSize)) { return false; }
+    uint64_t stack[kMaxStack];
+    unsigned n = 0;
+    auto pushVal = [&](uint64_t val) {
+      c.ok = c.ok && n < kMaxStack;
+      if (c.ok) { stack[n++] = val; }
+    };
+    auto pop = [&]() -> uint64_t {
+      c.ok = c.ok && n;
+      return c.ok ? stack[--n] : 0;
+    };
+    if (push) { pushVal(*push); }
+
+    while (c.ok && c.pos < c.end) {
+      auto op = c.u8();
+      uint64_t a;
+      uint64_t b;
+      if (op >= 0x30 && op <= 0x4f) {  // DW_OP_lit0-31
+        pushVal(op - 0x30u);
+        continue;
+      }
+      if ((op >= 0x70 && op <= 0x8f) || op == 0x92) {  // DW_OP_breg0-31, bregx
+        auto r = (op == 0x92) ? c.uleb() : op - 0x70u;
+        auto offset = c.sleb();
+        if (!reg(unsigned(r), &a)) { return false; }
+        pushVal(a + uint64_t(offset));
+        continue;
+      }
+      switch (op) {
+      case 0x06:  // DW_OP_deref
+        if (!load(pop(), &a)) { return false; }
+        pushVal(a);
+        break;
+      case 0x08: pushVal(c.read(1)); break;  // DW_OP_const1u
+      case 0x09: pushVal(uint64_t(int8_t(c.read(1)))); break;
+      case 0x0a: pushVal(c.read(2)); break;
+      case 0x0b: pushVal(uint64_t(int16_t(c.read(2)))); break;
+      case 0x0c: pushVal(c.read(4)); break;
+      case 0x0d: pushVal(uint64_t(int32_t(c.read(4)))); break;
+      case 0x0e:
+      case 0x0f: pushVal(c.read(8)); break;
+      case 0x10: pushVal(c.uleb()); break;            // DW_OP_constu
+      case 0x11: pushVal(uint64_t(c.sleb())); break;  // DW_OP_consts
+      case 0x12:                                      // DW_OP_dup
+        a = pop();
+        pushVal(a);
+        pushVal(a);
+        break;
+      case 0x13: pop(); break;  // DW_OP_drop
+      case 0x14:                // DW_OP_over
+        c.ok = c.ok && n >= 2;
+        if (c.ok) { pushVal(stack[n - 2]); }
+        break;
+      case 0x16:  // DW_OP_swap
+        b = pop();
+        a = pop();
+        pushVal(b);
+        pushVal(a);
+        break;
+      case 0x1f: pushVal(-pop()); break;            // DW_OP_neg
+      case 0x20: pushVal(~pop()); break;            // DW_OP_not
+      case 0x23: pushVal(pop() + c.uleb()); break;  // DW_OP_plus_uconst
+      case 0x96: break;                             // DW_OP_nop
+      case 0x1a:  // DW_OP_and, minus, mul, or, plus, shifts, comparisons...
+      case 0x1c:
+      case 0x1e:
+      case 0x21:
+      case 0x22:
+      case 0x24:
+      case 0x25:
+      case 0x26:
+      case 0x27:
+      case 0x29:
+      case 0x2a:
+      case 0x2b:
+      case 0x2c:
+      case 0x2d:
+      case 0x2e:
+        b = pop();
+        a = pop();
+        pushVal(binaryOp(op, a, b));
+        break;
+      default: return false;
+      }
+    }
+    if (!c.ok || !n) { return false; }
+    *out = stack[n - 1];
+    return true;
+  }
+
+private:
+  static uint64_t binaryOp(uint8_t op, uint64_t a, uint64_t b) {
+    auto sa = int64_t(a);
+    auto sb = int64_t(b);
+    switch (op) {
+    case 0x1a: return a & b;
+    case 0x1c: return a - b;
+    case 0x1e: return a * b;
+    case 0x21: return a | b;
+    case 0x22: return a + b;
+    case 0x24: return b < 64 ? a << b : 0;
+    case 0x25: return b < 64 ? a >> b : 0;
+    case 0x26: return uint64_t(b < 64 ? sa >> b : sa >> 63);
+    case 0x27: return a ^ b;
+    case 0x29: return sa == sb;
+    case 0x2a: return sa >= sb;
+    case 0x2b: return sa > sb;
+    case 0x2c: return sa <= sb;
+    case 0x2d: return sa < sb;
+    default: return sa != sb;  // 0x2e, DW_OP_ne
+    }
+  }
+};
+
+}  // namespace proginfo::unwind
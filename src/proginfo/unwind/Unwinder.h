@@ -0,0 +1,569 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "../binary/Binary.h"
+#include "../binary/elf/Notes.h"
+#include "../procinfo/Memory.h"
+#include "../procinfo/ProcInfo.h"
+#include "../util/Alloc.h"
+#include "../util/MMap.h"
+#include "../util/Stats.h"
+#include "../util/ThreadPool.h"
+#include "EhFrame.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace proginfo::unwind {
+
+/** DWARF register numbers of an architecture's stack and frame registers. */
+struct Arch {
+  uint16_t sp;
+  uint16_t fp;
+  uint16_t lr;  // Link register; or the return address column, if none
+  uint16_t pc;  // Number expressions use for the PC
+  bool hasLinkRegister;
+
+  static Arch x86_64() { return {7, 6, 16, 16, false}; }
+  static Arch aarch64() { return {31, 29, 30, 32, true}; }
+
+  static Arch host() {
+#if defined(__aarch64__)
+    return aarch64();
+#else
+    return x86_64();
+#endif
+  }
+};
+
+/**
+The registers a sample's stack walk starts from, e.g. from perf's
+`PERF_SAMPLE_REGS_USER`.  Other registers (and any of these left zero) are
+assumed unknown; CFI rarely needs them.
+*/
+struct Registers {
+  uint64_t pc;
+  uint64_t sp;
+  uint64_t fp;
+  uint64_t lr;  // AArch64 only
+};
+
+/** A copy of some thread's registers and stack, to unwind after the fact. */
+struct Sample {
+  procinfo::ModuleMap const* modules;  // The process's, at the time
+  Registers regs;
+  uint64_t stackAddr;      // Where `stack` was copied from; normally `regs.sp`
+  std::string_view stack;  // The copy (e.g. `PERF_SAMPLE_STACK_USER`'s data)
+  // Optionally, the process's memory (e.g. a `procinfo::RemoteMemory`) to read
+  // what isn't in `stack` from
+  procinfo::MemorySource* memory {};
+};
+
+/** Why a stack walk stopped. */
+enum class Stop : uint8_t {
+  kEnd,         // Outermost frame reached, or a null return address
+  kMaxDepth,    // No room for more frames
+  kNoModule,    // A PC outside any module (JIT code, or a bad return address)
+  kNoCfi,       // No CFI for a PC, and no usable frame pointer
+  kBadCfi,      // CFI we couldn't follow, e.g. an unsupported expression
+  kStackEnd,    // Needed more of the stack than was copied
+  kNoProgress,  // The stack pointer didn't move up; bad CFI or stack data
+};
+
+constexpr size_t kStops = 7;
+
+struct Trace {
+  uint32_t depth;          // PCs stored
+  uint32_t fpFrames;       // Frames unwound by frame pointer, for lack of CFI
+  uint32_t scannedFrames;  // Frames whose frame pointer was found by scanning
+  Stop stop;
+};
+
+struct UnwindStats {
+  size_t samples {};
+  size_t frames {};
+  size_t fpFrames {};
+  size_t scannedFrames {};
+  size_t stops[kStops] {};  // Samples by `Stop`
+  size_t binaries {};       // Distinct binaries with CFI used by this batch
+  size_t indexed {};        // Binaries whose CFI was indexed for this batch
+  size_t chunks {};
+  size_t steals {};
+  uint64_t indexNanos {};  // Wall time spent building indexes
+  uint64_t totalNanos {};
+
+  double perSecond() const {
+    return totalNanos ? double(samples) * 1e9 / double(totalNanos) : 0;
+  }
+};
+
+/*
+Unwinds stacks offline, from samples of registers and stack bytes (as recorded
+by `perf record --call-graph dwarf`) and the sampled process's module map, using
+each binary's `.eh_frame` CFI; or where a binary has none, its frame pointers.
+
+Binaries are found by module build ID (see `addBinary`) or else path, mapped and
+parsed once, and their `EhFrame` indexes built the first time a batch needs
+them; after that, indexes are shared read-only by all samples and threads.
+`unwind`ing a batch spreads its samples across a work-stealing `ThreadPool`.
+
+Samples can also be of live processes: with a `MemorySource` to read the stack
+from, and perhaps only a PC and stack pointer (see
+`procinfo::blockedRegisters`), in which case frame pointers are found by
+scanning the stack when CFI needs them.
+
+Stack copies are read as little-endian 64-bit words; x86-64 and AArch64 are
+supported.  This is for offline use; it uses the heap and isn't signal-safe.
+*/
+class Unwinder {
+  constexpr static size_t kChunk = 1024;
+  constexpr static unsigned kScanWords = 4096;  // How far `scanFp` looks
+
+  struct Image {
+    util::MMap mm;
+    util::Virtual<binary::Binary> bin;
+    std::string buildId;  // Raw bytes
+    EhFrame cfi;
+    bool indexed {};
+    bool hasCfi {};
+
+    // Unwinding jumps around; prefer not to read ahead
+    explicit Image(std::string_view path)
+        : mm(path, {.advice = util::MMap::Advice::kRandom}) {}
+
+    void index() {
+      if (auto sec = bin->section(".eh_frame")) {
+        mm.prefault(sec->fileOffset(), sec->size());
+      }
+      hasCfi = cfi.build(*bin);
+      indexed = true;
+    }
+  };
+
+  /** Registers of the frame being unwound; `valid` has a bit for each. */
+  struct Frame {
+    uint64_t regs[Row::kMaxRegs];
+    uint64_t valid;
+    uint64_t pc;
+    bool isReturn;  // `pc` is a return address; look up `pc - 1`
+
+    bool has(unsigned reg) const {
+      return reg < Row::kMaxRegs && (valid >> reg & 1);
+    }
+    void set(unsigned reg, uint64_t val) {
+      regs[reg] = val;
+      valid |= uint64_t(1) << reg;
+    }
+    void clear(unsigned reg) { valid &= ~(uint64_t(1) << reg); }
+  };
+
+  Arch arch_;
+  util::ThreadPool pool_;
+  std::vector<std::unique_ptr<Image>> images_;
+  std::unordered_map<std::string, Image*> byBuildId_;
+  std::unordered_map<std::string, Image*> byPath_;  // Null if it failed
+  // Each prepared module map's images, by module index; null if none.  Changed
+  // with `mapsMutex_` held exclusively; read with it shared by `unwind`ing
+  // threads, for as long as they use a map's images.
+  mutable std::shared_mutex mapsMutex_;
+  std::unordered_map<procinfo::ModuleMap const*, std::vector<Image*>> maps_;
+
+  using Clock = std::chrono::steady_clock;
+
+  static uint64_t nanosSince(Clock::time_point start) {
+    using std::chrono::nanoseconds;
+    auto elapsed = Clock::now() - start;
+    return uint64_t(std::chrono::duration_cast<nanoseconds>(elapsed).count());
+  }
+
+  /** Raw GNU build ID of the binary, or empty if it has none. */
+  static std::string buildId(binary::Binary const& bin) {
+    return std::string(binary::buildId(bin));
+  }
+
+  Image* load(std::string_view path) {
+    auto [it, isNew] = byPath_.try_emplace(std::string(path), nullptr);
+    if (!isNew) { return it->second; }
+    auto img = std::make_unique<Image>(path);
+    if (!img->mm) { return nullptr; }
+    // The binary might be used (and eventually destroyed) on any worker thread
+    img->bin = binary::Binary::at(img->mm.addr_,
+                                  img->mm.size_,
+                                  false,
+                                  false,
+                                  std::pmr::new_delete_resource());
+    if (!img->bin) { return nullptr; }
+    img->buildId = buildId(*img->bin);
+    if (!img->buildId.empty()) {
+      byBuildId_.try_emplace(img->buildId, img.get());
+    }
+    it->second = img.get();
+    images_.push_back(std::move(img));
+    return it->second;
+  }
+
+  Image* imageFor(procinfo::Module const& mod) {
+    if (mod.buildId.empty()) { return load(mod.path); }
+    auto it = byBuildId_.find(std::string(mod.buildId));
+    if (it != byBuildId_.end()) { return it->second; }
+    auto* img = load(mod.path);
+    // A different build of the file is no use
+    return (img && img->buildId == mod.buildId) ? img : nullptr;
+  }
+
+  /** Find `modules`' binaries, without indexing them yet. */
+  void attach(procinfo::ModuleMap const& modules) {
+    std::unique_lock lock(mapsMutex_);
+    auto& images = maps_[&modules];
+    images.clear();
+    for (auto& mod : modules) { images.push_back(imageFor(mod)); }
+  }
+
+  /** Index the attached binaries not indexed yet, in parallel. */
+  size_t indexAll() {
+    std::unordered_set<Image*> todo;
+    for (auto& [map, images] : maps_) {
+      for (auto* img : images) {
+        if (img && !img->indexed) { todo.insert(img); }
+      }
+    }
+    for (auto* img : todo) {
+      pool_.submit([img] {
+        util::Alloc alloc;
+        img->index();
+      });
+    }
+    pool_.wait();
+    return todo.size();
+  }
+
+  /** The word at `addr` in `sample`'s stack copy (or memory), if it has it. */
+  static bool read(Sample const& sample, uint64_t addr, uint64_t* out) {
+    auto size = sample.stack.size();
+    uint8_t bytes[8];
+    if (size >= 8 && addr >= sample.stackAddr &&
+        addr - sample.stackAddr <= size - 8) {
+      memcpy(bytes, sample.stack.data() + (addr - sample.stackAddr), 8);
+    } else if (!sample.memory || !sample.memory->read(addr, bytes, 8)) {
+      return false;
+    }
+    uint64_t ret = 0;
+    for (unsigned i = 0; i < 8; i++) { ret |= uint64_t(bytes[i]) << (8 * i); }
+    *out = ret;
+    return true;
+  }
+
+  /** Step `f` to its caller using CFI; false (setting `stop`) if we can't. */
+  bool stepCfi(EhFrame const& cfi,
+               Row const& row,
+               Sample const& sample,
+               Frame& f,
+               Stop* stop) const {
+    auto reg = [&](unsigned r, uint64_t* val) {
+      if (!f.has(r)) { return false; }
+      *val = f.regs[r];
+      return true;
+    };
+    auto mem = [&](uint64_t addr, uint64_t* val) {
+      return read(sample, addr, val);
+    };
+
+    uint64_t cfa;
+    if (row.cfa.kind == Rule::kRegister) {
+      if (!f.has(row.cfa.reg)) {
+        *stop = Stop::kBadCfi;
+        return false;
+      }
+      cfa = f.regs[row.cfa.reg] + uint64_t(row.cfa.value);
+    } else if (row.cfa.kind != Rule::kValExpression ||
+               !cfi.evaluate(row.cfa, nullptr, reg, mem, &cfa)) {
+      *stop = Stop::kBadCfi;
+      return false;
+    }
+
+    Frame next = f;
+    auto raStop = Stop::kEnd;
+    for (unsigned r = 0; r < Row::kMaxRegs; r++) {
+      auto& rule = row.regs[r];
+      uint64_t val = 0;
+      uint64_t addr;
+      bool ok = true;
+      auto why = Stop::kStackEnd;
+      switch (rule.kind) {
+      case Rule::kSame: continue;
+      case Rule::kUndefined:
+        ok = false;
+        why = Stop::kEnd;
+        break;
+      case Rule::kOffset:
+        ok = read(sample, cfa + uint64_t(rule.value), &val);
+        break;
+      case Rule::kValOffset: val = cfa + uint64_t(rule.value); break;
+      case Rule::kRegister:
+        ok = reg(rule.reg, &val);
+        why = Stop::kBadCfi;
+        break;
+      case Rule::kExpression:
+        why = Stop::kBadCfi;
+        ok = cfi.evaluate(rule, &cfa, reg, mem, &addr);
+        if (ok) {
+          why = Stop::kStackEnd;
+          ok = read(sample, addr, &val);
+        }
+        break;
+      case Rule::kValExpression:
+        why = Stop::kBadCfi;
+        ok = cfi.evaluate(rule, &cfa, reg, mem, &val);
+        break;
+      }
+      if (ok) {
+        next.set(r, val);
+      } else {
+        next.clear(r);
+        if (r == row.raReg) { raStop = why; }
+      }
+    }
+    next.set(arch_.sp, cfa);
+
+    if (!next.has(row.raReg)) {
+      *stop = raStop;
+      return false;
+    }
+    next.pc = next.regs[row.raReg];
+    if (row.raSigned) { next.pc &= (uint64_t(1) << 48) - 1; }
+    next.isReturn = !row.isSignalFrame;
+    return advance(f, next, stop);
+  }
+
+  /** Whether `pc` is a return address into code we have CFI for. */
+  bool isReturnAddress(Sample const& sample,
+                       std::vector<Image*> const& images,
+                       uint64_t pc) const {
+    auto* mod = sample.modules->find(uintptr_t(pc - 1));
+    auto* img = mod ? images[sample.modules->indexOf(mod)] : nullptr;
+    Row row;
+    return img && img->hasCfi &&
+           img->cfi.find(mod->offset(uintptr_t(pc - 1)), row);
+  }
+
+  /**
+  Find `f`'s frame pointer when it's needed (for its CFA) but wasn't sampled,
+  as when only the PC and stack pointer are known (see
+  `procinfo::blockedRegisters`): the first thing above the stack pointer which
+  looks like a frame record, i.e. a pointer further up the stack (or null)
+  followed by a return address.  A heuristic, but usually right.
+  */
+  bool scanFp(Sample const& sample,
+              std::vector<Image*> const& images,
+              Frame& f) const {
+    if (!f.has(arch_.sp)) { return false; }
+    auto addr = (f.regs[arch_.sp] + 7) & ~uint64_t(7);
+    for (unsigned i = 0; i < kScanWords; i++, addr += 8) {
+      uint64_t savedFp;
+      uint64_t ra;
+      if (!read(sample, addr, &savedFp) || !read(sample, addr + 8, &ra)) {
+        return false;
+      }
+      if ((savedFp > addr || !savedFp) && !(savedFp & 7) &&
+          isReturnAddress(sample, images, ra)) {
+        f.set(arch_.fp, addr);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /** Step `f` to its caller by its frame pointer; false if we can't. */
+  bool stepFp(Sample const& sample, Frame& f, Stop* stop) const {
+    *stop = Stop::kNoCfi;
+    if (!f.has(arch_.fp) || !f.has(arch_.sp)) { return false; }
+    auto fp = f.regs[arch_.fp];
+    if (fp < f.regs[arch_.sp] || (fp & 7)) { return false; }
+    uint64_t savedFp;
+    uint64_t ra;
+    if (!read(sample, fp, &savedFp) || !read(sample, fp + 8, &ra)) {
+      *stop = Stop::kStackEnd;
+      return false;
+    }
+    Frame next = f;
+    next.set(arch_.sp, fp + 16);
+    next.set(arch_.fp, savedFp);
+    next.set(arch_.lr, ra);
+    next.pc = ra;
+    next.isReturn = true;
+    return advance(f, next, stop);
+  }
+
+  /** Move from `f` to `next`, if that's progress up the stack. */
+  bool advance(Frame& f, Frame const& next, Stop* stop) const {
+    auto sp = f.regs[arch_.sp];
+    auto nextSp = next.regs[arch_.sp];
+    if (!next.pc) {
+      *stop = Stop::kEnd;
+      return false;
+    }
+    if (f.has(arch_.sp) && (nextSp < sp || (nextSp == sp && next.pc == f.pc))) {
+      *stop = Stop::kNoProgress;
+      return false;
+    }
+    f = next;
+    return true;
+  }
+
+public:
+  explicit Unwinder(Arch arch = Arch::host(),
+                    unsigned threads = std::thread::hardware_concurrency())
+      : arch_(arch), pool_(threads) {}
+
+  Unwinder(Unwinder const&) = delete;
+  Unwinder& operator=(Unwinder const&) = delete;
+
+  /**
+  Map and parse the binary at `path`, to be used for modules with its build ID
+  (wherever they were loaded from), or with the same path if it has none.  For
+  modules with no binary added, their own paths are tried.  Returns false if it
+  couldn't be loaded.  Like other `Binary` operations, this needs a
+  `util::Alloc` on the calling thread.
+  */
+  bool addBinary(std::string_view path) { return load(path); }
+
+  size_t binaryCount() const { return images_.size(); }
+
+  /**
+  Get ready to unwind samples with this module map: find and index its modules'
+  binaries.  The map must stay as it is, and outlive any use of this by
+  `unwind`; call this again if it changes.  Returns how many modules have CFI.
+  Needs a `util::Alloc` on the calling thread (see `addBinary`).  Can be called
+  while other threads `unwind` single samples (with maps already prepared), but
+  not at the same time as itself or a batch `unwind`.
+  */
+  size_t prepare(procinfo::ModuleMap const& modules) {
+    attach(modules);
+    indexAll();
+    size_t ret = 0;
+    for (auto* img : maps_[&modules]) { ret += img && img->hasCfi; }
+    return ret;
+  }
+
+  /**
+  Unwind one sample (whose module map must be `prepare`d), storing up to `max`
+  PCs in `pcs`: the sampled PC, then return addresses.  Doesn't allocate, and
+  can be called from many threads at once, and while other maps are prepared.
+  */
+  Trace unwind(Sample const& sample, uintptr_t* pcs, size_t max) const {
+    util::Stats::Scope timer(util::Timer::kUnwind);
+    Trace ret {0, 0, 0, Stop::kEnd};
+    std::shared_lock lock(mapsMutex_);
+    auto it = maps_.find(sample.modules);
+    auto* images = (it == maps_.end()) ? nullptr : &it->second;
+    Frame f {};
+    f.set(arch_.sp, sample.regs.sp);
+    if (sample.regs.fp) { f.set(arch_.fp, sample.regs.fp); }
+    if (arch_.hasLinkRegister && sample.regs.lr) {
+      f.set(arch_.lr, sample.regs.lr);
+    }
+    f.pc = sample.regs.pc;
+    Row row;
+    while (f.pc) {
+      if (ret.depth == max) {
+        ret.stop = Stop::kMaxDepth;
+        break;
+      }
+      pcs[ret.depth++] = uintptr_t(f.pc);
+      f.set(arch_.pc, f.pc);
+      auto where = f.isReturn ? f.pc - 1 : f.pc;
+      auto* mod = images ? sample.modules->find(uintptr_t(where)) : nullptr;
+      if (!mod) {
+        ret.stop = Stop::kNoModule;
+        break;
+      }
+      auto* img = (*images)[sample.modules->indexOf(mod)];
+      auto* cfi = (img && img->hasCfi) ? &img->cfi : nullptr;
+      if (cfi && cfi->find(mod->offset(uintptr_t(where)), row)) {
+        if (row.cfa.kind == Rule::kRegister && row.cfa.reg == arch_.fp &&
+            !f.has(arch_.fp) && scanFp(sample, *images, f)) {
+          ++ret.scannedFrames;
+        }
+        if (!stepCfi(*cfi, row, sample, f, &ret.stop)) { break; }
+      } else {
+        if (!stepFp(sample, f, &ret.stop)) { break; }
+        ++ret.fpFrames;
+      }
+    }
+    util::Stats::add(util::Counter::kUnwindSteps, ret.depth);
+    return ret;
+  }
+
+  /**
+  Unwind `n` samples, into the corresponding `out` elements, with sample `i`'s
+  PCs at `pcs + i * maxDepth`.  The samples' module maps are `prepare`d first
+  (so this needs a `util::Alloc` on the calling thread), if they weren't
+  already; those prepared before stay so.  As with `prepare`, other threads can
+  `unwind` single samples meanwhile.
+  */
+  UnwindStats unwind(Sample const* samples,
+                     size_t n,
+                     size_t maxDepth,
+                     uintptr_t* pcs,
+                     Trace* out) {
+    UnwindStats stats;
+    stats.samples = n;
+    auto start = Clock::now();
+    auto steals = pool_.steals();
+
+    // Maps already `prepare`d are kept, for single samples too
+    std::unordered_set<procinfo::ModuleMap const*> batchMaps;
+    for (size_t i = 0; i < n; i++) {
+      auto* modules = samples[i].modules;
+      if (!modules || !batchMaps.insert(modules).second) { continue; }
+      if (!maps_.count(modules)) { attach(*modules); }
+    }
+    auto indexStart = Clock::now();
+    stats.indexed = indexAll();
+    stats.indexNanos = nanosSince(indexStart);
+    {
+      std::unordered_set<Image const*> used;
+      for (auto* map : batchMaps) {
+        for (auto* img : maps_.find(map)->second) {
+          if (img && img->hasCfi) { used.insert(img); }
+        }
+      }
+      stats.binaries = used.size();
+    }
+
+    for (size_t i = 0; i < n; i += kChunk) {
+      auto count = std::min(kChunk, n - i);
+      ++stats.chunks;
+      pool_.submit([this, samples, maxDepth, pcs, out, i, count] {
+        for (auto j = i; j < i + count; j++) {
+          out[j] = unwind(samples[j], pcs + j * maxDepth, maxDepth);
+        }
+      });
+    }
+    pool_.wait();
+
+    for (size_t i = 0; i < n; i++) {
+      stats.frames += out[i].depth;
+      stats.fpFrames += out[i].fpFrames;
+      stats.scannedFrames += out[i].scannedFrames;
+      ++stats.stops[size_t(out[i].stop)];
+    }
+    stats.steals = pool_.steals() - steals;
+    stats.totalNanos = nanosSince(start);
+    return stats;
+  }
+};
+
+}  // namespace proginfo::unwind
@@ -1,6 +1,8 @@
 #pragma once
 static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
 
+#include "Stats.h"
+
 #include <algorithm>
 #include <cassert>
 #include <cmath>
@@ -42,7 +44,11 @@ in threads subsequently _spawned by_ T.
 
 This is a `std::pmr::memory_resource`, so it's easily usable with `std::pmr::allocator`.
 
-FIXME: Probably worth profiling.
+The default 640 bytes suit the handful of small objects `Binary` and friends create.
+For heavier work, hand the constructor a bigger buffer (static, or on some big stack)
+of up to 1MB.  Allocation is first-fit, so it's linear in the number of live blocks;
+if that matters, consider `Arena` (bump allocation, freed all at once) or `Pool`
+(size-class free lists), which are also `memory_resource`s.
 */
 
 class Alloc : public std::pmr::memory_resource {
@@ -67,7 +73,7 @@ private:
   // Allocate in units of this size
   constexpr static unsigned kSlotSize = alignof(std::max_align_t);
 
-  // Total size of this storage in bytes
+  // Total size of the default (inline) storage in bytes
   constexpr static unsigned kSize = 640;
   static_assert(!(kSize % kSlotSize));
 
@@ -82,11 +88,12 @@ private:
   void recordDealloc(unsigned slots);
   void checkStats();
 
-  // We have this many slots to work with.
+  // We have this many slots to work with, by default.
   constexpr static unsigned kSlots = kSize / kSlotSize;
 
-  // In some places a slot index is represented with a uint16_t; avoid overflow
-  static_assert(kSlots < 65536);
+  // Block sizes are represented with a uint16_t; avoid overflow
+  constexpr static unsigned kMaxSlots = 65536;
+  static_assert(kSlots <= kMaxSlots);
 
   // Each allocation of size S will occupy:
   //   * ceil(S / kSlotSize) slots as contiguous byte storage
@@ -124,9 +131,9 @@ private:
   // occasionally coalesce free blocks: find consecutive adjacent free-chunks and
   // merge them.
   //
-  // When deallocating we'll try twice to coalesce free blocks.  This is limited to
-  // two attempts simply to balance housekeeping operations vs. efficiency with respect
-  // to space.  If an allocation fails we'll aggressively coalesce-and-retry until it succeeds.
+  // When deallocating we'll merge the freed block with any free blocks following it,
+  // which is cheap since it doesn't need a scan.  If an allocation fails we'll coalesce
+  // every run of free blocks in one pass, and retry once more.
 
   struct Slot {
     char type;      // F(ree) or U(sed)
@@ -135,15 +142,18 @@ private:
   };
   static_assert(sizeof(Slot) == kSlotSize);
 
-  // Together these slots form our memory space.
+  // Default storage, used unless the constructor was given some other space.
   // We won't initialize these bytes in the interest of fast init / destruction.
-  Slot slots_[kSlots];
+  Slot local_[kSlots];
+
+  // Together these slots form our memory space.
+  Slot* const slots_;
+  unsigned const numSlots_;
 
-  // We use this invalid "index" as a special value indicating failure.
-  constexpr static unsigned kInvalid = kSlots;
+  // We use the invalid "index" `numSlots_` as a special value indicating failure.
 
   // When linear-searching for free blocks, start here (instead of at 0).
-  unsigned firstFree_ {kInvalid};
+  unsigned firstFree_ {numSlots_};
 
 public:
   virtual ~Alloc() {
@@ -153,17 +163,30 @@ public:
     checkStats();  // dump stats if debugging; also check alloc/dealloc count, abort if wrong
   }
 
-  Alloc() {
+  Alloc() : Alloc(local_, sizeof(local_)) {}
+
+  /**
+  Use `size` bytes at `space` (which must be aligned to `max_align_t`, and outlive this)
+  instead of the default 640 bytes of inline storage.
+  */
+  Alloc(void* space, size_t size)
+      : slots_((Slot*) space)
+      , numSlots_(unsigned(std::min<size_t>(size / kSlotSize, kMaxSlots))) {
+    assert(!(uintptr_t(space) % kSlotSize));
+    assert(numSlots_ >= 2);
     // Ensure none exists in (thread-local) context
     assert(!instance_);
     // Initialize only the first entry as free space
-    slots_[0] = {.type = 'F', .size = kSlots - 1, ._pad = {}};
+    slots_[0] = {.type = 'F', .size = uint16_t(numSlots_ - 1), ._pad = {}};
     // Initially first free block (and only free block) is at 0.
     firstFree_ = 0;
     // "Install" self as thread's allocator (until destruction)
     instance_ = this;
   }
 
+  /** Total bytes of storage (including bookkeeping) */
+  size_t capacity() const { return size_t(numSlots_) * kSlotSize; }
+
   // We want this thing to be parked in a predictable place on the stack,
   // so no copying or moving is allowed.
   Alloc(Alloc const&) = delete;
@@ -184,7 +207,7 @@ public:
   // Doesn't support large alignments, i.e. fails if align is > `kSlotSize`.
   [[nodiscard]] void* do_allocate(size_t size, size_t align) override {
     if (align > kSlotSize) { throw std::bad_alloc(); }
-    if (size > kSize) { throw std::bad_alloc(); }
+    if (size > capacity()) { throw std::bad_alloc(); }
     auto ret = (void*) alloc(unsigned(size));
     if (ret == nullptr) { throw std::bad_alloc(); }
     return ret;
@@ -194,7 +217,7 @@ public:
   // `size` and `align` are not useful here, but they are checked for unreasonable values.
   void do_deallocate(void* ptr, size_t size, size_t align) noexcept override {
     assert (align <= kSlotSize);
-    assert (size <= kSize);
+    assert (size <= capacity());
     dealloc(ptr);
   }
 
@@ -203,12 +226,12 @@ public:
   std::pmr::polymorphic_allocator<T> pmrAlloc() { return {this}; }
 
   [[nodiscard]] std::byte* alloc(unsigned size) {
-    if (size > kSize) { return nullptr; }             // Check within reason
+    if (size > capacity()) { return nullptr; }        // Check within reason
     if (!size) { ++size; }                            // Prevent zero-size allocations
     auto slots = (size + kSlotSize - 1) / kSlotSize;  // Determine number of slots, rounding up
 retry:
     auto index = claimSpace(unsigned(slots));         // Find first free slot;
-    if (index == kInvalid) {                          // invalid index means no space.
+    if (index == numSlots_) {                          // invalid index means no space.
       if (coalesce()) { goto retry; }                 // If we could coalesce any free slots, retry.
       return nullptr;                                 // Otherwise if we couldn't coalesce; fail.
     }
@@ -222,19 +245,21 @@ retry:
     auto thisP = uintptr_t(_obj) - kSlotSize;         // Object's slot "header" immediately precedes object
     auto& thisM = *(Slot*) (thisP);                   // Get location of this header-slot,
     assert (thisM.type == 'U');                       // verify it's an allocated obj.
-    assert (thisP >= uintptr_t(&slots_));             // Range check: ensure this space belongs to us
-    assert (thisP < uintptr_t(slots_ + kSlots));      // Range check: ensure this space belongs to us
+    assert (thisP >= uintptr_t(slots_));              // Range check: ensure this space belongs to us
+    assert (thisP < uintptr_t(slots_ + numSlots_));   // Range check: ensure this space belongs to us
     assert(!(thisP % kSlotSize));                     // (Should be aligned)
     thisM.type = 'F';                                 // Mark this chunk as free,
     recordDealloc(thisM.size);                        // do bookkeeping,
-    coalesce();                                       // and finally coalesce if possible.
+    auto thisI = unsigned(&thisM - slots_);           // then absorb any free blocks just after this one.
+    mergeFollowing(thisI);                            // (Free blocks before this one are merged lazily,
+    firstFree_ = std::min(firstFree_, thisI);         // by `coalesce`, if an allocation needs the space.)
   }
 
 private:
   /** Search the structures in our space for a free block of sufficient size. */
   unsigned claimSpace(unsigned slots) {
-    unsigned thisI = firstFree_ % kSlots;             // Starting at first [free, if known] block, search through
-    while (thisI < kSlots) {                          // each allocation, stopping at end of space.
+    unsigned thisI = firstFree_ % numSlots_;          // Starting at first [free, if known] block, search through
+    while (thisI < numSlots_) {                       // each allocation, stopping at end of space.
       auto& thisM = slots_[thisI];                    // At this slot,
       if (thisM.type == 'F' && thisM.size >= slots) { // if this is free space, and it's big enough,
         splitFree(thisI, slots);                      // then carve out space that we need
@@ -242,7 +267,7 @@ private:
       }
       thisI = thisI + thisM.size + 1;                 // Otherwise keep searching ...
     }
-    return kInvalid;                                  // Failed
+    return numSlots_;                                  // Failed
   }
 
   /** Given this free space block, split it into a "used" block for the allocation of
@@ -253,7 +278,7 @@ private:
     if (thisM.size < slots + 2) {                     // but if this is isn't quite big enough to split,
       thisM.type = 'U';                               // we'll just claim this whole block.
       if (firstFree_ == thisI) {                      // If this block was the first free, block,
-        firstFree_ = kInvalid;                        // then invalidate it, because we don't know where next is
+        firstFree_ = numSlots_;                        // then invalidate it, because we don't know where next is
       }
       return;
     }
@@ -266,29 +291,35 @@ private:
     firstFree_ = std::min(firstFree_, thisI);
   }
 
-  /** Merge adjacent free blocks, stopping after merging the first-found pair of free blocks. */
+  /** Merge the free block at `thisI` with any free blocks directly following it. */
+  bool mergeFollowing(unsigned thisI) {
+    auto& thisS = slots_[thisI];                      // Looking at this free block,
+    bool merged = false;
+    while (true) {
+      auto nextI = thisI + thisS.size + 1;            // and the one after it:
+      if (nextI == numSlots_) { return merged; }      // if this is at the end, we're done;
+      assert(nextI < numSlots_);                      // (nextI shouldn't have exceeded this area)
+      auto& nextS = slots_[nextI];
+      if (nextS.type != 'F') { return merged; }       // if the next block is used, we're done;
+      thisS.size = uint16_t(thisS.size + nextS.size + 1);  // otherwise swallow it and keep going.
+      merged = true;
+    }
+  }
+
+  /** Merge all runs of adjacent free blocks, in one pass.  Returns true if anything merged. */
   bool coalesce() {
-    unsigned thisI = firstFree_ % kSlots;             // Starting at first [free, if known] block,
-    while (thisI != kSlots) {                         // we'll scan the entire space for free blocks
-      assert(thisI < kSlots);                         // (thisI shouldn't have exceeded this area)
+    bool merged = false;
+    unsigned thisI = firstFree_ % numSlots_;          // Starting at first [free, if known] block,
+    while (thisI != numSlots_) {                      // we'll scan the entire space for free blocks
+      assert(thisI < numSlots_);                      // (thisI shouldn't have exceeded this area)
       auto& thisS = slots_[thisI];                    // We'll examine this slot,
-      auto nextI = thisI + thisS.size + 1;            //  and the one after it, for mergeable free space.
-      if (thisS.type != 'F') {                        // If this isn't free space, skip.
-        thisI = nextI;                                // Move on to next block.
-        continue;
-      }
-      if (nextI == kSlots) { return false; }          // If it's at the end, we're done; indicate no merges.
-      assert(nextI < kSlots);                         // (nextI shouldn't have exceeded this area)
-      auto& nextS = slots_[nextI];                    // Otherwise, at the next slot,
-      if (nextS.type != 'F') {                        // if we don't see free space, then
-        thisI = nextI + nextS.size + 1;               // move right along; skip `this` _and_ `next`.
-        continue;
+      if (thisS.type == 'F') {                        // and if it's free space,
+        merged |= mergeFollowing(thisI);              // merge with whatever free space follows,
+        firstFree_ = std::min(firstFree_, thisI);     // and if this is the earliest free block, note that.
       }
-      thisS.size = thisS.size + nextS.size + 1;       // Othe rwise, we can merge; enlarge the earlier freeblock.
-      firstFree_ = std::min(firstFree_, thisI);       // If this is the earliest free block, update that.
-      return true;                                    // Indicate we made some progress on merging.
+      thisI = thisI + thisS.size + 1;                 // Move on to next block.
     }
-    return false;
+    return merged;
   }
 };
 
@@ -296,17 +327,18 @@ inline thread_local Alloc* Alloc::instance_ {nullptr};
 
 inline void Alloc::recordAlloc(unsigned slots) {
   allocs_++;
-  if (!kDebug) { return; }
+  if (!kDebug && !Stats::kEnabled) { return; }
   allocSlots_ += slots;
   auto active = allocs_ - deallocs_;
   auto activeSlots = allocSlots_ - deallocSlots_;
   highMarkAllocs_ = std::max(highMarkAllocs_, active);
   highMarkSlots_ = std::max(highMarkSlots_, activeSlots);
+  Stats::max(Gauge::kAllocHighWater, uint64_t(highMarkSlots_) * kSlotSize);
 }
 
 inline void Alloc::recordDealloc(unsigned slots) {
   deallocs_++;
-  if (!kDebug) { return; }
+  if (!kDebug && !Stats::kEnabled) { return; }
   deallocSlots_ += slots;
   auto active = allocs_ - deallocs_;
   auto activeSlots = allocSlots_ - deallocSlots_;
@@ -331,7 +363,7 @@ inline void Alloc::checkStats() {
   if (!kDebug) { return; }
 
   auto totalUsed = (highMarkAllocs_ + highMarkSlots_) * kSlotSize;
-  auto totalUtil = float(totalUsed) / kSize;
+  auto totalUtil = float(totalUsed) / float(capacity());
   printf("### allocs:%4d deallocs:%4d allocSlots:%4d deallocSlots:%4d "
          "highMarkAllocs:%4d highMarkSlots:%4d; "
          "peak usage %d bytes (%d%%)\n",
@@ -0,0 +1,107 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+
+namespace proginfo::util {
+
+/*
+Monotonic ("bump") allocator over a fixed region of memory.
+
+Allocation just advances a pointer, so it's constant time and has no per-block
+overhead.  Individual deallocations are ignored (except for the most recent one,
+which is simply un-bumped); instead, everything is released at once with
+`reset`, or back to some earlier point with a `Scope`. This suits scoped jobs,
+e.g. the symbolization of one stack trace, which create lots of short-lived
+objects and then discard them all together.
+
+The memory is provided by the caller (see also `StackArena`) and this never
+falls back to the heap, so it's safe to use in a signal handler.  Like `Alloc`,
+this is a `std::pmr::memory_resource`; unlike `Alloc` it isn't installed in any
+thread-local context.  Not thread-safe.
+*/
+class Arena : public std::pmr::memory_resource {
+  std::byte* const base_;
+  size_t const size_;
+  size_t used_ {0};
+  size_t last_ {0};  // Offset of most recent allocation, so it can be undone
+  size_t highMark_ {0};
+
+public:
+  /** Allocate from `size` bytes at `space`, which must outlive this arena. */
+  Arena(void* space, size_t size) : base_((std::byte*) space), size_(size) {}
+
+  Arena(Arena const&) = delete;
+  Arena(Arena&&) = delete;
+  Arena& operator=(Arena const&) = delete;
+  Arena& operator=(Arena&&) = delete;
+
+  size_t capacity() const { return size_; }
+  size_t used() const { return used_; }
+  size_t highMark() const { return highMark_; }
+
+  /** Allocate `size` bytes, aligned to `align`; nullptr if there's no room. */
+  [[nodiscard]] void*
+  alloc(size_t size, size_t align = alignof(std::max_align_t)) {
+    assert(align && !(align & (align - 1)));
+    auto addr = uintptr_t(base_) + used_;
+    auto pad = (align - (addr % align)) % align;
+    if (pad > size_ - used_ || size > size_ - used_ - pad) { return nullptr; }
+    last_ = used_;
+    used_ += pad + size;
+    if (used_ > highMark_) { highMark_ = used_; }
+    return (void*) (addr + pad);
+  }
+
+  /** Releases only the most recent allocation; others wait for `reset`. */
+  void dealloc(void* ptr, size_t size) {
+    assert(!ptr || (ptr >= base_ && (std::byte*) ptr + size <= base_ + used_));
+    if (ptr && (std::byte*) ptr + size == base_ + used_) { used_ = last_; }
+  }
+
+  /** Release everything allocated so far. */
+  void reset() { used_ = last_ = 0; }
+
+  /** Releases everything allocated during its lifetime (and nothing else). */
+  class Scope {
+    Arena& arena_;
+    size_t const used_;
+
+  public:
+    explicit Scope(Arena& arena) : arena_(arena), used_(arena.used_) {}
+    ~Scope() { arena_.used_ = arena_.last_ = used_; }
+    Scope(Scope const&) = delete;
+    Scope& operator=(Scope const&) = delete;
+  };
+
+protected:
+  [[nodiscard]] void* do_allocate(size_t size, size_t align) override {
+    auto* ret = alloc(size, align);
+    if (!ret) { throw std::bad_alloc(); }
+    return ret;
+  }
+
+  void do_deallocate(void* ptr, size_t size, size_t) noexcept override {
+    dealloc(ptr, size);
+  }
+
+  bool do_is_equal(
+      std::pmr::memory_resource const& rhs) const noexcept override {
+    return &rhs == this;
+  }
+};
+
+/** An `Arena` with `kSize` bytes of inline storage, e.g. on the stack. */
+template <size_t kSize>
+class StackArena : public Arena {
+  alignas(std::max_align_t) std::byte space_[kSize];
+
+public:
+  StackArena() : Arena(space_, kSize) {}
+};
+
+}  // namespace proginfo::util
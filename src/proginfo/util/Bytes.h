@@ -5,6 +5,7 @@ static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
 #include <cstddef>
 #include <cstdlib>
 #include <cstring>
+#include <new>
 #include <string_view>
 
 namespace proginfo::util {
@@ -0,0 +1,83 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <unistd.h>
+
+namespace proginfo::util {
+
+/*
+Buffered, formatted output straight to a file descriptor, for use where stdio
+isn't safe (signal handlers; after `fork`).  Only `write` is called, and only
+when the buffer fills up, or on `flush`; errors are ignored, since there's
+usually nowhere left to report them.
+*/
+class FdWriter {
+  int fd_;
+  size_t used_ {};
+  char buf_[512];
+
+public:
+  explicit FdWriter(int fd) : fd_(fd) {}
+  ~FdWriter() { flush(); }
+
+  FdWriter(FdWriter const&) = delete;
+  FdWriter& operator=(FdWriter const&) = delete;
+
+  void flush() {
+    size_t done = 0;
+    while (done < used_) {
+      auto n = ::write(fd_, buf_ + done, used_ - done);
+      if (n < 0 && errno == EINTR) { continue; }
+      if (n <= 0) { break; }
+      done += size_t(n);
+    }
+    used_ = 0;
+  }
+
+  FdWriter& put(char c) {
+    if (used_ == sizeof(buf_)) { flush(); }
+    buf_[used_++] = c;
+    return *this;
+  }
+
+  FdWriter& put(std::string_view str) {
+    for (char c : str) { put(c); }
+    return *this;
+  }
+
+  FdWriter& putDec(uint64_t val) {
+    char digits[20];
+    unsigned n = 0;
+    do {
+      digits[n++] = char('0' + val % 10);
+      val /= 10;
+    } while (val);
+    while (n) { put(digits[--n]); }
+    return *this;
+  }
+
+  /** Hex with a `0x` prefix, zero-padded to at least `width` digits. */
+  FdWriter& putHex(uint64_t val, unsigned width = 1) {
+    char digits[16];
+    unsigned n = 0;
+    do {
+      digits[n++] = "0123456789abcdef"[val & 15];
+      val >>= 4;
+    } while (val);
+    put("0x");
+    for (; width > n; --width) { put('0'); }
+    while (n) { put(digits[--n]); }
+    return *this;
+  }
+
+  /** For `DemangleSink`'s streaming mode: `ctx` is an `FdWriter`. */
+  static void sinkFlush(void* ctx, char const* data, size_t size) {
+    ((FdWriter*) ctx)->put({data, size});
+  }
+};
+
+}  // namespace proginfo::util
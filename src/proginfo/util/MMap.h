@@ -1,13 +1,16 @@
 #pragma once
 static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
 
+#include "Stats.h"
+
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
 #include <cstddef>
-#include <cstdio>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <fcntl.h>
-#include <iostream>
 #include <string_view>
 #include <sys/mman.h>
 #include <sys/types.h>
@@ -15,53 +18,226 @@ static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
 
 namespace proginfo::util {
 
+/*
+Read-only mapping of a file, or of some byte range of it.
+
+By default the whole file is mapped, with no particular advice to the kernel.
+For large files (e.g. multi-GB debug info), `MMap::Options` can limit the
+mapping to a range, and set an access pattern and/or prefault pages up front;
+after mapping, `advise` and `prefault` can do the same for smaller ranges,
+such as individual sections.  Offsets given to these are file offsets, as in
+section headers, whatever range was mapped.
+
+Page faults on hot sections (`.symtab`, `.strtab`, `.eh_frame_hdr`) are most of
+the cold-start cost of symbolization, so it's usually worth prefaulting just
+those, and advising `kRandom` for the rest.
+
+Options which the platform doesn't support (e.g. huge pages on OSX) are
+ignored.
+*/
 struct MMap {
+  enum class Advice {
+    kNormal,
+    kSequential,  // Read ahead aggressively; e.g. for a full scan
+    kRandom,      // Don't read ahead; e.g. for binary searches
+    kWillNeed,    // Start reading it in now
+  };
+
+  struct Options {
+    size_t offset {0};  // Start of range to map (needn't be page-aligned)
+    size_t length {0};  // Length of range; 0 means to end of file
+    Advice advice {Advice::kNormal};
+    bool populate {false};   // Prefault the whole range before returning
+    bool hugePages {false};  // Use transparent huge pages, where supported
+  };
+
   std::string_view path_;
-  int fd_;
-  size_t size_ {};
-  void const* addr_ {};
+  int fd_ {-1};
+  size_t size_ {};       // Size of the mapped range (not necessarily the file)
+  void const* addr_ {};  // Address of the range's first byte
   int errno_ {};
+  size_t offset_ {};  // File offset corresponding to `addr_`
+  void* mapAddr_ {};  // Page-aligned start of the mapping
+  size_t mapSize_ {};
 
+  /** Abort (with a message on stderr) if the file couldn't be mapped. */
   MMap& check() {
     if (!*this) {
-      if (errno_) {
-        std::cerr << "MMap check failed: " << strerror(errno_) << '\n';
-        abort();
-      }
+      char const* what = errno_ ? strerror(errno_) : "empty range";
+      writeErr("MMap check failed: ");
+      writeErr(what);
+      writeErr("\n");
+      abort();
     }
     return *this;
   }
 
-  explicit MMap(std::string_view path) : path_(path) {
-    fd_ = open(path.data(), O_RDONLY);
+  explicit MMap(std::string_view path) : MMap(path, Options {}) {}
+
+  MMap(std::string_view path, Options const& opts) : path_(path) {
+    Stats::Scope timer(Timer::kIO);
+    // `path` isn't necessarily NUL-terminated
+    char pathz[4096];
+    if (path.size() >= sizeof(pathz)) {
+      errno_ = ENAMETOOLONG;
+      return;
+    }
+    memcpy(pathz, path.data(), path.size());
+    pathz[path.size()] = 0;
+
+    fd_ = open(pathz, O_RDONLY);
     if (fd_ < 0) {
       errno_ = errno;
       return;
     }
+    map(opts);
+  }
+
+  /**
+  Map the file `path`, already open (for reading) as `fd`, which this then owns,
+  and closes.  E.g. for files opened asynchronously; see `binary::Loader`.
+  */
+  MMap(std::string_view path, int fd, Options const& opts)
+      : path_(path)
+      , fd_(fd) {
+    Stats::Scope timer(Timer::kIO);
+    if (fd_ < 0) {
+      errno_ = EBADF;
+      return;
+    }
+    map(opts);
+  }
+
+  ~MMap() {
+    if (mapAddr_) { munmap(mapAddr_, mapSize_); }
+    if (fd_ >= 0) { close(fd_); }
+  }
+
+  MMap(MMap const&) = delete;
+  MMap& operator=(MMap const&) = delete;
+
+  operator bool() const { return addr_ && size_; }
 
+  /** Whether the file range `[offset, offset + size)` is within the mapping. */
+  bool contains(size_t offset, size_t size) const {
+    return offset >= offset_ && offset - offset_ <= size_ &&
+           size <= size_ - (offset - offset_);
+  }
+
+  /** Pointer to the byte at file offset `offset`, which must be mapped. */
+  void const* at(size_t offset) const {
+    assert(contains(offset, 0));
+    return (std::byte const*) addr_ + (offset - offset_);
+  }
+
+  /**
+  Tell the kernel how the file range `[offset, offset + size)` will be read.
+  The range is clipped to the mapping.  Returns false if that fails (it's only
+  a hint, so that's usually not a problem).
+  */
+  bool advise(size_t offset, size_t size, Advice advice) const {
+    void* start;
+    size_t len;
+    if (!pages(offset, size, &start, &len)) { return false; }
+    return !madvise(start, len, toMAdv(advice));
+  }
+
+  /**
+  Fault in the pages of the file range `[offset, offset + size)` (clipped to
+  the mapping) now, so that later accesses don't stall on I/O.
+  */
+  void prefault(size_t offset, size_t size) const {
+    void* start;
+    size_t len;
+    if (!pages(offset, size, &start, &len)) { return; }
+    madvise(start, len, MADV_WILLNEED);
+    auto page = pageSize();
+    auto const* bytes = (unsigned char const volatile*) start;
+    unsigned char sum = 0;
+    for (size_t i = 0; i < len; i += page) { sum ^= bytes[i]; }
+    (void) sum;
+  }
+
+private:
+  /** Map the range of the file (open as `fd_`) that `opts` asks for. */
+  void map(Options const& opts) {
     off_t seekRes = lseek(fd_, 0, SEEK_END);
     if (seekRes < 0) {
       errno_ = errno;
-      close(fd_);
       return;
     }
-    size_ = size_t(seekRes);
+    auto fileSize = size_t(seekRes);
+    if (opts.offset > fileSize) {
+      errno_ = EINVAL;
+      return;
+    }
+    auto length = opts.length ? opts.length : fileSize - opts.offset;
+    if (length > fileSize - opts.offset) {
+      errno_ = EINVAL;
+      return;
+    }
+    if (!length) { return; }
 
-    auto* mmapRes = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+    auto pageOff = opts.offset - (opts.offset % pageSize());
+    auto mapSize = length + (opts.offset - pageOff);
+    int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+    if (opts.populate) { flags |= MAP_POPULATE; }
+#endif
+    auto* mmapRes =
+        mmap(nullptr, mapSize, PROT_READ, flags, fd_, off_t(pageOff));
     if (mmapRes == MAP_FAILED) {
       errno_ = errno;
-      close(fd_);
       return;
     }
-    addr_ = mmapRes;
+    mapAddr_ = mmapRes;
+    mapSize_ = mapSize;
+    offset_ = opts.offset;
+    size_ = length;
+    addr_ = (std::byte const*) mmapRes + (opts.offset - pageOff);
+
+#ifdef MADV_HUGEPAGE
+    if (opts.hugePages) { madvise(mapAddr_, mapSize_, MADV_HUGEPAGE); }
+#endif
+    if (opts.advice != Advice::kNormal) {
+      advise(offset_, size_, opts.advice);
+    }
+#ifndef MAP_POPULATE
+    if (opts.populate) { prefault(offset_, size_); }
+#endif
   }
 
-  ~MMap() {
-    if (addr_ && size_) { munmap((void*) addr_, size_); }
-    if (fd_) { close(fd_); }
+  static size_t pageSize() {
+    static size_t const ret = size_t(sysconf(_SC_PAGESIZE));
+    return ret;
   }
 
-  operator bool() const { return addr_ && size_; }
+  static void writeErr(char const* msg) {
+    auto ret = write(STDERR_FILENO, msg, strlen(msg));
+    (void) ret;
+  }
+
+  static int toMAdv(Advice advice) {
+    switch (advice) {
+    case Advice::kSequential: return MADV_SEQUENTIAL;
+    case Advice::kRandom: return MADV_RANDOM;
+    case Advice::kWillNeed: return MADV_WILLNEED;
+    default: return MADV_NORMAL;
+    }
+  }
+
+  /** Page-aligned bounds of the mapped part of a file range. */
+  bool pages(size_t offset, size_t size, void** start, size_t* len) const {
+    if (!mapAddr_) { return false; }
+    auto begin = std::max(offset, offset_);
+    auto end = std::min(offset + size, offset_ + size_);
+    if (begin >= end) { return false; }
+    auto base = uintptr_t(addr_) - offset_;  // Address of file offset 0
+    auto first = (base + begin) - ((base + begin) % pageSize());
+    *start = (void*) first;
+    *len = (base + end) - first;
+    return true;
+  }
 };
 
 }  // namespace proginfo::util
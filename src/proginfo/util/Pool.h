@@ -0,0 +1,128 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+
+namespace proginfo::util {
+
+/*
+Allocator with per-size-class free lists, over a fixed region of memory.
+
+Requests are rounded up to a power of two, from `kMinBlock` through `kMaxBlock`
+bytes.  Blocks are carved out of the region as needed, and when freed, go onto
+the free list for their size class to be reused by the next allocation of that
+class.  So both allocation and deallocation are constant time, regardless of how
+many blocks are live, which suits mixed workloads with lots of churn (where
+`Alloc` would spend its time scanning, and an `Arena` would never reclaim
+anything).
+
+Memory is never returned from one size class to another, so a workload which
+changes its mix of sizes over time may run out of room sooner than with `Alloc`.
+
+The memory is provided by the caller (see also `StackPool`) and this never falls
+back to the heap, so it's safe to use in a signal handler.  Not thread-safe.
+*/
+class Pool : public std::pmr::memory_resource {
+public:
+  constexpr static size_t kMinBlock = 16;
+  constexpr static size_t kMaxBlock = 4096;
+  constexpr static unsigned kClasses = 9;  // 16, 32, ..., 4096
+  static_assert(kMinBlock << (kClasses - 1) == kMaxBlock);
+
+private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  std::byte* const base_;
+  size_t const size_;
+  size_t carved_ {0};  // Bytes from the start of the region given to classes
+  FreeBlock* free_[kClasses] {};
+  unsigned live_ {0};
+
+  static unsigned classOf(size_t size) {
+    unsigned ret = 0;
+    for (size_t block = kMinBlock; block < size; block <<= 1) { ++ret; }
+    return ret;
+  }
+
+public:
+  /** Allocate from `size` bytes at `space`, which must outlive this pool. */
+  Pool(void* space, size_t size) : base_((std::byte*) space), size_(size) {
+    assert(!(uintptr_t(space) % kMinBlock));
+  }
+
+  Pool(Pool const&) = delete;
+  Pool(Pool&&) = delete;
+  Pool& operator=(Pool const&) = delete;
+  Pool& operator=(Pool&&) = delete;
+
+  size_t capacity() const { return size_; }
+
+  /** Number of blocks currently allocated */
+  unsigned live() const { return live_; }
+
+  /**
+  Allocate `size` bytes, or return nullptr if too big or there's no room.
+  Blocks are aligned to `kMinBlock` bytes, so `align` can't exceed that.
+  */
+  [[nodiscard]] void*
+  alloc(size_t size, size_t align = alignof(std::max_align_t)) {
+    if (size > kMaxBlock || align > kMinBlock) { return nullptr; }
+    auto cls = classOf(size);
+    auto* ret = free_[cls];
+    if (ret) {
+      free_[cls] = ret->next;
+    } else {
+      auto block = kMinBlock << cls;
+      if (block > size_ - carved_) { return nullptr; }
+      ret = (FreeBlock*) (base_ + carved_);
+      carved_ += block;
+    }
+    ++live_;
+    return ret;
+  }
+
+  /** Return a block obtained from `alloc`; `size` must be as requested. */
+  void dealloc(void* ptr, size_t size) {
+    if (!ptr) { return; }
+    assert(ptr >= base_ && ptr < base_ + carved_);
+    assert(size <= kMaxBlock);
+    auto cls = classOf(size);
+    auto* block = (FreeBlock*) ptr;
+    block->next = free_[cls];
+    free_[cls] = block;
+    --live_;
+  }
+
+protected:
+  [[nodiscard]] void* do_allocate(size_t size, size_t align) override {
+    auto* ret = alloc(size, align);
+    if (!ret) { throw std::bad_alloc(); }
+    return ret;
+  }
+
+  void do_deallocate(void* ptr, size_t size, size_t) noexcept override {
+    dealloc(ptr, size);
+  }
+
+  bool do_is_equal(
+      std::pmr::memory_resource const& rhs) const noexcept override {
+    return &rhs == this;
+  }
+};
+
+/** A `Pool` with `kSize` bytes of inline storage, e.g. on the stack. */
+template <size_t kSize>
+class StackPool : public Pool {
+  alignas(std::max_align_t) std::byte space_[kSize];
+
+public:
+  StackPool() : Pool(space_, kSize) {}
+};
+
+}  // namespace proginfo::util
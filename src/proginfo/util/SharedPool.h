@@ -0,0 +1,148 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+
+namespace proginfo::util {
+
+/*
+Like `Pool`, but safe to share between threads: a block can be allocated on one
+thread and freed on another.  This is what to use for objects that are created
+once (e.g. a `Binary`, via `Binary::at`) and then handed to a pool of worker
+threads.
+
+It's lock-free (never blocks, nor spins waiting on another thread), so it's also
+safe to use in a signal handler, even one interrupting another use of the same
+pool.
+
+Each size class has a lock-free stack of free blocks.  The stack head packs the
+block's index along with a counter which changes on every update, so that a
+stale head can't be mistaken for a current one (the "ABA problem"). Blocks are
+identified by their index in `kMinBlock` units, so the region can be up to 64GB.
+*/
+class SharedPool : public std::pmr::memory_resource {
+public:
+  constexpr static size_t kMinBlock = 16;
+  constexpr static size_t kMaxBlock = 4096;
+  constexpr static unsigned kClasses = 9;  // 16, 32, ..., 4096
+  static_assert(kMinBlock << (kClasses - 1) == kMaxBlock);
+
+private:
+  // Free blocks hold the (1-based) index of the next one; 0 ends the list
+  using Link = std::atomic<uint32_t>;
+  static_assert(sizeof(Link) <= kMinBlock);
+  static_assert(Link::is_always_lock_free);
+  static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+  std::byte* const base_;
+  size_t const size_;
+  std::atomic<size_t> carved_ {0};
+  std::atomic<uint64_t> free_[kClasses] {};  // (tag << 32) | (1-based index)
+  std::atomic<unsigned> live_ {0};
+
+  static unsigned classOf(size_t size) {
+    unsigned ret = 0;
+    for (size_t block = kMinBlock; block < size; block <<= 1) { ++ret; }
+    return ret;
+  }
+
+  Link& link(uint32_t index) const {
+    return *(Link*) (base_ + (index - 1) * kMinBlock);
+  }
+
+  void* carve(size_t block) {
+    auto carved = carved_.load(std::memory_order_relaxed);
+    do {
+      if (block > size_ - carved) { return nullptr; }
+    } while (!carved_.compare_exchange_weak(
+        carved, carved + block, std::memory_order_relaxed));
+    return base_ + carved;
+  }
+
+public:
+  /** Allocate from `size` bytes at `space`, which must outlive this pool. */
+  SharedPool(void* space, size_t size)
+      : base_((std::byte*) space)
+      , size_(std::min<size_t>(size, size_t(UINT32_MAX - 1) * kMinBlock)) {
+    assert(!(uintptr_t(space) % kMinBlock));
+  }
+
+  SharedPool(SharedPool const&) = delete;
+  SharedPool(SharedPool&&) = delete;
+  SharedPool& operator=(SharedPool const&) = delete;
+  SharedPool& operator=(SharedPool&&) = delete;
+
+  size_t capacity() const { return size_; }
+
+  /** Number of blocks currently allocated */
+  unsigned live() const { return live_.load(std::memory_order_relaxed); }
+
+  /** Allocate `size` bytes (aligned to `kMinBlock`); nullptr if no room. */
+  [[nodiscard]] void*
+  alloc(size_t size, size_t align = alignof(std::max_align_t)) {
+    if (size > kMaxBlock || align > kMinBlock) { return nullptr; }
+    auto cls = classOf(size);
+    auto& head = free_[cls];
+    auto old = head.load(std::memory_order_acquire);
+    void* ret = nullptr;
+    while (true) {
+      auto index = uint32_t(old);
+      if (!index) {
+        ret = carve(kMinBlock << cls);
+        break;
+      }
+      // The block might be popped (and reused) by another thread before we get
+      // to it; then `next` would be garbage, but the tag in `old` would have
+      // changed, so the exchange would fail.
+      auto next = link(index).load(std::memory_order_relaxed);
+      auto tag = (old >> 32) + 1;
+      if (head.compare_exchange_weak(
+              old, (tag << 32) | next, std::memory_order_acquire)) {
+        ret = &link(index);
+        break;
+      }
+    }
+    if (ret) { live_.fetch_add(1, std::memory_order_relaxed); }
+    return ret;
+  }
+
+  /** Free a block from `alloc` (on any thread); `size` must be as requested. */
+  void dealloc(void* ptr, size_t size) {
+    if (!ptr) { return; }
+    assert(ptr >= base_ && ptr < base_ + carved_.load());
+    assert(size <= kMaxBlock);
+    auto& head = free_[classOf(size)];
+    auto index = uint32_t(size_t((std::byte*) ptr - base_) / kMinBlock + 1);
+    auto* block = new (ptr) Link;
+    auto old = head.load(std::memory_order_relaxed);
+    do {
+      block->store(uint32_t(old), std::memory_order_relaxed);
+    } while (!head.compare_exchange_weak(
+        old, (((old >> 32) + 1) << 32) | index, std::memory_order_release));
+    live_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+protected:
+  [[nodiscard]] void* do_allocate(size_t size, size_t align) override {
+    auto* ret = alloc(size, align);
+    if (!ret) { throw std::bad_alloc(); }
+    return ret;
+  }
+
+  void do_deallocate(void* ptr, size_t size, size_t) noexcept override {
+    dealloc(ptr, size);
+  }
+
+  bool do_is_equal(
+      std::pmr::memory_resource const& rhs) const noexcept override {
+    return &rhs == this;
+  }
+};
+
+}  // namespace proginfo::util
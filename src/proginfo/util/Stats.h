@@ -0,0 +1,233 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+Instrumentation is compiled out unless this is 1.  Define it the same way
+for every translation unit (e.g. with `-DPROGINFO_STATS=1`), or the inline
+functions here differ between them.
+*/
+#ifndef PROGINFO_STATS
+#define PROGINFO_STATS 0
+#endif
+
+namespace proginfo::util {
+
+/** Things counted on hot paths. */
+enum class Counter : unsigned {
+  kSectionsScanned,  // Section headers looked at, finding or listing sections
+  kSymbolsVisited,   // Symbol table entries read while indexing
+  kBytesDecoded,     // Of unwind and line tables
+  kCacheHits,        // Of `FrameCache`s
+  kCacheMisses,
+  kUnwindSteps,  // Frames unwound
+  kCount,
+};
+
+/** Maximums (over time, and over threads). */
+enum class Gauge : unsigned {
+  kAllocHighWater,  // Bytes in use in a thread's `Alloc`
+  kCount,
+};
+
+/** Where time is spent; nested timers each count the full time. */
+enum class Timer : unsigned {
+  kParse,  // Building symbol indexes and unwind tables
+  kIO,     // Mapping files and reading other processes' memory
+  kUnwind,
+  kSymbolize,
+  kCount,
+};
+
+struct TimerStats {
+  uint64_t count {};   // Times started
+  uint64_t cycles {};  // Total, in `Stats::cycles` units
+};
+
+/** Totals over all threads, as of `Stats::snapshot`. */
+struct StatsSnapshot {
+  uint64_t sectionsScanned {};
+  uint64_t symbolsVisited {};
+  uint64_t bytesDecoded {};
+  uint64_t cacheHits {};
+  uint64_t cacheMisses {};
+  uint64_t unwindSteps {};
+  uint64_t allocHighWater {};  // Highest of any thread
+  TimerStats parse;
+  TimerStats io;
+  TimerStats unwind;
+  TimerStats symbolize;
+  unsigned threads {};  // Which have recorded anything
+};
+
+/*
+Counters and timers for the hot paths (parsing, I/O, unwinding, symbolizing),
+for finding where time goes in production without a profiler.
+
+With `PROGINFO_STATS` 0 (the default), every call here compiles to nothing,
+and no storage is used.  Otherwise, each thread gets its own cache-line
+aligned block of counters from a fixed array, the first time it records
+anything, and updates it with relaxed atomics only; nothing allocates or
+locks, so this is safe in signal handlers.  Threads beyond `kMaxThreads`
+share one more block.  `snapshot` sums all the blocks.
+
+Timers count in `cycles()`: the TSC on x86, the virtual counter on AArch64
+(both fixed-rate on current CPUs), or else nanoseconds.
+*/
+class Stats {
+public:
+  constexpr static bool kEnabled = PROGINFO_STATS;
+  constexpr static unsigned kMaxThreads = 256;
+
+private:
+  constexpr static auto kCounters = unsigned(Counter::kCount);
+  constexpr static auto kGauges = unsigned(Gauge::kCount);
+  constexpr static auto kTimers = unsigned(Timer::kCount);
+
+  // Where each kind of value is in a block
+  constexpr static unsigned kGaugesAt = kCounters;
+  constexpr static unsigned kTimerCountsAt = kGaugesAt + kGauges;
+  constexpr static unsigned kTimerCyclesAt = kTimerCountsAt + kTimers;
+  constexpr static unsigned kValues = kTimerCyclesAt + kTimers;
+
+  struct alignas(64) Block {
+    std::atomic<uint64_t> values[kValues];  // Zeroed, being static
+  };
+
+  static inline Block blocks_[kMaxThreads + 1];  // The last is shared
+  static inline std::atomic<unsigned> claimed_ {0};
+  static inline thread_local Block* mine_ {nullptr};
+
+  static Block& mine() {
+    if (!mine_) {
+      auto i = claimed_.fetch_add(1, std::memory_order_relaxed);
+      mine_ = &blocks_[std::min(i, kMaxThreads)];
+    }
+    return *mine_;
+  }
+
+  static void add(std::atomic<uint64_t>& var, uint64_t n) {
+    var.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  /** How many blocks are in use. */
+  static unsigned blocks() {
+    return std::min(claimed_.load(std::memory_order_relaxed), kMaxThreads + 1);
+  }
+
+  static uint64_t sum(unsigned value);
+
+public:
+  static uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ret;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(ret));
+    return ret;
+#else
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch())
+                        .count());
+#endif
+  }
+
+  static void add(Counter counter, uint64_t n = 1) {
+    if constexpr (kEnabled) { add(mine().values[unsigned(counter)], n); }
+  }
+
+  /** Raise `gauge` to `value`, if it's higher. */
+  static void max(Gauge gauge, uint64_t value) {
+    if constexpr (kEnabled) {
+      auto& var = mine().values[kGaugesAt + unsigned(gauge)];
+      auto cur = var.load(std::memory_order_relaxed);
+      while (cur < value && !var.compare_exchange_weak(
+                                cur, value, std::memory_order_relaxed)) {}
+    }
+  }
+
+  static void time(Timer timer, uint64_t cycles) {
+    if constexpr (kEnabled) {
+      auto& block = mine();
+      add(block.values[kTimerCountsAt + unsigned(timer)], 1);
+      add(block.values[kTimerCyclesAt + unsigned(timer)], cycles);
+    }
+  }
+
+  /** Times the scope it's in (if enabled). */
+  class Scope {
+    Timer const timer_;
+    uint64_t const start_;
+
+  public:
+    explicit Scope(Timer timer)
+        : timer_(timer), start_(kEnabled ? cycles() : 0) {}
+    ~Scope() {
+      if constexpr (kEnabled) { time(timer_, cycles() - start_); }
+    }
+    Scope(Scope const&) = delete;
+    Scope& operator=(Scope const&) = delete;
+  };
+
+  static StatsSnapshot snapshot();
+
+  /** Zero everything; updates made meanwhile by other threads might be lost. */
+  static void reset();
+};
+
+inline uint64_t Stats::sum(unsigned value) {
+  uint64_t ret = 0;
+  for (unsigned i = 0, n = blocks(); i < n; i++) {
+    ret += blocks_[i].values[value].load(std::memory_order_relaxed);
+  }
+  return ret;
+}
+
+inline StatsSnapshot Stats::snapshot() {
+  StatsSnapshot ret;
+  if constexpr (kEnabled) {
+    auto counter = [](Counter c) { return sum(unsigned(c)); };
+    auto timer = [](Timer t) {
+      return TimerStats {sum(kTimerCountsAt + unsigned(t)),
+                         sum(kTimerCyclesAt + unsigned(t))};
+    };
+    ret.sectionsScanned = counter(Counter::kSectionsScanned);
+    ret.symbolsVisited = counter(Counter::kSymbolsVisited);
+    ret.bytesDecoded = counter(Counter::kBytesDecoded);
+    ret.cacheHits = counter(Counter::kCacheHits);
+    ret.cacheMisses = counter(Counter::kCacheMisses);
+    ret.unwindSteps = counter(Counter::kUnwindSteps);
+    ret.parse = timer(Timer::kParse);
+    ret.io = timer(Timer::kIO);
+    ret.unwind = timer(Timer::kUnwind);
+    ret.symbolize = timer(Timer::kSymbolize);
+    ret.threads = claimed_.load(std::memory_order_relaxed);
+    for (unsigned i = 0, n = blocks(); i < n; i++) {
+      auto& var = blocks_[i].values[kGaugesAt];  // `kAllocHighWater`
+      ret.allocHighWater = std::max(ret.allocHighWater,
+                                    var.load(std::memory_order_relaxed));
+    }
+  }
+  return ret;
+}
+
+inline void Stats::reset() {
+  if constexpr (kEnabled) {
+    for (unsigned i = 0, n = blocks(); i < n; i++) {
+      for (auto& var : blocks_[i].values) {
+        var.store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+}
+
+}  // namespace proginfo::util
@@ -0,0 +1,144 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace proginfo::util {
+
+/*
+Fixed-size pool of worker threads, with work stealing.
+
+Each worker has its own queue.  Tasks submitted from a worker go onto that
+worker's queue (so related work tends to stay on one core); tasks submitted from
+elsewhere are dealt out round-robin.  Workers take from the back of their own
+queue, and when that's empty, steal from the front of the others'.
+
+This uses the heap and locks freely, so it's meant for offline / batch work, and
+isn't signal-safe.  Tasks shouldn't throw.
+*/
+class ThreadPool {
+public:
+  using Task = std::function<void()>;
+
+private:
+  struct Queue {
+    std::mutex mutex_;
+    std::deque<Task> tasks_;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;  // Guards sleeping / waking, and `stop_`
+  std::condition_variable wake_;
+  std::condition_variable idle_;
+  std::atomic<size_t> queued_ {0};   // Tasks in queues
+  std::atomic<size_t> pending_ {0};  // Tasks queued or running
+  std::atomic<unsigned> next_ {0};
+  std::atomic<size_t> steals_ {0};
+  bool stop_ {false};
+
+  // Index of this thread's queue, if it's one of our workers
+  static inline thread_local ThreadPool const* currentPool_ {};
+  static inline thread_local unsigned currentIndex_ {};
+
+  bool take(unsigned self, Task* task) {
+    auto n = unsigned(queues_.size());
+    for (unsigned i = 0; i < n; i++) {
+      auto& q = *queues_[(self + i) % n];
+      std::lock_guard lock(q.mutex_);
+      if (q.tasks_.empty()) { continue; }
+      if (i) {
+        *task = std::move(q.tasks_.front());
+        q.tasks_.pop_front();
+        steals_.fetch_add(1, std::memory_order_relaxed);
+      } else {
+        *task = std::move(q.tasks_.back());
+        q.tasks_.pop_back();
+      }
+      queued_.fetch_sub(1);
+      return true;
+    }
+    return false;
+  }
+
+  void run(unsigned self) {
+    currentPool_ = this;
+    currentIndex_ = self;
+    Task task;
+    while (true) {
+      if (take(self, &task)) {
+        task();
+        task = nullptr;
+        if (pending_.fetch_sub(1) == 1) {
+          std::lock_guard lock(mutex_);
+          idle_.notify_all();
+        }
+        continue;
+      }
+      std::unique_lock lock(mutex_);
+      wake_.wait(lock, [&] { return stop_ || queued_.load(); });
+      if (stop_ && !queued_.load()) { return; }
+    }
+  }
+
+public:
+  /** Start `threads` workers (at least one). */
+  explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency()) {
+    if (!threads) { threads = 1; }
+    for (unsigned i = 0; i < threads; i++) {
+      queues_.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 0; i < threads; i++) {
+      threads_.emplace_back([this, i] { run(i); });
+    }
+  }
+
+  /** Finishes any queued tasks, then stops the workers. */
+  ~ThreadPool() {
+    {
+      std::lock_guard lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) { thread.join(); }
+  }
+
+  ThreadPool(ThreadPool const&) = delete;
+  ThreadPool& operator=(ThreadPool const&) = delete;
+
+  unsigned size() const { return unsigned(threads_.size()); }
+
+  /** Number of tasks run by a worker other than the one they were queued on */
+  size_t steals() const { return steals_.load(std::memory_order_relaxed); }
+
+  void submit(Task task) {
+    auto index = (currentPool_ == this)
+                     ? currentIndex_
+                     : next_.fetch_add(1, std::memory_order_relaxed) % size();
+    pending_.fetch_add(1);
+    {
+      auto& q = *queues_[index];
+      std::lock_guard lock(q.mutex_);
+      q.tasks_.push_back(std::move(task));
+      queued_.fetch_add(1);
+    }
+    std::lock_guard lock(mutex_);
+    wake_.notify_one();
+  }
+
+  /** Block until all tasks (including any they submit) have finished. */
+  void wait() {
+    std::unique_lock lock(mutex_);
+    idle_.wait(lock, [&] { return !pending_.load(); });
+  }
+};
+
+}  // namespace proginfo::util
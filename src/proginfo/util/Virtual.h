@@ -8,22 +8,35 @@ static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <memory_resource>
 #include <type_traits>
 #include <utility>
 
 namespace proginfo::util {
 
+/*
+Owns an object of some subclass of `B`, allocated from a `memory_resource`.
+
+The resource is remembered along with the object, so the object is always
+returned to the resource it came from, even if this `Virtual` is moved to (and
+destroyed on) some other thread.  By default that's the current thread's
+`Alloc`; to hand objects off between threads, use a resource which can be shared
+between them, e.g. `SharedPool`.
+*/
 template <class B>
 class Virtual {
   static_assert(std::has_virtual_destructor_v<B>);
 
+  constexpr static size_t kAlign = alignof(std::max_align_t);
+
   B* ptr_ {nullptr};
   unsigned size_ {0};
+  std::pmr::memory_resource* mr_ {nullptr};  // Source of `ptr_`
 
   void clear() {
     if (ptr_) {
       ptr_->~B();
-      Alloc::get().dealloc(ptr_);
+      mr_->deallocate(ptr_, size_, kAlign);
       ptr_ = nullptr;
     }
   }
@@ -31,7 +44,9 @@ class Virtual {
   Virtual& moveFrom(Virtual&& rhs) {
     if (&rhs != this) {
       clear();
-      if (rhs.ptr_) { std::swap(ptr_, rhs.ptr_); }
+      std::swap(ptr_, rhs.ptr_);
+      std::swap(size_, rhs.size_);
+      std::swap(mr_, rhs.mr_);
     }
     return *this;
   }
@@ -41,6 +56,9 @@ public:
 
   Virtual() = default;
 
+  /** Allocate from `mr` (if null: the thread's `Alloc`, as of `emplace`). */
+  explicit Virtual(std::pmr::memory_resource* mr) : mr_(mr) {}
+
   Virtual(Virtual const& rhs) = delete;
   Virtual& operator=(Virtual const& rhs) = delete;
 
@@ -59,13 +77,18 @@ public:
   void emplace(A&&... args) {
     static_assert(std::has_virtual_destructor_v<T>);
     static_assert(std::is_base_of_v<B, T>);
+    static_assert(alignof(T) <= kAlign);
     clear();
+    if (!mr_) { mr_ = &Alloc::get(); }
     size_ = sizeof(T);
-    ptr_ = (T*) Alloc::get().alloc(size_);
+    ptr_ = (T*) mr_->allocate(size_, kAlign);
     assert(ptr_);
     new (ptr_) T(std::forward<A>(args)...);
   }
 
+  /** The resource this object was allocated from (null if never allocated) */
+  std::pmr::memory_resource* resource() const { return mr_; }
+
   B* operator->() { return ptr_; }
 
   B& operator*() {
@@ -0,0 +1,291 @@
+#pragma once
+static_assert(__cplusplus >= 201700L, "proginfo requires C++17");
+
+#include "Bytes.h"
+#include "Stats.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <list>
+#include <mutex>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <vector>
+
+namespace proginfo::util {
+
+struct WindowedFileStats {
+  uint64_t reads {};      // `pread` calls
+  uint64_t bytesRead {};  // By them
+  uint64_t evictions {};  // Windows dropped to stay within budget
+  size_t resident {};     // Bytes in memory now
+  size_t pinned {};       // Of those, in use by `Pin`s (so not evictable)
+};
+
+/*
+A file read on demand with `pread`, in fixed-size windows, rather than mapped:
+for debug files too big (or on filesystems too slow) to map and fault in.
+
+The whole file gets a range of address space, laid out as in the file, so
+parsers (e.g. a `binary::Binary`) can run on it as they would on an `MMap`; but
+it's anonymous memory, with nothing in it until `fetch`ed.  `fetch` reads the
+windows covering a file range (those not already in memory, a run of them per
+`pread`) and pins them, for as long as the `Pin` it returns lives.
+
+Memory is bounded: windows not pinned are kept, for reuse, up to `maxBytes`
+in all; beyond that the least recently used are dropped (`MADV_DONTNEED`), so
+RSS stays flat however big the file is.  Pinned windows aren't dropped, even if
+they're over budget.  Reading a part of the file that isn't fetched sees
+zeroes, as if the file were sparse there, rather than what's in the file.
+
+Thread-safe; `fetch`es are serialized, per file.  Uses the heap, so isn't
+signal-safe.  See `binary::WindowedBinary` for fetching a binary's headers.
+*/
+class WindowedFile {
+public:
+  constexpr static size_t kWindow = 64 << 10;
+
+  /** Keeps a fetched range of the file in memory while it lives. */
+  class Pin {
+    friend class WindowedFile;
+
+    WindowedFile* file_ {};
+    size_t first_ {};  // Windows pinned
+    size_t count_ {};
+    Addr addr_;
+
+    Pin(WindowedFile* file, size_t first, size_t count, Addr addr)
+        : file_(file)
+        , first_(first)
+        , count_(count)
+        , addr_(addr) {}
+
+  public:
+    Pin() = default;
+    ~Pin() { reset(); }
+
+    Pin(Pin const&) = delete;
+    Pin& operator=(Pin const&) = delete;
+
+    Pin(Pin&& rhs) { *this = std::move(rhs); }
+    Pin& operator=(Pin&& rhs) {
+      if (this != &rhs) {
+        reset();
+        file_ = rhs.file_;
+        first_ = rhs.first_;
+        count_ = rhs.count_;
+        addr_ = rhs.addr_;
+        rhs.file_ = nullptr;
+        rhs.count_ = 0;
+      }
+      return *this;
+    }
+
+    /** Whether the range was read; an empty range is, trivially. */
+    explicit operator bool() const { return file_; }
+
+    /** The range, in the file's address space. */
+    Addr addr() const { return addr_; }
+    std::string_view str() const { return addr_.str(); }
+
+    void reset() {
+      if (file_ && count_) { file_->unpin(first_, count_); }
+      file_ = nullptr;
+      count_ = 0;
+      addr_ = {};
+    }
+  };
+
+private:
+  struct Window {
+    uint32_t pins {};
+    bool resident {};
+    std::list<size_t>::iterator lru;  // If resident and not pinned
+  };
+
+  int fd_ {-1};
+  size_t size_ {};
+  std::byte* map_ {};
+  size_t mapSize_ {};
+  size_t const maxBytes_;
+  int errno_ {};
+
+  std::mutex mutex_;
+  std::vector<Window> windows_;
+  std::list<size_t> lru_;  // Unpinned resident windows; most recent first
+  WindowedFileStats stats_;
+
+  /** Read windows `[first, first + count)`, none of which are resident. */
+  bool read(size_t first, size_t count) {
+    Stats::Scope timer(Timer::kIO);
+    auto begin = first * kWindow;
+    auto end = std::min(size_, (first + count) * kWindow);
+    while (begin < end) {
+      auto got = pread(fd_, map_ + begin, end - begin, off_t(begin));
+      if (got < 0 && errno == EINTR) { continue; }
+      if (got <= 0) {
+        errno_ = got ? errno : EIO;  // Truncated meanwhile
+        madvise(map_ + first * kWindow, count * kWindow, MADV_DONTNEED);
+        return false;
+      }
+      ++stats_.reads;
+      stats_.bytesRead += uint64_t(got);
+      begin += size_t(got);
+    }
+    for (size_t i = first; i < first + count; i++) {
+      windows_[i].resident = true;
+      stats_.resident += kWindow;
+    }
+    return true;
+  }
+
+  void drop(size_t window) {
+    madvise(map_ + window * kWindow, kWindow, MADV_DONTNEED);
+    windows_[window].resident = false;
+    stats_.resident -= kWindow;
+    ++stats_.evictions;
+  }
+
+  /** Drop least recently used windows until within budget (or all pinned). */
+  void trim() {
+    while (stats_.resident > maxBytes_ && !lru_.empty()) {
+      drop(lru_.back());
+      lru_.pop_back();
+    }
+  }
+
+  /** Unpin windows `[first, first + count)`; with `mutex_` held. */
+  void release(size_t first, size_t count) {
+    for (size_t i = first; i < first + count; i++) {
+      auto& w = windows_[i];
+      if (--w.pins) { continue; }
+      stats_.pinned -= kWindow;
+      if (w.resident) { w.lru = lru_.insert(lru_.begin(), i); }
+    }
+    trim();
+  }
+
+  void unpin(size_t first, size_t count) {
+    std::lock_guard lock(mutex_);
+    release(first, count);
+  }
+
+public:
+  /** Open `path`; with up to `maxBytes` of unpinned windows kept in memory. */
+  explicit WindowedFile(std::string_view path,
+                        size_t maxBytes = size_t(64) << 20)
+      : maxBytes_(maxBytes) {
+    // `path` isn't necessarily NUL-terminated
+    char pathz[4096];
+    if (path.size() >= sizeof(pathz)) {
+      errno_ = ENAMETOOLONG;
+      return;
+    }
+    memcpy(pathz, path.data(), path.size());
+    pathz[path.size()] = 0;
+
+    fd_ = open(pathz, O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) {
+      errno_ = errno;
+      return;
+    }
+    off_t seekRes = lseek(fd_, 0, SEEK_END);
+    if (seekRes < 0) {
+      errno_ = errno;
+      return;
+    }
+    size_ = size_t(seekRes);
+    if (!size_) { return; }
+
+    // Address space only: nothing is committed until it's read into
+    auto windows = (size_ + kWindow - 1) / kWindow;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+    auto* mmapRes =
+        mmap(nullptr, windows * kWindow, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (mmapRes == MAP_FAILED) {
+      errno_ = errno;
+      return;
+    }
+    map_ = (std::byte*) mmapRes;
+    mapSize_ = windows * kWindow;
+    windows_.resize(windows);
+  }
+
+  ~WindowedFile() {
+    if (map_) { munmap(map_, mapSize_); }
+    if (fd_ >= 0) { close(fd_); }
+  }
+
+  WindowedFile(WindowedFile const&) = delete;
+  WindowedFile& operator=(WindowedFile const&) = delete;
+
+  explicit operator bool() const { return map_; }
+  int error() const { return errno_; }
+
+  size_t size() const { return size_; }
+  size_t maxBytes() const { return maxBytes_; }
+
+  /** The whole file's address space (only fetched parts of it are read). */
+  Addr addr() const { return {map_, size_}; }
+
+  /**
+  Read the file range `[offset, offset + size)` (clipped to the file), if it's
+  not in memory already, and keep it there while the returned `Pin` lives.
+  On a read error, the `Pin` is false, and `error` says why.
+  */
+  Pin fetch(size_t offset, size_t size) {
+    if (!map_ || offset >= size_) { return {this, 0, 0, {}}; }
+    size = std::min(size, size_ - offset);
+    if (!size) { return {this, 0, 0, {}}; }
+    auto first = offset / kWindow;
+    auto count = (offset + size - 1) / kWindow - first + 1;
+
+    std::lock_guard lock(mutex_);
+    for (size_t i = first; i < first + count; i++) {
+      auto& w = windows_[i];
+      if (w.pins++) { continue; }
+      stats_.pinned += kWindow;
+      if (w.resident) { lru_.erase(w.lru); }
+    }
+    // Read each run of windows not yet in memory
+    bool ok = true;
+    for (size_t i = first; ok && i < first + count;) {
+      if (windows_[i].resident) {
+        ++i;
+        continue;
+      }
+      auto run = i;
+      while (i < first + count && !windows_[i].resident) { ++i; }
+      ok = read(run, i - run);
+    }
+    if (!ok) {
+      release(first, count);
+      return {};
+    }
+    trim();
+    return {this, first, count, {map_ + offset, size}};
+  }
+
+  /** Drop all windows not pinned. */
+  void clear() {
+    std::lock_guard lock(mutex_);
+    for (auto window : lru_) { drop(window); }
+    lru_.clear();
+  }
+
+  WindowedFileStats stats() {
+    std::lock_guard lock(mutex_);
+    return stats_;
+  }
+};
+
+}  // namespace proginfo::util
@@ -0,0 +1,570 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*
+Writes synthetic (but valid) ELF files, for scale tests and benchmarks.
+
+The fixtures in `test/bins` are tiny; this makes files with as many sections,
+symbols, DWARF compile units and FDEs as wanted, as ELF32 or ELF64, in either
+byte order, without needing a cross toolchain.  The layout is:
+
+  ELF header, one `PT_LOAD` program header covering the whole file
+  .text           `symbols` functions, `funcSize` bytes apart
+  .eh_frame_hdr   sorted lookup table for `.eh_frame`
+  .eh_frame       one CIE, and `fdes` FDEs (spread across the functions)
+  .debug_abbrev
+  .debug_info     `cus` DWARF 5 compile units (each covering some functions)
+  .debug_str      } if `names`: a `DW_TAG_subprogram` DIE per function (named
+  .debug_names    } `dieName(i)`), in its CU, and both kinds of index of
+  .gdb_index      } those names
+  .gen.N          `sections` extra (empty) sections
+  .symtab, .strtab, .shstrtab
+  section headers
+
+Virtual addresses are equal to file offsets, as in a position-independent
+executable.  Function `i` is named `symbolName(i)` and is at `symbolAddr(i)`.
+Nothing is executable, of course; instructions are just `0xcc` bytes.
+*/
+struct GenELF {
+  struct Options {
+    bool is64 {true};
+    bool isLE {true};
+    uint32_t symbols {1000};
+    uint32_t sections {0};  // Extra sections, beyond those above
+    uint32_t cus {1};
+    uint32_t fdes {0};
+    uint32_t funcSize {16};
+    bool names {false};  // Function DIEs, `.debug_names` and `.gdb_index`
+  };
+
+  // ELF section header indexes are 16 bits, with the top 256 values reserved
+  constexpr static uint32_t kMaxSections = 0xff00 - 10;
+
+  constexpr static uint64_t kTextOffset = 0x1000;
+
+  static uint64_t symbolAddr(Options const& opts, uint32_t i) {
+    return kTextOffset + uint64_t(i) * opts.funcSize;
+  }
+
+  /** A mangled name, like `_ZN3gen6fn1234Ev` (i.e. `gen::fn1234()`). */
+  static std::string symbolName(uint32_t i) {
+    auto fn = "fn" + std::to_string(i);
+    return "_ZN3gen" + std::to_string(fn.size()) + fn + "Ev";
+  }
+
+  /** Function `i`'s DIE's `DW_AT_name`, if `names`: like `fn1234`. */
+  static std::string dieName(uint32_t i) { return "fn" + std::to_string(i); }
+
+  static std::vector<uint8_t> build(Options const& opts) {
+    return Writer(opts).run();
+  }
+
+  /** Write to `path`; returns false on failure. */
+  static bool write(Options const& opts, char const* path) {
+    auto bytes = build(opts);
+    auto* f = fopen(path, "wb");
+    if (!f) { return false; }
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+    return (fclose(f) == 0) && ok;
+  }
+
+private:
+  class Writer {
+    struct Sec {
+      uint32_t name;
+      uint32_t type;
+      uint64_t flags;
+      uint64_t offset;
+      uint64_t size;
+      uint32_t link;
+      uint32_t info;
+      uint64_t align;
+      uint64_t entSize;
+    };
+
+    Options const& opts_;
+    std::vector<uint8_t> out_;
+    std::vector<Sec> secs_;
+    std::string shstrtab_ {'\0'};
+
+    // If `names`: each function's DIE, its CU, and its name in `.debug_str`
+    std::vector<uint64_t> dies_;
+    std::vector<uint32_t> dieCus_;
+    std::vector<uint64_t> cuOffsets_;  // And each CU's offset
+    std::vector<uint32_t> nameOffsets_;
+    uint64_t infoSize_ {};
+
+    void align(size_t n) {
+      while (out_.size() % n) { out_.push_back(0); }
+    }
+
+    void put(uint64_t val, unsigned bytes) {
+      for (unsigned i = 0; i < bytes; i++) {
+        auto shift = 8 * (opts_.isLE ? i : bytes - 1 - i);
+        out_.push_back(uint8_t(val >> shift));
+      }
+    }
+
+    void put8(uint64_t val) { put(val, 1); }
+    void put16(uint64_t val) { put(val, 2); }
+    void put32(uint64_t val) { put(val, 4); }
+    void put64(uint64_t val) { put(val, 8); }
+    void putAddr(uint64_t val) { put(val, opts_.is64 ? 8 : 4); }
+
+    void patch(size_t offset, uint64_t val, unsigned bytes) {
+      for (unsigned i = 0; i < bytes; i++) {
+        auto shift = 8 * (opts_.isLE ? i : bytes - 1 - i);
+        out_[offset + i] = uint8_t(val >> shift);
+      }
+    }
+
+    void putStr(std::string_view str) {
+      out_.insert(out_.end(), str.begin(), str.end());
+      out_.push_back(0);
+    }
+
+    void putULEB(uint64_t val) {
+      do {
+        auto byte = uint8_t(val & 0x7f);
+        val >>= 7;
+        put8(val ? (byte | 0x80) : byte);
+      } while (val);
+    }
+
+    uint32_t secName(std::string_view name) {
+      auto ret = uint32_t(shstrtab_.size());
+      shstrtab_ += name;
+      shstrtab_ += '\0';
+      return ret;
+    }
+
+    /** Add a section header for everything written since `start`. */
+    uint32_t addSec(std::string_view name,
+                    uint32_t type,
+                    uint64_t flags,
+                    size_t start,
+                    uint64_t align,
+                    uint64_t entSize = 0) {
+      secs_.push_back({secName(name),
+                       type,
+                       flags,
+                       start,
+                       out_.size() - start,
+                       0,
+                       0,
+                       align,
+                       entSize});
+      return uint32_t(secs_.size() - 1);
+    }
+
+    uint64_t textEnd() const {
+      return symbolAddr(opts_, opts_.symbols ? opts_.symbols : 1);
+    }
+
+    void text() {
+      out_.resize(kTextOffset, 0);
+      out_.resize(textEnd(), 0xcc);
+      addSec(".text", 1, 6, kTextOffset, 16);  // PROGBITS, ALLOC|EXECINSTR
+    }
+
+    /** The functions (first one, and count) covered by FDE or CU `i` of `n`. */
+    std::pair<uint32_t, uint32_t> span(uint32_t i, uint32_t n) const {
+      auto funcs = opts_.symbols ? opts_.symbols : 1;
+      auto first = uint32_t(uint64_t(funcs) * i / n);
+      auto last = uint32_t(uint64_t(funcs) * (i + 1) / n);
+      return {first, std::max(last, first + 1) - first};
+    }
+
+    void ehFrame() {
+      auto n = opts_.fdes;
+      // .eh_frame_hdr: version, eh_frame_ptr (pcrel sdata4), fde_count
+      // (udata4), table (datarel sdata4 pairs, relative to .eh_frame_hdr)
+      align(4);
+      auto hdr = out_.size();
+      put8(1);
+      put8(0x1b);
+      put8(0x03);
+      put8(0x3b);
+      auto ehFramePtr = out_.size();
+      put32(0);
+      put32(n);
+      auto table = out_.size();
+      out_.resize(out_.size() + size_t(n) * 8);
+      addSec(".eh_frame_hdr", 1, 2, hdr, 4);
+
+      // .eh_frame: a CIE ("zR", pcrel sdata4 pointers), then the FDEs
+      align(8);
+      auto frame = out_.size();
+      patch(ehFramePtr, uint32_t(frame - ehFramePtr), 4);
+      auto cieStart = out_.size();
+      put32(0);  // Length, patched below
+      put32(0);  // CIE ID
+      put8(1);   // Version
+      putStr("zR");
+      putULEB(1);  // Code alignment
+      put8(0x78);  // Data alignment: -8 (SLEB)
+      put8(16);    // Return address register
+      putULEB(1);  // Augmentation data length
+      put8(0x1b);  // FDE pointer encoding: pcrel sdata4
+      put8(0x0c);  // DW_CFA_def_cfa: r7 + 8
+      put8(7);
+      put8(8);
+      put8(0x90);  // DW_CFA_offset: r16 at cfa - 8
+      put8(1);
+      align(4);
+      patch(cieStart, out_.size() - cieStart - 4, 4);
+
+      for (uint32_t i = 0; i < n; i++) {
+        auto [first, count] = span(i, n);
+        auto fde = out_.size();
+        put32(16);                  // Length
+        put32(fde + 4 - cieStart);  // CIE pointer
+        auto pc = symbolAddr(opts_, first);
+        put32(uint32_t(pc - out_.size()));        // PC begin (pcrel)
+        put32(uint64_t(count) * opts_.funcSize);  // PC range
+        put8(0);                                  // Augmentation data length
+        put8(0);                                  // DW_CFA_nop (padding)
+        put8(0);
+        put8(0);
+        patch(table + i * 8, uint32_t(pc - hdr), 4);
+        patch(table + i * 8 + 4, uint32_t(fde - hdr), 4);
+      }
+      put32(0);  // Terminator
+      addSec(".eh_frame", 1, 2, frame, 8);
+    }
+
+    void debugInfo() {
+      // A compile unit with a name and PC range; and, if `names`, children:
+      // functions with a name and PC range
+      auto abbrev = out_.size();
+      putULEB(1);
+      putULEB(0x11);      // DW_TAG_compile_unit
+      put8(opts_.names);  // DW_CHILDREN_yes or no
+      putULEB(0x03);      // DW_AT_name
+      putULEB(0x08);      // DW_FORM_string
+      putULEB(0x11);      // DW_AT_low_pc
+      putULEB(0x01);      // DW_FORM_addr
+      putULEB(0x12);      // DW_AT_high_pc
+      putULEB(0x06);      // DW_FORM_data4 (length)
+      put8(0);
+      put8(0);
+      if (opts_.names) {
+        putULEB(2);
+        putULEB(0x2e);  // DW_TAG_subprogram
+        put8(0);
+        putULEB(0x03);  // DW_AT_name
+        putULEB(0x0e);  // DW_FORM_strp
+        putULEB(0x11);
+        putULEB(0x01);
+        putULEB(0x12);
+        putULEB(0x06);
+        put8(0);
+        put8(0);
+      }
+      put8(0);
+      addSec(".debug_abbrev", 1, 0, abbrev, 1);
+
+      std::string strs;
+      auto info = out_.size();
+      for (uint32_t i = 0; i < opts_.cus; i++) {
+        auto [first, count] = span(i, opts_.cus);
+        auto unit = out_.size();
+        cuOffsets_.push_back(unit - info);
+        put32(0);                  // Length, patched below
+        put16(5);                  // Version
+        put8(0x01);                // DW_UT_compile
+        put8(opts_.is64 ? 8 : 4);  // Address size
+        put32(0);                  // Abbreviations offset
+        putULEB(1);
+        putStr("gen" + std::to_string(i) + ".cc");
+        putAddr(symbolAddr(opts_, first));
+        put32(uint64_t(count) * opts_.funcSize);
+        for (uint32_t fn = first; opts_.names && fn < first + count; fn++) {
+          if (fn >= opts_.symbols) { break; }
+          dies_.push_back(out_.size() - info);
+          dieCus_.push_back(i);
+          nameOffsets_.push_back(uint32_t(strs.size()));
+          strs += dieName(fn);
+          strs += '\0';
+          putULEB(2);
+          put32(nameOffsets_.back());
+          putAddr(symbolAddr(opts_, fn));
+          put32(opts_.funcSize);
+        }
+        if (opts_.names) { put8(0); }  // End of children
+        patch(unit, out_.size() - unit - 4, 4);
+      }
+      infoSize_ = out_.size() - info;
+      addSec(".debug_info", 1, 0, info, 1);
+      if (!opts_.names) { return; }
+
+      auto start = out_.size();
+      out_.insert(out_.end(), strs.begin(), strs.end());
+      addSec(".debug_str", 1, 0x30, start, 1, 1);  // SHF_MERGE | SHF_STRINGS
+      debugNames();
+      gdbIndex();
+    }
+
+    /** DJB hash of the case-folded name, as `.debug_names` uses. */
+    static uint32_t namesHash(std::string_view name) {
+      uint32_t ret = 5381;
+      for (auto c : name) { ret = ret * 33 + uint8_t(tolower(uint8_t(c))); }
+      return ret;
+    }
+
+    void debugNames() {
+      // Names, ordered by hash bucket
+      auto n = uint32_t(dies_.size());
+      auto buckets = std::max(n / 2, 1u);
+      std::vector<uint32_t> hashes(n);
+      std::vector<uint32_t> order(n);
+      for (uint32_t i = 0; i < n; i++) {
+        hashes[i] = namesHash(dieName(i));
+        order[i] = i;
+      }
+      std::stable_sort(order.begin(), order.end(), [&](auto a, auto b) {
+        return hashes[a] % buckets < hashes[b] % buckets;
+      });
+
+      auto start = out_.size();
+      put32(0);  // Length, patched below
+      put16(5);  // Version
+      put16(0);
+      put32(opts_.cus);
+      put32(0);  // Local type units
+      put32(0);  // Foreign type units
+      put32(buckets);
+      put32(n);
+      put32(9);  // Abbreviations' size
+      put32(0);  // No augmentation string
+      for (auto cu : cuOffsets_) { put32(cu); }
+      std::vector<uint32_t> first(buckets, 0);
+      for (uint32_t i = n; i-- > 0;) {
+        first[hashes[order[i]] % buckets] = i + 1;
+      }
+      for (auto f : first) { put32(f); }
+      for (auto i : order) { put32(hashes[i]); }
+      for (auto i : order) { put32(nameOffsets_[i]); }
+      for (uint32_t i = 0; i < n; i++) { put32(i * 7); }  // 7 bytes per entry
+      putULEB(1);
+      putULEB(0x2e);  // DW_TAG_subprogram
+      putULEB(1);     // DW_IDX_compile_unit
+      putULEB(0x0b);  // DW_FORM_data1
+      putULEB(3);     // DW_IDX_die_offset
+      putULEB(0x13);  // DW_FORM_ref4
+      put8(0);
+      put8(0);
+      put8(0);
+      assert(opts_.cus <= 0x100);
+      for (auto i : order) {
+        putULEB(1);
+        put8(dieCus_[i]);
+        put32(dies_[i] - cuOffsets_[dieCus_[i]]);
+        put8(0);
+      }
+      patch(start, out_.size() - start - 4, 4);
+      addSec(".debug_names", 1, 0, start, 4);
+    }
+
+    /** Hash of the lowercased name, as `.gdb_index` (version 5 on) uses. */
+    static uint32_t gdbHash(std::string_view name) {
+      uint32_t ret = 0;
+      for (auto c : name) {
+        ret = ret * 67 + uint8_t(tolower(uint8_t(c))) - 113;
+      }
+      return ret;
+    }
+
+    void gdbIndex() {
+      // Always little-endian
+      std::string data;
+      auto le = [&](uint64_t val, unsigned bytes) {
+        for (unsigned i = 0; i < bytes; i++) { data += char(val >> (8 * i)); }
+      };
+      auto n = uint32_t(dies_.size());
+      uint32_t slots = 4;
+      while (slots < n * 4 / 3 + 1) { slots *= 2; }
+      auto cuList = 24u;
+      auto symbols = cuList + opts_.cus * 16;
+      auto pool = symbols + slots * 8;
+      le(7, 4);  // Version
+      le(cuList, 4);
+      le(symbols, 4);  // Types CU list (empty)
+      le(symbols, 4);  // Address area (empty)
+      le(symbols, 4);
+      le(pool, 4);
+      for (uint32_t i = 0; i < opts_.cus; i++) {
+        auto end = i + 1 < opts_.cus ? cuOffsets_[i + 1] : infoSize_;
+        le(cuOffsets_[i], 8);
+        le(end - cuOffsets_[i], 8);
+      }
+
+      // The hash table, then the constant pool: each name's CU vector (of
+      // one CU), then the names
+      std::vector<std::pair<uint32_t, uint32_t>> table(slots, {0, 0});
+      std::string vectors;
+      std::string names;
+      for (uint32_t i = 0; i < n; i++) {
+        auto hash = gdbHash(dieName(i));
+        auto slot = hash & (slots - 1);
+        auto step = ((hash * 17) & (slots - 1)) | 1;
+        while (table[slot].first || table[slot].second) {
+          slot = (slot + step) & (slots - 1);
+        }
+        table[slot] = {n * 8 + uint32_t(names.size()), i * 8};
+        uint32_t cuVector[] = {1, dieCus_[i] | (3u << 28)};  // A function
+        for (auto v : cuVector) {
+          for (unsigned b = 0; b < 4; b++) { vectors += char(v >> (8 * b)); }
+        }
+        names += dieName(i);
+        names += '\0';
+      }
+      for (auto [name, vec] : table) {
+        le(name, 4);
+        le(vec, 4);
+      }
+      data += vectors;
+      data += names;
+
+      auto start = out_.size();
+      out_.insert(out_.end(), data.begin(), data.end());
+      addSec(".gdb_index", 1, 0, start, 4);
+    }
+
+    void symbols(uint32_t textIndex) {
+      std::string strtab {'\0'};
+      align(8);
+      auto symtab = out_.size();
+      out_.resize(out_.size() + (opts_.is64 ? 24 : 16), 0);  // Null symbol
+      for (uint32_t i = 0; i < opts_.symbols; i++) {
+        auto name = uint32_t(strtab.size());
+        strtab += symbolName(i);
+        strtab += '\0';
+        auto value = symbolAddr(opts_, i);
+        uint8_t info = 0x12;  // STB_GLOBAL, STT_FUNC
+        if (opts_.is64) {
+          put32(name);
+          put8(info);
+          put8(0);
+          put16(textIndex);
+          put64(value);
+          put64(opts_.funcSize);
+        } else {
+          put32(name);
+          put32(value);
+          put32(opts_.funcSize);
+          put8(info);
+          put8(0);
+          put16(textIndex);
+        }
+      }
+      auto strtabIndex = uint32_t(secs_.size() + 1);
+      auto index = addSec(
+          ".symtab", 2, 0, symtab, 8, opts_.is64 ? 24 : 16);  // SHT_SYMTAB
+      secs_[index].link = strtabIndex;
+      secs_[index].info = 1;  // First non-local symbol
+      auto start = out_.size();
+      out_.insert(out_.end(), strtab.begin(), strtab.end());
+      addSec(".strtab", 3, 0, start, 1);  // SHT_STRTAB
+    }
+
+    void header(uint64_t shoff, uint32_t shstrndx) {
+      auto is64 = opts_.is64;
+      out_[0] = 0x7f;
+      out_[1] = 'E';
+      out_[2] = 'L';
+      out_[3] = 'F';
+      out_[4] = is64 ? 2 : 1;
+      out_[5] = opts_.isLE ? 1 : 2;
+      out_[6] = 1;  // EV_CURRENT
+      auto ehSize = is64 ? 64u : 52u;
+      auto phSize = is64 ? 56u : 32u;
+      auto shSize = is64 ? 64u : 40u;
+      auto w = is64 ? 8u : 4u;
+      size_t at = 16;
+      auto field = [&](uint64_t val, unsigned bytes) {
+        patch(at, val, bytes);
+        at += bytes;
+      };
+      field(3, 2);              // ET_DYN
+      field(is64 ? 62 : 3, 2);  // EM_X86_64 or EM_386
+      field(1, 4);
+      field(kTextOffset, w);  // Entry
+      field(ehSize, w);       // Program headers offset
+      field(shoff, w);
+      field(0, 4);  // Flags
+      field(ehSize, 2);
+      field(phSize, 2);
+      field(1, 2);  // Program header count
+      field(shSize, 2);
+      field(secs_.size(), 2);
+      field(shstrndx, 2);
+
+      // PT_LOAD, covering everything, R+X
+      at = ehSize;
+      field(1, 4);
+      if (is64) { field(5, 4); }
+      field(0, w);            // Offset
+      field(0, w);            // Virtual address
+      field(0, w);            // Physical address
+      field(out_.size(), w);  // File size
+      field(out_.size(), w);  // Memory size
+      if (!is64) { field(5, 4); }
+      field(0x1000, w);  // Alignment
+    }
+
+    void sectionHeaders() {
+      for (auto const& s : secs_) {
+        put32(s.name);
+        put32(s.type);
+        putAddr(s.flags);
+        putAddr((s.flags & 2) ? s.offset : 0);  // Address (if allocated)
+        putAddr(s.offset);
+        putAddr(s.size);
+        put32(s.link);
+        put32(s.info);
+        putAddr(s.align);
+        putAddr(s.entSize);
+      }
+    }
+
+  public:
+    explicit Writer(Options const& opts) : opts_(opts) {
+      assert(opts.sections <= kMaxSections);
+      assert(opts.cus && opts.funcSize >= 4);
+    }
+
+    std::vector<uint8_t> run() {
+      secs_.push_back({});  // Null section
+      text();
+      auto textIndex = uint32_t(secs_.size() - 1);
+      ehFrame();
+      debugInfo();
+      for (uint32_t i = 0; i < opts_.sections; i++) {
+        addSec(".gen." + std::to_string(i), 1, 0, out_.size(), 1);
+      }
+      symbols(textIndex);
+      auto shstrndx = uint32_t(secs_.size());
+      auto start = out_.size();
+      auto name = secName(".shstrtab");
+      out_.insert(out_.end(), shstrtab_.begin(), shstrtab_.end());
+      secs_.push_back({name, 3, 0, start, out_.size() - start, 0, 0, 1, 0});
+      align(8);
+      auto shoff = out_.size();
+      sectionHeaders();
+      header(shoff, shstrndx);
+      return std::move(out_);
+    }
+  };
+};
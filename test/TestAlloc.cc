@@ -0,0 +1,135 @@
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <proginfo/binary/Binary.h>
+#include <proginfo/util/Alloc.h>
+#include <proginfo/util/Arena.h>
+#include <proginfo/util/MMap.h>
+#include <proginfo/util/Pool.h>
+#include <proginfo/util/SharedPool.h>
+#include <thread>
+#include <vector>
+
+using namespace proginfo;
+
+int main(int, char**) {
+  unsigned errors = 0;
+
+  auto check = [&](bool ok, char const* what) {
+    if (!ok) {
+      std::cerr << "failed: " << what << '\n';
+      ++errors;
+    }
+  };
+
+  // Default `Alloc`: freeing in any order leaves all the space usable again
+  {
+    util::Alloc a;
+    void* ptrs[8];
+    for (auto& p : ptrs) { p = a.alloc(48); }
+    for (auto* p : ptrs) { check(p, "alloc small blocks"); }
+    for (unsigned i = 0; i < 8; i += 2) { a.dealloc(ptrs[i]); }
+    for (unsigned i = 1; i < 8; i += 2) { a.dealloc(ptrs[i]); }
+    auto* big = a.alloc(unsigned(a.capacity() - 16));
+    check(big, "alloc whole space after fragmenting frees");
+    a.dealloc(big);
+    check(!a.alloc(unsigned(a.capacity() + 1)), "alloc too big");
+  }
+
+  // `Alloc` over caller-supplied space, beyond the 640-byte default
+  {
+    alignas(std::max_align_t) static std::byte space[1 << 16];
+    util::Alloc a(space, sizeof(space));
+    check(a.capacity() == sizeof(space), "alloc capacity");
+    auto* p = a.alloc(40000);
+    check(p >= space && p < space + sizeof(space), "large alloc");
+    std::pmr::vector<int> vec(a.pmrAlloc<int>());
+    for (int i = 0; i < 1000; i++) { vec.push_back(i); }
+    check(vec[999] == 999, "pmr vector");
+    vec = std::pmr::vector<int>(a.pmrAlloc<int>());
+    a.dealloc(p);
+  }
+
+  // `Arena`: bump allocation, scopes, and reset
+  {
+    util::StackArena<256> arena;
+    auto* a = arena.alloc(10, 1);
+    auto* b = arena.alloc(8, 8);
+    check(a && b && !(uintptr_t(b) % 8), "arena alignment");
+    auto used = arena.used();
+    {
+      util::Arena::Scope scope(arena);
+      check(arena.alloc(100), "arena alloc in scope");
+      check(!arena.alloc(200), "arena full");
+    }
+    check(arena.used() == used, "arena scope rewinds");
+    auto* c = arena.alloc(16);
+    arena.dealloc(c, 16);
+    check(arena.used() == used, "arena undoes most recent alloc");
+    arena.reset();
+    check(!arena.used() && arena.highMark() > 100, "arena reset");
+  }
+
+  // `Pool`: freed blocks are reused by later allocations of the same size class
+  {
+    util::StackPool<1024> pool;
+    auto* a = pool.alloc(24);
+    auto* b = pool.alloc(100);
+    auto* c = pool.alloc(30);
+    check(a && b && c && pool.live() == 3, "pool alloc");
+    pool.dealloc(a, 24);
+    check(pool.alloc(32) == a, "pool reuses block");
+    check(!pool.alloc(util::Pool::kMaxBlock + 1), "pool alloc too big");
+    check(!pool.alloc(1024), "pool full");
+    pool.dealloc(a, 32);
+    pool.dealloc(b, 100);
+    pool.dealloc(c, 30);
+    check(!pool.live(), "pool empty");
+  }
+
+  // `SharedPool`: blocks allocated on one thread can be freed on others
+  {
+    alignas(std::max_align_t) static std::byte space[1 << 16];
+    util::SharedPool pool(space, sizeof(space));
+    std::vector<void*> blocks;
+    for (unsigned i = 0; i < 64; i++) {
+      blocks.push_back(pool.alloc(16u << (i % 4)));
+    }
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < 4; t++) {
+      threads.emplace_back([&, t] {
+        for (unsigned i = t; i < 64; i += 4) {
+          pool.dealloc(blocks[i], 16u << (i % 4));
+        }
+      });
+    }
+    for (auto& thread : threads) { thread.join(); }
+    check(!pool.live(), "shared pool empty");
+    check(pool.alloc(32) != nullptr, "shared pool reuses blocks");
+  }
+
+  // A `Binary` made on one thread, used and destroyed on another
+  {
+    alignas(std::max_align_t) static std::byte space[1 << 12];
+    util::SharedPool pool(space, sizeof(space));
+    util::MMap mm("test/bins/elf.64.le.exe");
+    mm.check();
+    auto bin = binary::Binary::at(mm.addr_, mm.size_, false, false, &pool);
+    check(bin && bin.resource() == &pool && pool.live() == 1,
+          "binary in shared pool");
+    uintptr_t mainAddr = 0;
+    std::thread worker([&, bin = std::move(bin)]() mutable {
+      util::Alloc a;  // For this thread's short-lived objects (sections, etc.)
+      bin->symTable()->each([&](auto& sym) {
+        if (sym.name() == "main") { mainAddr = sym.value(); }
+        return !mainAddr;
+      });
+      bin = {};
+    });
+    worker.join();
+    check(mainAddr == 0x12fa, "symbol lookup on worker thread");
+    check(!pool.live(), "binary freed on worker thread");
+  }
+
+  assert(!errors);
+}
@@ -0,0 +1,225 @@
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <proginfo/binary/Binary.h>
+#include <proginfo/binary/Core.h>
+#include <proginfo/util/Alloc.h>
+#include <string>
+#include <vector>
+
+using namespace proginfo;
+
+namespace {
+
+/*
+A small hand-made core file, like the kernel writes: one `PT_NOTE` (two
+threads, and the file mappings), then the `PT_LOAD`s, in address order.
+*/
+struct CoreWriter {
+  bool is64;
+  bool isLE;
+  uint16_t machine;
+  std::vector<uint8_t> out;
+
+  void put(uint64_t val, unsigned bytes) {
+    for (unsigned i = 0; i < bytes; i++) {
+      auto shift = 8 * (isLE ? i : bytes - 1 - i);
+      out.push_back(uint8_t(val >> shift));
+    }
+  }
+
+  void patch(size_t offset, uint64_t val, unsigned bytes) {
+    for (unsigned i = 0; i < bytes; i++) {
+      auto shift = 8 * (isLE ? i : bytes - 1 - i);
+      out[offset + i] = uint8_t(val >> shift);
+    }
+  }
+
+  void pad() {
+    while (out.size() % 4) { out.push_back(0); }
+  }
+
+  void note(uint32_t type, std::string const& desc) {
+    put(5, 4);
+    put(desc.size(), 4);
+    put(type, 4);
+    out.insert(out.end(), {'C', 'O', 'R', 'E', 0});
+    pad();
+    out.insert(out.end(), desc.begin(), desc.end());
+    pad();
+  }
+
+  std::string bytes(uint64_t val, unsigned n) {
+    std::string ret(n, '\0');
+    for (unsigned i = 0; i < n; i++) {
+      ret[i] = char(val >> (8 * (isLE ? i : n - 1 - i)));
+    }
+    return ret;
+  }
+
+  std::string prstatus(uint32_t pid, uint16_t sig, uint64_t pc, uint64_t sp) {
+    unsigned w = is64 ? 8 : 4;
+    size_t regsOff = is64 ? 112 : 72;
+    unsigned nregs = is64 ? 27 : 17;
+    unsigned pcIdx = is64 ? 16 : 12, spIdx = is64 ? 19 : 15;
+    unsigned fpIdx = is64 ? 4 : 5;
+    std::string ret(regsOff + nregs * w + 8, '\0');
+    ret.replace(12, 2, bytes(sig, 2));
+    ret.replace(is64 ? 32 : 24, 4, bytes(pid, 4));
+    ret.replace(regsOff + pcIdx * w, w, bytes(pc, w));
+    ret.replace(regsOff + spIdx * w, w, bytes(sp, w));
+    ret.replace(regsOff + fpIdx * w, w, bytes(sp + 0x10, w));
+    return ret;
+  }
+
+  std::vector<uint8_t> build() {
+    unsigned w = is64 ? 8 : 4;
+    unsigned ehSize = is64 ? 64 : 52;
+    unsigned phSize = is64 ? 56 : 32;
+    struct Load {
+      uint64_t vaddr, memSize, fileSize;
+      uint8_t fill;
+    };
+    Load loads[] = {
+        {0x400000, 0x1000, 0x1000, 0xaa},
+        {0x500000, 0x2000, 0, 0},  // Not dumped
+        {0x7ff000, 0x1000, 0x1000, 0x55},
+    };
+    out.assign(ehSize + 4 * phSize, 0);
+
+    auto notes = out.size();
+    note(1, prstatus(100, 11, 0x400123, 0x7ff800));
+    note(1, prstatus(101, 0, 0x400456, 0x7ffc00));
+    std::string files;
+    files += bytes(2, w) + bytes(0x1000, w);
+    files += bytes(0x400000, w) + bytes(0x401000, w) + bytes(0, w);
+    files += bytes(0x7ff000, w) + bytes(0x800000, w) + bytes(3, w);
+    files += std::string("/bin/prog\0/lib/libc.so", 22) + '\0';
+    note(0x46494c45, files);
+    auto notesSize = out.size() - notes;
+
+    // Program headers; the first `PT_LOAD`'s contents are followed by the
+    // last's (the middle one has no file data)
+    size_t at = ehSize;
+    auto phdr = [&](uint32_t type,
+                    uint64_t off,
+                    uint64_t vaddr,
+                    uint64_t fileSize,
+                    uint64_t memSize) {
+      patch(at, type, 4);
+      if (is64) {
+        patch(at + 8, off, 8);
+        patch(at + 0x10, vaddr, 8);
+        patch(at + 0x20, fileSize, 8);
+        patch(at + 0x28, memSize, 8);
+      } else {
+        patch(at + 4, off, 4);
+        patch(at + 8, vaddr, 4);
+        patch(at + 0x10, fileSize, 4);
+        patch(at + 0x14, memSize, 4);
+      }
+      at += phSize;
+    };
+    phdr(4, notes, 0, notesSize, 0);
+    for (auto& load : loads) {
+      while (out.size() % 0x1000) { out.push_back(0); }
+      phdr(1, out.size(), load.vaddr, load.fileSize, load.memSize);
+      out.insert(out.end(), load.fileSize, load.fill);
+    }
+    // A pointer to read back, on the "stack"
+    patch(out.size() - 0x1000 + 0x800, 0x400123, w);
+
+    out[0] = 0x7f, out[1] = 'E', out[2] = 'L', out[3] = 'F';
+    out[4] = is64 ? 2 : 1;
+    out[5] = isLE ? 1 : 2;
+    out[6] = 1;
+    patch(0x10, 4, 2);  // ET_CORE
+    patch(0x12, machine, 2);
+    patch(0x14, 1, 4);
+    patch(is64 ? 0x20 : 0x1c, ehSize, w);  // Program headers offset
+    patch(is64 ? 0x34 : 0x28, ehSize, 2);
+    patch(is64 ? 0x36 : 0x2a, phSize, 2);
+    patch(is64 ? 0x38 : 0x2c, 4, 2);
+    patch(is64 ? 0x3a : 0x2e, is64 ? 64 : 40, 2);
+    return out;
+  }
+};
+
+}  // namespace
+
+int main(int, char**) {
+  unsigned errors = 0;
+  util::Alloc alloc;
+
+  auto check = [&](bool ok, char const* what, CoreWriter const& cw) {
+    if (!ok) {
+      std::cerr << "failed: " << what << " (ELF" << (cw.is64 ? 64 : 32)
+                << (cw.isLE ? " LE" : " BE") << ")\n";
+      ++errors;
+    }
+  };
+
+  CoreWriter writers[] = {
+      {true, true, binary::Core::kEMX86_64, {}},
+      {true, false, binary::Core::kEMX86_64, {}},
+      {false, true, binary::Core::kEM386, {}},
+  };
+  for (auto& cw : writers) {
+    auto bytes = cw.build();
+    auto bin = binary::Binary::at(bytes.data(), bytes.size(), false, false);
+    check(bin && bin->isCore(), "isCore", cw);
+    check(!bin->isExecutable() && !bin->isSharedObject(), "not exe/lib", cw);
+    binary::Core core(*bin);
+    check(bool(core), "core", cw);
+
+    std::vector<binary::Core::Thread> threads;
+    core.eachThread([&](auto& thread) {
+      threads.push_back(thread);
+      return true;
+    });
+    check(threads.size() == 2, "thread count", cw);
+    if (threads.size() == 2) {
+      auto& t = threads[0];
+      check(t.pid == 100 && t.signal == 11, "thread 0 pid, signal", cw);
+      check(t.pc == 0x400123 && t.sp == 0x7ff800, "thread 0 pc, sp", cw);
+      check(t.fp == 0x7ff810, "thread 0 fp", cw);
+      check(threads[1].pid == 101 && threads[1].pc == 0x400456, "thread 1", cw);
+    }
+
+    std::vector<binary::Core::MappedFile> files;
+    core.eachFile([&](auto& file) {
+      files.push_back(file);
+      return true;
+    });
+    check(files.size() == 2, "file count", cw);
+    if (files.size() == 2) {
+      check(files[0].path == "/bin/prog" && files[0].start == 0x400000 &&
+                files[0].end == 0x401000 && files[0].fileOffset == 0,
+            "file 0",
+            cw);
+      check(files[1].path == "/lib/libc.so" && files[1].fileOffset == 0x3000,
+            "file 1",
+            cw);
+    }
+
+    auto mem = core.memory(0x400ff0, 0x100);
+    check(mem.size_ == 0x10 && mem.u8(0) == 0xaa, "memory at end", cw);
+    check(!core.memory(0x3fffff, 1), "memory before", cw);
+    check(!core.memory(0x500000, 8), "memory not dumped", cw);
+    check(!core.memory(0x800000, 1), "memory after", cw);
+    check(core.memory(0x7ff000, 1).u8(0) == 0x55, "memory of last", cw);
+    uintptr_t word = 0;
+    check(core.readWord(0x7ff800, &word) && word == 0x400123, "readWord", cw);
+  }
+
+  // Not a core
+  {
+    std::vector<uint8_t> bytes = CoreWriter {true, true, 62, {}}.build();
+    bytes[0x10] = 2;  // ET_EXEC
+    auto bin = binary::Binary::at(bytes.data(), bytes.size(), false, false);
+    binary::Core core(*bin);
+    check(!core && !bin->isCore(), "not a core", {true, true, 62, {}});
+  }
+
+  assert(!errors);
+}
@@ -0,0 +1,146 @@
+#include <cassert>
+#include <csignal>
+#include <iostream>
+#include <proginfo/procinfo/Backtrace.h>
+#include <proginfo/procinfo/ProcInfo.h>
+#include <proginfo/symbolize/CrashHandler.h>
+#include <proginfo/util/Alloc.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace proginfo;
+
+namespace {
+
+size_t level3(uintptr_t* pcs, size_t max) {
+  return procinfo::backtraceHere(pcs, max);
+}
+
+size_t level2(uintptr_t* pcs, size_t max) { return level3(pcs, max) + 0; }
+
+size_t level1(uintptr_t* pcs, size_t max) { return level2(pcs, max) + 0; }
+
+void traceHere(symbolize::CrashHandler& handler) { handler.writeTrace(); }
+
+void crashHere(int* volatile ptr) { *ptr = 42; }
+
+void abortHere() { abort(); }
+
+/** Everything `fd` produces until EOF. */
+std::string readAll(int fd) {
+  std::string ret;
+  char buf[4096];
+  ssize_t n;
+  while ((n = read(fd, buf, sizeof(buf))) > 0) { ret.append(buf, size_t(n)); }
+  return ret;
+}
+
+/** Run `func` in a child process with a handler writing to a pipe. */
+template <class F>
+std::string crashChild(F func, int* status) {
+  int fds[2];
+  if (pipe(fds)) { return {}; }
+  auto pid = fork();
+  if (!pid) {
+    close(fds[0]);
+    util::Alloc alloc;
+    symbolize::CrashHandler handler({.fd = fds[1]});
+    handler.install();
+    func();
+    _exit(0);
+  }
+  close(fds[1]);
+  auto ret = readAll(fds[0]);
+  close(fds[0]);
+  waitpid(pid, status, 0);
+  return ret;
+}
+
+}  // namespace
+
+int main(int, char**) {
+  unsigned errors = 0;
+
+  auto check = [&](bool ok, char const* what) {
+    if (!ok) {
+      std::cerr << "failed: " << what << '\n';
+      ++errors;
+    }
+  };
+
+  {
+    util::Alloc alloc;
+    procinfo::ModuleMap modules;
+    check(modules.refresh() && modules.size() > 1, "modules");
+    auto* exe = modules.find(uintptr_t(&level1));
+    char exePath[4096] {};
+    check(readlink("/proc/self/exe", exePath, sizeof(exePath) - 1) > 0, "exe");
+    check(exe && exe->path == exePath, "find exe");
+    for (auto& mod : modules) {
+      check(modules.find(mod.start) == &mod, "find each");
+    }
+    check(!modules.find(0), "find null");
+    check(exe && !exe->buildId.empty(), "build ID");
+    if (exe) {
+      auto* same = modules.find(exe->end - 1);
+      check(same == exe && !modules.find(exe->end), "module end");
+    }
+
+    uintptr_t pcs[16];
+    auto n = level1(pcs, 16);
+    check(n >= 4, "backtrace depth");
+    if (n >= 4 && exe) {
+      symbolize::SymbolIndex index;
+      util::MMap mm(exe->path);
+      auto bin = binary::Binary::at(mm.addr_, mm.size_, false, false);
+      check(bin && index.build(*bin), "exe symbols");
+      auto name = [&](size_t i) {
+        auto* e = index.lookup(exe->offset(pcs[i] - 1));
+        return e ? e->name : std::string_view();
+      };
+      check(name(0).find("level3") != name(0).npos, "frame 0");
+      check(name(1).find("level2") != name(1).npos, "frame 1");
+      check(name(2).find("level1") != name(2).npos, "frame 2");
+      check(name(3) == "main", "frame 3");
+    }
+    check(level1(pcs, 2) == 2, "backtrace max");
+  }
+
+  // Trace on demand, to a pipe
+  {
+    int fds[2];
+    check(!pipe(fds), "pipe");
+    util::Alloc alloc;
+    symbolize::CrashHandler handler({.fd = fds[1]});
+    traceHere(handler);
+    close(fds[1]);
+    auto out = readAll(fds[0]);
+    close(fds[0]);
+    check(out.find("#0  0x") == 0, "writeTrace format");
+    check(out.find("in (anonymous namespace)::traceHere(") != out.npos,
+          "writeTrace caller");
+    check(out.find("in main+0x") != out.npos, "writeTrace main");
+  }
+
+  // Real crashes
+  {
+    int status = 0;
+    auto out = crashChild([] { crashHere(nullptr); }, &status);
+    check(out.find("*** SIGSEGV (signal 11), fault address 0x0 ***\n") == 0,
+          "segv header");
+    check(out.find("in (anonymous namespace)::crashHere(int*)+0x") != out.npos,
+          "segv frame");
+    check(out.find("in main+0x") != out.npos, "segv main");
+    // Re-raised, to the default handler (or a sanitizer's)
+    check(WIFSIGNALED(status) || WEXITSTATUS(status), "segv status");
+
+    out = crashChild([] { abortHere(); }, &status);
+    check(out.find("*** SIGABRT (signal 6) ***\n") == 0, "abort header");
+    check(out.find("(anonymous namespace)::abortHere()") != out.npos,
+          "abort frame");
+    check(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT, "abort status");
+  }
+
+  assert(!errors);
+}
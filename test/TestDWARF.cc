@@ -0,0 +1,536 @@
+#include "GenELF.h"
+
+#include <cassert>
+#include <iostream>
+#include <proginfo/binary/elf/Relocatable.h>
+#include <proginfo/debug/DWARF.h>
+#include <proginfo/debug/Lines.h>
+#include <proginfo/debug/Names.h>
+#include <proginfo/debug/Units.h>
+#include <proginfo/symbolize/SymbolIndex.h>
+#include <proginfo/util/Alloc.h>
+#include <proginfo/util/MMap.h>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using namespace proginfo;
+using namespace std::string_literals;
+
+// Its line table should place this function's first instruction on this line
+extern "C" [[gnu::noinline]] int lineMarker(int x) { return x * 3; }
+constexpr unsigned kLineMarkerLine = __LINE__ - 1;
+
+int main(int, char**) {
+  unsigned errors = 0;
+
+  auto check = [&](bool ok, char const* what) {
+    if (!ok) {
+      std::cerr << "failed: " << what << '\n';
+      ++errors;
+    }
+  };
+
+  util::Alloc alloc;
+
+  // The reader
+  {
+    std::string bytes = "\xe5\x8e\x26\x7f\x80\x7f";  // ULEB, SLEB, SLEB
+    debug::Reader r(bytes);
+    check(r.uleb() == 624485 && r.sleb() == -1 && r.sleb() == -128, "LEBs");
+    check(r.ok() && r.atEnd(), "all read");
+    r.u8();
+    check(!r.ok() && r.pos() == bytes.size(), "overrun");
+
+    std::string unit = "\xff\xff\xff\xff\x02\0\0\0\0\0\0\0\x05\0"s;
+    debug::Reader u(unit);
+    bool is64 = false;
+    check(u.initialLength(is64) == 2 && is64 && u.u16() == 5, "64-bit length");
+    debug::Reader be(unit, false, 12);
+    check(be.u16() == 0x0500, "big-endian");
+
+    std::string forms = "abc\0\x03xyz\x81\x01!"s;
+    debug::Reader f(forms);
+    check(f.skipForm(debug::Form::kString, false, 8) && f.pos() == 4, "string");
+    check(f.skipForm(debug::Form::kBlock1, false, 8) && f.pos() == 8, "block");
+    check(f.skipForm(debug::Form::kUdata, false, 8) && f.u8() == '!', "udata");
+    check(!f.skipForm(debug::Form(0x7f), false, 8), "unknown form");
+  }
+
+  // Name lookups in a synthetic binary, with thousands of names across CUs,
+  // by `.debug_names` or `.gdb_index`, in either byte order
+  for (bool isLE : {true, false}) {
+    GenELF::Options opts {
+        .isLE = isLE, .symbols = 5000, .cus = 50, .names = true};
+    auto path = "/tmp/TestDWARF." + std::to_string(getpid()) + ".elf";
+    check(GenELF::write(opts, path.c_str()), "write synthetic ELF");
+    util::MMap mm(path);
+    auto bin = binary::Binary::at(mm.addr_, mm.size_, false, false);
+    check(bin, "parse synthetic ELF");
+    if (!bin) { break; }
+    auto sections = debug::Sections::of(*bin);
+    check(!sections.info.empty() && !sections.names.empty() &&
+              !sections.gdbIndex.empty(),
+          "sections");
+
+    // Check an entry's DIE: a subprogram (abbreviation 2) with that name
+    auto isDie = [&](debug::NameEntry const& e, std::string const& name) {
+      debug::Reader r(sections.info, sections.isLE, e.unitOffset);
+      bool is64;
+      r.initialLength(is64);
+      if (r.u16() != 5 || e.dieOffset == e.kUnknown) { return false; }
+      r.seek(e.dieOffset);
+      if (r.uleb() != 2) { return false; }
+      auto str = sections.str.substr(r.u32());
+      return r.ok() && str.substr(0, str.find('\0')) == name;
+    };
+
+    debug::NameIndex index;
+    check(index.open(sections) && index.hasDebugNames(), "open .debug_names");
+    bool found = true;
+    for (uint32_t i = 0; i < opts.symbols; i++) {
+      auto name = GenELF::dieName(i);
+      size_t n = index.lookup(name, [&](auto& e) {
+        found = found && e.tag == 0x2e && isDie(e, name);
+        return true;
+      });
+      found = found && n == 1;
+    }
+    check(found, "all names found");
+    check(!index.lookup("FN123", [](auto&) { return true; }), "case");
+    check(!index.lookup("nothere", [](auto&) { return true; }), "missing");
+    check(!index.lookup("", [](auto&) { return true; }), "empty");
+
+    // Without `.debug_names`, units (but not DIEs) come from `.gdb_index`
+    auto gdbOnly = sections;
+    gdbOnly.names = {};
+    check(index.open(gdbOnly) && index.hasGdbIndex(), "open .gdb_index");
+    debug::NameEntry viaNames {}, viaGdb {};
+    auto first = [](debug::NameEntry& out) {
+      return [&out](auto& e) {
+        out = e;
+        return false;
+      };
+    };
+    check(index.lookup("fn4321", first(viaGdb)) == 1, ".gdb_index lookup");
+    index.open(sections);
+    index.lookup("fn4321", first(viaNames));
+    check(viaGdb.unitOffset == viaNames.unitOffset && viaGdb.tag == 0x2e &&
+              viaGdb.dieOffset == debug::NameEntry::kUnknown,
+          ".gdb_index entry");
+    found = true;
+    index.open(gdbOnly);
+    for (uint32_t i = 0; i < opts.symbols; i += 7) {
+      found = found && index.lookup(GenELF::dieName(i), first(viaGdb)) == 1;
+    }
+    check(found, ".gdb_index names found");
+    check(!index.lookup("fn5000", first(viaGdb)), ".gdb_index missing");
+
+    auto neither = gdbOnly;
+    neither.gdbIndex = {};
+    check(!index.open(neither), "no index");
+    unlink(path.c_str());
+  }
+
+  // Units in the test binaries, built by clang with split DWARF: skeleton
+  // units, whose strings and addresses are indexed
+  for (auto [file, lowPc] : {std::pair("elf.64.le.exe", 0x12f4u),
+                             std::pair("elf.32.be.exe", 0x1020cu)}) {
+    util::MMap mm("test/bins/"s + file);
+    auto bin = binary::Binary::at(mm.addr_, mm.size_, false, false);
+    check(bin, "parse test binary");
+    if (!bin) { continue; }
+    debug::Units units;
+    check(units.open(debug::Sections::of(*bin)) && units.size() == 1,
+          "skeleton unit");
+    if (!units.size()) { continue; }
+    auto& u = units[0];
+    check(u.version == 5 && u.type == 4 && u.tag == 0x4a && u.id,
+          "skeleton header");
+    check(u.strOffsetsBase == 8 && u.addrBase == 8 && u.lowPc == lowPc,
+          "skeleton bases");
+    std::string_view compDir, dwoName;
+    uint64_t addr = 0;
+    units.attributes(u, u.dieOffset, [&](auto& a, debug::Reader& r) {
+      if (a.name == 0x1b) { compDir = units.string(u, a.form, r); }
+      if (a.name == 0x76) { dwoName = units.string(u, a.form, r); }
+      if (a.name == 0x11) { units.address(u, a.form, r, addr); }
+      return true;
+    });
+    check(compDir == "/Users/steve/code/proginfo/test/bins", "strx1");
+    check(dwoName == file + "-simple.exe.dwo"s, "strx1 again");
+    check(addr == lowPc, "addrx");
+    check(units.find(u.dieOffset) == &u && !units.find(u.end), "find");
+  }
+
+  // The split unit in a `.dwo` gives no bases; it has the only contributions
+  {
+    util::MMap mm("test/bins/elf.64.le.exe-simple.exe.dwo");
+    auto bin = binary::Binary::at(mm.addr_, mm.size_, false, false);
+    check(bin, "parse .dwo");
+    debug::Units units;
+    auto sections = bin ? debug::Sections::of(*bin) : debug::Sections {};
+    check(units.open(sections) && units.size() == 1, "split unit");
+    if (units.size()) {
+      auto& u = units[0];
+      check(u.type == 5 && u.tag == 0x11 && u.strOffsetsBase == 8 &&
+                u.rnglistsBase == 12,
+            "split unit bases");
+      // As `llvm-dwarfdump` shows: `_start` at 0x1a, and `main` at 0x29
+      std::string_view name;
+      uint64_t ranges = 0, lo = 0, hi = 0, addr = 0;
+      bool hasAddr = true;
+      auto tag = units.attributes(u, 0x29, [&](auto& a, debug::Reader& r) {
+        if (a.name == 0x03) { name = units.string(u, a.form, r); }
+        if (a.name == 0x55) { units.rnglist(u, a.form, r, ranges); }
+        return true;
+      });
+      check(tag == 0x2e && name == "main" && ranges == 0x10, "rnglistx");
+      check(units.ranges(u,
+                         ranges,
+                         [&](uint64_t l, uint64_t h) {
+                           lo = l;
+                           hi = h;
+                           return true;
+                         }) &&
+                lo == 6 && hi == 0xc,
+            "range list");
+      // Its addresses are in the skeleton's `.debug_addr`
+      auto address = [&](auto& a, debug::Reader& r) {
+        if (a.name == 0x11) { hasAddr = units.address(u, a.form, r, addr); }
+        return true;
+      };
+      units.attributes(u, 0x1a, address);
+      check(!hasAddr, "no .debug_addr");
+      util::MMap skel("test/bins/elf.64.le.exe");
+      auto skelBin = binary::Binary::at(skel.addr_, skel.size_, false, false);
+      sections.addr = debug::Sections::of(*skelBin).addr;
+      units.open(sections);
+      units.attributes(units[0], 0x1a, address);
+      check(hasAddr && addr == 0x12f4, "skeleton's .debug_addr");
+    }
+  }
+
+  // Every kind of range and location list entry, in hand-made sections
+  {
+    auto put = [](std::string& s, uint64_t v, unsigned n) {
+      for (unsigned i = 0; i < n; i++) { s += char(v >> (8 * i)); }
+    };
+    // Headers (with one offset entry, for the list just after it), then lists
+    std::string addr, rnglists, loclists;
+    put(addr, 20, 4);
+    put(addr, 5, 2);
+    put(addr, 8, 1);
+    put(addr, 0, 1);
+    put(addr, 0x2000, 8);
+    put(addr, 0x3000, 8);
+    for (auto* s : {&rnglists, &loclists}) {
+      put(*s, 0, 4);  // Length isn't checked
+      put(*s, 5, 2);
+      put(*s, 8, 1);
+      put(*s, 0, 1);
+      put(*s, 1, 4);
+      put(*s, 4, 4);
+    }
+    // Offset pair (from `lowPc`); base address (x) and offset pair; start (x)
+    // and end (x); start (x) and length; base address and offset pair; start
+    // and end; start and length
+    rnglists += "\x04\x10\x20\x01\x01\x04\x00\x08\x02\x00\x01\x03\x00\x10\x05"s;
+    put(rnglists, 0x5000, 8);
+    rnglists += "\x04\x01\x02\x06"s;
+    put(rnglists, 0x6000, 8);
+    put(rnglists, 0x6100, 8);
+    rnglists += "\x07"s;
+    put(rnglists, 0x7000, 8);
+    rnglists += "\x40\x00"s;
+    // Offset pair; base address and offset pair; start and length; a GNU view
+    // pair (skipped); the default location.  Each has an expression
+    loclists += "\x04\x00\x04\x01\x50\x06"s;
+    put(loclists, 0x8000, 8);
+    loclists += "\x04\x00\x02\x01\x51\x08"s;
+    put(loclists, 0x9000, 8);
+    loclists += "\x04\x01\x52\x09\x01\x02\x05\x02\x53\x54\x00"s;
+
+    debug::Sections sections;
+    sections.addr = addr;
+    sections.rnglists = rnglists;
+    sections.loclists = loclists;
+    debug::Units units;
+    units.open(sections);  // With no units, but the sections are all it uses
+    debug::Unit u {};
+    u.version = 5;
+    u.addrSize = 8;
+    u.lowPc = 0x1000;
+    u.addrBase = 8;
+    u.rnglistsBase = 12;
+    u.loclistsBase = 12;
+
+    std::string zero(1, '\0');
+    debug::Reader index(zero);
+    uint64_t offset = 0;
+    check(units.rnglist(u, debug::Form::kRnglistx, index, offset) &&
+              offset == 16,
+          "rnglistx offset");
+    std::vector<std::pair<uint64_t, uint64_t>> got;
+    auto collect = [&](uint64_t lo, uint64_t hi) {
+      got.emplace_back(lo, hi);
+      return true;
+    };
+    check(units.ranges(u, offset, collect), "ranges");
+    check(got == decltype(got) {{0x1010, 0x1020},
+                                {0x3000, 0x3008},
+                                {0x2000, 0x3000},
+                                {0x2000, 0x2010},
+                                {0x5001, 0x5002},
+                                {0x6000, 0x6100},
+                                {0x7000, 0x7040}},
+          "range list entries");
+    got.clear();
+    check(units.ranges(u,
+                       offset,
+                       [&](uint64_t lo, uint64_t hi) {
+                         got.emplace_back(lo, hi);
+                         return false;
+                       }) &&
+              got.size() == 1,
+          "stop early");
+    std::string truncated = rnglists.substr(0, rnglists.size() - 1);
+    sections.rnglists = truncated;
+    units.open(sections);
+    check(!units.ranges(u, offset, collect), "truncated list");
+
+    debug::Reader index2(zero);
+    check(units.loclist(u, debug::Form::kLoclistx, index2, offset) &&
+              offset == 16,
+          "loclistx offset");
+    std::string exprs;
+    got.clear();
+    check(units.locations(u,
+                          offset,
+                          [&](uint64_t lo, uint64_t hi, std::string_view e) {
+                            got.emplace_back(lo, hi);
+                            exprs += e;
+                            return true;
+                          }),
+          "locations");
+    check(got == decltype(got) {{0x1000, 0x1004},
+                                {0x8000, 0x8002},
+                                {0x9000, 0x9004},
+                                {0, ~uint64_t(0)}},
+          "location list entries");
+    check(exprs == "\x50\x51\x52\x53\x54", "location expressions");
+    std::string sec = "\x10\0\0\0"s;
+    debug::Reader secOffset(sec);
+    check(units.loclist(u, debug::Form::kSecOffset, secOffset, offset) &&
+              offset == 16,
+          "sec_offset");
+  }
+
+  // This program's own line table, compacted: the same rows as decoding it
+  {
+    util::MMap mm("/proc/self/exe");
+    auto bin = binary::Binary::at(mm.addr_, mm.size_, false, false);
+    debug::Units units;
+    check(bin && units.open(debug::Sections::of(*bin)), "own units");
+    debug::LineTable table;
+    check(table.add(units), "own line programs");
+    table.finish();
+    check(table.rowCount() > 100, "own rows");
+
+    // Each row's address, and the byte before the next row, find that row
+    std::vector<debug::LineRow> rows;
+    std::vector<debug::LineFile> files;
+    debug::LineProgram program;
+    for (auto& u : units) {
+      if (!program.open(units, u)) { continue; }
+      auto base = uint32_t(files.size());
+      for (size_t i = 0; i < program.fileCount(); i++) {
+        files.push_back(program.file(i));
+      }
+      program.run([&](auto& row) {
+        rows.push_back(row);
+        rows.back().file += base;
+        return true;
+      });
+    }
+    bool same = true;
+    size_t checked = 0;
+    for (size_t i = 0; i + 1 < rows.size(); i++) {
+      auto& row = rows[i];
+      if (row.endSequence || rows[i + 1].addr <= row.addr) { continue; }
+      for (auto addr : {row.addr, rows[i + 1].addr - 1}) {
+        debug::LineRow got;
+        same = same && table.lookup(addr, got) && got.line == row.line &&
+               got.column == row.column &&
+               table.file(got.file)->name == files[row.file].name;
+        ++checked;
+      }
+    }
+    check(same && checked > 100, "lookups match the line programs");
+
+    symbolize::SymbolIndex symbols;
+    symbols.build(*bin);
+    auto* marker = symbols.find("lineMarker");
+    debug::LineRow row;
+    check(marker && table.lookup(marker->addr, row), "marker row");
+    auto* file = table.file(row.file);
+    check(file && file->name.find("TestDWARF.cc") != file->name.npos &&
+              row.line == kLineMarkerLine,
+          "marker file and line");
+    check(!table.lookup(0, row), "before any code");
+  }
+
+  // Many rows, in sequences added out of order, in a few bytes each
+  {
+    debug::LineTable table;
+    std::vector<debug::LineRow> rows;
+    uint32_t files[] = {table.addFile({"/src", "a.cc"}),
+                        table.addFile({"/src", "b.h"})};
+    uint64_t seed = 1;
+    auto rand = [&](uint64_t n) {
+      seed = seed * 6364136223846793005u + 1442695040888963407u;
+      return (seed >> 33) % n;
+    };
+    constexpr size_t kSequences = 20000;
+    for (size_t s = 0; s < kSequences; s++) {
+      // Sequence `s` is at `0x100000 + s * 0x1000`, but added in another order
+      auto at = (s * 7919) % kSequences;
+      debug::LineRow row {
+          0x100000 + at * 0x1000, files[0], uint32_t(10 + at * 3), 1, false};
+      for (size_t i = 0, n = 20 + rand(60); i < n; i++) {
+        table.add(row);
+        rows.push_back(row);
+        row.addr += 1 + rand(12);
+        row.line = uint32_t(int64_t(row.line) + int64_t(rand(9)) - 3);
+        if (!rand(4)) { row.column = uint32_t(1 + rand(40)); }
+        if (!rand(20)) { row.file = files[rand(2)]; }
+      }
+      row.endSequence = true;
+      table.add(row);
+    }
+    table.add({0x100000 + 0x10, files[0], 1, 1, false});  // Overlaps: dropped
+    table.add({0x100000 + 0x20, files[0], 1, 1, true});
+    table.finish();
+    auto perRow = double(table.bytes()) / double(table.rowCount());
+    check(table.rowCount() == rows.size() + kSequences, "row count");
+    check(perRow <= 4, "bytes per row");
+
+    bool same = true;
+    for (size_t i = 0; i < rows.size(); i += 3) {
+      debug::LineRow got;
+      auto& row = rows[i];
+      same = same && table.lookup(row.addr, got) && got.addr == row.addr &&
+             got.line == row.line && got.column == row.column &&
+             got.file == row.file;
+    }
+    check(same, "lookups");
+    debug::LineRow got;
+    check(!table.lookup(0x100000 + kSequences * 0x1000, got), "past the end");
+    check(!table.lookup(0xfffff, got), "before the start");
+
+    // More rows, merged with those already encoded
+    table.add({0x10, files[1], 7, 1, false});
+    table.add({0x20, files[1], 8, 1, true});
+    table.finish();
+    check(table.lookup(0x18, got) && got.line == 7 && got.file == files[1],
+          "merged row");
+    check(table.lookup(rows[5].addr, got) && got.line == rows[5].line,
+          "old rows kept");
+  }
+
+  // Object files: DWARF read through relocations, with synthetic addresses.
+  // Without them, both functions would be at 0, and names would be wrong.
+  for (auto* path : {"test/bins/elf.64.le.o", "test/bins/elf.32.le.o"}) {
+    util::MMap mm(path);
+    auto bin = binary::Binary::at(mm.addr_, mm.size_, false, false);
+    check(bin, "parse object");
+    if (!bin) { break; }
+    check(static_cast<binary::ELF const&>(*bin).isRelocatable(), "ET_REL");
+    binary::Relocatable relocs(*bin);
+    check(bool(relocs), "relocatable");
+    uintptr_t start = 0, main = 0;
+    size_t index = 0;
+    bin->eachSection([&](auto& sec) {
+      if (sec.name() == ".text._start") { start = relocs.sectionAddr(index); }
+      if (sec.name() == ".text.startup.main") {
+        main = relocs.sectionAddr(index);
+      }
+      ++index;
+      return true;
+    });
+    check(start >= binary::Relocatable::kBaseAddr && main > start,
+          "section addresses");
+    check(!relocs.sectionAddr(0), "null section");
+
+    symbolize::SymbolIndex symbols;
+    symbols.build(*bin);
+    auto* startSym = symbols.lookup(start);
+    auto* mainSym = symbols.lookup(main + 1);
+    check(startSym && startSym->name == "_start" && startSym->addr == start,
+          "_start symbol");
+    check(mainSym && mainSym->name == "main" && mainSym->addr == main,
+          "main symbol");
+
+    debug::Units units;
+    check(units.open(debug::Sections::of(*bin, &relocs)) && units.size() == 1,
+          "object's units");
+    debug::LineTable table;
+    check(table.add(units), "object's line programs");
+    table.finish();
+    debug::LineRow row;
+    check(table.lookup(main, row) && row.line == 2, "main's line");
+    check(table.lookup(start, row) && row.line == 1, "_start's line");
+    auto* file = table.file(row.file);
+    check(file && file->name == "simple.exe.c", "file name");
+    check(!relocs.skipped(), "all relocations applied");
+
+    // Sections are relocated once, then reused
+    auto info = relocs.contents(".debug_info");
+    check(!info.empty() && info.data() == relocs.contents(".debug_info").data(),
+          "relocated once");
+    auto inFile = [&](char const* name) {
+      return (char const*) bin->baseAddr().ptr_ +
+             bin->section(name)->fileOffset();
+    };
+    check(info.data() != inFile(".debug_info"), "copied");
+    check(relocs.contents(".debug_str").data() == inFile(".debug_str"),
+          "in place");
+  }
+
+  // References to named symbols, including in sections which aren't allocated
+  // and in the TLS block (see `test/bins/reloc.s`)
+  for (auto* path :
+       {"test/bins/elf.64.le.reloc.o", "test/bins/elf.32.le.reloc.o"}) {
+    util::MMap mm(path);
+    auto bin = binary::Binary::at(mm.addr_, mm.size_, false, false);
+    check(bin, "parse reloc object");
+    if (!bin) { break; }
+    binary::Relocatable relocs(*bin);
+    check(bool(relocs), "reloc object");
+    uintptr_t data = 0, tdata = 0, tbss = 0;
+    size_t index = 0;
+    bin->eachSection([&](auto& sec) {
+      if (sec.name() == ".data") { data = relocs.sectionAddr(index); }
+      if (sec.name() == ".tdata") { tdata = relocs.sectionAddr(index); }
+      if (sec.name() == ".tbss") { tbss = relocs.sectionAddr(index); }
+      ++index;
+      return true;
+    });
+    check(data && tdata && tbss == tdata + 16, "TLS block together");
+    auto refs = relocs.contents(".refs");
+    check(refs.size() == (bin->is64() ? 32 : 16), "refs");
+    if (refs.size() < 16) { continue; }
+    util::Addr addr {refs.data(), refs.size()};
+    check(addr.u32LE(0) == 6, "symbol in a section not allocated");
+    check(addr.u32LE(4) == data + 4, "symbol in .data");
+    check(addr.u32LE(8) == 8, "offset in the TLS block");
+    check(addr.u32LE(12) == 20, "offset in .tbss");
+    if (bin->is64()) {
+      check(addr.u64LE(16) == 6 && addr.u64LE(24) == 8, "64-bit refs");
+    }
+    check(!relocs.skipped(), "all reloc object's relocations applied");
+  }
+
+  assert(!errors);
+}
@@ -0,0 +1,99 @@
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <proginfo/binary/Demangle.h>
+#include <proginfo/util/Alloc.h>
+#include <string>
+
+using namespace proginfo;
+
+int main(int, char**) {
+  unsigned errors = 0;
+
+  auto check = [&](char const* mangled, std::string const& expect) {
+    char buf[1024];
+    auto len = binary::demangle(mangled, buf, sizeof(buf));
+    if (expect != buf || len != expect.size()) {
+      std::cerr << "demangle(" << mangled << ")\n"
+                << "  expected: " << expect << '\n'
+                << "    actual: " << buf << '\n';
+      ++errors;
+    }
+  };
+
+  // Plain names, and things which aren't mangled names at all, come back as-is
+  check("main", "main");
+  check("_Z", "_Z");
+  check("_ZN3fooE1", "_ZN3fooE1");
+  check("_Z1fv", "f()");
+  check("_ZL3fooi", "foo(int)");
+
+  check("_ZNSt6vectorIiSaIiEE9push_backERKi",
+        "std::vector<int, std::allocator<int> >::push_back(int const&)");
+  check("_ZN3foo3barIiEEvT_", "void foo::bar<int>(int)");
+  check("_ZTVN10__cxxabiv117__class_type_infoE",
+        "vtable for __cxxabiv1::__class_type_info");
+  check("_ZNKSt8functionIFvvEEclEv",
+        "std::function<void ()>::operator()() const");
+  check("_ZZ4mainE1x", "main::x");
+  check("_ZN1AC2Ev", "A::A()");
+  check("_ZN1AD0Ev", "A::~A()");
+  check("_ZplRK1AS1_", "operator+(A const&, A const&)");
+  check("_ZN5Outer5InnerIiE3getEv.cold",
+        "Outer::Inner<int>::get() [clone .cold]");
+  check("_ZThn8_N1B1fEv", "non-virtual thunk to B::f()");
+  check("_ZN12_GLOBAL__N_13bazEv", "(anonymous namespace)::baz()");
+  check("_Z1fPFPKcvE", "f(char const* (*)())");
+  check("_Z1fM1AKFivE", "f(int (A::*)() const)");
+  check("_Z1fA10_i", "f(int [10])");
+  check("_ZNSt3mapIiSsSt4lessIiESaISt4pairIKiSsEEEixERS3_",
+        "std::map<int, std::basic_string<char, std::char_traits<char>, "
+        "std::allocator<char> >, std::less<int>, "
+        "std::allocator<std::pair<int const, "
+        "std::basic_string<char, std::char_traits<char>, "
+        "std::allocator<char> > > > >::operator[](int const&)");
+
+  // Truncation: always NUL-terminated, and returns the untruncated length
+  {
+    char buf[8];
+    auto len = binary::demangle("_ZN3foo3barEv", buf, sizeof(buf));
+    if (len != strlen("foo::bar()") || std::string(buf) != "foo::ba") {
+      std::cerr << "truncated demangle: " << len << " '" << buf << "'\n";
+      ++errors;
+    }
+  }
+
+  // Streaming through a tiny buffer, with scratch space from `util::Alloc`
+  {
+    std::string streamed;
+    char buf[4];
+    auto append = [](void* ctx, char const* data, size_t size) {
+      ((std::string*) ctx)->append(data, size);
+    };
+    binary::DemangleSink out(buf, sizeof(buf), append, &streamed);
+    util::Alloc alloc;
+    binary::Demangler demangler(alloc);
+    bool ok = demangler.demangle("_ZNSt6vectorIiSaIiEE9push_backERKi", out);
+    out.finish();
+    auto expect =
+        "std::vector<int, std::allocator<int> >::push_back(int const&)";
+    if (!ok || out.truncated() || streamed != expect) {
+      std::cerr << "streamed demangle: " << ok << " '" << streamed << "'\n";
+      ++errors;
+    }
+  }
+
+  // Running out of scratch space fails cleanly
+  {
+    char buf[256];
+    binary::Demangler::Entry scratch[2];
+    binary::Demangler demangler(scratch, sizeof(scratch));
+    binary::DemangleSink out(buf, sizeof(buf));
+    if (demangler.demangle("_ZNSt6vectorIiSaIiEE9push_backERKi", out)) {
+      std::cerr << "demangle with tiny scratch should fail\n";
+      ++errors;
+    }
+  }
+
+  assert(!errors);
+}
@@ -0,0 +1,114 @@
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <proginfo/symbolize/FrameCache.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace proginfo;
+
+int main(int, char**) {
+  unsigned errors = 0;
+
+  auto check = [&](bool ok, char const* what) {
+    if (!ok) {
+      std::cerr << "failed: " << what << '\n';
+      ++errors;
+    }
+  };
+
+  auto frame = [](uint64_t offset) {
+    symbolize::ResolvedFrame ret;
+    ret.symbol = "fn" + std::to_string(offset);
+    ret.offset = offset & 0xf;
+    ret.file = "src/file.cc";
+    ret.line = uint32_t(offset);
+    ret.inlined.push_back({"inner", "src/inner.h", 12});
+    return ret;
+  };
+
+  // Basics, with one shard
+  {
+    symbolize::FrameCache cache(1 << 20, 1);
+    auto mod = cache.module("0123abcd");
+    check(cache.module("0123abcd") == mod && cache.module("ffff") != mod,
+          "modules");
+    check(!cache.get(mod, 0x10), "miss");
+    cache.put(mod, 0x10, frame(0x10));
+    auto got = cache.get("0123abcd", 0x10);
+    check(got && got->symbol == "fn16" && got->line == 16 &&
+              got->inlined.size() == 1 && got->inlined[0].line == 12,
+          "hit");
+    check(!cache.get(cache.module("ffff"), 0x10), "other module");
+
+    unsigned calls = 0;
+    auto resolve = [&] {
+      ++calls;
+      return frame(0x20);
+    };
+    cache.get(mod, 0x20, resolve);
+    auto again = cache.get(mod, 0x20, resolve);
+    check(calls == 1 && again->symbol == "fn32", "resolved once");
+
+    auto stats = cache.stats();
+    check(stats.hits == 2 && stats.misses == 3 && stats.inserts == 2 &&
+              stats.entries == 2 && !stats.evictions,
+          "stats");
+    check(stats.bytes > 2 * frame(0).bytes(), "bytes");
+
+    cache.put(mod, 0x20, frame(0x21));
+    check(cache.get(mod, 0x20)->line == 0x21 && cache.stats().entries == 2,
+          "replace");
+    cache.clear();
+    check(!cache.get(mod, 0x10) && !cache.stats().bytes, "clear");
+    check(got->symbol == "fn16", "still valid after clear");
+  }
+
+  // Bounded memory: least recently used entries go first
+  {
+    auto size = frame(0).bytes();
+    symbolize::FrameCache cache(20 * (size + 256), 1);
+    for (uint64_t i = 0; i < 1000; i++) {
+      cache.put(0, i, frame(i));
+      cache.get(0, 0);  // Keep this one in use
+    }
+    auto stats = cache.stats();
+    check(stats.bytes <= cache.maxBytes() && stats.entries >= 20 &&
+              stats.entries < 50,
+          "bounded");
+    check(stats.evictions == 1000 - stats.entries, "evictions");
+    check(cache.get(0, 0) && cache.get(0, 999) && !cache.get(0, 500), "LRU");
+
+    symbolize::ResolvedFrame big;
+    big.symbol.assign(cache.maxBytes(), 'x');
+    auto kept = cache.put(0, 5000, std::move(big));
+    check(kept && !cache.get(0, 5000), "too big to keep");
+  }
+
+  // Threads sharing a cache, over a working set which fits
+  {
+    symbolize::FrameCache cache(64 << 20);
+    std::atomic<unsigned> wrong {0};
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < 4; t++) {
+      threads.emplace_back([&, t] {
+        auto mod = cache.module(t % 2 ? "aaaa" : "bbbb");
+        for (uint64_t i = 0; i < 20000; i++) {
+          auto offset = (i * 7 + t) % 2000;
+          auto got = cache.get(mod, offset, [&] { return frame(offset); });
+          if (got->line != offset) { ++wrong; }
+        }
+      });
+    }
+    for (auto& t : threads) { t.join(); }
+    auto stats = cache.stats();
+    check(!wrong, "right frames");
+    check(stats.hits + stats.misses == 80000 && stats.entries <= 4000 &&
+              !stats.evictions,
+          "shared stats");
+    check(stats.hitRate() > 0.9, "hit rate");
+  }
+
+  assert(!errors);
+}
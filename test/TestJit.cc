@@ -0,0 +1,179 @@
+#include "GenELF.h"
+
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+#include <proginfo/procinfo/Memory.h>
+#include <proginfo/symbolize/JitSymbols.h>
+#include <proginfo/symbolize/ProcessSymbols.h>
+#include <proginfo/util/Alloc.h>
+#include <string>
+#include <unistd.h>
+
+using namespace proginfo;
+
+// A JIT's half of the GDB JIT interface, as in GDB's documentation
+extern "C" {
+
+struct jit_code_entry {
+  jit_code_entry* next_entry;
+  jit_code_entry* prev_entry;
+  char const* symfile_addr;
+  uint64_t symfile_size;
+};
+
+struct jit_descriptor {
+  uint32_t version;
+  uint32_t action_flag;
+  jit_code_entry* relevant_entry;
+  jit_code_entry* first_entry;
+};
+
+[[gnu::noinline, gnu::used]] void __jit_debug_register_code() {
+  asm volatile("");
+}
+
+[[gnu::used]] jit_descriptor __jit_debug_descriptor {1, 0, nullptr, nullptr};
+}
+
+namespace {
+
+void append(std::string const& path, char const* text) {
+  auto* f = fopen(path.c_str(), "a");
+  fputs(text, f);
+  fclose(f);
+}
+
+void registerCode(jit_code_entry* entry) {
+  entry->prev_entry = nullptr;
+  entry->next_entry = __jit_debug_descriptor.first_entry;
+  if (entry->next_entry) { entry->next_entry->prev_entry = entry; }
+  __jit_debug_descriptor.first_entry = entry;
+  __jit_debug_descriptor.relevant_entry = entry;
+  __jit_debug_descriptor.action_flag = 1;  // JIT_REGISTER_FN
+  __jit_debug_register_code();
+}
+
+void unregisterCode(jit_code_entry* entry) {
+  if (entry->prev_entry) {
+    entry->prev_entry->next_entry = entry->next_entry;
+  } else {
+    __jit_debug_descriptor.first_entry = entry->next_entry;
+  }
+  if (entry->next_entry) { entry->next_entry->prev_entry = entry->prev_entry; }
+  __jit_debug_descriptor.relevant_entry = entry;
+  __jit_debug_descriptor.action_flag = 2;  // JIT_UNREGISTER_FN
+  __jit_debug_register_code();
+}
+
+}  // namespace
+
+int main(int, char**) {
+  unsigned errors = 0;
+
+  auto check = [&](bool ok, char const* what) {
+    if (!ok) {
+      std::cerr << "failed: " << what << '\n';
+      ++errors;
+    }
+  };
+
+  util::Alloc alloc;
+  symbolize::JitSymbols jit;
+
+  auto name = [&](uintptr_t addr) {
+    auto* sym = jit.lookup(addr);
+    return sym ? std::string(sym->name) : std::string("?");
+  };
+
+  // A perf map, read as it's written: only whole lines count
+  auto path = "/tmp/TestJit." + std::to_string(getpid()) + ".map";
+  unlink(path.c_str());
+  check(!jit.readPerfMap(path), "no map yet");
+  append(path,
+         "7f0000001000 40 jitA\n"
+         "7f0000001040 20 LazyCompile:*jitB foo.js:10\n"
+         "7f0000002000 100 jit");
+  check(jit.readPerfMap(path) && jit.size() == 2, "first read");
+  check(name(0x7f0000001000) == "jitA" && name(0x7f000000103f) == "jitA",
+        "lookup");
+  check(name(0x7f0000001040) == "LazyCompile:*jitB foo.js:10",
+        "names with spaces");
+  check(name(0x7f0000001060) == "?" && name(0x7f0000000fff) == "?", "gaps");
+  check(name(0x7f0000002000) == "?", "partial line");
+
+  append(path,
+         "C\n"
+         "bad line\n"
+         "7f0000001000 40 jitA2\n");
+  check(jit.readPerfMap(path) && jit.size() == 4, "incremental read");
+  check(name(0x7f0000002080) == "jitC", "completed line");
+  check(name(0x7f0000001010) == "jitA2", "newest wins");
+
+  check(jit.readPerfMap(path) && jit.size() == 4, "nothing new");
+  {
+    auto* f = fopen(path.c_str(), "w");
+    fputs("7f0000003000 10 jitD\n", f);
+    fclose(f);
+  }
+  check(jit.readPerfMap(path) && jit.size() == 1, "rewritten");
+  check(name(0x7f0000003000) == "jitD" && name(0x7f0000001000) == "?",
+        "after rewrite");
+  unlink(path.c_str());
+
+  // In-memory ELF objects, registered through `__jit_debug_descriptor`
+  symbolize::ProcessSymbols symbols;
+  check(symbols.refresh(), "symbols");
+  auto descriptor = symbols.address("__jit_debug_descriptor");
+  check(descriptor == uintptr_t(&__jit_debug_descriptor), "descriptor");
+
+  GenELF::Options opts {.symbols = 100};
+  auto image = GenELF::build(opts);
+  GenELF::Options opts2 {.symbols = 10, .funcSize = 64};
+  auto image2 = GenELF::build(opts2);
+  jit_code_entry entry {nullptr, nullptr, (char*) image.data(), image.size()};
+  jit_code_entry entry2 {nullptr, nullptr, (char*) image2.data(), 0};
+  registerCode(&entry);
+
+  procinfo::SelfMemory memory;
+  check(jit.readGdbJit(memory, descriptor), "read GDB JIT");
+  check(jit.objectCount() == 1 && jit.size() == 101, "object indexed");
+  auto fn5 = GenELF::symbolAddr(opts, 5);
+  check(name(fn5 + 3) == GenELF::symbolName(5), "object symbol");
+  check(name(GenELF::symbolAddr(opts, 99) + 15) == GenELF::symbolName(99),
+        "last symbol, to the end of .text");
+  check(name(GenELF::symbolAddr(opts, 100)) == "?", "past .text");
+
+  // Resolved like any other symbol, though not in any module
+  symbols.setJit(&jit);
+  auto res = symbols.resolve(fn5 + 4, true);
+  check(res && !res.module && res.symbol->name == GenELF::symbolName(5) &&
+            res.symbolOffset == 4,
+        "resolve");
+  res = symbols.resolve(0x7f0000003008);
+  check(res && res.symbol->name == "jitD" && res.symbolOffset == 8,
+        "resolve from the perf map");
+  res = symbols.resolve(uintptr_t(&__jit_debug_register_code));
+  check(res && res.module, "still resolves modules");
+
+  // Only new objects are read again; unregistered ones go away
+  entry2.symfile_size = image2.size();
+  registerCode(&entry2);
+  check(jit.readGdbJit(memory, descriptor), "read again");
+  check(jit.objectCount() == 2 && jit.size() == 111, "second object");
+  // Both objects start functions at 0x1000; the newer one wins
+  check(name(GenELF::symbolAddr(opts2, 1)) == GenELF::symbolName(1),
+        "second object symbol");
+  unregisterCode(&entry2);
+  check(jit.readGdbJit(memory, descriptor), "read after unregistering");
+  check(jit.objectCount() == 1 && jit.size() == 101, "object dropped");
+  check(name(GenELF::symbolAddr(opts, 1) + 1) == GenELF::symbolName(1),
+        "first object remains");
+  unregisterCode(&entry);
+  check(jit.readGdbJit(memory, descriptor) && jit.size() == 1, "all gone");
+
+  symbols.setJit(nullptr);
+  check(!symbols.resolve(0x7f0000003008), "detached");
+
+  assert(!errors);
+}
@@ -0,0 +1,93 @@
+#include <cassert>
+#include <cerrno>
+#include <iostream>
+#include <proginfo/binary/Binary.h>
+#include <proginfo/binary/Loader.h>
+#include <proginfo/util/Alloc.h>
+#include <proginfo/util/MMap.h>
+#include <string>
+#include <vector>
+
+using namespace proginfo;
+
+int main(int, char**) {
+  unsigned errors = 0;
+  util::Alloc alloc;
+
+  auto check = [&](bool ok, char const* what) {
+    if (!ok) {
+      std::cerr << "failed: " << what << '\n';
+      ++errors;
+    }
+  };
+
+  // Each test binary many times over (as a service loads hundreds of files),
+  // plus some which aren't binaries, or don't exist
+  std::vector<std::string> files {
+      "test/bins/elf.64.le.exe",
+      "test/bins/elf.32.be.exe",
+      "test/bins/elf.64.le.so",
+      "test/bins/elf.64.le.o",
+      "test/bins/macho.64.le.exe",
+      "/proc/self/exe",
+  };
+  std::vector<std::string> paths;
+  for (unsigned i = 0; i < 40; i++) {
+    paths.insert(paths.end(), files.begin(), files.end());
+  }
+  paths.push_back("README.md");
+  paths.push_back("/nonexistent/TestLoader");
+
+  // The sections each should have, mapped the usual way (none for Mach-O)
+  std::vector<size_t> sections;
+  for (auto& path : files) {
+    util::MMap mm(path);
+    auto bin = binary::Binary::at(mm.addr_, mm.size_, false, false);
+    sections.push_back(bin->isELF() ? bin->secHeaderCount() : 0);
+  }
+
+  for (bool ioUring : {true, false}) {
+    for (unsigned depth : {64u, 3u}) {
+      binary::Loader loader({.queueDepth = depth, .ioUring = ioUring});
+      std::vector<unsigned> seen(paths.size());
+      std::vector<binary::LoadedBinary> loaded(paths.size());
+      auto stats = loader.load(paths, [&](size_t i, binary::LoadedBinary bin) {
+        ++seen[i];
+        loaded[i] = std::move(bin);
+      });
+      check(ioUring || !stats.ioUring, "threads if asked");
+      check(stats.loaded == paths.size() - 2 && stats.failed == 2, "counts");
+
+      bool once = true, same = true;
+      for (size_t i = 0; i < paths.size(); i++) {
+        once = once && seen[i] == 1;
+        if (i >= paths.size() - 2) { continue; }
+        auto& l = loaded[i];
+        auto want = sections[i % files.size()];
+        same = same && !l.error && l.mm && l.bin && l.path == paths[i] &&
+               (want ? l.bin->secHeaderCount() == want : l.bin->isMachO());
+      }
+      check(once, "each once");
+      check(same, "same binaries");
+      check(loaded[paths.size() - 2].error == ENOEXEC &&
+                !loaded[paths.size() - 2].bin,
+            "not a binary");
+      check(loaded.back().error == ENOENT && !loaded.back().mm, "missing");
+
+      // They're usable, and hold on to their mappings
+      auto& exe = loaded[files.size() - 1];
+      check(exe.bin && exe.bin->section(".symtab"), "own symbols");
+    }
+  }
+
+  // In order, all at once
+  binary::Loader loader;
+  binary::LoadStats stats;
+  auto all = loader.loadAll(files, &stats);
+  check(all.size() == files.size() && stats.loaded == files.size(), "loadAll");
+  check(all[3].bin && all[3].bin->isELF() && !all[3].bin->isExecutable(),
+        "object file");
+
+  assert(!errors);
+  return 0;
+}
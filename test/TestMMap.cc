@@ -0,0 +1,63 @@
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <proginfo/util/MMap.h>
+
+using namespace proginfo;
+
+int main(int, char**) {
+  unsigned errors = 0;
+
+  auto check = [&](bool ok, char const* what) {
+    if (!ok) {
+      std::cerr << "failed: " << what << '\n';
+      ++errors;
+    }
+  };
+
+  constexpr std::string_view kPath = "test/bins/macho.64.le.exe";
+
+  util::MMap whole(kPath);
+  check(bool(whole) && whole.size_ > 0x2000, "map whole file");
+  check(whole.fd_ >= 0 && !whole.offset_, "whole file fd and offset");
+  check(!memcmp(whole.addr_, "\xcf\xfa\xed\xfe", 4), "Mach-O magic");
+
+  {
+    // Unaligned, across a page boundary; compare with the full mapping
+    util::MMap range(kPath, {.offset = 0x1ff0, .length = 0x100});
+    check(bool(range) && range.size_ == 0x100, "map range");
+    check(range.at(0x1ff0) == range.addr_, "range start");
+    check(!memcmp(range.addr_, whole.at(0x1ff0), 0x100), "range contents");
+    check(range.contains(0x1ff0, 0x100), "range contains all");
+    check(!range.contains(0x1fef, 1), "range excludes before");
+    check(!range.contains(0x2080, 0x71), "range excludes after");
+    check(range.advise(0, ~size_t(0) / 2, util::MMap::Advice::kRandom),
+          "advise clipped to range");
+    check(!range.advise(0, 0x1000, util::MMap::Advice::kRandom),
+          "advise outside range");
+    range.prefault(0x1ff0, 0x100);
+  }
+
+  {
+    util::MMap hot(kPath,
+                   {.advice = util::MMap::Advice::kSequential,
+                    .populate = true,
+                    .hugePages = true});
+    check(bool(hot) && hot.size_ == whole.size_, "map with options");
+    check(!memcmp(hot.addr_, whole.addr_, hot.size_), "options contents");
+  }
+
+  {
+    util::MMap bad(kPath, {.offset = whole.size_ + 1});
+    check(!bad && bad.errno_ == EINVAL, "offset past end");
+    util::MMap missing("test/bins/nonexistent");
+    check(!missing && missing.errno_ == ENOENT && missing.fd_ < 0,
+          "missing file");
+    // Not NUL-terminated: the path is just `kPath`
+    std::string_view prefix("test/bins/macho.64.le.exe.extra", kPath.size());
+    util::MMap sub(prefix);
+    check(bool(sub) && sub.size_ == whole.size_, "string_view path");
+  }
+
+  assert(!errors);
+}
@@ -0,0 +1,204 @@
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <link.h>
+#include <proginfo/binary/Binary.h>
+#include <proginfo/binary/elf/Notes.h>
+#include <proginfo/procinfo/ProcInfo.h>
+#include <proginfo/util/Alloc.h>
+#include <proginfo/util/MMap.h>
+#include <string>
+#include <vector>
+
+using namespace proginfo;
+
+namespace {
+
+/*
+A small hand-made ELF file with two blocks of notes: a GNU property note,
+padded to 8 bytes (as linkers write them), then a vendor note and the build ID,
+padded to 4.  The blocks are `PT_NOTE` segments of an executable, or for a
+relocatable object (which has no program headers), `SHT_NOTE` sections.
+*/
+struct NotesWriter {
+  bool is64;
+  bool isLE;
+  bool isObject;
+  std::vector<uint8_t> out;
+  size_t vendorAt {};  // Where the vendor note is
+
+  void put(uint64_t val, unsigned bytes) {
+    for (unsigned i = 0; i < bytes; i++) {
+      auto shift = 8 * (isLE ? i : bytes - 1 - i);
+      out.push_back(uint8_t(val >> shift));
+    }
+  }
+
+  void patch(size_t offset, uint64_t val, unsigned bytes) {
+    for (unsigned i = 0; i < bytes; i++) {
+      auto shift = 8 * (isLE ? i : bytes - 1 - i);
+      out[offset + i] = uint8_t(val >> shift);
+    }
+  }
+
+  void pad(size_t align) {
+    while (out.size() % align) { out.push_back(0); }
+  }
+
+  void note(std::string const& name,
+            uint32_t type,
+            std::string const& desc,
+            size_t align) {
+    put(name.size() + 1, 4);
+    put(desc.size(), 4);
+    put(type, 4);
+    out.insert(out.end(), name.begin(), name.end());
+    out.push_back(0);
+    pad(align);
+    out.insert(out.end(), desc.begin(), desc.end());
+    pad(align);
+  }
+
+  std::vector<uint8_t> build() {
+    unsigned w = is64 ? 8 : 4;
+    unsigned ehSize = is64 ? 64 : 52;
+    unsigned phSize = is64 ? 56 : 32;
+    unsigned shSize = is64 ? 64 : 40;
+    out.assign(ehSize, 0);
+
+    struct Block {
+      size_t offset, size, align;
+    };
+    Block blocks[2];
+    pad(8);
+    blocks[0].offset = out.size();
+    note("GNU", 5, std::string(12, '\x01'), 8);  // NT_GNU_PROPERTY_TYPE_0
+    blocks[0] = {blocks[0].offset, out.size() - blocks[0].offset, 8};
+    blocks[1].offset = vendorAt = out.size();
+    note("Vendor", 1, "abc", 4);
+    note("GNU", 3, "\x01\x23\x45\x67\x89\xab\xcd\xef", 4);
+    blocks[1] = {blocks[1].offset, out.size() - blocks[1].offset, 4};
+
+    pad(8);
+    auto headers = out.size();
+    for (auto& block : blocks) {
+      auto at = out.size();
+      out.resize(at + (isObject ? shSize : phSize));
+      if (isObject) {
+        patch(at + 4, 7, 4);  // SHT_NOTE
+        patch(at + (is64 ? 0x18 : 0x10), block.offset, w);
+        patch(at + (is64 ? 0x20 : 0x14), block.size, w);
+        patch(at + (is64 ? 0x30 : 0x20), block.align, w);
+      } else {
+        patch(at, 4, 4);  // PT_NOTE
+        patch(at + (is64 ? 0x08 : 0x04), block.offset, w);
+        patch(at + (is64 ? 0x10 : 0x08), block.offset, w);
+        patch(at + (is64 ? 0x20 : 0x10), block.size, w);
+        patch(at + (is64 ? 0x28 : 0x14), block.size, w);
+        patch(at + (is64 ? 0x30 : 0x1c), block.align, w);
+      }
+    }
+
+    out[0] = 0x7f, out[1] = 'E', out[2] = 'L', out[3] = 'F';
+    out[4] = is64 ? 2 : 1;
+    out[5] = isLE ? 1 : 2;
+    out[6] = 1;
+    patch(0x10, isObject ? 1 : 2, 2);  // ET_REL or ET_EXEC
+    patch(0x14, 1, 4);
+    patch(is64 ? 0x34 : 0x28, ehSize, 2);
+    if (isObject) {
+      patch(is64 ? 0x28 : 0x20, headers, w);
+      patch(is64 ? 0x3a : 0x2e, shSize, 2);
+      patch(is64 ? 0x3c : 0x30, 2, 2);
+    } else {
+      patch(is64 ? 0x20 : 0x1c, headers, w);
+      patch(is64 ? 0x36 : 0x2a, phSize, 2);
+      patch(is64 ? 0x38 : 0x2c, 2, 2);
+    }
+    return out;
+  }
+};
+
+void marker() {}
+
+}  // namespace
+
+int main(int, char**) {
+  unsigned errors = 0;
+  util::Alloc alloc;
+
+  auto check = [&](bool ok, char const* what) {
+    if (!ok) {
+      std::cerr << "failed: " << what << '\n';
+      ++errors;
+    }
+  };
+
+  // Hand-made files, in each word size, byte order, and with either segments
+  // or sections
+  for (unsigned i = 0; i < 8; i++) {
+    NotesWriter nw {bool(i & 1), bool(i & 2), bool(i & 4), {}};
+    auto bytes = nw.build();
+    auto bin = binary::Binary::at(bytes.data(), bytes.size(), false, false);
+    std::vector<std::string> seen;
+    binary::eachNote(*bin, [&](binary::Note const& note) {
+      seen.push_back(std::string(note.name) + ":" + std::to_string(note.type) +
+                     ":" + std::to_string(note.desc.size_));
+      return true;
+    });
+    check(seen ==
+              std::vector<std::string> {"GNU:5:12", "Vendor:1:3", "GNU:3:8"},
+          "notes");
+    check(binary::buildId(*bin) == "\x01\x23\x45\x67\x89\xab\xcd\xef",
+          "build ID");
+
+    // Stopping early
+    unsigned n = 0;
+    binary::eachNote(*bin, [&](binary::Note const&) { return ++n < 2; });
+    check(n == 2, "stop");
+
+    // A note too big for its block ends it, so the build ID isn't seen
+    nw.patch(nw.vendorAt + 4, 0x1000, 4);
+    bin = binary::Binary::at(nw.out.data(), nw.out.size(), false, false);
+    n = 0;
+    binary::eachNote(*bin, [&](binary::Note const&) { return ++n; });
+    check(n == 1 && binary::buildId(*bin).empty(), "malformed");
+  }
+
+  // This executable, as a file and as loaded
+  {
+    util::MMap mm("/proc/self/exe");
+    auto bin = binary::Binary::at(mm.addr_, mm.size_, false, false);
+    auto fileId = binary::buildId(*bin);
+    check(fileId.size() >= 8, "own build ID");
+
+    procinfo::ModuleMap modules;
+    modules.refresh();
+    auto* exe = modules.find(uintptr_t(&marker));
+    check(exe && exe->buildId == fileId, "matches loaded module's");
+
+    struct Image {
+      uintptr_t start;
+      size_t size;
+    } image {};
+    dl_iterate_phdr(
+        [](dl_phdr_info* info, size_t, void* arg) {
+          uintptr_t lo = ~uintptr_t(0), hi = 0;
+          for (unsigned i = 0; i < info->dlpi_phnum; i++) {
+            auto& ph = info->dlpi_phdr[i];
+            if (ph.p_type != PT_LOAD) { continue; }
+            lo = std::min<uintptr_t>(lo, ph.p_vaddr - ph.p_offset);
+            hi = std::max<uintptr_t>(hi, ph.p_vaddr + ph.p_filesz);
+          }
+          *(Image*) arg = {info->dlpi_addr + lo, hi - lo};
+          return 1;  // The first is the executable
+        },
+        &image);
+    auto loaded =
+        binary::Binary::at((void const*) image.start, image.size, true, false);
+    check(binary::buildId(*loaded) == fileId, "loaded build ID");
+  }
+
+  assert(!errors);
+  return 0;
+}
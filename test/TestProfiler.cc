@@ -0,0 +1,183 @@
+#include <cassert>
+#include <ctime>
+#include <iostream>
+#include <proginfo/profile/Profiler.h>
+#include <proginfo/util/Alloc.h>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace proginfo;
+
+namespace {
+
+double threadCpuSeconds() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+}
+
+volatile uint64_t sink;
+
+[[gnu::noinline]] void busyLoop(double seconds) {
+  auto end = threadCpuSeconds() + seconds;
+  uint64_t x = 1;
+  while (threadCpuSeconds() < end) {
+    for (int i = 0; i < 1000; i++) { x = x * 6364136223846793005ull + 1; }
+  }
+  sink = x;
+}
+
+[[gnu::noinline]] void otherBusyLoop(double seconds) { busyLoop(seconds); }
+
+/** Minimal protobuf reading: a message's fields, in order. */
+struct Field {
+  unsigned number;
+  uint64_t value;          // For varints
+  std::string_view bytes;  // For length-delimited fields
+};
+
+bool readVarint(std::string_view& in, uint64_t* out) {
+  *out = 0;
+  for (unsigned shift = 0; !in.empty() && shift < 64; shift += 7) {
+    auto byte = uint8_t(in[0]);
+    in.remove_prefix(1);
+    *out |= uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) { return true; }
+  }
+  return false;
+}
+
+std::vector<Field> readFields(std::string_view in) {
+  std::vector<Field> ret;
+  uint64_t key, val;
+  while (!in.empty() && readVarint(in, &key)) {
+    Field field {unsigned(key >> 3), 0, {}};
+    if ((key & 7) == 0) {
+      if (!readVarint(in, &field.value)) { break; }
+    } else if ((key & 7) == 2) {
+      if (!readVarint(in, &val) || val > in.size()) { break; }
+      field.bytes = in.substr(0, val);
+      in.remove_prefix(val);
+    } else {
+      break;
+    }
+    ret.push_back(field);
+  }
+  return ret;
+}
+
+}  // namespace
+
+int main(int, char**) {
+  unsigned errors = 0;
+  util::Alloc alloc;
+
+  auto check = [&](bool ok, char const* what) {
+    if (!ok) {
+      std::cerr << "failed: " << what << '\n';
+      ++errors;
+    }
+  };
+
+  using Source = profile::Profiler::Source;
+  for (auto source : {Source::kTimer, Source::kPerfEvent}) {
+    profile::Profiler profiler({.source = source, .hz = 500});
+    check(profiler.start(), "start");
+    profile::Profiler other;
+    check(!other.start(), "only one at a time");
+    std::thread thread([&] {
+      profiler.addThread();
+      otherBusyLoop(0.2);
+    });
+    busyLoop(0.3);
+    thread.join();
+    profiler.stop();
+
+    auto stats = profiler.stats();
+    if (source == Source::kTimer) {
+      check(stats.source == Source::kTimer, "timer source");
+    }
+    check(stats.samples >= 50, "samples");
+    check(stats.unique > 0 && stats.drains > 0, "aggregated");
+    check(!stats.noRing && !stats.dropped, "nothing dropped");
+
+    auto folded = profiler.folded();
+    check(folded.find("main;(anonymous namespace)::busyLoop(double) ") !=
+              folded.npos,
+          "folded main thread");
+    check(folded.find("otherBusyLoop(double);(anonymous "
+                      "namespace)::busyLoop(double) ") != folded.npos,
+          "folded other thread");
+    uint64_t foldedTotal = 0;
+    for (size_t pos = 0; pos < folded.size();) {
+      auto eol = folded.find('\n', pos);
+      auto space = folded.rfind(' ', eol);
+      foldedTotal += std::stoull(folded.substr(space + 1, eol - space - 1));
+      pos = eol + 1;
+    }
+    check(!stats.noStack, "all stacks kept");
+    check(foldedTotal == stats.samples - stats.lost, "folded counts");
+
+    auto pprof = profiler.pprof();
+    auto fields = readFields(pprof);
+    std::vector<std::string_view> strings;
+    uint64_t samples = 0, period = 0;
+    size_t locations = 0, functions = 0, mappings = 0;
+    for (auto& field : fields) {
+      switch (field.number) {
+      case 2: {
+        auto sample = readFields(field.bytes);
+        if (sample.size() == 2 && sample[1].number == 2) {
+          auto values = sample[1].bytes;
+          uint64_t count;
+          if (readVarint(values, &count)) { samples += count; }
+        }
+        break;
+      }
+      case 3:  ++mappings; break;
+      case 4:  ++locations; break;
+      case 5:  ++functions; break;
+      case 6:  strings.push_back(field.bytes); break;
+      case 12: period = field.value; break;
+      }
+    }
+    check(samples == foldedTotal, "pprof sample counts");
+    check(period == 2000000, "pprof period");
+    check(mappings && locations >= functions && functions, "pprof tables");
+    check(!strings.empty() && strings[0].empty(), "pprof string table");
+    auto has = [&](std::string_view str) {
+      return std::find(strings.begin(), strings.end(), str) != strings.end();
+    };
+    check(has("(anonymous namespace)::busyLoop(double)"), "pprof function");
+    check(has("_ZN12_GLOBAL__N_18busyLoopEd"), "pprof system name");
+    check(has("cpu") && has("nanoseconds") && has("samples"), "pprof types");
+  }
+
+  // Stacks whose PCs don't fit are left out of profiles, and counted
+  {
+    profile::Profiler profiler({.hz = 500, .stackBytes = 64});
+    check(profiler.start(), "start, small");
+    busyLoop(0.2);
+    otherBusyLoop(0.1);
+    profiler.stop();
+    auto stats = profiler.stats();
+    check(stats.noStack > 0, "no room for stacks");
+    auto folded = profiler.folded();
+    uint64_t foldedTotal = 0;
+    bool allFrames = true;
+    for (size_t pos = 0; pos < folded.size();) {
+      auto eol = folded.find('\n', pos);
+      auto space = folded.rfind(' ', eol);
+      allFrames = allFrames && space > pos;
+      foldedTotal += std::stoull(folded.substr(space + 1, eol - space - 1));
+      pos = eol + 1;
+    }
+    check(allFrames, "no empty stacks");
+    check(foldedTotal == stats.samples - stats.lost - stats.noStack,
+          "small folded counts");
+  }
+
+  assert(!errors);
+}
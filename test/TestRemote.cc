@@ -0,0 +1,159 @@
+#include <cassert>
+#include <iostream>
+#include <proginfo/procinfo/Memory.h>
+#include <proginfo/procinfo/ProcInfo.h>
+#include <proginfo/symbolize/ProcessSymbols.h>
+#include <proginfo/unwind/Unwinder.h>
+#include <proginfo/util/Alloc.h>
+#include <signal.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace proginfo;
+
+namespace {
+
+volatile uint64_t marker = 1;
+
+[[gnu::noinline]] void hang(int fd) {
+  char c;
+  while (read(fd, &c, 1) < 0) {}
+  asm volatile("");
+}
+
+[[gnu::noinline]] void childMain(int fd) {
+  marker = 0x5eed;
+  hang(fd);
+  asm volatile("");
+  _exit(0);
+}
+
+}  // namespace
+
+int main(int, char**) {
+  unsigned errors = 0;
+
+  auto check = [&](bool ok, char const* what) {
+    if (!ok) {
+      std::cerr << "failed: " << what << '\n';
+      ++errors;
+    }
+  };
+
+  util::Alloc alloc;
+
+  // A child process, blocked (in `hang`) until we write to the pipe
+  int fds[2];
+  check(pipe(fds) == 0, "pipe");
+  auto pid = fork();
+  if (!pid) {
+    close(fds[1]);
+    childMain(fds[0]);
+  }
+  close(fds[0]);
+
+  procinfo::RemoteMemory memory(pid, 64);
+  procinfo::Registers regs {};
+  for (int i = 0; i < 500; i++) {
+    uint64_t val = 0;
+    memory.invalidate();
+    if (memory.read(uintptr_t(&marker), &val) && val == 0x5eed &&
+        procinfo::blockedRegisters(pid, pid, &regs)) {
+      break;
+    }
+    regs = {};
+    usleep(10000);
+  }
+  check(regs.pc && regs.sp, "child blocked");
+
+  // Its memory
+  {
+    uint64_t val = 0;
+    check(memory.read(uintptr_t(&marker), &val) && val == 0x5eed, "read");
+    check(marker == 1, "ours is different");
+    auto before = memory.stats();
+    check(memory.read(uintptr_t(&marker), &val), "read again");
+    auto after = memory.stats();
+    check(after.hits == before.hits + 1 && after.misses == before.misses,
+          "cache hit");
+    check(!memory.read(0, &val) && memory.stats().failed > after.failed,
+          "unmapped");
+    int tids[4];
+    check(procinfo::threadIds(pid, tids, 4) == 1 && tids[0] == pid,
+          "thread IDs");
+  }
+
+  // Its modules: being a fork, the same as ours
+  {
+    procinfo::ModuleMap ours;
+    procinfo::ModuleMap theirs;
+    check(ours.refresh(), "our modules");
+    check(theirs.refresh(pid, memory), "their modules");
+    bool same = true;
+    size_t withBuildId = 0;
+    for (auto& mod : ours) {
+      if (mod.buildId.empty()) { continue; }
+      ++withBuildId;
+      auto* other = theirs.find(mod.start);
+      same = same && other && other->buildId == mod.buildId &&
+             other->base == mod.base && other->start == mod.start &&
+             other->end == mod.end;
+    }
+    check(same && withBuildId >= 2, "same modules");
+    auto* exe = theirs.find(uintptr_t(&childMain));
+    check(exe && exe->path == ours.find(uintptr_t(&childMain))->path,
+          "exe path");
+  }
+
+  // Its stack, unwound and symbolized without stopping it
+  {
+    procinfo::ModuleMap modules;
+    check(modules.refresh(pid, memory), "modules");
+    symbolize::ProcessSymbols symbols;
+    check(symbols.refresh(pid, memory), "symbols");
+    unwind::Unwinder unwinder;
+    check(unwinder.prepare(modules) >= 2, "prepare");
+
+    std::string stack(256 << 10, '\0');
+    stack.resize(memory.readDirect(regs.sp, stack.data(), stack.size()));
+    check(stack.size() >= 4096, "stack copy");
+
+    auto names = [&](unwind::Sample const& sample) {
+      uintptr_t pcs[64];
+      auto trace = unwinder.unwind(sample, pcs, 64);
+      check(trace.stop == unwind::Stop::kEnd, "unwound to the end");
+      std::string ret;
+      for (size_t i = 0; i < trace.depth; i++) {
+        auto res = symbols.resolve(pcs[i], i);
+        ret += res ? std::string(res.symbol->name) : "?";
+        ret += ' ';
+      }
+      return ret;
+    };
+    auto inOrder = [](std::string const& names) {
+      auto hang = names.find("hang");
+      auto childMain = names.find("childMain");
+      auto main = names.find("main ");
+      return hang < childMain && childMain < main && main != names.npos;
+    };
+
+    unwind::Sample sample {&modules, {regs.pc, regs.sp, 0, 0}, regs.sp, stack};
+    auto copied = names(sample);
+    check(inOrder(copied), "frames from a copy");
+
+    // Or reading the stack only as needed, through the cache
+    sample.stack = {};
+    sample.memory = &memory;
+    auto direct = names(sample);
+    check(direct == copied, "frames from memory");
+    if (!inOrder(copied) || direct != copied) {
+      std::cerr << "frames: " << copied << "\nfrom memory: " << direct << '\n';
+    }
+  }
+
+  check(write(fds[1], "x", 1) == 1, "release child");
+  int status = 0;
+  check(waitpid(pid, &status, 0) == pid && WIFEXITED(status), "child exit");
+  assert(!errors);
+}
@@ -0,0 +1,69 @@
+#include "GenELF.h"
+
+#include <cassert>
+#include <iostream>
+#include <proginfo/binary/Binary.h>
+#include <proginfo/symbolize/SymbolIndex.h>
+#include <proginfo/util/Alloc.h>
+
+using namespace proginfo;
+
+int main(int, char**) {
+  unsigned errors = 0;
+  util::Alloc alloc;
+
+  auto check = [&](bool ok, char const* what, GenELF::Options const& opts) {
+    if (!ok) {
+      std::cerr << "failed: " << what << " (ELF" << (opts.is64 ? 64 : 32)
+                << (opts.isLE ? " LE" : " BE") << ")\n";
+      ++errors;
+    }
+  };
+
+  // More symbols than fit in 16 bits, and lots of sections
+  for (auto is64 : {true, false}) {
+    for (auto isLE : {true, false}) {
+      GenELF::Options opts {
+          .is64 = is64,
+          .isLE = isLE,
+          .symbols = 70000,
+          .sections = 1000,
+          .cus = 10,
+          .fdes = 100,
+      };
+      auto bytes = GenELF::build(opts);
+      auto bin = binary::Binary::at(bytes.data(), bytes.size(), false, false);
+      check(bin && bin->isELF() && bin->is64() == is64, "parse", opts);
+      if (!bin) { continue; }
+      check(bin->isLE() == isLE && bin->isExecutable(), "header", opts);
+      check(bin->secHeaderCount() == 1009, "section count", opts);
+      auto sec = bin->section(".gen.999");
+      check(sec && sec->fileOffset(), "last generated section", opts);
+      auto text = bin->section(".text");
+      check(text && text->size() == 70000 * 16, ".text size", opts);
+
+      auto symTable = bin->symTable();
+      check(bool(symTable), "symbol table", opts);
+      if (!symTable) { continue; }
+      uint32_t count = 0;
+      bool namesOK = true;
+      symTable->each([&](auto& sym) {
+        if (count) {
+          namesOK &= sym.value() == GenELF::symbolAddr(opts, count - 1);
+          namesOK &= sym.name() == GenELF::symbolName(count - 1);
+        }
+        ++count;
+        return true;
+      });
+      check(count == 70001, "symbol count", opts);
+      check(namesOK, "symbol names and values", opts);
+
+      symbolize::SymbolIndex index;
+      check(index.build(*bin) && index.size() == 70000, "index", opts);
+      auto* e = index.lookup(GenELF::symbolAddr(opts, 65537) + 5);
+      check(e && e->name == GenELF::symbolName(65537), "lookup", opts);
+    }
+  }
+
+  assert(!errors);
+}
@@ -0,0 +1,147 @@
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <proginfo/procinfo/Backtrace.h>
+#include <proginfo/symbolize/StackTable.h>
+#include <proginfo/util/Alloc.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace proginfo;
+
+namespace {
+
+size_t level2(uintptr_t* pcs, size_t max) {
+  return procinfo::backtraceHere(pcs, max);
+}
+
+size_t level1(uintptr_t* pcs, size_t max) { return level2(pcs, max) + 0; }
+
+}  // namespace
+
+int main(int, char**) {
+  unsigned errors = 0;
+
+  auto check = [&](bool ok, char const* what) {
+    if (!ok) {
+      std::cerr << "failed: " << what << '\n';
+      ++errors;
+    }
+  };
+
+  // Table basics
+  {
+    symbolize::StackTable table(4, 16);
+    check(table.capacity() == 4, "capacity");
+    auto a = table.add(0x1234);
+    check(a.entry && a.isNew, "add new");
+    check(!table.isPublished(*a.entry) && table.text(*a.entry).empty(),
+          "not published");
+    auto again = table.add(0x1234, 2);
+    check(again.entry == a.entry && !again.isNew, "add again");
+    check(a.entry->count() == 3 && a.entry->fingerprint() == 0x1234, "count");
+    check(table.publish(*a.entry, "main;foo"), "publish");
+    check(table.text(*a.entry) == "main;foo", "text");
+    check(table.find(0x1234) == a.entry && !table.find(0x9999), "find");
+
+    auto b = table.add(0x5678);
+    check(!table.publish(*b.entry, "main;bar;baz"), "publish too long");
+    check(table.isPublished(*b.entry) && table.text(*b.entry).empty(),
+          "published without text");
+
+    table.add(0x1);
+    table.add(0x2);
+    auto full = table.add(0x3, 5);
+    check(!full.entry && !full.isNew, "full");
+    check(table.add(0x1234).entry == a.entry, "full, but known");
+    auto stats = table.stats();
+    check(stats.unique == 4 && stats.samples == 12, "stats counts");
+    check(stats.dropped == 5 && stats.textMissing == 1, "stats drops");
+    check(stats.textUsed == 16, "stats text");
+    uint64_t total = 0;
+    table.each([&](auto& entry) { total += entry.count(); });
+    check(total == 7, "each");
+  }
+
+  // Concurrent adds: every stack is new exactly once
+  {
+    symbolize::StackTable table(256, 1 << 16);
+    std::atomic<unsigned> news {0};
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < 8; t++) {
+      threads.emplace_back([&] {
+        for (unsigned i = 0; i < 10000; i++) {
+          auto added = table.add(1 + (i % 100) * 0x10001);
+          if (added.isNew) {
+            ++news;
+            table.publish(*added.entry, "x");
+          }
+        }
+      });
+    }
+    for (auto& thread : threads) { thread.join(); }
+    auto stats = table.stats();
+    check(news == 100 && stats.unique == 100, "concurrent unique");
+    check(stats.samples == 80000 && !stats.dropped, "concurrent samples");
+    auto* entry = table.find(1 + 42 * 0x10001);
+    check(entry && entry->count() == 800 && table.text(*entry) == "x",
+          "concurrent count");
+  }
+
+  // Fingerprints depend on module and offset, not where modules are loaded
+  {
+    procinfo::ModuleMap run1, run2, other;
+    run1.add({"/lib/a.so", "\x01\x02", 0x10000, 0x10000, 0x20000});
+    run1.add({"/bin/x", {}, 0x400000, 0x400000, 0x500000});
+    run2.add({"/lib/a.so", "\x01\x02", 0x70000, 0x70000, 0x80000});
+    run2.add({"/bin/x", {}, 0x900000, 0x900000, 0xa00000});
+    other.add({"/lib/a.so", "\x01\x03", 0x10000, 0x10000, 0x20000});
+    other.add({"/bin/x", {}, 0x400000, 0x400000, 0x500000});
+    symbolize::StackFingerprinter fp1(run1), fp2(run2), fpOther(other);
+
+    uintptr_t stack1[] = {0x10123, 0x400456, 0x400789};
+    uintptr_t stack2[] = {0x70123, 0x900456, 0x900789};
+    check(fp1(stack1, 3) == fp2(stack2, 3), "stable across runs");
+    check(fp1(stack1, 3) != fpOther(stack1, 3), "build ID matters");
+    check(fp1(stack1, 3) != fp1(stack1, 2), "depth matters");
+    uintptr_t swapped[] = {0x400456, 0x10123, 0x400789};
+    check(fp1(stack1, 3) != fp1(swapped, 3), "order matters");
+    uintptr_t unknown[] = {0x123, 0x456};
+    check(fp1(unknown, 2) == fp2(unknown, 2) && fp1(unknown, 2),
+          "unknown modules");
+    check(fp1(nullptr, 0) != 0, "empty stack");
+  }
+
+  // Aggregation of real stacks: formatted once per distinct stack
+  {
+    util::Alloc alloc;
+    symbolize::ProcessSymbols symbols;
+    check(symbols.refresh(), "symbols");
+    symbolize::StackAggregator agg(symbols, {.firstIsReturn = true});
+    uintptr_t pcs[64];
+    symbolize::StackTable::Entry const* e1 = nullptr;
+    symbolize::StackTable::Entry const* e2 = nullptr;
+    for (int i = 0; i < 100; i++) {
+      auto n = level1(pcs, 64);
+      e1 = agg.add(pcs, n);
+      n = level2(pcs, 64);
+      e2 = agg.add(pcs, n, 2);
+    }
+    check(e1 && e2 && e1 != e2, "distinct stacks");
+    check(agg.table().stats().unique == 2, "unique stacks");
+    check(e1 && e1->count() == 100 && e2 && e2->count() == 200, "weights");
+    if (e1 && e2) {
+      auto t1 = agg.text(*e1);
+      auto t2 = agg.text(*e2);
+      check(t1.find(";main;(anonymous namespace)::level1(") != t1.npos,
+            "folded text 1");
+      auto last = t1.substr(t1.rfind(';') + 1);
+      check(last.find("(anonymous namespace)::level2(") == 0, "innermost last");
+      check(t2.find("level1") == t2.npos && t2.find(";main;") != t2.npos,
+            "folded text 2");
+    }
+  }
+
+  assert(!errors);
+}
@@ -0,0 +1,94 @@
+// Instrumentation is off by default; this test is about having it on
+#define PROGINFO_STATS 1
+
+#include <cassert>
+#include <iostream>
+#include <proginfo/binary/Binary.h>
+#include <proginfo/symbolize/FrameCache.h>
+#include <proginfo/symbolize/SymbolIndex.h>
+#include <proginfo/unwind/EhFrame.h>
+#include <proginfo/util/Alloc.h>
+#include <proginfo/util/MMap.h>
+#include <proginfo/util/Stats.h>
+#include <thread>
+#include <vector>
+
+using namespace proginfo;
+
+int main(int, char**) {
+  unsigned errors = 0;
+  util::Alloc alloc;
+
+  auto check = [&](bool ok, char const* what) {
+    if (!ok) {
+      std::cerr << "failed: " << what << '\n';
+      ++errors;
+    }
+  };
+
+  static_assert(util::Stats::kEnabled);
+  auto s = util::Stats::snapshot();
+  check(!s.sectionsScanned && !s.symbolsVisited && !s.threads, "starts empty");
+
+  // Parsing and I/O
+  {
+    util::MMap mm("test/bins/elf.64.le.exe");
+    check(mm.addr_, "open");
+    auto bin = binary::Binary::at(mm.addr_, mm.size_, false, false);
+    auto n = uint64_t(bin->secHeaderCount());
+    check(bin->section(".symtab"), "section");
+    s = util::Stats::snapshot();
+    check(s.sectionsScanned && s.sectionsScanned <= n, "sections scanned");
+    check(!bin->section(".nonexistent"), "no section");
+    check(util::Stats::snapshot().sectionsScanned == s.sectionsScanned + n,
+          "all sections scanned");
+
+    symbolize::SymbolIndex index;
+    check(index.build(*bin), "build index");
+    unwind::EhFrame cfi;
+    check(cfi.build(*bin), "build cfi");
+    s = util::Stats::snapshot();
+    check(s.symbolsVisited >= index.size(), "symbols visited");
+    check(s.bytesDecoded == bin->section(".eh_frame")->size(), "bytes");
+    check(s.parse.count == 2 && s.parse.cycles, "parse timer");
+    check(s.io.count == 1, "io timer");
+    check(s.allocHighWater, "alloc high water");
+  }
+
+  // Cache hits and misses
+  {
+    symbolize::FrameCache cache(1 << 20, 1);
+    auto mod = cache.module("abcd");
+    cache.get(mod, 1);
+    cache.put(mod, 1, {});
+    cache.get(mod, 1);
+    cache.get(mod, 1);
+    s = util::Stats::snapshot();
+    check(s.cacheHits == 2 && s.cacheMisses == 1, "cache stats");
+  }
+
+  // Scoped timers, and counts from many threads (more than have blocks)
+  {
+    util::Stats::reset();
+    { util::Stats::Scope timer(util::Timer::kSymbolize); }
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < util::Stats::kMaxThreads + 8; i++) {
+      threads.emplace_back([] {
+        for (unsigned j = 0; j < 1000; j++) {
+          util::Stats::add(util::Counter::kUnwindSteps);
+        }
+        util::Stats::max(util::Gauge::kAllocHighWater, 12345);
+      });
+    }
+    for (auto& t : threads) { t.join(); }
+    s = util::Stats::snapshot();
+    check(s.unwindSteps == (util::Stats::kMaxThreads + 8) * 1000, "threads");
+    check(s.threads >= util::Stats::kMaxThreads + 8, "thread count");
+    check(s.allocHighWater == 12345, "gauge max");
+    check(s.symbolize.count == 1, "symbolize timer");
+    check(!s.sectionsScanned && !s.parse.count, "reset");
+  }
+
+  assert(!errors);
+  return 0;
+}
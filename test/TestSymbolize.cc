@@ -0,0 +1,183 @@
+#include <cassert>
+#include <iostream>
+#include <proginfo/binary/elf/Plt.h>
+#include <proginfo/symbolize/Batch.h>
+#include <proginfo/symbolize/ProcessSymbols.h>
+#include <proginfo/util/Alloc.h>
+#include <proginfo/util/MMap.h>
+#include <string_view>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using namespace proginfo;
+
+int main(int, char**) {
+  unsigned errors = 0;
+  util::Alloc alloc;
+
+  auto check = [&](bool ok, char const* what) {
+    if (!ok) {
+      std::cerr << "failed: " << what << '\n';
+      ++errors;
+    }
+  };
+
+  symbolize::Batch batch(4);
+  auto add = [&](char const* path, char const* key) {
+    return batch.addBinary(path, key);
+  };
+  check(add("test/bins/elf.64.le.exe", "exe64") == "exe64", "add exe64");
+  check(add("test/bins/elf.32.le.exe", "exe32") == "exe32", "add exe32");
+  check(add("test/bins/elf.64.le.so", "so64") == "so64", "add so64");
+  check(add("test/bins/nonexistent", "nope").empty(), "add missing file");
+  check(add("test/bins/elf.64.le.exe", "").empty(), "add without ID or key");
+  check(batch.moduleCount() == 3, "module count");
+
+  // Lots of requests, interleaved across modules
+  std::vector<symbolize::Request> reqs;
+  for (unsigned i = 0; i < 30000; i++) {
+    switch (i % 4) {
+    case 0: reqs.push_back({"exe64", 0x12fa + (i % 6)}); break;
+    case 1: reqs.push_back({"exe32", 0x11f8 + (i % 3)}); break;
+    case 2: reqs.push_back({"so64", 0x1029c}); break;
+    case 3: reqs.push_back({"unknown", 0x1234}); break;
+    }
+  }
+  std::vector<symbolize::Frame> frames(reqs.size());
+  auto stats = batch.resolve(reqs.data(), reqs.size(), frames.data());
+
+  for (size_t i = 0; i < reqs.size(); i++) {
+    auto const& f = frames[i];
+    switch (i % 4) {
+    case 0: check(f.symbol == "main" && f.offset == i % 6, "exe64 main"); break;
+    case 1: check(f.symbol == "main" && f.offset == i % 3, "exe32 main"); break;
+    case 2: check(f.symbol == "test" && !f.offset, "so64 test"); break;
+    case 3: check(f.symbol.empty(), "unknown module"); break;
+    }
+    if (errors) { break; }
+  }
+
+  check(stats.requests == reqs.size(), "stats.requests");
+  check(stats.resolved == reqs.size() / 4 * 3, "stats.resolved");
+  check(stats.unknownModule == reqs.size() / 4, "stats.unknownModule");
+  check(stats.modules == 3 && stats.indexed == 3, "stats.modules");
+  check(stats.chunks >= 3, "stats.chunks");
+  check(stats.chunkMaxNanos >= stats.chunkP50Nanos, "stats.chunk*Nanos");
+
+  // Indexes are only built once
+  stats = batch.resolve(reqs.data(), reqs.size(), frames.data());
+  check(stats.indexed == 0 && frames[0].symbol == "main", "second batch");
+
+  // Symbols' sizes, types etc., and filtering by them
+  for (auto* path : {"test/bins/elf.64.le.exe", "test/bins/elf.32.be.exe"}) {
+    util::MMap mm(path);
+    auto bin = binary::Binary::at(mm.addr_, mm.size_, false, false);
+    auto symTable = bin->symTable();
+    auto mainSize = bin->is64() ? 6u : 8u;
+    unsigned all = 0;
+    symTable->each([&](binary::Symbol const& sym) {
+      ++all;
+      using binary::SymbolBinding, binary::SymbolType;
+      using binary::SymbolVisibility;
+      if (sym.name() == "main") {
+        check(sym.size() == mainSize && sym.type() == SymbolType::kFunction &&
+                  sym.binding() == SymbolBinding::kGlobal &&
+                  sym.visibility() == SymbolVisibility::kDefault &&
+                  sym.secIndex() == 7 && sym.isDefined(),
+              "main symbol");
+        check(sym.contains(sym.value() + mainSize - 1) &&
+                  !sym.contains(sym.value() + mainSize) &&
+                  !sym.contains(sym.value() - 1),
+              "main contains");
+      } else if (sym.name() == "_DYNAMIC") {
+        check(!sym.size() && sym.type() == SymbolType::kNone &&
+                  sym.binding() == SymbolBinding::kLocal &&
+                  sym.visibility() == SymbolVisibility::kHidden,
+              "_DYNAMIC symbol");
+      } else if (sym.name() == "simple.exe.c") {
+        check(sym.type() == SymbolType::kFile &&
+                  sym.secIndex() == binary::Symbol::kAbsolute,
+              "file symbol");
+      } else if (sym.name().empty()) {
+        check(!sym.isDefined(), "null symbol");
+      }
+      return true;
+    });
+    check(all == 5, "all symbols");
+    std::vector<std::string_view> names;
+    symTable->each(binary::SymbolFilter::addressable(), [&](auto& sym) {
+      names.push_back(sym.name());
+      return true;
+    });
+    check(names == std::vector<std::string_view> {"_start", "main"},
+          "filtered symbols");
+    binary::SymbolFilter locals;
+    locals.bindings = locals.bit(binary::SymbolBinding::kLocal);
+    unsigned n = 0;
+    symTable->each(locals, [&](auto&) { return ++n; });
+    check(n == 3, "local symbols");
+
+    // Addresses past the end of the last function aren't in it
+    symbolize::SymbolIndex index;
+    index.build(*bin);
+    auto* e = index.find("main");
+    check(e && e->size == mainSize, "index size");
+    if (e) {
+      check(index.lookup(e->addr + mainSize - 1) == e, "in main");
+      check(!index.lookup(e->addr + mainSize), "past main");
+      check(index.maxAddr() == e->addr, "last symbol");
+      auto* start = index.find("_start");
+      check(start && index.minAddr() == start->addr, "first symbol");
+    }
+  }
+
+  // With an IBT PLT, only the stubs in `.plt.sec` are named, as by `objdump`;
+  // not the lazy-binding ones in `.plt` too
+  for (auto* path :
+       {"test/bins/elf.64.le.ibt.so", "test/bins/elf.32.le.ibt.so"}) {
+    util::MMap mm(path);
+    auto bin = binary::Binary::at(mm.addr_, mm.size_, false, false);
+    check(bin && bin->section(".plt.sec"), "IBT PLT");
+    if (!bin) { continue; }
+    std::vector<std::pair<uintptr_t, std::string_view>> stubs;
+    binary::eachPltEntry(*bin, [&](auto& e) {
+      stubs.push_back({e.addr, e.name});
+      return true;
+    });
+    check(stubs == decltype(stubs) {{0x1030, "getpid"}, {0x1040, "puts"}},
+          "IBT PLT stubs");
+    symbolize::SymbolIndex index;
+    index.build(*bin);
+    auto* puts = index.find("puts@plt");
+    check(puts && puts->addr == 0x1040, "puts@plt in .plt.sec");
+
+    // The lazy-binding stubs `push` the relocation's index (x86-64) or byte
+    // offset into `.rel.plt` (x86)
+    binary::detail::GotSlots slots(*bin);
+    auto plt = bin->section(".plt");
+    check(plt && plt->virtAddr() == 0x1000, ".plt");
+    if (!plt) { continue; }
+    auto pos = plt->fileOffset() + 0x20;  // The second stub, after the header
+    auto* slot = binary::detail::x86Slot(*bin, slots, pos, 0x1020, 16, 0);
+    check(slot && slot->name == "puts", "lazy stub's relocation");
+  }
+
+  // PLT stubs have synthetic symbols, like `getpid@plt`
+  {
+    symbolize::ProcessSymbols symbols;
+    check(symbols.refresh(), "process symbols");
+    auto stub = symbols.address("getpid@plt");
+    check(stub, "getpid@plt");
+    auto res = symbols.resolve(stub + 4);
+    check(res && res.symbol->name == "getpid@plt" && res.symbolOffset == 4 &&
+              res.module->path.find("TestSymbolize") != res.module->path.npos,
+          "resolve in the PLT");
+    if (stub) {
+      auto getpidStub = (pid_t(*)()) stub;
+      check(getpidStub() == getpid(), "stub calls getpid");
+    }
+  }
+
+  assert(!errors);
+}
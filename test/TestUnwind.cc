@@ -0,0 +1,251 @@
+#include "GenELF.h"
+
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <proginfo/procinfo/Backtrace.h>
+#include <proginfo/symbolize/ProcessSymbols.h>
+#include <proginfo/unwind/Unwinder.h>
+#include <proginfo/util/Alloc.h>
+#include <string>
+#include <thread>
+#include <ucontext.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace proginfo;
+
+namespace {
+
+/** This thread's registers, and a copy of its stack, as a profiler would. */
+[[gnu::noinline]] void capture(unwind::Sample& sample, std::string& stack) {
+  ucontext_t uc;
+  getcontext(&uc);
+  auto regs = procinfo::Registers::fromContext(&uc);
+  sample.regs = {regs.pc, regs.sp, regs.fp, 0};
+#if defined(__aarch64__)
+  sample.regs.lr = uc.uc_mcontext.regs[30];
+#endif
+  // Up to the top of the stack, or 1MB
+  auto page = size_t(sysconf(_SC_PAGESIZE));
+  auto addr = regs.sp;
+  stack.clear();
+  while (stack.size() < (1 << 20)) {
+    char buf[65536];
+    auto size = std::min(sizeof(buf), page - addr % page);
+    if (!procinfo::readMemory(addr, buf, size)) { break; }
+    stack.append(buf, size);
+    addr += size;
+  }
+  sample.stackAddr = regs.sp;
+  sample.stack = stack;
+}
+
+[[gnu::noinline]] void level2(unwind::Sample& sample, std::string& stack) {
+  capture(sample, stack);
+  asm volatile("");
+}
+
+[[gnu::noinline]] void level1(unwind::Sample& sample, std::string& stack) {
+  level2(sample, stack);
+  asm volatile("");
+}
+
+void put64(std::string& out, uint64_t val) {
+  for (unsigned i = 0; i < 8; i++) { out += char(val >> (8 * i)); }
+}
+
+}  // namespace
+
+int main(int, char**) {
+  unsigned errors = 0;
+
+  auto check = [&](bool ok, char const* what) {
+    if (!ok) {
+      std::cerr << "failed: " << what << '\n';
+      ++errors;
+    }
+  };
+
+  util::Alloc alloc;
+
+  // CFI of a synthetic binary: one CIE (CFA = rsp + 8, return address at
+  // CFA - 8, as on entry to an x86-64 function), and FDEs covering 100
+  // functions in groups of 10
+  GenELF::Options opts {.symbols = 100, .fdes = 10};
+  auto path = "/tmp/TestUnwind." + std::to_string(getpid()) + ".elf";
+  check(GenELF::write(opts, path.c_str()), "write synthetic ELF");
+  {
+    util::MMap mm(path);
+    auto bin = binary::Binary::at(mm.addr_, mm.size_, false, false);
+    check(bin, "parse synthetic ELF");
+    unwind::EhFrame cfi;
+    check(bin && cfi.build(*bin), "build CFI");
+    check(cfi.cieCount() == 1 && cfi.fdeCount() == 10, "CIE and FDE counts");
+    check(!cfi.skipped(), "nothing skipped");
+    unwind::Row row;
+    auto fn15 = GenELF::symbolAddr(opts, 15);
+    check(cfi.find(fn15 + 3, row), "find row");
+    check(row.cfa.kind == unwind::Rule::kRegister && row.cfa.reg == 7 &&
+              row.cfa.value == 8,
+          "CFA rule");
+    check(row.raReg == 16 && row.regs[16].kind == unwind::Rule::kOffset &&
+              row.regs[16].value == -8,
+          "return address rule");
+    check(row.start == GenELF::symbolAddr(opts, 10) &&
+              row.end == GenELF::symbolAddr(opts, 20),
+          "row range");
+    check(!cfi.find(GenELF::symbolAddr(opts, 100), row), "past the end");
+    check(!cfi.find(0x10, row), "before the start");
+  }
+
+  // Offline unwinding of synthetic stacks through that binary, loaded at
+  // some random address; each "function" just returns to the next
+  {
+    uint64_t base = 0x7f1200000000;
+    procinfo::ModuleMap modules;
+    modules.add({path,
+                 {},
+                 base,
+                 base + GenELF::kTextOffset,
+                 base + GenELF::symbolAddr(opts, 100)});
+    auto addr = [&](uint32_t fn, uint64_t off) {
+      return base + GenELF::symbolAddr(opts, fn) + off;
+    };
+    std::string stack;
+    put64(stack, addr(40, 5));  // fn3 returns into fn40
+    put64(stack, addr(77, 1));  // Which returns into fn77
+    put64(stack, 0);            // Which is the outermost frame
+    uint64_t sp = 0x7ffd0000;
+    unwind::Sample sample {&modules, {addr(3, 2), sp, 0, 0}, sp, stack};
+
+    unwind::Unwinder unwinder(unwind::Arch::x86_64(), 4);
+    check(unwinder.prepare(modules) == 1, "prepare");
+    uintptr_t pcs[8];
+    auto trace = unwinder.unwind(sample, pcs, 8);
+    check(trace.depth == 3 && trace.stop == unwind::Stop::kEnd, "depth");
+    check(pcs[0] == addr(3, 2) && pcs[1] == addr(40, 5) &&
+              pcs[2] == addr(77, 1),
+          "pcs");
+    check(!trace.fpFrames, "no frame pointers needed");
+
+    trace = unwinder.unwind(sample, pcs, 2);
+    check(trace.depth == 2 && trace.stop == unwind::Stop::kMaxDepth,
+          "max depth");
+
+    auto shortSample = sample;
+    shortSample.stack = std::string_view(stack).substr(0, 12);
+    trace = unwinder.unwind(shortSample, pcs, 8);
+    check(trace.depth == 2 && trace.stop == unwind::Stop::kStackEnd,
+          "stack end");
+
+    std::string wild = stack;
+    wild[8] = 0x42;  // Second return address now points outside the module
+    wild[12] = 0x42;
+    auto wildSample = sample;
+    wildSample.stack = wild;
+    trace = unwinder.unwind(wildSample, pcs, 8);
+    check(trace.depth == 3 && trace.stop == unwind::Stop::kNoModule,
+          "no module");
+
+    // Lots of samples at once: the same answers, from every thread
+    std::vector<unwind::Sample> samples(100000, sample);
+    for (size_t i = 0; i < samples.size(); i += 3) {
+      samples[i] = shortSample;
+    }
+    std::vector<uintptr_t> allPcs(samples.size() * 8);
+    std::vector<unwind::Trace> traces(samples.size());
+    auto stats = unwinder.unwind(
+        samples.data(), samples.size(), 8, allPcs.data(), traces.data());
+    bool same = true;
+    for (size_t i = 0; i < samples.size(); i++) {
+      auto want = (i % 3) ? 3u : 2u;
+      same = same && traces[i].depth == want;
+      same = same && allPcs[i * 8 + 1] == addr(40, 5);
+    }
+    check(same, "batch results");
+    auto shorts = (samples.size() + 2) / 3;
+    check(stats.samples == samples.size() &&
+              stats.frames == samples.size() * 3 - shorts,
+          "batch stats");
+    auto& stops = stats.stops;
+    check(stops[size_t(unwind::Stop::kStackEnd)] == shorts &&
+              stops[size_t(unwind::Stop::kEnd)] == samples.size() - shorts,
+          "batch stops");
+    check(stats.binaries == 1 && !stats.indexed, "CFI index reused");
+    check(stats.chunks == (samples.size() + 1023) / 1024, "batch chunks");
+
+    // A batch on another map leaves those already prepared usable
+    procinfo::ModuleMap otherModules;
+    for (auto& mod : modules) { otherModules.add(mod); }
+    auto otherSample = sample;
+    otherSample.modules = &otherModules;
+    stats = unwinder.unwind(&otherSample, 1, 8, allPcs.data(), traces.data());
+    check(stats.binaries == 1 && traces[0].depth == 3, "other map");
+    trace = unwinder.unwind(sample, pcs, 8);
+    check(trace.depth == 3 && trace.stop == unwind::Stop::kEnd,
+          "prepared map kept");
+
+    // Single samples on one thread, while batches on new maps are prepared
+    std::atomic<bool> done {false};
+    std::atomic<unsigned> wrong {0};
+    std::thread single([&] {
+      uintptr_t threadPcs[8];
+      while (!done) {
+        auto t = unwinder.unwind(sample, threadPcs, 8);
+        if (t.depth != 3 || threadPcs[2] != addr(77, 1)) { ++wrong; }
+      }
+    });
+    std::vector<std::unique_ptr<procinfo::ModuleMap>> moreMaps;
+    for (unsigned i = 0; i < 64; i++) {
+      moreMaps.push_back(std::make_unique<procinfo::ModuleMap>());
+      for (auto& mod : modules) { moreMaps.back()->add(mod); }
+      auto batchSample = sample;
+      batchSample.modules = moreMaps.back().get();
+      unwinder.unwind(&batchSample, 1, 8, allPcs.data(), traces.data());
+      if (traces[0].depth != 3) { ++wrong; }
+    }
+    done = true;
+    single.join();
+    check(!wrong, "concurrent batches and single samples");
+  }
+  unlink(path.c_str());
+
+  // This process's own stack, unwound from a copy, with its binaries' CFI
+  {
+    unwind::Sample sample {};
+    std::string stack;
+    level1(sample, stack);
+    procinfo::ModuleMap modules;
+    check(modules.refresh(), "module map");
+    sample.modules = &modules;
+
+    unwind::Unwinder unwinder;
+    check(unwinder.prepare(modules) >= 2, "own binaries have CFI");
+    uintptr_t pcs[64];
+    auto trace = unwinder.unwind(sample, pcs, 64);
+    check(trace.stop == unwind::Stop::kEnd, "unwound to the end");
+    check(!trace.fpFrames, "all by CFI");
+
+    // Check the innermost frames by name
+    symbolize::ProcessSymbols symbols;
+    check(symbols.refresh(), "symbols");
+    std::string names;
+    for (size_t i = 0; i < trace.depth; i++) {
+      auto res = symbols.resolve(pcs[i], i);
+      names += res ? std::string(res.symbol->name) : "?";
+      names += ' ';
+    }
+    auto capture = names.find("capture");
+    auto level2 = names.find("level2");
+    auto level1 = names.find("level1");
+    auto main = names.find("main ");
+    bool inOrder = capture < level2 && level2 < level1 && level1 < main &&
+                   main != names.npos;
+    check(inOrder, "frames");
+    if (!inOrder) { std::cerr << "frames: " << names << '\n'; }
+  }
+
+  assert(!errors);
+}
@@ -0,0 +1,148 @@
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <proginfo/binary/WindowedBinary.h>
+#include <proginfo/symbolize/SymbolIndex.h>
+#include <proginfo/util/Alloc.h>
+#include <proginfo/util/MMap.h>
+#include <proginfo/util/WindowedFile.h>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using namespace proginfo;
+
+namespace {
+
+uint8_t patternAt(size_t offset) {
+  return uint8_t((offset * 131) ^ (offset >> 9));
+}
+
+/** Pages of `[addr, addr + size)` in memory, per `mincore`. */
+size_t residentPages(void const* addr, size_t size) {
+  auto page = size_t(sysconf(_SC_PAGESIZE));
+  std::vector<unsigned char> vec((size + page - 1) / page);
+  if (mincore((void*) addr, size, vec.data())) { return ~size_t(0); }
+  size_t ret = 0;
+  for (auto v : vec) { ret += v & 1; }
+  return ret;
+}
+
+}  // namespace
+
+int main(int, char**) {
+  unsigned errors = 0;
+  util::Alloc alloc;
+
+  auto check = [&](bool ok, char const* what) {
+    if (!ok) {
+      std::cerr << "failed: " << what << '\n';
+      ++errors;
+    }
+  };
+
+  constexpr size_t kWindow = util::WindowedFile::kWindow;
+
+  // A file of 4MB and a bit, read through a cache of 4 windows
+  {
+    auto path = "/tmp/TestWindowed." + std::to_string(getpid());
+    constexpr size_t kSize = (size_t(4) << 20) + 12345;
+    {
+      std::vector<uint8_t> bytes(kSize);
+      for (size_t i = 0; i < kSize; i++) { bytes[i] = patternAt(i); }
+      auto* f = fopen(path.c_str(), "wb");
+      check(f && fwrite(bytes.data(), 1, kSize, f) == kSize, "write file");
+      if (f) { fclose(f); }
+    }
+    util::WindowedFile file(path, 4 * kWindow);
+    unlink(path.c_str());
+    check(bool(file) && file.size() == kSize, "open");
+    auto same = [&](util::WindowedFile::Pin const& pin, size_t offset) {
+      auto str = pin.str();
+      for (size_t i = 0; i < str.size(); i++) {
+        if (uint8_t(str[i]) != patternAt(offset + i)) { return false; }
+      }
+      return true;
+    };
+
+    // Across a window boundary: both windows, in one read
+    auto pin = file.fetch(kWindow - 10, 20);
+    check(pin && pin.str().size() == 20 && same(pin, kWindow - 10), "fetch");
+    check(pin.addr().ptr_ == file.addr().ptr_ + kWindow - 10, "in place");
+    auto s = file.stats();
+    check(s.reads == 1 && s.bytesRead == 2 * kWindow, "one read");
+    check(s.resident == 2 * kWindow && s.pinned == 2 * kWindow, "pinned");
+
+    // Again: already in memory
+    auto again = file.fetch(kWindow, 5);
+    check(again && same(again, kWindow) && file.stats().reads == 1, "reuse");
+
+    // Clipped at the end of the file; past it, empty
+    auto tail = file.fetch(kSize - 5, 100);
+    check(tail && tail.str().size() == 5 && same(tail, kSize - 5), "clipped");
+    auto past = file.fetch(kSize, 10);
+    check(past && past.str().empty(), "past the end");
+
+    // Many more windows than fit: the least recently used unpinned ones go,
+    // but pinned ones stay (and are still right)
+    for (size_t off = 0; off < kSize; off += kWindow / 2) {
+      auto p = file.fetch(off, 100);
+      check(p && same(p, off), "scan");
+    }
+    s = file.stats();
+    check(s.evictions > 50 && s.resident <= 4 * kWindow + s.pinned, "bounded");
+    check(same(pin, kWindow - 10) && same(tail, kSize - 5), "pinned kept");
+    pin.reset();
+    again.reset();
+    tail.reset();
+    s = file.stats();
+    check(!s.pinned && s.resident <= 4 * kWindow, "unpinned");
+    auto page = size_t(sysconf(_SC_PAGESIZE));
+    check(residentPages(file.addr().ptr_, file.size()) * page <= 4 * kWindow,
+          "RSS bounded");
+
+    // Pinned windows may go over budget, until unpinned
+    auto big = file.fetch(0, 8 * kWindow);
+    check(big && same(big, 0) && file.stats().resident >= 8 * kWindow,
+          "over budget while pinned");
+    big.reset();
+    check(file.stats().resident <= 4 * kWindow, "back within budget");
+    file.clear();
+    check(!file.stats().resident, "clear");
+
+    util::WindowedFile missing("/nonexistent/TestWindowed");
+    check(!missing && missing.error() == ENOENT, "missing file");
+  }
+
+  // A binary, of which only the headers and the sections used are read
+  {
+    util::WindowedFile file("/proc/self/exe", 16 * kWindow);
+    binary::WindowedBinary bin(file);
+    check(bool(bin) && bin->isELF(), "windowed binary");
+    if (!bin) { return 1; }
+    check(bin->section(".text") && bin->section(".symtab"), "sections");
+    auto symtab = bin.fetch(".symtab");
+    auto strtab = bin.fetch(".strtab");
+    check(symtab && strtab, "fetch symbols");
+    symbolize::SymbolIndex index;
+    check(index.build(*bin), "build index");
+
+    util::MMap mm("/proc/self/exe");
+    auto mapped = binary::Binary::at(mm.addr_, mm.size_, false, false);
+    symbolize::SymbolIndex expected;
+    expected.build(*mapped);
+    auto* got = index.find("main");
+    auto* want = expected.find("main");
+    check(got && want && got->addr == want->addr, "same symbols");
+    auto* found = want ? index.lookup(want->addr + 1) : nullptr;
+    check(found && found->name == "main", "same lookups");
+    check(file.stats().bytesRead < file.size() / 2, "only what's needed");
+  }
+
+  assert(!errors);
+  return 0;
+}
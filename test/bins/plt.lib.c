@@ -0,0 +1,4 @@
+int puts(char const*);
+int getpid(void);
+
+int hello(void) { return puts("hello") + getpid(); }
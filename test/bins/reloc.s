@@ -0,0 +1,42 @@
+# References to named symbols (not sections), as relocations in a section
+# which isn't allocated, like DWARF's: `make` assembles this for x86 (with
+# `I386` defined) and x86-64.
+
+	.data
+	.zero	4
+	.globl	counter
+counter:
+	.long	42
+
+	.section .tdata,"awT",@progbits
+	.zero	8
+	.globl	tlsData
+tlsData:
+	.long	1
+	.zero	4
+
+# Not allocated next to `.tdata` in the file; they're together in the TLS block
+	.section .rodata,"a",@progbits
+	.long	7
+
+	.section .tbss,"awT",@nobits
+	.zero	4
+	.globl	tlsBss
+tlsBss:
+	.zero	4
+
+	.section .debug_str,"MS",@progbits,1
+	.string	"first"
+	.globl	second
+second:
+	.string	"second"
+
+	.section .refs,"",@progbits
+	.long	second
+	.long	counter
+	.long	tlsData@dtpoff
+	.long	tlsBss@dtpoff
+.ifndef I386
+	.quad	second
+	.quad	tlsData@dtpoff
+.endif